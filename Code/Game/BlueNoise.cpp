@@ -0,0 +1,302 @@
+#include "Game/BlueNoise.hpp"
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace
+{
+	constexpr char BLUE_NOISE_CACHE_MAGIC[4] = { 'B', 'N', 'V', 'C' };
+	constexpr int BLUE_NOISE_CACHE_VERSION = 1;
+
+	struct BlueNoiseCacheHeader
+	{
+		char magic[4];
+		int version;
+		int width;
+		int height;
+		int depth;
+		float sigma;
+		float initialFill;
+		unsigned int seed;
+	};
+
+	// Binary pattern plus its Gaussian energy, kept in sync as points are added and removed
+	class VoidAndClusterPattern
+	{
+	public:
+		VoidAndClusterPattern(const IntVec3& dimensions, float sigma)
+			: m_dimensions(dimensions)
+		{
+			// Truncate at 3 sigma, but never wider than half the texture so a wrapped offset isn't counted twice
+			int radius = (int)ceilf(3.f * sigma);
+			m_radius = IntVec3(GetRadiusForAxis(radius, dimensions.x), GetRadiusForAxis(radius, dimensions.y), GetRadiusForAxis(radius, dimensions.z));
+
+			float inverseTwoSigmaSquared = 1.f / (2.f * sigma * sigma);
+			for (int dz = -m_radius.z; dz <= m_radius.z; ++dz)
+			{
+				for (int dy = -m_radius.y; dy <= m_radius.y; ++dy)
+				{
+					for (int dx = -m_radius.x; dx <= m_radius.x; ++dx)
+					{
+						m_weights.push_back(expf(-(float)(dx * dx + dy * dy + dz * dz) * inverseTwoSigmaSquared));
+					}
+				}
+			}
+
+			int numTexels = dimensions.x * dimensions.y * dimensions.z;
+			m_isSet.assign(numTexels, 0);
+			m_energy.assign(numTexels, 0.f);
+		}
+
+		void Set(int index, bool isSet)
+		{
+			m_isSet[index] = isSet ? 1 : 0;
+			Splat(index, isSet ? 1.f : -1.f);
+		}
+
+		bool IsSet(int index) const { return m_isSet[index] != 0; }
+		int GetNumTexels() const { return (int)m_isSet.size(); }
+
+		int FindTightestCluster() const
+		{
+			int bestIndex = -1;
+			float bestEnergy = -1e30f;
+			for (int index = 0; index < GetNumTexels(); ++index)
+			{
+				if (m_isSet[index] && m_energy[index] > bestEnergy)
+				{
+					bestEnergy = m_energy[index];
+					bestIndex = index;
+				}
+			}
+			return bestIndex;
+		}
+
+		int FindLargestVoid() const
+		{
+			int bestIndex = -1;
+			float bestEnergy = 1e30f;
+			for (int index = 0; index < GetNumTexels(); ++index)
+			{
+				if (!m_isSet[index] && m_energy[index] < bestEnergy)
+				{
+					bestEnergy = m_energy[index];
+					bestIndex = index;
+				}
+			}
+			return bestIndex;
+		}
+
+	private:
+		static int GetRadiusForAxis(int radius, int size)
+		{
+			return (radius < (size - 1) / 2) ? radius : (size - 1) / 2;
+		}
+
+		void Splat(int index, float sign)
+		{
+			int width = m_dimensions.x;
+			int height = m_dimensions.y;
+			int depth = m_dimensions.z;
+
+			int x = index % width;
+			int y = (index / width) % height;
+			int z = index / (width * height);
+
+			int weightIndex = 0;
+			for (int dz = -m_radius.z; dz <= m_radius.z; ++dz)
+			{
+				int wz = (z + dz + depth) % depth;
+				for (int dy = -m_radius.y; dy <= m_radius.y; ++dy)
+				{
+					int wy = (y + dy + height) % height;
+					for (int dx = -m_radius.x; dx <= m_radius.x; ++dx)
+					{
+						int wx = (x + dx + width) % width;
+						m_energy[(wz * height + wy) * width + wx] += sign * m_weights[weightIndex++];
+					}
+				}
+			}
+		}
+
+	private:
+		IntVec3 m_dimensions;
+		IntVec3 m_radius;
+		std::vector<float> m_weights;
+		std::vector<unsigned char> m_isSet;
+		std::vector<float> m_energy;
+	};
+}
+
+void BlueNoiseTexture::Generate(const BlueNoiseConfig& config)
+{
+	m_config = config;
+
+	VoidAndClusterPattern pattern(config.dimensions, config.sigma);
+	int numTexels = pattern.GetNumTexels();
+
+	// 1) Random initial pattern
+	int numInitial = (int)(config.initialFill * (float)numTexels);
+	if (numInitial < 1)
+	{
+		numInitial = 1;
+	}
+
+	std::mt19937 random(config.seed);
+	std::uniform_int_distribution<int> texelDistribution(0, numTexels - 1);
+	for (int placed = 0; placed < numInitial;)
+	{
+		int index = texelDistribution(random);
+		if (!pattern.IsSet(index))
+		{
+			pattern.Set(index, true);
+			++placed;
+		}
+	}
+
+	// 2) Move the tightest cluster into the largest void until that no longer changes anything
+	for (int iteration = 0; iteration < numTexels; ++iteration)
+	{
+		int cluster = pattern.FindTightestCluster();
+		pattern.Set(cluster, false);
+
+		int largestVoid = pattern.FindLargestVoid();
+		pattern.Set(largestVoid, true);
+
+		if (largestVoid == cluster)
+		{
+			break;
+		}
+	}
+
+	std::vector<int> ranks(numTexels, 0);
+
+	// 3) Rank the initial points by removing tightest clusters first
+	VoidAndClusterPattern removal = pattern;
+	for (int rank = numInitial - 1; rank >= 0; --rank)
+	{
+		int cluster = removal.FindTightestCluster();
+		removal.Set(cluster, false);
+		ranks[cluster] = rank;
+	}
+
+	// 4) Rank the rest by filling the largest void each time
+	for (int rank = numInitial; rank < numTexels; ++rank)
+	{
+		int largestVoid = pattern.FindLargestVoid();
+		pattern.Set(largestVoid, true);
+		ranks[largestVoid] = rank;
+	}
+
+	m_values.resize(numTexels);
+	for (int index = 0; index < numTexels; ++index)
+	{
+		m_values[index] = ((float)ranks[index] + 0.5f) / (float)numTexels;
+	}
+}
+
+void BlueNoiseTexture::LoadOrGenerate(const BlueNoiseConfig& config, const std::string& cacheDirectory)
+{
+	std::string filePath = cacheDirectory + "/" + GetCacheFileName(config);
+	if (LoadFromFile(config, filePath))
+	{
+		return;
+	}
+
+	Generate(config);
+
+	// A failed write only costs a regeneration next run
+	std::error_code error;
+	std::filesystem::create_directories(cacheDirectory, error);
+	SaveToFile(filePath);
+}
+
+bool BlueNoiseTexture::LoadFromFile(const BlueNoiseConfig& config, const std::string& filePath)
+{
+	std::ifstream file(filePath, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	BlueNoiseCacheHeader header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file || memcmp(header.magic, BLUE_NOISE_CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != BLUE_NOISE_CACHE_VERSION)
+	{
+		return false;
+	}
+
+	if (header.width != config.dimensions.x || header.height != config.dimensions.y || header.depth != config.dimensions.z ||
+		header.sigma != config.sigma || header.initialFill != config.initialFill || header.seed != config.seed)
+	{
+		return false;
+	}
+
+	std::vector<float> values((size_t)header.width * header.height * header.depth);
+	file.read(reinterpret_cast<char*>(values.data()), (std::streamsize)(values.size() * sizeof(float)));
+	if (!file)
+	{
+		return false;
+	}
+
+	m_config = config;
+	m_values.swap(values);
+	return true;
+}
+
+bool BlueNoiseTexture::SaveToFile(const std::string& filePath) const
+{
+	std::ofstream file(filePath, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	BlueNoiseCacheHeader header;
+	memcpy(header.magic, BLUE_NOISE_CACHE_MAGIC, sizeof(header.magic));
+	header.version = BLUE_NOISE_CACHE_VERSION;
+	header.width = m_config.dimensions.x;
+	header.height = m_config.dimensions.y;
+	header.depth = m_config.dimensions.z;
+	header.sigma = m_config.sigma;
+	header.initialFill = m_config.initialFill;
+	header.seed = m_config.seed;
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(m_values.data()), (std::streamsize)(m_values.size() * sizeof(float)));
+	return file.good();
+}
+
+std::string BlueNoiseTexture::GetCacheFileName(const BlueNoiseConfig& config)
+{
+	return "BlueNoise_" + std::to_string(config.dimensions.x) + "x" + std::to_string(config.dimensions.y) + "x" + std::to_string(config.dimensions.z) +
+		"_" + std::to_string(config.seed) + ".bin";
+}
+
+float BlueNoiseTexture::GetValue(int x, int y, int z) const
+{
+	int width = m_config.dimensions.x;
+	int height = m_config.dimensions.y;
+	int depth = m_config.dimensions.z;
+
+	x = ((x % width) + width) % width;
+	y = ((y % height) + height) % height;
+	z = ((z % depth) + depth) % depth;
+
+	return m_values[((size_t)z * height + y) * width + x];
+}
+
+RayJitterGPU BlueNoiseTexture::GetRayJitterForFrame(unsigned int frameIndex, float strength)
+{
+	// Golden ratio rotation for the value, R2 sequence for the texel offset
+	float frame = (float)(frameIndex % 65536u);
+
+	RayJitterGPU jitter;
+	jitter.rotation = frame * 0.618034f - floorf(frame * 0.618034f);
+	jitter.offsetX = (int)((frame * 0.754878f - floorf(frame * 0.754878f)) * (float)BLUE_NOISE_SIZE);
+	jitter.offsetY = (int)((frame * 0.569840f - floorf(frame * 0.569840f)) * (float)BLUE_NOISE_SIZE);
+	jitter.strength = strength;
+	return jitter;
+}
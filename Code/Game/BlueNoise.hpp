@@ -0,0 +1,54 @@
+#pragma once
+#include "Engine/Math/IntVec3.hpp"
+#include <string>
+#include <vector>
+
+// Edge length of the 2D ray-start jitter texture uploaded to the cloud shaders
+constexpr int BLUE_NOISE_SIZE = 64;
+
+struct BlueNoiseConfig
+{
+	IntVec3 dimensions = IntVec3(BLUE_NOISE_SIZE, BLUE_NOISE_SIZE, 1);	// Depth of 1 gives a 2D texture
+	float sigma = 1.5f;				// Gaussian energy filter width in texels
+	float initialFill = 0.1f;		// Fraction of texels set in the initial binary pattern
+	unsigned int seed = 0;
+};
+
+// Per-frame jitter parameters (must match RayJitter in CloudShader.hlsl and CloudShadowShader.hlsl)
+struct RayJitterGPU
+{
+	int textureSize = BLUE_NOISE_SIZE;
+	int offsetX = 0;
+	int offsetY = 0;
+	float rotation = 0.f;			// Added to every texel then wrapped, so each frame gets a new blue-noise pattern
+	float strength = 1.f;			// Fraction of a step to jitter by, 0 disables
+	float padding[3] = {};
+};
+
+// Tileable void-and-cluster blue noise (Ulichney 1993). Values are ranks normalized to [0,1), stored x-fastest.
+class BlueNoiseTexture
+{
+public:
+	BlueNoiseTexture() = default;
+
+	void Generate(const BlueNoiseConfig& config);
+
+	// Reads the texture from cacheDirectory if a matching file exists, otherwise generates and writes it
+	void LoadOrGenerate(const BlueNoiseConfig& config, const std::string& cacheDirectory);
+	bool LoadFromFile(const BlueNoiseConfig& config, const std::string& filePath);
+	bool SaveToFile(const std::string& filePath) const;
+	static std::string GetCacheFileName(const BlueNoiseConfig& config);
+
+	float GetValue(int x, int y, int z = 0) const;
+
+	IntVec3 GetDimensions() const { return m_config.dimensions; }
+	const std::vector<float>& GetValues() const { return m_values; }
+	bool IsGenerated() const { return !m_values.empty(); }
+
+	// Frame-dependent rotation and texel offset that decorrelate consecutive frames
+	static RayJitterGPU GetRayJitterForFrame(unsigned int frameIndex, float strength);
+
+private:
+	BlueNoiseConfig m_config;
+	std::vector<float> m_values;
+};
@@ -279,6 +279,13 @@ void Cloud::Update(float deltaSeconds, const Weather& weather)
 	UNUSED(deltaSeconds);
 	UNUSED(weather);
 
+	FitBoundingBox();
+	//Vec3 wind = weather.m_windDirection * weather.m_windSpeed * deltaSeconds;
+	//m_center += wind;
+}
+
+void Cloud::FitBoundingBox()
+{
 	Vec3 mins = Vec3(m_center - m_voxelDimensions * .5f);
 	Vec3 maxs = Vec3(m_center + m_voxelDimensions * .5f);
 
@@ -306,8 +313,6 @@ void Cloud::Update(float deltaSeconds, const Weather& weather)
 	}
 
 	boundingBox = AABB3(mins, maxs);
-	//Vec3 wind = weather.m_windDirection * weather.m_windSpeed * deltaSeconds;
-	//m_center += wind;
 }
 
 CloudGPU Cloud::GetCloudGPU(unsigned int& voxelOffset, unsigned int& densityOffset) const
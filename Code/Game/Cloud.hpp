@@ -14,6 +14,8 @@ enum class ECloudType
 	CLOUD_COUNT
 };
 
+// One placed cloud. The voxels and octree belong to its prototype and are shared by every instance of it, in
+// prototype space: world = center + prototype * scale. The bounds are the instance's, in world space.
 struct CloudGPU
 {
 	Vec3 center;
@@ -25,8 +27,22 @@ struct CloudGPU
 	unsigned int octreeIndex;
 	//unsigned int densityOffset; // Offset into density buffer
 	//unsigned int densityCount;  // Number of density values
+	float scale = 1.f;
+	float densityScale = 1.f;
+	Vec3 noiseOffset;			// Added to world positions before the noise lookups, so instances don't look alike
+	unsigned int prototypeIndex = 0;
 };
 
+inline Vec3 GetPrototypePosition(const CloudGPU& cloud, const Vec3& worldPosition)
+{
+	return (worldPosition - cloud.center) * (1.f / cloud.scale);
+}
+
+inline Vec3 GetWorldPosition(const CloudGPU& cloud, const Vec3& prototypePosition)
+{
+	return cloud.center + prototypePosition * cloud.scale;
+}
+
 class Cloud
 {
 public:
@@ -43,6 +59,7 @@ public:
 	void GenerateDensityField(int width, int height, int depth, float noiseScale, float noiseThreshold);
 
 	void Update(float deltaSeconds, const Weather& weather);
+	void FitBoundingBox();		// To the voxel positions, a voxel across each way
 
 	CloudGPU GetCloudGPU(unsigned int& voxelOffset, unsigned int& densityOffset) const;
 //IndexedVertexBufferData BuildVerts();
@@ -58,6 +75,9 @@ public:
 	std::vector<float> GetDensityField() const;
 
 	bool NeedsRebuild() const;
+
+	// CPU bytes of the generated data: the density field, voxel positions and voxels
+	size_t GetMemoryBytes() const { return m_densityField.capacity() * sizeof(float) + m_voxelPositions.capacity() * sizeof(Vec3) + m_voxels.capacity() * sizeof(Voxel); }
 private:
 	//void AddVoxelVertices(IntVec3 location);
 
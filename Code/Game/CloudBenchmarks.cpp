@@ -0,0 +1,727 @@
+#include "Game/CloudBenchmarks.hpp"
+#include "Game/app.hpp"
+#include "Game/Game.hpp"
+#include "Game/GameCommon.hpp"
+#include "Game/GameRenderBackend.hpp"
+#include "Game/Player.hpp"
+#include "Game/CloudRayMarcher.hpp"
+#include "Game/CloudRayCost.hpp"
+#include "Game/CloudTemporalReprojection.hpp"
+#include "Game/CloudUpsample.hpp"
+#include "Game/CloudStepPolicy.hpp"
+#include "Game/CloudSunTransmittance.hpp"
+#include "Game/CloudOpacityShadowMap.hpp"
+#include "Game/CloudNoiseVolumes.hpp"
+#include "Engine/Core/DevConsole.hpp"
+#include "Engine/Renderer/Camera.hpp"
+#include <algorithm>
+#include <chrono>
+
+extern DevConsole* g_theConsole;
+
+//-----------------------------------------------------------------------------------------------
+static bool Event_LoadCloudPreset(EventArgs& args)
+{
+	// e.g. LoadCloudPreset name=Benchmark, from the presets in Data/GameConfig.xml
+	std::string presetName = args.GetValue("name", "Default");
+	bool wasApplied = g_theApp->m_theGame->m_singleCloudManager->ApplyParameterPreset(presetName);
+	g_theConsole->AddLine(wasApplied ? Rgba8(0, 200, 0, 200) : Rgba8(200, 0, 0, 200),
+		Stringf("%s cloud preset %s", wasApplied ? "Applied" : "No", presetName.c_str()));
+	return true;
+}
+
+static bool Event_SaveCloudPreset(EventArgs& args)
+{
+	// e.g. SaveCloudPreset name=Overcast; replaces a preset with the same name
+	std::string presetName = args.GetValue("name", "Default");
+	bool wasSaved = g_theApp->m_theGame->m_singleCloudManager->GetParameters().SavePreset(CLOUD_PRESETS_FILE_PATH, presetName);
+	g_theConsole->AddLine(wasSaved ? Rgba8(0, 200, 0, 200) : Rgba8(200, 0, 0, 200),
+		Stringf("%s cloud preset %s to %s", wasSaved ? "Saved" : "Failed to save", presetName.c_str(), CLOUD_PRESETS_FILE_PATH));
+	return true;
+}
+
+static CloudRayMarchCamera GetPlayerRayMarchCamera(Game* game, int width, int height)
+{
+	const Camera& playerCam = game->m_player->m_playerCam;
+	Mat44 cameraOrientation = playerCam.m_orientation.GetMatrix_XFwd_YLeft_ZUp();
+
+	CloudRayMarchCamera camera;
+	camera.position = playerCam.m_position;
+	camera.forward = cameraOrientation.GetIBasis3D();
+	camera.left = cameraOrientation.GetJBasis3D();
+	camera.up = cameraOrientation.GetKBasis3D();
+	camera.fovDegrees = 60.f;
+	camera.aspect = (float)width / (float)height;
+	return camera;
+}
+
+// What the CPU cloud events share: the current scene and sliders, the noise volumes (noiseSize=128) and the player's
+// view. Marchers hold references to the scene and noise, so a bench stays where it was made.
+struct CpuCloudBench
+{
+	CloudRayMarchScene scene;
+	CloudRayMarchSettings settings;
+	CloudNoiseVolumes noiseVolumes;
+	CloudRayMarchCamera camera;
+	const CurlNoiseField* windField = nullptr;
+
+	// A marcher with the wind field, on these settings or a changed copy of them
+	CloudRayMarcher MakeMarcher(const CloudRayMarchSettings& marcherSettings) const
+	{
+		CloudRayMarcher marcher(scene, noiseVolumes, marcherSettings);
+		marcher.SetWindField(windField);
+		return marcher;
+	}
+};
+
+static void MakeCpuCloudBench(EventArgs& args, int width, int height, CpuCloudBench& outBench)
+{
+	Game* game = g_theApp->m_theGame;
+	game->m_singleCloudManager->BuildRayMarchScene(outBench.scene, outBench.settings);
+
+	CloudNoiseVolumesConfig noiseConfig;
+	noiseConfig.size = args.GetValue("noiseSize", 128);
+	outBench.noiseVolumes.LoadOrBake(noiseConfig);
+
+	outBench.camera = GetPlayerRayMarchCamera(game, width, height);
+	outBench.windField = &game->m_singleCloudManager->GetWindField();
+}
+
+// RMSE of the density and alpha channels against a reference of the same size; with a mask, over its pixels only
+static double ComputeImageRmse(const FloatImage& image, const FloatImage& reference, const std::vector<bool>* pixelMask = nullptr)
+{
+	double squaredError = 0.0;
+	int numPixels = 0;
+	for (int pixelIndex = 0; pixelIndex < (int)image.GetPixels().size(); ++pixelIndex)
+	{
+		if (pixelMask != nullptr && !(*pixelMask)[pixelIndex])
+		{
+			continue;
+		}
+
+		const Vec4& pixel = image.GetPixels()[pixelIndex];
+		const Vec4& referencePixel = reference.GetPixels()[pixelIndex];
+		squaredError += ((pixel.x - referencePixel.x) * (pixel.x - referencePixel.x) + (pixel.w - referencePixel.w) * (pixel.w - referencePixel.w)) * 0.5;
+		numPixels++;
+	}
+	return sqrt(squaredError / (double)(numPixels > 0 ? numPixels : 1));
+}
+
+static bool Event_RenderCloudsCPU(EventArgs& args)
+{
+	// e.g. RenderCloudsCPU width=1382 height=691 threads=0 noiseSize=128 packet=8 grid=1 heatmaps=1 file=Data/CloudReference
+	// heatmaps=1 also writes one false-colour cost image per counter (file_Steps.png, ...) and logs their percentiles
+	IntVec2 clientDimensions = g_theRenderBackend->GetRenderDimensions();
+
+	int width = args.GetValue("width", clientDimensions.x);
+	int height = args.GetValue("height", clientDimensions.y);
+	int numThreads = args.GetValue("threads", 0);
+	std::string filePath = args.GetValue("file", "Data/CloudReference");
+
+	CpuCloudBench bench;
+	MakeCpuCloudBench(args, width, height, bench);
+	bench.settings.packetSize = args.GetValue("packet", 1);
+	bench.settings.useOccupancyGrid = args.GetValue("grid", 0) != 0;
+	CloudRayMarcher marcher = bench.MakeMarcher(bench.settings);
+
+	bool writeHeatmaps = args.GetValue("heatmaps", 0) != 0;
+	CloudRayCostMap costMap;
+
+	FloatImage image(width, height);
+	marcher.Render(bench.camera, image, numThreads, nullptr, writeHeatmaps ? &costMap : nullptr);
+
+	const CloudRayMarchStats& stats = marcher.GetStats();
+	g_theConsole->AddLine(Rgba8(200, 200, 0, 200), Stringf("CPU clouds %dx%d: %.3f s, %lld rays, %.1f steps/ray, %lld noise samples, %lld interval refills",
+		width, height, stats.seconds, stats.numRays, (double)stats.numSteps / (double)(stats.numRays > 0 ? stats.numRays : 1), stats.numNoiseSamples,
+		stats.numIntervalRefills));
+
+	if (writeHeatmaps)
+	{
+		bool wroteHeatmaps = true;
+		for (int channelIndex = 0; channelIndex < (int)CloudRayCostChannel::COUNT; ++channelIndex)
+		{
+			CloudRayCostChannel channel = (CloudRayCostChannel)channelIndex;
+			CloudRayCostSummary summary = costMap.Summarize(channel);
+			g_theConsole->AddLine(Rgba8(200, 200, 0, 200), Stringf("%-20s mean %.1f, p50 %.1f, p90 %.1f, p99 %.1f, max %.1f",
+				CloudRayCostMap::GetChannelName(channel), summary.meanValue, summary.p50, summary.p90, summary.p99, summary.maxValue));
+
+			std::string channelName = CloudRayCostMap::GetChannelName(channel);
+			channelName.erase(std::remove(channelName.begin(), channelName.end(), ' '), channelName.end());
+
+			FloatImage heatmap;
+			costMap.RenderHeatmap(channel, heatmap);
+			wroteHeatmaps &= heatmap.WritePNG(filePath + "_" + channelName + ".png");
+		}
+		g_theConsole->AddLine(wroteHeatmaps ? Rgba8(0, 200, 0, 200) : Rgba8(200, 0, 0, 200),
+			Stringf("%s %s_*.png cost heatmaps", wroteHeatmaps ? "Wrote" : "Failed to write", filePath.c_str()));
+	}
+
+	bool wrotePNG = image.WritePNG(filePath + ".png");
+	bool wroteEXR = image.WriteEXR(filePath + ".exr");
+	g_theConsole->AddLine((wrotePNG && wroteEXR) ? Rgba8(0, 200, 0, 200) : Rgba8(200, 0, 0, 200),
+		Stringf("%s %s.png / .exr", (wrotePNG && wroteEXR) ? "Wrote" : "Failed to write", filePath.c_str()));
+
+	return true;
+}
+
+static bool Event_BenchmarkCloudsCPU(EventArgs& args)
+{
+	// e.g. BenchmarkCloudsCPU width=1382 height=691 threads=0 repeats=3 intervals=1, on the startup CreateTest scene
+	int width = args.GetValue("width", 1382);
+	int height = args.GetValue("height", 691);
+	int numThreads = args.GetValue("threads", 0);
+	int numRepeats = args.GetValue("repeats", 3);
+
+	CpuCloudBench bench;
+	MakeCpuCloudBench(args, width, height, bench);
+	CloudRayMarchSettings& settings = bench.settings;
+	settings.useCloudIntervals = args.GetValue("intervals", 1) != 0;
+
+	// Packets vectorize the BoxSDF search over every cloud only with intervals=0; with intervals (the default) they
+	// walk each lane's short interval list instead, so the speedups there don't measure that search
+	if (settings.useCloudIntervals)
+	{
+		g_theConsole->AddLine(Rgba8(200, 200, 0, 200), "Cloud intervals on: the SSE search over every cloud only runs with intervals=0");
+	}
+
+	FloatImage reference(width, height);
+	double singleRaySeconds = 0.0;
+	// Single rays on the octree are the reference; the last row swaps the octree for the DDA occupancy grid
+	const int packetSizes[] = { 1, 4, 8, 1 };
+	const bool useOccupancyGrids[] = { false, false, false, true };
+
+	for (int run = 0; run < 4; ++run)
+	{
+		int packetSize = packetSizes[run];
+		settings.packetSize = packetSize;
+		settings.useOccupancyGrid = useOccupancyGrids[run];
+		CloudRayMarcher marcher = bench.MakeMarcher(settings);
+
+		// Best of N, since the first pass also warms the caches
+		FloatImage image(width, height);
+		double bestSeconds = 0.0;
+		for (int repeat = 0; repeat < numRepeats; ++repeat)
+		{
+			marcher.Render(bench.camera, image, numThreads);
+			if (repeat == 0 || marcher.GetStats().seconds < bestSeconds)
+			{
+				bestSeconds = marcher.GetStats().seconds;
+			}
+		}
+
+		if (run == 0)
+		{
+			reference = image;
+			singleRaySeconds = bestSeconds;
+		}
+
+		float maxDifference = 0.f;
+		for (int pixelIndex = 0; pixelIndex < (int)image.GetPixels().size(); ++pixelIndex)
+		{
+			const Vec4& pixel = image.GetPixels()[pixelIndex];
+			const Vec4& referencePixel = reference.GetPixels()[pixelIndex];
+			maxDifference = fmaxf(maxDifference, fabsf(pixel.x - referencePixel.x));
+			maxDifference = fmaxf(maxDifference, fabsf(pixel.w - referencePixel.w));
+		}
+
+		const CloudRayMarchStats& stats = marcher.GetStats();
+		g_theConsole->AddLine(Rgba8(200, 200, 0, 200), Stringf("%d-ray packets, %s %dx%d: %.3f s (%.2fx single), %lld steps, max diff %.2e",
+			packetSize, settings.useOccupancyGrid ? "grid DDA" : "octree", width, height, bestSeconds, singleRaySeconds / bestSeconds, stats.numSteps, maxDifference));
+	}
+
+	return true;
+}
+
+static bool Event_CompareCloudEstimatorsCPU(EventArgs& args)
+{
+	// e.g. CompareCloudEstimatorsCPU width=691 height=345 threads=0 ratio=1 referenceDivisor=8
+	// Error against cost: a fine-step march is the reference, then the default march and delta tracking at 1/4/16 spp
+	int width = args.GetValue("width", 691);
+	int height = args.GetValue("height", 345);
+	int numThreads = args.GetValue("threads", 0);
+	float referenceDivisor = args.GetValue("referenceDivisor", 8.f);
+
+	CpuCloudBench bench;
+	MakeCpuCloudBench(args, width, height, bench);
+	CloudRayMarchSettings& settings = bench.settings;
+	settings.useRatioTrackingShadows = args.GetValue("ratio", 0) != 0;
+	float defaultMinStepSize = settings.minStepSize;
+
+	int blockSize = settings.pixelBlockSize;
+	double numBlocks = (double)(((width + blockSize - 1) / blockSize) * ((height + blockSize - 1) / blockSize));
+
+	FloatImage reference(width, height);
+	const char* runNames[] = { "reference march", "march", "delta 1 spp", "delta 4 spp", "delta 16 spp" };
+	const int samplesPerPixel[] = { 1, 1, 1, 4, 16 };
+
+	for (int run = 0; run < 5; ++run)
+	{
+		settings.estimator = (run < 2) ? CloudTransmittanceEstimator::RAY_MARCH : CloudTransmittanceEstimator::DELTA_TRACKING;
+		settings.minStepSize = (run == 0) ? defaultMinStepSize / referenceDivisor : defaultMinStepSize;
+		settings.samplesPerPixel = samplesPerPixel[run];
+
+		CloudRayMarcher marcher = bench.MakeMarcher(settings);
+
+		FloatImage image(width, height);
+		marcher.Render(bench.camera, image, numThreads);
+		if (run == 0)
+		{
+			reference = image;
+		}
+		double rmse = ComputeImageRmse(image, reference);
+
+		const CloudRayMarchStats& stats = marcher.GetStats();
+		g_theConsole->AddLine(Rgba8(200, 200, 0, 200), Stringf("%-16s %.3f s, RMSE %.4f, %.1f density lookups/pixel, %.1f steps/pixel",
+			runNames[run], stats.seconds, rmse, (double)stats.numDensityLookups / numBlocks, (double)stats.numSteps / numBlocks));
+	}
+
+	return true;
+}
+
+// Scripted fly-through for the temporal benchmark: drifts forward while turning left
+static CloudRayMarchCamera GetScriptedPathCamera(const CloudRayMarchCamera& start, int frameIndex, float speed, float turnDegreesPerFrame)
+{
+	float yawRadians = (float)frameIndex * turnDegreesPerFrame * 3.14159265f / 180.f;
+	float cosYaw = cosf(yawRadians);
+	float sinYaw = sinf(yawRadians);
+
+	// Rotate the basis about world up
+	CloudRayMarchCamera camera = start;
+	camera.forward = Vec3(start.forward.x * cosYaw - start.forward.y * sinYaw, start.forward.x * sinYaw + start.forward.y * cosYaw, start.forward.z);
+	camera.left = Vec3(start.left.x * cosYaw - start.left.y * sinYaw, start.left.x * sinYaw + start.left.y * cosYaw, start.left.z);
+	camera.up = Vec3(start.up.x * cosYaw - start.up.y * sinYaw, start.up.x * sinYaw + start.up.y * cosYaw, start.up.z);
+	camera.position = start.position + camera.forward * (speed * (float)frameIndex);
+	return camera;
+}
+
+static bool Event_BenchmarkTemporalCloudsCPU(EventArgs& args)
+{
+	// e.g. BenchmarkTemporalCloudsCPU width=691 height=345 frames=32 speed=1 turn=0.25 threads=0
+	// Every frame is also marched at full resolution as the reference; the error is what replication or reprojection
+	// loses against it (ghosting and blur), the cost is the rays actually marched
+	int width = args.GetValue("width", 691);
+	int height = args.GetValue("height", 345);
+	int numFrames = args.GetValue("frames", 32);
+	int numThreads = args.GetValue("threads", 0);
+	float speed = args.GetValue("speed", 1.f);
+	float turnDegreesPerFrame = args.GetValue("turn", 0.25f);
+	float frameSeconds = 1.f / 60.f;
+
+	CpuCloudBench bench;
+	MakeCpuCloudBench(args, width, height, bench);
+	CloudRayMarchSettings& settings = bench.settings;
+	float startTime = settings.timeElapsed;
+	Vec3 cloudDrift = GetCloudNoiseVelocity(settings.scrollFactor, settings.noiseScale, settings.voxelDimensions) * frameSeconds;
+
+	// Replicated blocks like ComputeMain, then the amortized modes
+	const char* modeNames[] = { "replicate 2x2", "replicate 4x4", "temporal 2x2", "temporal 4x4" };
+	const int blockSizes[] = { 2, 4, 2, 4 };
+	CloudTemporalReprojector temporal2x2(bench.scene.clouds, 2, settings.maxDistance);
+	CloudTemporalReprojector temporal4x4(bench.scene.clouds, 4, settings.maxDistance);
+
+	double squaredErrorSum[4] = {};
+	double seconds[4] = {};
+	long long numRays[4] = {};
+	double referenceSeconds = 0.0;
+
+	for (int frameIndex = 0; frameIndex < numFrames; ++frameIndex)
+	{
+		CloudRayMarchCamera camera = GetScriptedPathCamera(bench.camera, frameIndex, speed, turnDegreesPerFrame);
+		settings.timeElapsed = startTime + (float)frameIndex * frameSeconds;
+
+		CloudRayMarchSettings referenceSettings = settings;
+		referenceSettings.pixelBlockSize = 1;
+		CloudRayMarcher referenceMarcher = bench.MakeMarcher(referenceSettings);
+		FloatImage reference(width, height);
+		referenceMarcher.Render(camera, reference, numThreads);
+		referenceSeconds += referenceMarcher.GetStats().seconds;
+
+		for (int mode = 0; mode < 4; ++mode)
+		{
+			bool isTemporal = mode >= 2;
+			CloudTemporalReprojector& reprojector = (blockSizes[mode] == 4) ? temporal4x4 : temporal2x2;
+
+			CloudRayMarchSettings modeSettings = settings;
+			modeSettings.pixelBlockSize = blockSizes[mode];
+			if (isTemporal)
+			{
+				IntVec2 phase = reprojector.GetFramePhase();
+				modeSettings.blockSampleX = phase.x;
+				modeSettings.blockSampleY = phase.y;
+			}
+
+			CloudRayMarcher marcher = bench.MakeMarcher(modeSettings);
+			FloatImage image(width, height);
+			marcher.Render(camera, image, numThreads);
+			seconds[mode] += marcher.GetStats().seconds;
+			numRays[mode] += marcher.GetStats().numRays;
+
+			if (isTemporal)
+			{
+				FloatImage resolved;
+				reprojector.Resolve(image, camera, cloudDrift, resolved);
+				image = resolved;
+			}
+
+			double rmse = ComputeImageRmse(image, reference);
+			squaredErrorSum[mode] += rmse * rmse;
+		}
+	}
+
+	g_theConsole->AddLine(Rgba8(200, 200, 0, 200), Stringf("Full-res reference: %.3f s/frame over %d frames", referenceSeconds / (double)numFrames, numFrames));
+	for (int mode = 0; mode < 4; ++mode)
+	{
+		g_theConsole->AddLine(Rgba8(200, 200, 0, 200), Stringf("%-14s RMSE %.4f, %.3f s/frame, %lld rays/frame",
+			modeNames[mode], sqrt(squaredErrorSum[mode] / (double)numFrames), seconds[mode] / (double)numFrames, numRays[mode] / numFrames));
+	}
+
+	const CloudTemporalStats& stats = temporal4x4.GetStats();
+	g_theConsole->AddLine(Rgba8(200, 200, 0, 200), Stringf("temporal 4x4: %lld reprojected, %lld rejected, %lld fresh pixels",
+		stats.numReprojected, stats.numRejected, stats.numFresh));
+
+	return true;
+}
+
+static bool Event_CompareCloudUpsamplingCPU(EventArgs& args)
+{
+	// e.g. CompareCloudUpsamplingCPU width=691 height=345 sigma=0.1 threads=0
+	// Replicated blocks, plain bilinear and the depth-aware upsample at 2x2 and 4x4, against a full-res march.
+	// Edge pixels are the ones whose scene depth or reference alpha jumps within their 3x3 neighbourhood.
+	int width = args.GetValue("width", 691);
+	int height = args.GetValue("height", 345);
+	int numThreads = args.GetValue("threads", 0);
+	float depthSigma = args.GetValue("sigma", 0.1f);
+
+	CpuCloudBench bench;
+	MakeCpuCloudBench(args, width, height, bench);
+	const CloudRayMarchSettings& settings = bench.settings;
+
+	CloudRayMarchSettings referenceSettings = settings;
+	referenceSettings.pixelBlockSize = 1;
+	CloudRayMarcher referenceMarcher = bench.MakeMarcher(referenceSettings);
+	FloatImage reference(width, height);
+	FloatImage referenceDepth;
+	referenceMarcher.Render(bench.camera, reference, numThreads, &referenceDepth);
+
+	std::vector<bool> isEdge((size_t)width * height, false);
+	int numEdgePixels = 0;
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			const Vec4& center = reference.GetPixel(x, y);
+			float centerDepth = referenceDepth.GetPixel(x, y).y;
+			for (int offsetY = -1; offsetY <= 1 && !isEdge[(size_t)y * width + x]; ++offsetY)
+			{
+				for (int offsetX = -1; offsetX <= 1; ++offsetX)
+				{
+					int neighbourX = x + offsetX;
+					int neighbourY = y + offsetY;
+					if (neighbourX < 0 || neighbourY < 0 || neighbourX >= width || neighbourY >= height)
+					{
+						continue;
+					}
+
+					float neighbourDepth = referenceDepth.GetPixel(neighbourX, neighbourY).y;
+					if (fabsf(reference.GetPixel(neighbourX, neighbourY).w - center.w) > 0.25f || fabsf(neighbourDepth - centerDepth) > depthSigma * centerDepth)
+					{
+						isEdge[(size_t)y * width + x] = true;
+						numEdgePixels++;
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	g_theConsole->AddLine(Rgba8(200, 200, 0, 200), Stringf("Full-res reference: %.3f s, %lld rays, %d edge pixels", referenceMarcher.GetStats().seconds, referenceMarcher.GetStats().numRays, numEdgePixels));
+
+	const int factors[] = { 2, 4 };
+	for (int factor : factors)
+	{
+		CloudRayMarchSettings blockSettings = settings;
+		blockSettings.pixelBlockSize = factor;
+		CloudRayMarcher marcher = bench.MakeMarcher(blockSettings);
+		FloatImage replicated(width, height);
+		FloatImage blockDepth;
+		marcher.Render(bench.camera, replicated, numThreads, &blockDepth);
+
+		CloudUpsampleSettings upsampleSettings;
+		upsampleSettings.factor = factor;
+		upsampleSettings.maxDistance = settings.maxDistance;
+
+		FloatImage bilinear;
+		upsampleSettings.depthSigma = 0.f;
+		UpsampleCloudsBilateral(replicated, blockDepth, bench.scene.occluders, bench.camera, upsampleSettings, bilinear);
+
+		FloatImage bilateral;
+		upsampleSettings.depthSigma = depthSigma;
+		std::chrono::steady_clock::time_point upsampleStart = std::chrono::steady_clock::now();
+		UpsampleCloudsBilateral(replicated, blockDepth, bench.scene.occluders, bench.camera, upsampleSettings, bilateral);
+		double upsampleSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - upsampleStart).count();
+
+		const char* modeNames[] = { "replicate", "bilinear", "bilateral" };
+		const FloatImage* images[] = { &replicated, &bilinear, &bilateral };
+		for (int mode = 0; mode < 3; ++mode)
+		{
+			g_theConsole->AddLine(Rgba8(200, 200, 0, 200), Stringf("%dx%d %-9s RMSE %.4f, edge RMSE %.4f", factor, factor, modeNames[mode],
+				ComputeImageRmse(*images[mode], reference), ComputeImageRmse(*images[mode], reference, &isEdge)));
+		}
+		g_theConsole->AddLine(Rgba8(200, 200, 0, 200), Stringf("%dx%d march %.3f s, %lld rays, upsample %.3f s", factor, factor,
+			marcher.GetStats().seconds, marcher.GetStats().numRays, upsampleSeconds));
+	}
+
+	return true;
+}
+
+static bool Event_CompareCloudStepPoliciesCPU(EventArgs& args)
+{
+	// e.g. CompareCloudStepPoliciesCPU width=691 height=345 tolerance=0.01 maxMultiplier=8 referenceScale=0.25 histogram=false threads=0
+	// Each step policy at the current slider settings, against a fixed-step march at referenceScale * minStepSize
+	int width = args.GetValue("width", 691);
+	int height = args.GetValue("height", 345);
+	int numThreads = args.GetValue("threads", 0);
+	float referenceScale = args.GetValue("referenceScale", 0.25f);
+	bool printHistogram = args.GetValue("histogram", false);
+
+	CpuCloudBench bench;
+	MakeCpuCloudBench(args, width, height, bench);
+	CloudRayMarchSettings& settings = bench.settings;
+	settings.pixelBlockSize = 1;
+	settings.stepErrorTolerance = args.GetValue("tolerance", settings.stepErrorTolerance);
+	settings.maxStepMultiplier = args.GetValue("maxMultiplier", settings.maxStepMultiplier);
+
+	CloudRayMarchSettings referenceSettings = settings;
+	referenceSettings.stepPolicy = CloudStepPolicyType::FIXED;
+	referenceSettings.minStepSize = settings.minStepSize * referenceScale;
+	CloudRayMarcher referenceMarcher = bench.MakeMarcher(referenceSettings);
+	FloatImage reference(width, height);
+	referenceMarcher.Render(bench.camera, reference, numThreads);
+	g_theConsole->AddLine(Rgba8(200, 200, 0, 200), Stringf("Fixed-step reference (step %.3f): %.3f s, %.1f steps/ray", referenceSettings.minStepSize,
+		referenceMarcher.GetStats().seconds, referenceMarcher.GetStats().stepsPerRay.GetMean()));
+
+	const CloudStepPolicyType policyTypes[] = { CloudStepPolicyType::SHADER, CloudStepPolicyType::FIXED, CloudStepPolicyType::DENSITY_ADAPTIVE,
+		CloudStepPolicyType::DISTANCE_ADAPTIVE, CloudStepPolicyType::ERROR_CONTROLLED };
+	for (CloudStepPolicyType policyType : policyTypes)
+	{
+		CloudRayMarchSettings policySettings = settings;
+		policySettings.stepPolicy = policyType;
+		CloudRayMarcher marcher = bench.MakeMarcher(policySettings);
+		FloatImage image(width, height);
+		marcher.Render(bench.camera, image, numThreads);
+
+		const CloudRayMarchStats& stats = marcher.GetStats();
+		const CloudRayHistogram& steps = stats.stepsPerRay;
+		g_theConsole->AddLine(Rgba8(200, 200, 0, 200), Stringf("%-9s RMSE %.4f, %.3f s, steps/ray mean %.1f p50 %d p95 %d max %d, samples/ray %.1f, nodes/ray %.1f, %.1f%% early out",
+			marcher.GetStepPolicy().GetName(), ComputeImageRmse(image, reference), stats.seconds, steps.GetMean(), steps.GetPercentile(0.5f),
+			steps.GetPercentile(0.95f), steps.maxValue, stats.densitySamplesPerRay.GetMean(), stats.nodesVisitedPerRay.GetMean(),
+			100.0 * (double)stats.numEarlyTerminations / (double)(steps.numRays > 0 ? steps.numRays : 1)));
+
+		if (printHistogram)
+		{
+			for (int bucketIndex = 0; bucketIndex < CLOUD_RAY_HISTOGRAM_BUCKETS; ++bucketIndex)
+			{
+				if (steps.buckets[bucketIndex] > 0)
+				{
+					g_theConsole->AddLine(Rgba8(200, 200, 0, 200), Stringf("    <= %5d steps: %lld rays", CloudRayHistogram::GetBucketUpperBound(bucketIndex), steps.buckets[bucketIndex]));
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+static bool Event_BenchmarkSunTransmittanceCPU(EventArgs& args)
+{
+	// e.g. BenchmarkSunTransmittanceCPU cellsPerVoxel=2 samples=1 points=2000 threads=0
+	// Builds the volumes at the current sun and sliders, re-sweeps them for a rotated sun, and checks the lookup
+	// against a fine march towards the sun through the same cloud at random points with density
+	int numPoints = args.GetValue("points", 2000);
+	CloudSunTransmittanceConfig config;
+	config.cellsPerVoxel = args.GetValue("cellsPerVoxel", config.cellsPerVoxel);
+	config.samplesPerAxis = args.GetValue("samples", config.samplesPerAxis);
+	config.numThreads = args.GetValue("threads", 0);
+
+	IntVec2 clientDimensions = g_theRenderBackend->GetRenderDimensions();
+	CpuCloudBench bench;
+	MakeCpuCloudBench(args, clientDimensions.x, clientDimensions.y, bench);
+	const CloudRayMarchScene& scene = bench.scene;
+	const CloudRayMarchSettings& settings = bench.settings;
+	if (scene.clouds.empty())
+	{
+		return false;
+	}
+
+	CloudRayMarcher marcher = bench.MakeMarcher(settings);
+	CloudSunTransmittanceVolumes volumes;
+	volumes.Build(scene, marcher, config, 1);
+	CloudSunTransmittanceStats buildStats = volumes.GetStats();
+
+	RandomNumberGenerator rng;
+	CloudRayMarchStats samplingStats;
+	Vec3 directionToSun = settings.sunDirection.GetNormalized() * -1.f;
+	float referenceStep = 0.05f * settings.voxelDimensions.x;
+	double errorSum = 0.0;
+	double unshadowedErrorSum = 0.0;
+	int numMeasured = 0;
+	for (int attempt = 0; attempt < numPoints * 20 && numMeasured < numPoints; ++attempt)
+	{
+		int cloudIndex = rng.RollRandomIntInRange(0, (int)scene.clouds.size() - 1);
+		const CloudGPU& cloud = scene.clouds[cloudIndex];
+		Vec3 position = Vec3(rng.RollRandomFloatInRange(cloud.minBounds.x, cloud.maxBounds.x), rng.RollRandomFloatInRange(cloud.minBounds.y, cloud.maxBounds.y),
+			rng.RollRandomFloatInRange(cloud.minBounds.z, cloud.maxBounds.z));
+		if (marcher.SampleCloudExtinction(cloudIndex, position, samplingStats) <= 0.f)
+		{
+			continue;
+		}
+
+		double opticalDepth = 0.0;
+		for (float distance = 0.5f * referenceStep; ; distance += referenceStep)
+		{
+			Vec3 samplePosition = position + directionToSun * distance;
+			if (samplePosition.x < cloud.minBounds.x || samplePosition.y < cloud.minBounds.y || samplePosition.z < cloud.minBounds.z ||
+				samplePosition.x > cloud.maxBounds.x || samplePosition.y > cloud.maxBounds.y || samplePosition.z > cloud.maxBounds.z)
+			{
+				break;
+			}
+			opticalDepth += marcher.SampleCloudExtinction(cloudIndex, samplePosition, samplingStats) * referenceStep;
+		}
+
+		double reference = exp(-opticalDepth);
+		errorSum += fabs(volumes.Sample(cloudIndex, position) - reference);
+		unshadowedErrorSum += 1.0 - reference;
+		numMeasured++;
+	}
+
+	// A sun that moved only re-sweeps the cached extinction
+	CloudRayMarchSettings rotatedSettings = settings;
+	rotatedSettings.sunDirection = Vec3(-settings.sunDirection.y, settings.sunDirection.x, settings.sunDirection.z);
+	CloudRayMarcher rotatedMarcher = bench.MakeMarcher(rotatedSettings);
+	volumes.Build(scene, rotatedMarcher, config, 1);
+
+	g_theConsole->AddLine(Rgba8(200, 200, 0, 200), Stringf("%lld cells (%.1f KB): density %.1f ms, sweep %.2f ms, sun-only rebuild %.2f ms",
+		buildStats.numCells, (double)volumes.GetMemoryBytes() / 1024.0, buildStats.extinctionSeconds * 1000.0, buildStats.sweepSeconds * 1000.0, volumes.GetStats().sweepSeconds * 1000.0));
+	g_theConsole->AddLine(Rgba8(200, 200, 0, 200), Stringf("Mean |error| vs fine march over %d points: %.4f (unshadowed %.4f)",
+		numMeasured, errorSum / (double)(numMeasured > 0 ? numMeasured : 1), unshadowedErrorSum / (double)(numMeasured > 0 ? numMeasured : 1)));
+	return true;
+}
+
+static bool Event_CompareOpacityShadowMapCPU(EventArgs& args)
+{
+	// e.g. CompareOpacityShadowMapCPU size=512 halfExtent=500 step=1 points=2000 threads=0
+	// Builds the Fourier opacity map from the current light camera and checks it, and the old first depth / opacity /
+	// last depth map with its 3x3 PCF, against a march down each point's own light ray at random points with density
+	int numPoints = args.GetValue("points", 2000);
+	CloudOpacityShadowMapConfig config;
+	config.width = args.GetValue("size", 512);
+	config.height = config.width;
+	config.stepSize = args.GetValue("step", config.stepSize);
+	config.numThreads = args.GetValue("threads", 0);
+	CloudOpacityShadowFrame frame = g_theApp->m_theGame->MakeLightShadowFrame();
+	frame.halfExtent = args.GetValue("halfExtent", frame.halfExtent);
+
+	IntVec2 clientDimensions = g_theRenderBackend->GetRenderDimensions();
+	CpuCloudBench bench;
+	MakeCpuCloudBench(args, clientDimensions.x, clientDimensions.y, bench);
+	const CloudRayMarchScene& scene = bench.scene;
+	if (scene.clouds.empty())
+	{
+		return false;
+	}
+
+	CloudRayMarcher marcher = bench.MakeMarcher(bench.settings);
+	CloudOpacityShadowMap opacityMap;
+	opacityMap.Build(scene, marcher, frame, config);
+
+	RandomNumberGenerator rng;
+	CloudRayMarchStats samplingStats;
+	double fourierErrorSum = 0.0;
+	double startEndErrorSum = 0.0;
+	double unshadowedErrorSum = 0.0;
+	int numMeasured = 0;
+	for (int attempt = 0; attempt < numPoints * 20 && numMeasured < numPoints; ++attempt)
+	{
+		int cloudIndex = rng.RollRandomIntInRange(0, (int)scene.clouds.size() - 1);
+		const CloudGPU& cloud = scene.clouds[cloudIndex];
+		Vec3 position = Vec3(rng.RollRandomFloatInRange(cloud.minBounds.x, cloud.maxBounds.x), rng.RollRandomFloatInRange(cloud.minBounds.y, cloud.maxBounds.y),
+			rng.RollRandomFloatInRange(cloud.minBounds.z, cloud.maxBounds.z));
+		if (marcher.SampleCloudExtinction(cloudIndex, position, samplingStats) <= 0.f)
+		{
+			continue;
+		}
+
+		double reference = CloudOpacityShadowMap::TraceTransmittance(scene, marcher, frame, position, config.stepSize);
+		fourierErrorSum += fabs(opacityMap.Sample(position) - reference);
+		startEndErrorSum += fabs(opacityMap.SampleStartEnd(position) - reference);
+		unshadowedErrorSum += 1.0 - reference;
+		numMeasured++;
+	}
+
+	const CloudOpacityShadowMapStats& stats = opacityMap.GetStats();
+	double divisor = (double)(numMeasured > 0 ? numMeasured : 1);
+	g_theConsole->AddLine(Rgba8(200, 200, 0, 200), Stringf("%dx%d opacity map, %lld texels in cloud, %lld extinction samples: %.1f ms, depths %.3f-%.3f",
+		config.width, config.height, stats.numTexelsInCloud, stats.numExtinctionSamples, stats.seconds * 1000.0, opacityMap.GetDepthRange().depthMin, opacityMap.GetDepthRange().depthMax));
+	g_theConsole->AddLine(Rgba8(200, 200, 0, 200), Stringf("Mean |error| over %d points: Fourier %.4f, start/end PCF %.4f (unshadowed %.4f)",
+		numMeasured, fourierErrorSum / divisor, startEndErrorSum / divisor, unshadowedErrorSum / divisor));
+	return true;
+}
+
+static bool Event_ScatterClouds(EventArgs& args)
+{
+	// e.g. ScatterClouds count=200 halfExtent=2000 seed=1
+	// Places more instances of the existing prototypes; their voxels and octrees are not duplicated
+	CloudManager* manager = g_theApp->m_theGame->m_singleCloudManager;
+	int numInstances = args.GetValue("count", 100);
+	float halfExtent = args.GetValue("halfExtent", 1000.f);
+	int seed = args.GetValue("seed", 1);
+	manager->ScatterInstances(numInstances, halfExtent, (unsigned int)seed);
+
+	const CloudPrototypeLibrary& prototypes = manager->GetPrototypes();
+	g_theConsole->AddLine(Rgba8(200, 200, 0, 200), Stringf("%d cloud instances of %d prototypes, %d prototype voxels",
+		(int)manager->GetCloudInstances().size(), prototypes.GetNumPrototypes(), (int)prototypes.GetNumVoxels()));
+	return true;
+}
+
+static bool Event_CloudMemory(EventArgs& args)
+{
+	// e.g. CloudMemory budget=64 sets the budget in MB first (0 = none); the levels follow on the next update
+	CloudManager* manager = g_theApp->m_theGame->m_singleCloudManager;
+	std::string budget = args.GetValue("budget", "");
+	if (!budget.empty())
+	{
+		manager->GetParameters().SetValueFromString("memoryBudgetMB", budget);
+		manager->UpdateMemoryBudget();
+	}
+
+	const double megabyte = 1024.0 * 1024.0;
+	const CloudMemoryReport& report = manager->GetMemoryReport();
+	for (const CloudMemoryUsage& usage : report.GetUsages())
+	{
+		g_theConsole->AddLine(Rgba8(200, 200, 0, 200), Stringf("%-28s CPU %8.2f MB  GPU %8.2f MB", usage.name, usage.cpuBytes / megabyte, usage.gpuBytes / megabyte));
+	}
+	g_theConsole->AddLine(Rgba8(200, 200, 0, 200), Stringf("%-28s CPU %8.2f MB  GPU %8.2f MB", "Total", report.GetTotalCpuBytes() / megabyte,
+		report.GetTotalGpuBytes() / megabyte));
+
+	const CloudMemoryBudgetResult& result = manager->GetMemoryBudget();
+	g_theConsole->AddLine(result.fitsBudget ? Rgba8(0, 200, 0, 200) : Rgba8(200, 0, 0, 200), Stringf("Budget levels: %d full, %d coarse, %d evicted; %.2f MB estimated, %.2f MB at full detail",
+		(int)result.levels.size() - result.numCoarse - result.numEvicted, result.numCoarse, result.numEvicted, result.numBytes / megabyte, result.numBytesFull / megabyte));
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------
+void SubscribeCloudBenchmarkEvents()
+{
+	SubscribeEventCallbackFunction("LoadCloudPreset", Event_LoadCloudPreset);
+	SubscribeEventCallbackFunction("SaveCloudPreset", Event_SaveCloudPreset);
+	SubscribeEventCallbackFunction("RenderCloudsCPU", Event_RenderCloudsCPU);
+	SubscribeEventCallbackFunction("BenchmarkCloudsCPU", Event_BenchmarkCloudsCPU);
+	SubscribeEventCallbackFunction("CompareCloudEstimatorsCPU", Event_CompareCloudEstimatorsCPU);
+	SubscribeEventCallbackFunction("BenchmarkTemporalCloudsCPU", Event_BenchmarkTemporalCloudsCPU);
+	SubscribeEventCallbackFunction("CompareCloudUpsamplingCPU", Event_CompareCloudUpsamplingCPU);
+	SubscribeEventCallbackFunction("CompareCloudStepPoliciesCPU", Event_CompareCloudStepPoliciesCPU);
+	SubscribeEventCallbackFunction("BenchmarkSunTransmittanceCPU", Event_BenchmarkSunTransmittanceCPU);
+	SubscribeEventCallbackFunction("CompareOpacityShadowMapCPU", Event_CompareOpacityShadowMapCPU);
+	SubscribeEventCallbackFunction("ScatterClouds", Event_ScatterClouds);
+	SubscribeEventCallbackFunction("CloudMemory", Event_CloudMemory);
+}
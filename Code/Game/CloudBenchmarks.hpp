@@ -0,0 +1,5 @@
+#pragma once
+
+// The dev console's cloud commands: CPU reference renders, benchmarks and comparisons against them, cloud presets,
+// scattering instances and the memory report. Game subscribes them once at construction.
+void SubscribeCloudBenchmarkEvents();
@@ -0,0 +1,94 @@
+#include "Game/CloudDebugVoxels.hpp"
+#include "Engine/Core/VertexUtils.hpp"
+#include "Engine/Math/AABB3.hpp"
+#include <chrono>
+
+//-----------------------------------------------------------------------------------------------
+CloudDebugVoxelView::CloudDebugVoxelView()
+{
+	AddVertsForAABB3D(m_unitCube, AABB3(Vec3(-0.5f, -0.5f, -0.5f), Vec3(0.5f, 0.5f, 0.5f)), Rgba8(255, 255, 255, 255));
+}
+
+void CloudDebugVoxelView::SetEnabled(bool isEnabled)
+{
+	if (isEnabled == m_isEnabled)
+	{
+		return;
+	}
+
+	m_isEnabled = isEnabled;
+	if (!m_isEnabled)
+	{
+		std::vector<CloudDebugVoxelInstance>().swap(m_instances);
+		std::vector<Vertex_PCU>().swap(m_verts);
+		m_isBuilt = false;
+		m_stats.numInstances = 0;
+		m_stats.numSkipped = 0;
+		m_stats.numVertexes = 0;
+	}
+}
+
+bool CloudDebugVoxelView::NeedsRebuild(unsigned int sceneVersion) const
+{
+	return m_isEnabled && (!m_isBuilt || m_builtSceneVersion != sceneVersion);
+}
+
+std::vector<CloudDebugVoxelInstance>& CloudDebugVoxelView::BeginInstances()
+{
+	m_instances.clear();
+	return m_instances;
+}
+
+void CloudDebugVoxelView::Build(const Vec3& voxelSize, unsigned int sceneVersion)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	m_stats.numSkipped = 0;
+	if ((int)m_instances.size() > m_maxInstances)
+	{
+		m_stats.numSkipped = (int)m_instances.size() - m_maxInstances;
+		m_instances.resize((size_t)m_maxInstances);
+	}
+
+	float maxDensity = 0.f;
+	for (const CloudDebugVoxelInstance& instance : m_instances)
+	{
+		maxDensity = (instance.density > maxDensity) ? instance.density : maxDensity;
+	}
+
+	size_t numCubeVerts = m_unitCube.size();
+	m_verts.resize(m_instances.size() * numCubeVerts);
+	Vertex_PCU* vert = m_verts.data();
+	for (const CloudDebugVoxelInstance& instance : m_instances)
+	{
+		Rgba8 color = GetDensityColor(instance.density, maxDensity);
+		Vec3 size = voxelSize * instance.scale;
+		for (const Vertex_PCU& cubeVert : m_unitCube)
+		{
+			*vert = cubeVert;
+			vert->m_position = Vec3(instance.center.x + cubeVert.m_position.x * size.x, instance.center.y + cubeVert.m_position.y * size.y,
+				instance.center.z + cubeVert.m_position.z * size.z);
+			vert->m_color = color;
+			++vert;
+		}
+	}
+
+	m_isBuilt = true;
+	m_builtSceneVersion = sceneVersion;
+	m_stats.numInstances = (int)m_instances.size();
+	m_stats.numVertexes = (int)m_verts.size();
+	m_stats.numBuilds++;
+	m_stats.buildSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+}
+
+Rgba8 CloudDebugVoxelView::GetDensityColor(float density, float maxDensity)
+{
+	float t = (maxDensity > 0.f) ? density / maxDensity : 0.f;
+	t = (t < 0.f) ? 0.f : ((t > 1.f) ? 1.f : t);
+
+	// Rgba8::PURPLE toward white
+	unsigned char r = (unsigned char)(128.f + 127.f * t);
+	unsigned char g = (unsigned char)(255.f * t);
+	unsigned char b = (unsigned char)(128.f + 127.f * t);
+	return Rgba8(r, g, b, 255);
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "Engine/Math/Vec3.hpp"
+#include "Engine/Core/Rgba8.hpp"
+#include "Engine/Core/Vertex_PCU.hpp"
+#include <vector>
+
+// One voxel of the debug view: where it is, how big and how dense
+struct CloudDebugVoxelInstance
+{
+	Vec3 center;
+	float scale = 1.f;				// Of the voxel size, from the cloud instance it belongs to
+	float density = 0.f;
+};
+
+struct CloudDebugVoxelStats
+{
+	int numInstances = 0;
+	int numSkipped = 0;				// Voxels past the instance cap
+	int numVertexes = 0;
+	int numBuilds = 0;
+	double buildSeconds = 0.0;
+};
+
+// Voxel boxes for the debug view, built only while the view is shown. Each voxel is an instance record stamped
+// from one shared unit cube and coloured by density; hidden, it holds nothing and rebuilds cost it nothing.
+class CloudDebugVoxelView
+{
+public:
+	CloudDebugVoxelView();
+
+	// Hiding the view frees its vertexes; showing it again rebuilds on the next Sync
+	void SetEnabled(bool isEnabled);
+	bool IsEnabled() const { return m_isEnabled; }
+
+	void SetMaxInstances(int maxInstances) { m_maxInstances = maxInstances; }
+
+	// True when the view is shown and was last built for a different scene
+	bool NeedsRebuild(unsigned int sceneVersion) const;
+
+	// Fill the returned list, then Build stamps the cube at each instance
+	std::vector<CloudDebugVoxelInstance>& BeginInstances();
+	void Build(const Vec3& voxelSize, unsigned int sceneVersion);
+
+	const std::vector<CloudDebugVoxelInstance>& GetInstances() const { return m_instances; }
+	const std::vector<Vertex_PCU>& GetVerts() const { return m_verts; }
+	const CloudDebugVoxelStats& GetStats() const { return m_stats; }
+
+	// Thin voxels purple, dense ones white
+	static Rgba8 GetDensityColor(float density, float maxDensity);
+
+private:
+	bool m_isEnabled = false;
+	bool m_isBuilt = false;
+	unsigned int m_builtSceneVersion = 0;
+	int m_maxInstances = 1 << 15;
+	std::vector<Vertex_PCU> m_unitCube;		// Triangle list around the origin, one unit on a side
+	std::vector<CloudDebugVoxelInstance> m_instances;
+	std::vector<Vertex_PCU> m_verts;
+	CloudDebugVoxelStats m_stats;
+};
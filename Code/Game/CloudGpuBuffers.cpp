@@ -0,0 +1,234 @@
+#include "Game/CloudGpuBuffers.hpp"
+#include <cstdio>
+#include <cstring>
+
+//-----------------------------------------------------------------------------------------------
+void CloudBufferUploadStats::Add(const CloudBufferUploadStats& other)
+{
+	numCreates += other.numCreates;
+	numDestroys += other.numDestroys;
+	numUploads += other.numUploads;
+	numRanges += other.numRanges;
+	numElementsUploaded += other.numElementsUploaded;
+	numBytesUploaded += other.numBytesUploaded;
+}
+
+//-----------------------------------------------------------------------------------------------
+PersistentCloudBuffer::PersistentCloudBuffer(CloudBufferBackend& backend, size_t elementSize, size_t minCapacity)
+	: m_backend(backend)
+	, m_elementSize(elementSize)
+	, m_minCapacity((minCapacity > 0) ? minCapacity : 1)
+{
+}
+
+PersistentCloudBuffer::~PersistentCloudBuffer()
+{
+	if (m_handle != 0)
+	{
+		m_backend.DestroyBuffer(m_handle);
+	}
+}
+
+void PersistentCloudBuffer::Update(const void* elements, size_t numElements)
+{
+	Upload(elements, numElements, nullptr);
+}
+
+void PersistentCloudBuffer::Update(const void* elements, size_t numElements, const std::vector<CloudBufferRange>& changedRanges)
+{
+	Upload(elements, numElements, &changedRanges);
+}
+
+void PersistentCloudBuffer::Upload(const void* elements, size_t numElements, const std::vector<CloudBufferRange>* changedRanges)
+{
+	m_lastUpdateStats = CloudBufferUploadStats();
+	const unsigned char* bytes = static_cast<const unsigned char*>(elements);
+	m_dirtyRanges.clear();
+
+	if (m_handle == 0 || numElements > m_capacity)
+	{
+		size_t capacity = (m_capacity > 0) ? m_capacity : m_minCapacity;
+		while (capacity < numElements)
+		{
+			capacity *= 2;
+		}
+
+		if (m_handle != 0)
+		{
+			m_backend.DestroyBuffer(m_handle);
+			m_lastUpdateStats.numDestroys++;
+		}
+		m_handle = m_backend.CreateBuffer(capacity, m_elementSize);
+		m_capacity = capacity;
+		m_lastUpdateStats.numCreates++;
+
+		// A fresh buffer holds nothing worth keeping
+		if (numElements > 0)
+		{
+			m_dirtyRanges.push_back({ 0, numElements });
+		}
+	}
+	else if (changedRanges != nullptr)
+	{
+		m_dirtyRanges = *changedRanges;
+	}
+	else
+	{
+		FindChangedRanges(m_uploaded.data(), m_size, elements, numElements, m_elementSize, m_mergeGap, m_dirtyRanges);
+	}
+
+	if (!m_dirtyRanges.empty())
+	{
+		m_backend.UploadRanges(m_handle, elements, m_elementSize, m_dirtyRanges);
+		m_lastUpdateStats.numUploads++;
+		m_lastUpdateStats.numRanges = (int)m_dirtyRanges.size();
+		for (const CloudBufferRange& range : m_dirtyRanges)
+		{
+			m_lastUpdateStats.numElementsUploaded += (long long)range.numElements;
+		}
+		m_lastUpdateStats.numBytesUploaded = m_lastUpdateStats.numElementsUploaded * (long long)m_elementSize;
+	}
+
+	// Elements past the new size stay on the GPU but nothing indexes them. With known ranges only those are copied,
+	// so the frame does no work proportional to the whole buffer.
+	if (changedRanges != nullptr && m_lastUpdateStats.numCreates == 0)
+	{
+		m_uploaded.resize(numElements * m_elementSize);
+		for (const CloudBufferRange& range : m_dirtyRanges)
+		{
+			memcpy(m_uploaded.data() + range.firstElement * m_elementSize, bytes + range.firstElement * m_elementSize, range.numElements * m_elementSize);
+		}
+	}
+	else
+	{
+		m_uploaded.assign(bytes, bytes + numElements * m_elementSize);
+	}
+	m_size = numElements;
+	m_stats.Add(m_lastUpdateStats);
+}
+
+void PersistentCloudBuffer::FindDirtyRanges(const unsigned char* previous, const unsigned char* current, size_t numElements, size_t elementSize,
+	size_t mergeGap, std::vector<CloudBufferRange>& ranges)
+{
+	size_t element = 0;
+	while (element < numElements)
+	{
+		if (memcmp(previous + element * elementSize, current + element * elementSize, elementSize) == 0)
+		{
+			element++;
+			continue;
+		}
+
+		size_t first = element;
+		while (element < numElements && memcmp(previous + element * elementSize, current + element * elementSize, elementSize) != 0)
+		{
+			element++;
+		}
+
+		if (!ranges.empty() && ranges.back().firstElement + ranges.back().numElements + mergeGap >= first)
+		{
+			ranges.back().numElements = element - ranges.back().firstElement;
+		}
+		else
+		{
+			ranges.push_back({ first, element - first });
+		}
+	}
+}
+
+void PersistentCloudBuffer::FindChangedRanges(const void* previous, size_t numPrevious, const void* current, size_t numCurrent, size_t elementSize,
+	size_t mergeGap, std::vector<CloudBufferRange>& ranges)
+{
+	ranges.clear();
+
+	// Elements both versions have are compared; anything past the old size is new
+	size_t numShared = (numCurrent < numPrevious) ? numCurrent : numPrevious;
+	FindDirtyRanges(static_cast<const unsigned char*>(previous), static_cast<const unsigned char*>(current), numShared, elementSize, mergeGap, ranges);
+	if (numCurrent > numShared)
+	{
+		if (!ranges.empty() && ranges.back().firstElement + ranges.back().numElements + mergeGap >= numShared)
+		{
+			ranges.back().numElements = numCurrent - ranges.back().firstElement;
+		}
+		else
+		{
+			ranges.push_back({ numShared, numCurrent - numShared });
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------------------------
+int RecordingCloudBufferBackend::CreateBuffer(size_t capacity, size_t elementSize)
+{
+	Buffer buffer;
+	buffer.isLive = true;
+	buffer.elementSize = elementSize;
+	buffer.contents.assign(capacity * elementSize, 0);
+	m_buffers.push_back(buffer);
+
+	int handle = (int)m_buffers.size();
+	m_events.push_back({ EventType::CREATE, handle, 0, capacity, elementSize });
+	return handle;
+}
+
+void RecordingCloudBufferBackend::DestroyBuffer(int handle)
+{
+	Buffer& buffer = m_buffers[handle - 1];
+	buffer.isLive = false;
+	buffer.contents.clear();
+	m_events.push_back({ EventType::DESTROY, handle, 0, 0, buffer.elementSize });
+}
+
+void RecordingCloudBufferBackend::UploadRanges(int handle, const void* elements, size_t elementSize, const std::vector<CloudBufferRange>& ranges)
+{
+	Buffer& buffer = m_buffers[handle - 1];
+	const unsigned char* bytes = static_cast<const unsigned char*>(elements);
+	for (const CloudBufferRange& range : ranges)
+	{
+		memcpy(buffer.contents.data() + range.firstElement * elementSize, bytes + range.firstElement * elementSize, range.numElements * elementSize);
+		m_events.push_back({ EventType::UPLOAD, handle, range.firstElement, range.numElements, elementSize });
+	}
+}
+
+const std::vector<unsigned char>& RecordingCloudBufferBackend::GetContents(int handle) const
+{
+	return m_buffers[handle - 1].contents;
+}
+
+int RecordingCloudBufferBackend::GetNumLiveBuffers() const
+{
+	int numLive = 0;
+	for (const Buffer& buffer : m_buffers)
+	{
+		numLive += buffer.isLive ? 1 : 0;
+	}
+	return numLive;
+}
+
+std::string RecordingCloudBufferBackend::GetSummary() const
+{
+	int numCreates = 0;
+	int numDestroys = 0;
+	int numUploads = 0;
+	long long numBytes = 0;
+	for (const Event& event : m_events)
+	{
+		if (event.type == EventType::CREATE)
+		{
+			numCreates++;
+		}
+		else if (event.type == EventType::DESTROY)
+		{
+			numDestroys++;
+		}
+		else
+		{
+			numUploads++;
+			numBytes += (long long)(event.numElements * event.elementSize);
+		}
+	}
+
+	char summary[160];
+	snprintf(summary, sizeof(summary), "%d creates, %d destroys, %d range uploads, %lld bytes", numCreates, numDestroys, numUploads, numBytes);
+	return summary;
+}
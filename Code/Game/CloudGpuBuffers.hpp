@@ -0,0 +1,133 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Half-open element range [firstElement, firstElement + numElements)
+struct CloudBufferRange
+{
+	size_t firstElement = 0;
+	size_t numElements = 0;
+};
+
+// What the persistent buffers need from the renderer. Handles are the backend's own; 0 is never a buffer.
+class CloudBufferBackend
+{
+public:
+	virtual ~CloudBufferBackend() = default;
+
+	virtual int CreateBuffer(size_t capacity, size_t elementSize) = 0;
+	virtual void DestroyBuffer(int handle) = 0;
+
+	// elements is the whole array; only the ranges (sorted, disjoint) changed since the last upload
+	virtual void UploadRanges(int handle, const void* elements, size_t elementSize, const std::vector<CloudBufferRange>& ranges) = 0;
+};
+
+struct CloudBufferUploadStats
+{
+	int numCreates = 0;
+	int numDestroys = 0;
+	int numUploads = 0;				// Update calls that sent anything
+	int numRanges = 0;
+	long long numElementsUploaded = 0;
+	long long numBytesUploaded = 0;
+
+	void Add(const CloudBufferUploadStats& other);
+};
+
+// A structured buffer that outlives rebuilds. It grows by doubling, so a rebuild that fits reuses it, and keeps a
+// CPU copy of what it holds so each Update only sends the elements that differ, merged into a few ranges.
+class PersistentCloudBuffer
+{
+public:
+	PersistentCloudBuffer(CloudBufferBackend& backend, size_t elementSize, size_t minCapacity = 1);
+	PersistentCloudBuffer(const PersistentCloudBuffer& copy) = delete;
+	~PersistentCloudBuffer();
+
+	// Makes the buffer hold numElements elements; growing past the capacity reallocates and uploads everything
+	void Update(const void* elements, size_t numElements);
+
+	// The same, trusting changedRanges (FindChangedRanges from what the buffer holds to elements, found elsewhere)
+	// instead of comparing against the CPU copy
+	void Update(const void* elements, size_t numElements, const std::vector<CloudBufferRange>& changedRanges);
+
+	// Ranges closer than this many elements go up as one
+	void SetMergeGap(size_t mergeGap) { m_mergeGap = mergeGap; }
+
+	int GetHandle() const { return m_handle; }
+	size_t GetSize() const { return m_size; }
+	size_t GetCapacity() const { return m_capacity; }
+	const CloudBufferUploadStats& GetStats() const { return m_stats; }
+	const CloudBufferUploadStats& GetLastUpdateStats() const { return m_lastUpdateStats; }
+	size_t GetMemoryBytes() const { return m_capacity * m_elementSize * 2; }	// GPU buffer and the CPU copy
+
+	// Differing element ranges between two arrays of the same element size, merged across gaps of up to mergeGap
+	static void FindDirtyRanges(const unsigned char* previous, const unsigned char* current, size_t numElements, size_t elementSize,
+		size_t mergeGap, std::vector<CloudBufferRange>& ranges);
+
+	// What Update sends to turn previous into current: the dirty ranges of the elements both have, plus anything past
+	// the old size
+	static void FindChangedRanges(const void* previous, size_t numPrevious, const void* current, size_t numCurrent, size_t elementSize,
+		size_t mergeGap, std::vector<CloudBufferRange>& ranges);
+
+	static constexpr size_t DEFAULT_MERGE_GAP = 16;
+
+private:
+	void Upload(const void* elements, size_t numElements, const std::vector<CloudBufferRange>* changedRanges);
+
+private:
+	CloudBufferBackend& m_backend;
+	size_t m_elementSize = 0;
+	size_t m_minCapacity = 1;
+	size_t m_mergeGap = DEFAULT_MERGE_GAP;
+	int m_handle = 0;
+	size_t m_size = 0;
+	size_t m_capacity = 0;
+	std::vector<unsigned char> m_uploaded;		// What the GPU buffer holds, m_size elements
+	std::vector<CloudBufferRange> m_dirtyRanges;
+	CloudBufferUploadStats m_stats;
+	CloudBufferUploadStats m_lastUpdateStats;
+};
+
+// Backend that only records the calls, so upload traffic can be checked without a device
+class RecordingCloudBufferBackend : public CloudBufferBackend
+{
+public:
+	enum class EventType
+	{
+		CREATE,
+		DESTROY,
+		UPLOAD,
+	};
+
+	struct Event
+	{
+		EventType type = EventType::UPLOAD;
+		int handle = 0;
+		size_t firstElement = 0;	// UPLOAD: the range, CREATE: 0 and the capacity
+		size_t numElements = 0;
+		size_t elementSize = 0;
+	};
+
+	int CreateBuffer(size_t capacity, size_t elementSize) override;
+	void DestroyBuffer(int handle) override;
+	void UploadRanges(int handle, const void* elements, size_t elementSize, const std::vector<CloudBufferRange>& ranges) override;
+
+	// The contents each live buffer would have, for checking uploads against the source arrays
+	const std::vector<unsigned char>& GetContents(int handle) const;
+
+	const std::vector<Event>& GetEvents() const { return m_events; }
+	void ClearEvents() { m_events.clear(); }
+	int GetNumLiveBuffers() const;
+	std::string GetSummary() const;
+
+private:
+	struct Buffer
+	{
+		bool isLive = false;
+		size_t elementSize = 0;
+		std::vector<unsigned char> contents;
+	};
+
+	std::vector<Buffer> m_buffers;		// Handle - 1
+	std::vector<Event> m_events;
+};
@@ -1,5 +1,12 @@
 #include "Game/CloudManager.hpp"
+#include "Game/GameRenderBackend.hpp"
 #include "Game/Perlin3D.hpp"
+#include "Game/CloudRayMarcher.hpp"
+#include "Game/CloudTemporalReprojection.hpp"
+#include "Game/CloudUpsample.hpp"
+#include "Game/CloudRayCost.hpp"
+#include "Game/CpuProfiler.hpp"
+#include "Game/CloudMemoryBudget.hpp"
 #include "Engine/Renderer/VertexBuffer.hpp"
 #include "Engine/Renderer/StructuredBuffer.hpp"
 #include "Engine/Renderer/IndexBuffer.hpp"
@@ -12,47 +19,60 @@
 #include "ThirdParty/ImGui/imgui.h"
 #include "ThirdParty/ImGui/imgui_impl_dx11.h"
 #include "ThirdParty/ImGui/imgui_impl_win32.h"
+#include <chrono>
+#include <cstring>
+#include <random>
 
 CloudManager::CloudManager(Game* game, int maxClouds)
 	: m_maxClouds(maxClouds) 
 	, m_game(game)
 {
 	// Reserve space for efficiency 
-	InitializeNoiseTexture(256, 256, 256, 1.f, 7);
-	InitializeWorleyTexture(256, 256, 256, 32, 4);
+	InitializeNoiseVolumes();
+	InitializeWindField();
+	InitializeBlueNoise();
+	InitializeTemporalReprojection();
+	InitializeBilateralUpsample();
+	InitializeCostView();
+	InitializeSunTransmittance();
+	InitializeParameters();
+	InitializeCloudVisibility();
 
 	//Save3DTextureToDisk("Data/Textures/WorleyNoise", m_worleyTexture->)
 
-	m_cloudShader = g_theRenderer->CreateOrGetShader("Data/Shaders/Default3D", VertexType::VERTEX_PCU3D);
-	m_cloudDebugShader = g_theRenderer->CreateOrGetShader("Data/Shaders/BaseShader", VertexType::VERTEX_PCU);
+	m_cloudShader = g_theRenderBackend->CreateOrGetShader("Data/Shaders/Default3D", VertexType::VERTEX_PCU3D);
+	m_cloudDebugShader = g_theRenderBackend->CreateOrGetShader("Data/Shaders/BaseShader", VertexType::VERTEX_PCU);
 	//m_voxelShader = g_theRenderer->CreateOrGetShader("Data/Shaders/VoxelShader", VertexType::VOXEL_CLOUDS);
-	m_cloudComputeShader = g_theRenderer->CreateOrGetComputeShader("Data/Shaders/CloudShader", VertexType::VOXEL_CLOUDS);
-	m_cloudShadowShader = g_theRenderer->CreateOrGetComputeShader("Data/Shaders/CloudShadowShader", VertexType::VOXEL_CLOUDS);
-	m_cloudReshapedShader = g_theRenderer->CreateOrGetComputeShader("Data/Shaders/CloudReshapedShader", VertexType::VOXEL_CLOUDS);
-	m_outCloudTexture = g_theRenderer->CreateEmptyTextureWithUAV("OutCloudTexture", g_theWindow->GetClientDimensions());
-	m_outShadowTexture = g_theRenderer->CreateEmptyTextureWithUAV("OutShadowTexture", g_theWindow->GetClientDimensions());
-	m_inCloudBuffer = g_theRenderer->CreateStructuredBuffer(1, sizeof(Cloud), true);
+	m_cloudComputeShader = g_theRenderBackend->CreateOrGetComputeShader("Data/Shaders/CloudShader", VertexType::VOXEL_CLOUDS);
+	m_cloudShadowShader = g_theRenderBackend->CreateOrGetComputeShader("Data/Shaders/CloudShadowShader", VertexType::VOXEL_CLOUDS);
+	m_cloudReshapedShader = g_theRenderBackend->CreateOrGetComputeShader("Data/Shaders/CloudReshapedShader", VertexType::VOXEL_CLOUDS);
+	m_outCloudTexture = g_theRenderBackend->CreateEmptyTextureWithUAV("OutCloudTexture", g_theRenderBackend->GetRenderDimensions());
+	IntVec2 shadowDimensions = g_theRenderBackend->GetRenderDimensions();
+	m_outShadowTexture = g_theRenderBackend->CreateEmptyTextureWithUAV("OutShadowTexture", IntVec2(shadowDimensions.x, shadowDimensions.y * 2 + 1));
+	m_opacityShadowMapBuffer = g_theRenderBackend->CreateStructuredBuffer(1, sizeof(CloudOpacityShadowMapGPU), true);
+	m_frameConstantsBuffer = g_theRenderBackend->CreateStructuredBuffer(1, sizeof(CloudFrameGPU), true);
+	UploadPersistentBuffers(std::vector<OctreeNodeGPU>(), std::vector<Voxel>());
 
-	m_inVoxelBuffer = g_theRenderer->CreateStructuredBuffer(1, sizeof(Voxel), true);
-	m_inVoxelPositionBuffer = g_theRenderer->CreateStructuredBuffer(1, sizeof(Vec3), true);
+	m_inVoxelPositionBuffer = g_theRenderBackend->CreateStructuredBuffer(1, sizeof(Vec3), true);
 
 
-	m_cloudOctreeBuffer = g_theRenderer->CreateStructuredBuffer(1, sizeof(OctreeNodeGPU), true);
-	m_voxelOctreeBuffer = g_theRenderer->CreateStructuredBuffer(1, sizeof(OctreeNodeGPU), true);
+	m_cloudOctreeBuffer = g_theRenderBackend->CreateStructuredBuffer(1, sizeof(OctreeNodeGPU), true);
 }	
 
 CloudManager::~CloudManager()
 {
+	// A running scene job reads the noise volumes and wind field, which are destroyed before the builder
+	m_sceneBuilder.Wait();
 
 	//delete m_cloudShader;
 	//m_cloudShader = nullptr;
-	m_clouds.clear();
+	m_cloudInstances.clear();
+	m_prototypes.Clear();
 
-	delete m_inCloudBuffer;
+	// m_inCloudBuffer, m_inVoxelBuffer and m_voxelOctreeBuffer belong to m_bufferBackend
 	m_inCloudBuffer = nullptr;
-
-	delete m_inVoxelBuffer;
 	m_inVoxelBuffer = nullptr;
+	m_voxelOctreeBuffer = nullptr;
 
 	delete m_inVoxelPositionBuffer;
 	m_inVoxelPositionBuffer = nullptr;
@@ -60,20 +80,53 @@ CloudManager::~CloudManager()
 	delete m_cloudOctreeBuffer;
 	m_cloudOctreeBuffer = nullptr;
 
-	delete m_voxelOctreeBuffer;
-	m_voxelOctreeBuffer = nullptr;
+	delete m_perlinNoiseBuffer;
+	m_perlinNoiseBuffer = nullptr;
+
+	delete m_worleyNoiseBuffer;
+	m_worleyNoiseBuffer = nullptr;
+
+	delete m_noiseVolumeLevelBuffer;
+	m_noiseVolumeLevelBuffer = nullptr;
+
+	delete m_windFieldBuffer;
+	m_windFieldBuffer = nullptr;
+
+	delete m_blueNoiseBuffer;
+	m_blueNoiseBuffer = nullptr;
+
+	delete m_rayJitterBuffer;
+	m_rayJitterBuffer = nullptr;
+
+	delete m_temporalReprojectionBuffer;
+	m_temporalReprojectionBuffer = nullptr;
+
+	delete m_cloudUpsampleBuffer;
+	m_cloudUpsampleBuffer = nullptr;
+
+	delete m_sceneOccluderBuffer;
+	m_sceneOccluderBuffer = nullptr;
 
-	delete m_debugVoxelBuffer;
-	m_debugVoxelBuffer = nullptr;
+	delete m_costViewBuffer;
+	m_costViewBuffer = nullptr;
 
-	delete m_debugIndexBuffer;
-	m_debugIndexBuffer = nullptr;
+	delete m_frameConstantsBuffer;
+	m_frameConstantsBuffer = nullptr;
 
-	delete m_debugWireframeVBO;
-	m_debugWireframeVBO = nullptr;
+	delete m_sunTransmittanceVolumeBuffer;
+	m_sunTransmittanceVolumeBuffer = nullptr;
 
-	delete m_debugWireframeIBO;
-	m_debugWireframeIBO = nullptr;
+	delete m_sunTransmittanceBuffer;
+	m_sunTransmittanceBuffer = nullptr;
+
+	delete m_opacityShadowMapBuffer;
+	m_opacityShadowMapBuffer = nullptr;
+
+	delete m_cameraVisibleCloudBuffer;
+	m_cameraVisibleCloudBuffer = nullptr;
+
+	delete m_lightVisibleCloudBuffer;
+	m_lightVisibleCloudBuffer = nullptr;
 }
 
 void CloudManager::Shutdown()
@@ -104,96 +157,55 @@ void CloudManager::BeginFrame()
 			ImGui::Text("Press 6 to toggle Hi-Z Buffer View Mode");
 			ImGui::Text("Use ARROW keys to move Debug Camera");
 
-			//static float	scatteringCoefficient = 1.22f;
-			static float	extinctionCoefficient = 1.0f;
-			static float	densityMultiplier = .37f;
-
-			static float	minStepSize = 0.03f;
-			static float	noiseScale = .8f;
-			static float	noiseLerpVal = .5f;
-			static float	densityNoiseLerpVal = .92f;
-
-			static float	cloudVoxelDistanceLerpVal = .87f;
-			static float	minWorleyValue = 0.32f;
-			static float	noisePowVal = 3.7f;
-			//static float	densitySkipThreshold = 0.0f;
-
-			static float	scrollFactor = 0.5f;
-			static float	farDistanceThreshold = 50.f;
-			static float	farMultiplier = 2.8f;
-			static float	shadowFactorMin = 0.93f;
-
-			static float    powderBias = 0.9f;
-			static float    anisotropy = 0.01f;
-			static float    falloff = 0.5f;
-
-			static float    rayIntensity = 1.06f;
-			static float	rayDecay = .005f;
-
-			static float	shadowCastMin = .95f;
-
-			//ImGui::SliderFloat("Scattering Coefficient", &scatteringCoefficient, .1f, 5.f, "%.2f");
-			//m_cloudConstants.scatteringCoefficient = scatteringCoefficient;
-
-			ImGui::SliderFloat("Extinction Coefficient", &extinctionCoefficient, .1f, 5.f, "%.2f");
-			m_cloudConstants.extinctionCoefficient = extinctionCoefficient;
+			static int		costViewMode = 0;
+			static float	costViewMaxValue = 256.f;
+			static bool		showVoxels = false;
 
-			ImGui::SliderFloat("Density Multiplier", &densityMultiplier, 0.f, 3.f, "%.2f");
-			m_cloudConstants.densityMultiplier = densityMultiplier;
+			m_parameters.DrawImGui(CLOUD_PRESETS_FILE_PATH);
 
-			ImGui::SliderFloat("Min Step Size", &minStepSize, 0.01f, 1.f, "%.2f");
-			m_cloudConstants.minStepSize = minStepSize;
-
-			ImGui::SliderFloat("Noise Scale", &noiseScale, 0.001f, 3.f, "%.3f");
-			m_cloudConstants.noiseScale = noiseScale;
-
-			ImGui::SliderFloat("Noise Lerp Value", &noiseLerpVal, 0.f, 1.f, "%.2f");
-			m_cloudConstants.noiseLerpVal = noiseLerpVal;
-
-			ImGui::SliderFloat("Density Noise Lerp Value", &densityNoiseLerpVal, 0.f, 1.f, "%.2f");
-			m_cloudConstants.densityNoiseLerpVal = densityNoiseLerpVal;
-
-			ImGui::SliderFloat("Cloud Voxel Distance Lerp Value", &cloudVoxelDistanceLerpVal, 0.f, 1.f, "%.2f");
-			m_cloudConstants.cloudVoxelDistanceLerpVal = cloudVoxelDistanceLerpVal;
-
-			ImGui::SliderFloat("Min Worley Value", &minWorleyValue, 0.f, 1.f, "%.2f");
-			m_cloudConstants.minWorleyValue = minWorleyValue;
-
-			ImGui::SliderFloat("Noise Pow Value", &noisePowVal, 0.f, 5.f, "%.2f");
-			m_cloudConstants.noisePowVal = noisePowVal;
-
-			//ImGui::SliderFloat("Density Skip Threshold", &densitySkipThreshold, 0.f, 1.f, "%.2f");
-			//m_cloudConstants.densitySkipThreshold = densitySkipThreshold;
-
-			ImGui::SliderFloat("Scroll Factor", &scrollFactor, .0f, 3.f, "%.1f");
-			m_cloudConstants.scrollFactor = scrollFactor;
-
-			ImGui::SliderFloat("Far Distance Threshold", &farDistanceThreshold, 0.f, 200.f, "%.1f");
-			m_cloudConstants.farDistanceThreshold = farDistanceThreshold;
-
-			ImGui::SliderFloat("Far Multiplier", &farMultiplier, 0.f, 10.f, "%.1f");
-			m_cloudConstants.farMultiplier = farMultiplier;
-
-			ImGui::SliderFloat("Shadow Factor Min", &shadowFactorMin, 0.f, 1.f, "%.2f");
-			m_cloudConstants.shadowFactorMin = shadowFactorMin;
-
-			ImGui::SliderFloat("Powder Bias", &powderBias, 0.f, 10.f, "%.1f");
-			m_cloudConstants.powderBias = powderBias;
-
-			ImGui::SliderFloat("Anisotropy", &anisotropy, 0.f, 1.f, "%.2f");
-			m_cloudConstants.anisotropy = anisotropy;
-
-			ImGui::SliderFloat("Falloff", &falloff, 0.f, 5.f, "%.2f");
-			m_cloudConstants.falloff = falloff;
-
-			ImGui::SliderFloat("Ray Intensity", &rayIntensity, 0.f, 5.f, "%.2f");
-			m_game->grc.intensity = rayIntensity;
+			if (ImGui::Combo("Cost Heatmap", &costViewMode, "Off\0Steps\0Nodes Visited\0Voxel Tests\0Noise Samples\0Termination Distance\0Interval Refills\0") && costViewMode > 0)
+			{
+				costViewMaxValue = CloudRayCostMap::GetDefaultMaxValue((CloudRayCostChannel)(costViewMode - 1));
+			}
+			m_costViewChannel = costViewMode - 1;
+			ImGui::SliderFloat("Heatmap Max", &costViewMaxValue, 1.f, 4096.f, "%.0f");
+			m_costViewMaxValue = costViewMaxValue;
+
+			const CloudSunTransmittanceStats& sunStats = m_sunTransmittance.GetStats();
+			ImGui::Text("Sun volume: %lld cells, %.1f ms density, %.2f ms sweep, %d builds", sunStats.numCells,
+				sunStats.extinctionSeconds * 1000.0, sunStats.sweepSeconds * 1000.0, sunStats.numBuilds);
+			ImGui::Text("Visible clouds: camera %d / %d, light %d / %d (%.3f ms)", m_visibilityStats.numCameraVisible, m_visibilityStats.numClouds,
+				m_visibilityStats.numLightVisible, m_visibilityStats.numClouds, (m_visibilityStats.cameraSeconds + m_visibilityStats.lightSeconds) * 1000.0);
+			ImGui::Text("Last rebuild upload: %d ranges, %.1f KB, %d reallocations (%.1f MB sent total)", m_lastRebuildUploadStats.numRanges,
+				m_lastRebuildUploadStats.numBytesUploaded / 1024.0, m_lastRebuildUploadStats.numCreates, m_bufferBackend.GetNumBytesSent() / (1024.0 * 1024.0));
+			const CloudSceneBuildStats& sceneStats = m_sceneBuilder.GetStats();
+			ImGui::Text("Scene rebuilds: %d built, %d coalesced, %d waited for (%.2f ms last job, %.2f ms last wait)%s", sceneStats.numBuilds,
+				sceneStats.numCoalesced, sceneStats.numBlockingWaits, sceneStats.lastBuildSeconds * 1000.0, sceneStats.lastWaitSeconds * 1000.0,
+				m_sceneBuilder.IsBusy() ? ", building" : "");
+			if (m_scene)
+			{
+				ImGui::Text("Clouds: %d instances of %d prototypes, %d voxels, %d octree nodes", (int)m_scene->clouds.size(),
+					(int)m_scene->prototypes.size(), (int)m_scene->voxels.size(), (int)m_scene->octreeNodes.size());
+			}
+			ImGui::Text("Constant uploads: %d sent, %d skipped unchanged", m_constantUploadStats.numUploads, m_constantUploadStats.numSkipped);
+			if (m_appliedMemoryBudgetBytes > 0)
+			{
+				ImGui::Text("Memory budget: %d coarse, %d evicted, %.2f MB estimated (%.2f MB at full detail)%s", m_memoryBudget.numCoarse,
+					m_memoryBudget.numEvicted, m_memoryBudget.numBytes / (1024.0 * 1024.0), m_memoryBudget.numBytesFull / (1024.0 * 1024.0),
+					m_memoryBudget.fitsBudget ? "" : ", over budget");
+			}
 
-			ImGui::SliderFloat("Ray Decay", &rayDecay, 0.f, .1f, "%.3f");
-			m_game->grc.decay = rayDecay;
+			ImGui::Checkbox("Show Voxels", &showVoxels);
+			m_debugVoxelView.SetEnabled(showVoxels);
+			if (showVoxels)
+			{
+				const CloudDebugVoxelStats& voxelStats = m_debugVoxelView.GetStats();
+				ImGui::Text("Voxel view: %d voxels (%d over the cap), %d vertexes, %.2f ms build", voxelStats.numInstances, voxelStats.numSkipped,
+					voxelStats.numVertexes, voxelStats.buildSeconds * 1000.0);
+			}
 
-			ImGui::SliderFloat("Minimum Shadow Cast", &shadowCastMin, 0.f, 1.f, "%.2f");
-			m_game->sc.minShadow = shadowCastMin;
+			m_memoryReport.DrawImGui(m_appliedMemoryBudgetBytes);
+			CpuProfiler::Get().DrawImGui();
 
 			ImGui::PopStyleColor();
 		}
@@ -203,8 +215,9 @@ void CloudManager::BeginFrame()
 
 bool CloudManager::CreateTest()
 {
+	PROFILE_SCOPE("CloudManager::CreateTest");
 	//TODO: why is this function return a bool?
-	if (m_clouds.size() >= m_maxClouds)
+	if (m_cloudInstances.size() >= m_maxClouds)
 	{
 		ERROR_AND_DIE("Max clouds reached");
 	}
@@ -229,7 +242,7 @@ bool CloudManager::CreateTest()
 
 
 		
-		m_clouds.reserve(scaleX * scaleY * scaleZ);
+		m_cloudInstances.reserve(scaleX * scaleY * scaleZ);
 
 		//float offset = 0.001;
 
@@ -273,12 +286,12 @@ bool CloudManager::CreateTest()
 					int voxelY = int(uniformScale * uniformScaleY * scaleNoiseY);
 					int voxelZ = int(uniformScale * uniformScaleZ * scaleNoiseZ);
 
-					// Create and update the cloud
-					Cloud cloud = Cloud(cloudPos, IntVec3(voxelX, voxelY, voxelZ), m_voxelDimensions, ECloudType::CLOUD_TEST, useTest);
-					cloud.Update(m_game->m_gameClock->GetDeltaSeoconds(), m_game->m_weather);
+					// Clouds of the same size share one generated prototype and only place it somewhere else
+					CloudInstance instance;
+					instance.prototypeIndex = m_prototypes.FindOrAdd(IntVec3(voxelX, voxelY, voxelZ), m_voxelDimensions, ECloudType::CLOUD_TEST, useTest);
+					instance.position = cloudPos;
 
-					m_clouds.push_back(cloud);
-					m_voxelOctrees.push_back(std::make_unique<Octree<Voxel>>(cloud.boundingBox, DefaultGetDensity<Voxel>()));
+					m_cloudInstances.push_back(instance);
 				}
 			}
 		}
@@ -291,17 +304,18 @@ bool CloudManager::CreateCloud(Vec3 location, IntVec3 dimensions, float noiseSca
 	UNUSED(noiseScale);
 	UNUSED(threshold);
 
-	if (m_clouds.size() >= m_maxClouds)
+	if (m_cloudInstances.size() >= m_maxClouds)
 	{
 		ERROR_AND_DIE("Max clouds reached");
 	}
 	else
 	{
-		// Create a new cloud object
-		Cloud cloud = Cloud(location, dimensions, Vec3(1.f));
-		cloud.GenerateCloud();
+		// Create a new cloud instance, generating its shape if no prototype has it yet
+		CloudInstance instance;
+		instance.prototypeIndex = m_prototypes.FindOrAdd(dimensions, Vec3(1.f), ECloudType::CLOUD_CUMULUS, false);
+		instance.position = location;
 
-		m_clouds.push_back(cloud);
+		m_cloudInstances.push_back(instance);
 
 		//m_voxelOctrees.push_back(std::make_unique<Octree<Voxel>>(AABB3(location, Vec3(dimensions))));
 
@@ -312,6 +326,34 @@ bool CloudManager::CreateCloud(Vec3 location, IntVec3 dimensions, float noiseSca
 	return new Cloud();
 }
 
+void CloudManager::ScatterInstances(int numInstances, float halfExtent, unsigned int seed)
+{
+	if (m_prototypes.GetNumPrototypes() == 0)
+	{
+		CreateTest();
+	}
+
+	// Around the middle of CreateTest's grid, at its heights
+	Vec3 fieldCenter = Vec3(260.f, 260.f, 0.f);
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+	std::uniform_int_distribution<int> prototypeIndex(0, m_prototypes.GetNumPrototypes() - 1);
+
+	m_cloudInstances.clear();
+	m_cloudInstances.reserve((size_t)numInstances);
+	for (int instanceIndex = 0; instanceIndex < numInstances; ++instanceIndex)
+	{
+		CloudInstance instance;
+		instance.prototypeIndex = prototypeIndex(generator);
+		instance.position = fieldCenter + Vec3((unit(generator) * 2.f - 1.f) * halfExtent, (unit(generator) * 2.f - 1.f) * halfExtent, 200.f + unit(generator) * 50.f);
+		instance.scale = 0.75f + unit(generator) * 0.5f;
+		instance.densityScale = 0.75f + unit(generator) * 0.5f;
+		instance.noiseOffset = Vec3(unit(generator), unit(generator), unit(generator)) * 1000.f;
+		m_cloudInstances.push_back(instance);
+	}
+	m_needsRebuild = true;
+}
+
 void CloudManager::RemoveCloud(Cloud* cloud)
 {
 	UNUSED(cloud);
@@ -327,182 +369,155 @@ void CloudManager::RemoveCloud(Cloud* cloud)
 
 void CloudManager::UpdateClouds(float deltaSeconds, const Weather& weather)
 {
-	delete m_debugVoxelBuffer;
-	m_debugVoxelBuffer = nullptr;
-
-	delete m_debugIndexBuffer;
-	m_debugIndexBuffer = nullptr;
-
-	delete m_debugWireframeVBO;
-	m_debugWireframeVBO = nullptr;
-
-	delete m_debugWireframeIBO;
-	m_debugWireframeIBO = nullptr;
-	
+	PROFILE_SCOPE("CloudManager::UpdateClouds");
 	HandleInput(deltaSeconds);
 
-	if (m_needsRebuild)
+	if (m_parameters.ConsumeChanges() || (m_costViewChannel >= 0) != m_isCostViewApplied)
 	{
-		m_cloudsGPU.clear();
-		m_allVoxels.clear();
-		//m_allVoxelPositions.clear();
-		
-		int octreeIndex = 0;
-		
+		ApplyParameters();
+	}
 
-		for (int i = 0; i < m_clouds.size(); i++)
+	UpdateMemoryBudget();
+	if (m_needsRebuild)
+	{
+		PROFILE_SCOPE("Request Rebuild");
+		// The job shares the library's prototypes the budgeted scene uses and builds the sun transmittance with the
+		// octrees; the frame keeps drawing the current snapshot meanwhile
+		CloudSceneRequest request;
+		MakeBudgetedScene(m_prototypes, m_cloudInstances, m_memoryBudget.levels, request.prototypes, request.instances);
+		request.voxelDimensions = m_voxelDimensions;
+		if (m_useSunTransmittance)
 		{
-			m_clouds[i].Update(deltaSeconds, weather);
-
-
-			if (m_clouds[i].NeedsRebuild()) {
-				m_clouds[i].m_octreeIndex = octreeIndex;
-				m_voxelOctrees[i]->Build(m_clouds[i].GetVoxels(), m_voxelDimensions);
-
-
-
-				//m_voxelPositionOctrees[i]->Build(m_clouds[i].GetVoxelPositions(), m_voxelDimensions);
-
-				octreeIndex += (int)m_voxelOctrees[i]->GetAllChildrenSize();
-				//octreeIndex += (int)m_voxelPositionOctrees[i]->GetAllChildrenSize();
-			}
+			request.noiseVolumes = &m_noiseVolumes;
+			request.windField = &m_windField;
+			GetRayMarchSettings(request.raySettings);
+			request.raySettings.voxelDimensions = m_voxelDimensions;
+			request.sunConfig = m_sunTransmittanceConfig;
 		}
+		m_sceneBuilder.Request(std::move(request));
+		m_needsRebuild = false;
+	}
 
-#pragma region DebugRender
-
-		std::vector<Vertex_PCU> verts;
-		std::vector<unsigned int> indices;
-
-		for (const Cloud& cloud : m_clouds)
-		{
-			for (const Voxel& voxel : cloud.m_voxels)
-			{
-				AddVertsForAABB3D(verts, indices, AABB3(voxel.m_position, 1.f), Rgba8::PURPLE);
-			}
-
-			//for (const Vec3& position : cloud.m_voxelPositions)
-			//{
-			//	AddVertsForAABB3D(verts, indices, AABB3(position, 1.f), Rgba8::PURPLE);
-			//}
-		}
+	// There is nothing to keep drawing before the first snapshot, so that one is waited for, as is every one when
+	// asynchronous rebuilds are off
+	std::shared_ptr<const CloudSceneSnapshot> snapshot = (m_useAsyncRebuild && m_scene) ? m_sceneBuilder.Poll() : m_sceneBuilder.Wait();
+	if (snapshot)
+	{
+		ApplySceneSnapshot(snapshot);
+	}
 
-		std::vector<Vertex_PCU> wireVerts;
-		std::vector<unsigned int> wireIndices;
+	UpdateDebugVoxels();
 
-		for (const Cloud& cloud : m_clouds)
+	{
+		PROFILE_SCOPE("Per-Frame Uploads");
+		if (weather.m_windSpeed != m_uploadedWindSpeed)
 		{
-			for (const Voxel& voxel : cloud.m_voxels)
-			{
-				AddVertsForAABB3D(wireVerts, wireIndices, AABB3(voxel.m_position, 1.f), Rgba8::GREEN);
-			}
-
-			//for (const Vec3& position : cloud.m_voxelPositions)
-			//{
-			//	AddVertsForAABB3D(wireVerts, wireIndices, AABB3(position, 1.f), Rgba8::GREEN);
-			//}
+			UploadWindField(weather.m_windSpeed);
 		}
 
-		//if (verts.size() > 0)
-		//{
-		//	m_debugVoxelBuffer = g_theRenderer->CreateVertexBuffer(verts.size(), sizeof(Vertex_PCU));
-		//	m_debugIndexBuffer = g_theRenderer->CreateIndexBuffer(indices.size());
-		//
-		//	g_theRenderer->CopyCPUToGPU(verts.data(), verts.size() * sizeof(Vertex_PCU), m_debugVoxelBuffer);
-		//	g_theRenderer->CopyCPUToGPU(indices.data(), indices.size() * sizeof(unsigned int), m_debugIndexBuffer);
-		//}
-		//
-		//if (wireVerts.size() > 0)
-		//{
-		//	m_debugWireframeVBO = g_theRenderer->CreateVertexBuffer(wireVerts.size(), sizeof(Vertex_PCU));
-		//	m_debugWireframeIBO = g_theRenderer->CreateIndexBuffer(wireIndices.size());
-		//
-		//	g_theRenderer->CopyCPUToGPU(wireVerts.data(), wireVerts.size() * sizeof(Vertex_PCU), m_debugWireframeVBO);
-		//	g_theRenderer->CopyCPUToGPU(wireIndices.data(), wireIndices.size() * sizeof(unsigned int), m_debugWireframeIBO);
-		//}
-
-#pragma endregion
-
-		delete m_inCloudBuffer;
-		m_inCloudBuffer = nullptr;
-
-		delete m_inVoxelBuffer;
-		m_inVoxelBuffer = nullptr;
-
-		delete m_inVoxelPositionBuffer;
-		m_inVoxelPositionBuffer = nullptr;
-
-		delete m_cloudOctreeBuffer;
-		m_cloudOctreeBuffer = nullptr;
-
-		delete m_voxelOctreeBuffer;
-		m_voxelOctreeBuffer = nullptr;
-
-		std::vector<OctreeNodeGPU> gpuVoxelNodes;
-		std::vector<OctreeNodeGPU> gpuCloudNodes;
-		std::vector<Voxel> gpuVoxels;
-		std::vector<Vec3> gpuVoxelPositions;
-
-		SerializeOctreesToGPU(gpuVoxelNodes, gpuVoxels);
-		SerializePositionOctreesToGPU(gpuCloudNodes, gpuVoxelPositions);
-		//SerializeCloudNodesToGPU(gpuCloudNodes, );
-
-		unsigned int voxelOffset = 0;
-		unsigned int densityOffset = 0;
-
-		for (Cloud& cloud : m_clouds)
-		{
-			CloudGPU cloudGPU = cloud.GetCloudGPU(voxelOffset, densityOffset);
+		UploadFrameConstants();
+		UploadRayJitter();
+		UploadTemporalReprojection(deltaSeconds);
+		UploadBilateralUpsample();
+		UploadCostView();
+	}
+	UpdateSunTransmittance();
+	UpdateCameraVisibility();
 
+	UploadConstants();
+	UpdateMemoryReport();
+}
 
-			m_allVoxels.insert(m_allVoxels.end(), cloud.m_voxels.begin(), cloud.m_voxels.end());
+void CloudManager::UpdateMemoryBudget()
+{
+	PROFILE_SCOPE("Memory Budget");
+	size_t budgetBytes = (size_t)((double)m_memoryBudgetMB * 1024.0 * 1024.0);
+	Vec3 viewPosition = m_game->m_player->m_playerCam.m_position;
+	bool hasViewMoved = (viewPosition - m_memoryBudgetViewPosition).GetLength() > m_memoryBudgetRefitDistance;
+	bool hasBudgetChanged = budgetBytes != m_appliedMemoryBudgetBytes;
+	if (!m_needsRebuild && !hasBudgetChanged && !(budgetBytes > 0 && hasViewMoved))
+	{
+		return;
+	}
 
-			//m_allVoxelPositions.insert(m_allVoxelPositions.end(), cloud.m_voxelPositions.begin(), cloud.m_voxelPositions.end());
+	m_appliedMemoryBudgetBytes = budgetBytes;
+	m_memoryBudgetViewPosition = viewPosition;
 
-			m_cloudsGPU.push_back(cloudGPU);
-		}
+	CloudMemoryBudgetResult budget;
+	if (budgetBytes == 0)
+	{
+		// Without a budget nothing needs the coarse prototypes, so they aren't built
+		budget.levels.assign(m_cloudInstances.size(), CloudDetailLevel::FULL);
+	}
+	else
+	{
+		// Whatever no detail level changes: the prototype library and the noise, CPU and GPU
+		size_t fixedBytes = m_prototypes.GetMemoryBytes() + m_noiseVolumes.GetMemoryBytes() + GetNoiseVolumeBytesGPU();
+		CloudMemoryCosts costs = EstimateCloudMemoryCosts(m_prototypes, m_cloudInstances, m_sunTransmittanceConfig, fixedBytes);
+		budget = FitCloudMemoryBudget(m_cloudInstances, costs, viewPosition, budgetBytes);
+	}
 
+	if (budget.levels != m_memoryBudget.levels)
+	{
+		m_needsRebuild = true;
+	}
+	m_memoryBudget = budget;
+}
 
+void CloudManager::UpdateMemoryReport()
+{
+	m_memoryReport.Clear();
+	m_memoryReport.Add("Prototype library", m_prototypes.GetMemoryBytes() + m_cloudInstances.capacity() * sizeof(CloudInstance), 0);
 
-		//m_cloudOctreeBuffer = g_theRenderer->CreateStructuredBuffer(m_voxelOctrees.size(), sizeof(Octree<Voxel>), true);
-		//g_theRenderer->CopyCPUToGPU(m_voxelOctrees.data(), m_voxelOctrees.size(), m_cloudOctreeBuffer);
+	size_t snapshotBytes = m_cloudsGPU.capacity() * sizeof(CloudGPU);
+	if (m_scene)
+	{
+		snapshotBytes += (m_scene->clouds.capacity() + m_scene->prototypes.capacity()) * sizeof(CloudGPU) +
+			m_scene->octreeNodes.capacity() * sizeof(OctreeNodeGPU) + m_scene->voxels.capacity() * sizeof(Voxel) + m_scene->sunTransmittance.GetMemoryBytes();
+	}
+	m_memoryReport.Add("Scene snapshot", snapshotBytes, 0);
 
-		float mindensity = FLT_MAX;
-		float maxdensity = -FLT_MAX;
+	// The persistent buffers keep a CPU copy the size of the GPU buffer
+	size_t bufferBytes = m_persistentCloudBuffer.GetCapacity() * sizeof(CloudGPU) + m_persistentVoxelBuffer.GetCapacity() * sizeof(Voxel) +
+		m_persistentOctreeBuffer.GetCapacity() * sizeof(OctreeNodeGPU);
+	m_memoryReport.Add("Cloud buffers", bufferBytes, bufferBytes);
 
-		for (int i = 0; i < gpuVoxels.size(); i++)
-		{
-			mindensity = min(mindensity, gpuVoxels[i].m_density);
-			maxdensity = max(maxdensity, gpuVoxels[i].m_density);
-		}		m_voxelOctreeBuffer = g_theRenderer->CreateStructuredBuffer(gpuVoxelNodes.size(), sizeof(OctreeNodeGPU), true);
-		g_theRenderer->CopyCPUToGPU(gpuVoxelNodes.data(), gpuVoxelNodes.size(), m_voxelOctreeBuffer);
+	m_memoryReport.Add("Sun transmittance", m_sunTransmittance.GetMemoryBytes(),
+		m_sunTransmittanceVolumeCapacity * sizeof(SunTransmittanceVolumeGPU) + m_sunTransmittanceCellCapacity * sizeof(float));
+	m_memoryReport.Add("Visibility lists", (m_cameraVisibleClouds.capacity() + m_lightVisibleClouds.capacity()) * sizeof(unsigned int),
+		(m_cameraVisibleCloudCapacity + m_lightVisibleCloudCapacity) * sizeof(unsigned int));
 
-		m_inCloudBuffer = g_theRenderer->CreateStructuredBuffer(m_cloudsGPU.size(), sizeof(CloudGPU), true);
-		g_theRenderer->CopyCPUToGPU(m_cloudsGPU.data(), m_cloudsGPU.size(), m_inCloudBuffer);
+	m_memoryReport.Add("Noise volumes", m_noiseVolumes.GetMemoryBytes(), GetNoiseVolumeBytesGPU());
+}
 
-		//m_inVoxelBuffer = g_theRenderer->CreateStructuredBuffer(m_allVoxels.size(), sizeof(Voxel), true);
-		//g_theRenderer->CopyCPUToGPU(m_allVoxels.data(), m_allVoxels.size(), m_inVoxelBuffer);
+size_t CloudManager::GetNoiseVolumeBytesGPU() const
+{
+	// Both chains are uploaded whole, plus the level table they share
+	return m_noiseVolumes.GetMemoryBytes() + m_noiseVolumeLevelCount * sizeof(NoiseVolumeLevelGPU);
+}
 
-		m_inVoxelBuffer = g_theRenderer->CreateStructuredBuffer(gpuVoxels.size(), sizeof(Voxel), true);
-		g_theRenderer->CopyCPUToGPU(gpuVoxels.data(), gpuVoxels.size(), m_inVoxelBuffer);
+void CloudManager::ApplySceneSnapshot(const std::shared_ptr<const CloudSceneSnapshot>& snapshot)
+{
+	PROFILE_SCOPE("Upload Scene Snapshot");
+	// The job found the changed ranges against the newest snapshot when it started; they hold if that is the one
+	// the buffers have, which it isn't when a blocking wait skipped over it
+	bool hasChangedRanges = m_scene && snapshot->baseRequestIndex == m_scene->requestIndex;
 
-		//m_inVoxelPositionBuffer = g_theRenderer->CreateStructuredBuffer(gpuVoxelPositions.size(), sizeof(Vec3), true);
-		//g_theRenderer->CopyCPUToGPU(gpuVoxelPositions.data(), gpuVoxelPositions.size(), m_inVoxelPositionBuffer);
+	// One assignment switches every reader over; the previous snapshot is released once nothing holds it
+	m_scene = snapshot;
+	m_cloudsGPU = m_scene->clouds;
+	UploadPersistentBuffers(m_scene->octreeNodes, m_scene->voxels, hasChangedRanges ? m_scene.get() : nullptr);
 
-		m_cloudConstants.numClouds = (int)m_cloudsGPU.size();
-		m_cloudConstants.numOctrees = (int)gpuVoxelNodes.size();
-		m_cloudConstants.VoxelDimensions = m_voxelDimensions;
-		m_needsRebuild = false;
+	if (m_useSunTransmittance && !m_scene->sunTransmittance.GetVolumes().empty())
+	{
+		m_sunTransmittance = m_scene->sunTransmittance;
+		UploadSunTransmittance();
 	}
 
-	m_cloudConstants.timeElapsed = m_game->m_gameClock->GetTotalSeconds();
-
-	LightConstants lightConstants;
-	lightConstants = m_game->m_weather.m_lightConstants;
-
-	g_theRenderer->SetCurrentCamera(PipelineStage::COMPUTE, m_game->m_player->m_playerCam);
-	g_theRenderer->SetLightConstants(PipelineStage::COMPUTE, lightConstants);
-	g_theRenderer->SetCloudConstants(PipelineStage::COMPUTE, m_cloudConstants);
-	g_theRenderer->SetShadowConstants(PipelineStage::COMPUTE, m_game->sc);
+	m_cloudConstants.numClouds = (int)m_scene->clouds.size();
+	m_cloudConstants.numOctrees = (int)m_scene->octreeNodes.size();
+	m_cloudConstants.VoxelDimensions = m_scene->voxelDimensions;
+	m_sceneVersion++;
 }
 
 void CloudManager::HandleInput(float deltaSeconds)
@@ -527,9 +542,10 @@ void CloudManager::HandleInput(float deltaSeconds)
 	if (g_theInputSystem->WasKeyJustPressed('9'))
 	{
 		useTest = !useTest;
-		m_clouds.clear();
-		m_voxelOctrees.clear();
+		m_cloudInstances.clear();
+		m_prototypes.Clear();
 		CreateTest();
+		m_needsRebuild = true;
 	}
 
 	if (g_theInputSystem->WasKeyJustPressed('0'))
@@ -587,30 +603,57 @@ void CloudManager::HandleInput(float deltaSeconds)
 
 void CloudManager::RunCloudCompute() const
 {
+	// The reshaped demo shader has no amortized or upsampled path
+	bool isTemporal = m_temporalBlockSize > 1 && demonstration == 0;
+	bool isBilateral = !isTemporal && m_upsampleFactor > 1 && demonstration == 0;
+
 	if (demonstration == 0)
 	{
-		g_theRenderer->BindComputeShader(m_cloudComputeShader);
+		g_theRenderBackend->BindComputeShader(m_cloudComputeShader);
 	}
 	else
 	{
-		g_theRenderer->BindComputeShader(m_cloudReshapedShader);
+		g_theRenderBackend->BindComputeShader(m_cloudReshapedShader);
 
 	}
 
-	g_theRenderer->BindStructuredBufferToWrite(0, m_inCloudBuffer);
-	g_theRenderer->BindStructuredBufferToWrite(1, m_inVoxelBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(0, m_inCloudBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(1, m_inVoxelBuffer);
 	//g_theRenderer->BindStructuredBufferToWrite(1, m_inVoxelPositionBuffer);
-	g_theRenderer->BindTexture3D(PipelineStage::COMPUTE, m_noiseTexture, 2);
-	g_theRenderer->BindTexture3D(PipelineStage::COMPUTE, m_worleyTexture, 3);
-	g_theRenderer->BindStructuredBufferToWrite(4, m_voxelOctreeBuffer);
-	g_theRenderer->BindTexture(PipelineStage::COMPUTE, m_outShadowTexture, 5);
+	g_theRenderBackend->BindStructuredBufferToWrite(2, m_perlinNoiseBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(3, m_worleyNoiseBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(4, m_voxelOctreeBuffer);
+	g_theRenderBackend->BindTexture(PipelineStage::COMPUTE, m_outShadowTexture, 5);
+	g_theRenderBackend->BindStructuredBufferToWrite(6, m_windFieldBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(7, m_blueNoiseBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(8, m_rayJitterBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(9, m_temporalReprojectionBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(10, m_noiseVolumeLevelBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(12, m_cloudUpsampleBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(13, m_sceneOccluderBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(14, m_sunTransmittanceVolumeBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(15, m_sunTransmittanceBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(17, m_cameraVisibleCloudBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(18, m_costViewBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(19, m_frameConstantsBuffer);
 	//g_theRenderer->BindStructuredBufferToWrite(4, m_cloudOctreeBuffer);
 
-	g_theRenderer->BindTextureWithUAV(PipelineStage::COMPUTE, m_outCloudTexture);
+	if (isTemporal)
+	{
+		g_theRenderBackend->BindTextureWithUAV(PipelineStage::COMPUTE, m_cloudLowResTextures[m_temporalBlockSize == 4 ? 1 : 0]);
+	}
+	else if (isBilateral)
+	{
+		g_theRenderBackend->BindTextureWithUAV(PipelineStage::COMPUTE, m_cloudUpsampleAtlases[m_upsampleFactor == 4 ? 1 : 0]);
+	}
+	else
+	{
+		g_theRenderBackend->BindTextureWithUAV(PipelineStage::COMPUTE, m_outCloudTexture);
+	}
 
-	g_theRenderer->SetSamplerMode(SamplerMode::BILINEAR_WRAP);
+	g_theRenderBackend->SetSamplerMode(SamplerMode::BILINEAR_WRAP);
 
-	IntVec2 dimensions = g_theWindow->GetClientDimensions();
+	IntVec2 dimensions = g_theRenderBackend->GetRenderDimensions();
 
 	//int threadsx = (dimensions.x + 15) / 16;
 	//int threadsy = (dimensions.y + 15) / 16;
@@ -618,6 +661,17 @@ void CloudManager::RunCloudCompute() const
 	int halfWidth = (dimensions.x + 1) / 2;
 	int halfHeight = (dimensions.y + 1) / 2;
 
+	// Amortized: one thread per block of the low-res target
+	if (isTemporal)
+	{
+		halfWidth = (dimensions.x + m_temporalBlockSize - 1) / m_temporalBlockSize;
+		halfHeight = (dimensions.y + m_temporalBlockSize - 1) / m_temporalBlockSize;
+	}
+	else if (isBilateral)
+	{
+		halfWidth = (dimensions.x + m_upsampleFactor - 1) / m_upsampleFactor;
+		halfHeight = (dimensions.y + m_upsampleFactor - 1) / m_upsampleFactor;
+	}
 
 	//int threadsx = (halfWidth + 15) / 16;
 	//int threadsy = (halfHeight + 15) / 16;b
@@ -629,37 +683,106 @@ void CloudManager::RunCloudCompute() const
 	//int threadsy = (halfHeight + 31) / 32;
 
 	if (demonstration == 0)
-		g_theRenderer->DispatchComputeJob(m_cloudComputeShader, threadsx, threadsy, 1);
+		g_theRenderBackend->DispatchComputeJob(m_cloudComputeShader, threadsx, threadsy, 1);
 	else
-		g_theRenderer->DispatchComputeJob(m_cloudReshapedShader, threadsx, threadsy, 1);
+		g_theRenderBackend->DispatchComputeJob(m_cloudReshapedShader, threadsx, threadsy, 1);
 
-	g_theRenderer->UnbindComputeShader();
+	g_theRenderBackend->UnbindComputeShader();
 
-	g_theRenderer->BindTexture();
+	if (isTemporal)
+	{
+		RunTemporalReconstruction();
+	}
+	else if (isBilateral)
+	{
+		RunBilateralUpsample();
+	}
+
+	g_theRenderBackend->BindTexture();
+
+	g_theRenderBackend->SetSamplerMode(SamplerMode::BILINEAR_WRAP);
+}
+
+void CloudManager::RunTemporalReconstruction() const
+{
+	g_theRenderBackend->BindComputeShader(m_cloudTemporalShader);
+
+	g_theRenderBackend->BindStructuredBufferToWrite(0, m_inCloudBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(9, m_temporalReprojectionBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(17, m_cameraVisibleCloudBuffer);
+	g_theRenderBackend->BindTexture(PipelineStage::COMPUTE, m_cloudLowResTextures[m_temporalBlockSize == 4 ? 1 : 0], 10);
+	g_theRenderBackend->BindTexture(PipelineStage::COMPUTE, m_cloudHistoryTextures[1 - m_temporalHistoryIndex], 11);
+
+	g_theRenderBackend->BindTextureWithUAV(PipelineStage::COMPUTE, m_cloudHistoryTextures[m_temporalHistoryIndex]);
+
+	g_theRenderBackend->SetSamplerMode(SamplerMode::BILINEAR_WRAP);
+
+	IntVec2 dimensions = g_theRenderBackend->GetRenderDimensions();
+	int threadsx = (dimensions.x + 15) / 16;
+	int threadsy = (dimensions.y + 7) / 8;
+	g_theRenderBackend->DispatchComputeJob(m_cloudTemporalShader, threadsx, threadsy, 1);
+
+	g_theRenderBackend->UnbindComputeShader();
+}
+
+void CloudManager::RunBilateralUpsample() const
+{
+	g_theRenderBackend->BindComputeShader(m_cloudUpsampleShader);
+
+	g_theRenderBackend->BindTexture(PipelineStage::COMPUTE, m_cloudUpsampleAtlases[m_upsampleFactor == 4 ? 1 : 0], 10);
+	g_theRenderBackend->BindStructuredBufferToWrite(12, m_cloudUpsampleBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(13, m_sceneOccluderBuffer);
+
+	g_theRenderBackend->BindTextureWithUAV(PipelineStage::COMPUTE, m_outCloudTexture);
+
+	IntVec2 dimensions = g_theRenderBackend->GetRenderDimensions();
+	int threadsx = (dimensions.x + 15) / 16;
+	int threadsy = (dimensions.y + 7) / 8;
+	g_theRenderBackend->DispatchComputeJob(m_cloudUpsampleShader, threadsx, threadsy, 1);
+
+	g_theRenderBackend->UnbindComputeShader();
+}
 
-	g_theRenderer->SetSamplerMode(SamplerMode::BILINEAR_WRAP);
+Texture* CloudManager::GetCloudOutputTexture() const
+{
+	if (m_temporalBlockSize > 1 && demonstration == 0)
+	{
+		return m_cloudHistoryTextures[m_temporalHistoryIndex];
+	}
+	return m_outCloudTexture;
 }
 
-void CloudManager::RunShadowCompute() const
+void CloudManager::RunShadowCompute(const CloudOpacityShadowFrame& lightFrame) const
 {
 	//Bind the shadow compute shader for drawing the shadow map
-	g_theRenderer->BindComputeShader(m_cloudShadowShader);
+	g_theRenderBackend->BindComputeShader(m_cloudShadowShader);
 
+	// Expand the opacity series over just the depths the clouds span
+	CloudOpacityShadowMapGPU depthRange = CloudOpacityShadowMap::ComputeDepthRange(m_cloudsGPU, lightFrame);
+	g_theRenderBackend->CopyCPUToGPU(&depthRange, 1, m_opacityShadowMapBuffer);
 
 
-	g_theRenderer->BindStructuredBufferToWrite(0, m_inCloudBuffer);
-	g_theRenderer->BindStructuredBufferToWrite(1, m_inVoxelBuffer);
+
+	g_theRenderBackend->BindStructuredBufferToWrite(0, m_inCloudBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(1, m_inVoxelBuffer);
 	//g_theRenderer->BindStructuredBufferToWrite(1, m_inVoxelPositionBuffer);
-	g_theRenderer->BindTexture3D(PipelineStage::COMPUTE, m_noiseTexture, 2);
-	g_theRenderer->BindTexture3D(PipelineStage::COMPUTE, m_worleyTexture, 3);
-	g_theRenderer->BindStructuredBufferToWrite(4, m_voxelOctreeBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(2, m_perlinNoiseBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(3, m_worleyNoiseBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(4, m_voxelOctreeBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(6, m_windFieldBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(7, m_blueNoiseBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(8, m_rayJitterBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(10, m_noiseVolumeLevelBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(16, m_opacityShadowMapBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(17, m_lightVisibleCloudBuffer);
+	g_theRenderBackend->BindStructuredBufferToWrite(19, m_frameConstantsBuffer);
 	//g_theRenderer->BindStructuredBufferToWrite(4, m_cloudOctreeBuffer);
 
-	g_theRenderer->BindTextureWithUAV(PipelineStage::COMPUTE, m_outShadowTexture);
+	g_theRenderBackend->BindTextureWithUAV(PipelineStage::COMPUTE, m_outShadowTexture);
 
-	g_theRenderer->SetSamplerMode(SamplerMode::BILINEAR_WRAP);
+	g_theRenderBackend->SetSamplerMode(SamplerMode::BILINEAR_WRAP);
 
-	IntVec2 dimensions = g_theWindow->GetClientDimensions();
+	IntVec2 dimensions = g_theRenderBackend->GetRenderDimensions();
 
 	//int threadsx = (dimensions.x + 15) / 16;
 	//int threadsy = (dimensions.y + 15) / 16;
@@ -678,48 +801,84 @@ void CloudManager::RunShadowCompute() const
 	//int threadsy = (halfHeight + 31) / 32;
 
 	if (demonstration == 0)
-		g_theRenderer->DispatchComputeJob(m_cloudShadowShader, threadsx, threadsy, 1);
+		g_theRenderBackend->DispatchComputeJob(m_cloudShadowShader, threadsx, threadsy, 1);
 	else
-		g_theRenderer->DispatchComputeJob(m_cloudShadowShader, threadsx, threadsy, 1);
+		g_theRenderBackend->DispatchComputeJob(m_cloudShadowShader, threadsx, threadsy, 1);
 
-	g_theRenderer->UnbindComputeShader();
+	g_theRenderBackend->UnbindComputeShader();
 
-	g_theRenderer->BindTexture();
+	g_theRenderBackend->BindTexture();
 
-	g_theRenderer->SetSamplerMode(SamplerMode::BILINEAR_WRAP);
+	g_theRenderBackend->SetSamplerMode(SamplerMode::BILINEAR_WRAP);
 }
 
 void CloudManager::RenderClouds() const
 {
 	RunCloudCompute();
 
-	g_theRenderer->SetBlendMode(BlendMode::ALPHA);
+	g_theRenderBackend->SetBlendMode(BlendMode::ALPHA);
 
-	g_theRenderer->BindShader(m_cloudDebugShader);
+	g_theRenderBackend->BindShader(m_cloudDebugShader);
 
-	g_theRenderer->BindShaderResources(m_outCloudTexture->GetShaderResourceView(), 0);
+	g_theRenderBackend->BindShaderResources(GetCloudOutputTexture(), 0);
 
-	g_theRenderer->DrawFullScreenQuad();
+	g_theRenderBackend->DrawFullScreenQuad();
 
-	g_theRenderer->UnbindComputeShader();
+	g_theRenderBackend->UnbindComputeShader();
 }
 
-void CloudManager::RenderShadows() const
+void CloudManager::RenderShadows(const CloudOpacityShadowFrame& lightFrame)
 {
-	RunShadowCompute();
+	UpdateLightVisibility(lightFrame);
+	RunShadowCompute(lightFrame);
 
-	g_theRenderer->UnbindComputeShader();
+	g_theRenderBackend->UnbindComputeShader();
 }
 
 void CloudManager::DebugRenderClouds() const
 {
-	//g_theRenderer->DrawIndexedBuffer(m_debugVoxelBuffer, m_debugIndexBuffer);
-	//
-	//g_theRenderer->SetRasterizerMode(RasterizerMode::WIREFRAME_CULL_NONE);
-	//
-	//g_theRenderer->DrawIndexedBuffer(m_debugWireframeVBO, m_debugWireframeIBO);
-	//
-	//g_theRenderer->SetRasterizerMode(RasterizerMode::SOLID_CULL_BACK);
+	const std::vector<Vertex_PCU>& verts = m_debugVoxelView.GetVerts();
+	if (!m_debugVoxelView.IsEnabled() || verts.empty())
+	{
+		return;
+	}
+
+	// Density-coloured boxes, then the same boxes again as a green wireframe
+	g_theRenderBackend->SetModelConstants();
+	g_theRenderBackend->BindTexture(nullptr);
+	g_theRenderBackend->DrawVertexArray((int)verts.size(), verts.data());
+
+	g_theRenderBackend->SetRasterizerMode(RasterizerMode::WIREFRAME_CULL_BACK);
+	g_theRenderBackend->SetModelConstants(Mat44(), Rgba8::GREEN);
+	g_theRenderBackend->DrawVertexArray((int)verts.size(), verts.data());
+
+	g_theRenderBackend->SetRasterizerMode(RasterizerMode::SOLID_CULL_BACK);
+	g_theRenderBackend->SetModelConstants();
+}
+
+void CloudManager::UpdateDebugVoxels()
+{
+	if (!m_scene || !m_debugVoxelView.NeedsRebuild(m_sceneVersion))
+	{
+		return;
+	}
+
+	// From the snapshot being drawn, not m_cloudInstances, which may already hold the next scene. Every instance
+	// shows its prototype's voxels where it placed them.
+	std::vector<CloudDebugVoxelInstance>& instances = m_debugVoxelView.BeginInstances();
+	for (const CloudGPU& cloud : m_scene->clouds)
+	{
+		for (unsigned int voxelIndex = cloud.voxelOffset; voxelIndex < cloud.voxelOffset + cloud.voxelCount; ++voxelIndex)
+		{
+			const Voxel& voxel = m_scene->voxels[voxelIndex];
+			CloudDebugVoxelInstance instance;
+			instance.center = GetWorldPosition(cloud, voxel.m_position);
+			instance.scale = cloud.scale;
+			instance.density = voxel.m_density * cloud.densityScale;
+			instances.push_back(instance);
+		}
+	}
+	m_debugVoxelView.Build(m_voxelDimensions, m_sceneVersion);
 }
 
 //void CloudManager::BuildOctrees()
@@ -738,29 +897,6 @@ void CloudManager::DebugRenderClouds() const
 //	}
 //}
 
-void CloudManager::SerializeOctreesToGPU(std::vector<OctreeNodeGPU>& gpuNodes, std::vector<Voxel>& gpuVoxels) const
-{
-	gpuNodes.clear();
-	gpuVoxels.clear();
-
-	// Map to track unique voxels by position
-	std::unordered_map<Vec3, int, Vec3Hasher> voxelMap;
-
-	for (const auto& octree : m_voxelOctrees) {
-		// Serialize octree nodes and voxels
-		octree->SerializeToGPU(gpuNodes, gpuVoxels, voxelMap);
-	}
-
-	// Log duplicate voxels (optional, now redundant with voxelMap)
-	for (int i = 0; i < gpuVoxels.size(); i++) {
-		for (int j = i + 1; j < gpuVoxels.size(); j++) {
-			if (gpuVoxels[i].m_position == gpuVoxels[j].m_position) {
-				printf("Duplicate voxel found at %i and %i\n", i, j);
-			}
-		}
-	}
-}
-
 void CloudManager::SerializePositionOctreesToGPU(std::vector<OctreeNodeGPU>& gpuNodes, std::vector<Vec3>& gpuPositions) const
 {
 	gpuNodes.clear();
@@ -784,29 +920,479 @@ void CloudManager::SerializePositionOctreesToGPU(std::vector<OctreeNodeGPU>& gpu
 	//}
 }
 
-void CloudManager::InitializeNoiseTexture(int width, int height, int depth, float frequency, int octaves)
+void CloudManager::InitializeNoiseVolumes()
 {
-	UNUSED(frequency);
-	UNUSED(octaves);
-	m_noiseTexture = g_theRenderer->CreateTexture3DFromNoise(IntVec3(width, height, depth), 100.f, octaves, 0.5f, 2.f, true);
+	// The shaders read the baked mip chains instead of Texture3Ds without mips, so SampleNoise's lod 0.5 and 1
+	// lookups get the filtered levels. Baking 256^3 takes a while; after the first run it loads from the cache.
+	CloudNoiseVolumesConfig noiseConfig;
+	noiseConfig.size = GPU_NOISE_VOLUME_SIZE;
+	m_noiseVolumes.LoadOrBake(noiseConfig);
+
+	std::vector<float> texels;
+	std::vector<NoiseVolumeLevelGPU> levels;
+	FlattenVolumeMipChain(m_noiseVolumes.GetPerlin(), texels, levels);
+	m_perlinNoiseBuffer = g_theRenderBackend->CreateStructuredBuffer(texels.size(), sizeof(float), true);
+	g_theRenderBackend->CopyCPUToGPU(texels.data(), texels.size(), m_perlinNoiseBuffer);
+
+	FlattenVolumeMipChain(m_noiseVolumes.GetWorley(), texels, levels);
+	m_worleyNoiseBuffer = g_theRenderBackend->CreateStructuredBuffer(texels.size(), sizeof(float), true);
+	g_theRenderBackend->CopyCPUToGPU(texels.data(), texels.size(), m_worleyNoiseBuffer);
+
+	m_noiseVolumeLevelBuffer = g_theRenderBackend->CreateStructuredBuffer(levels.size(), sizeof(NoiseVolumeLevelGPU), true);
+	g_theRenderBackend->CopyCPUToGPU(levels.data(), levels.size(), m_noiseVolumeLevelBuffer);
+	m_noiseVolumeLevelCount = levels.size();
+}
 
-	//m_noiseTexture3D = GeneratePerlin3D(width, height, depth, 1.f, frequency, 1.f, 1.f, octaves, 0);
-	//m_noiseTexture3D = GeneratePerlin3D(width, height, depth, frequency, octaves, 1.0f, 0.5f, 4, 0);
+void CloudManager::BindNoiseTexture() const
+{
+	//g_theRenderer->SetLightConstants(m_sunDirection.GetNormalized(), m_sunIntensity, m_ambientIntensity);
+	g_theRenderBackend->SetModelConstants();
+	g_theRenderBackend->SetBlendMode(BlendMode::ALPHA);
+	g_theRenderBackend->BindTexture(nullptr);
+	g_theRenderBackend->BindShader(m_cloudShader);
+	//g_theRenderer->BindTexture3D(m_noiseTexture);
+	g_theRenderBackend->SetDepthMode(DepthMode::DISABLED);
+	g_theRenderBackend->SetRasterizerMode(RasterizerMode::SOLID_CULL_BACK);
 }
+void CloudManager::InitializeWindField()
+{
+	// Baked once with unit strength; the weather's wind speed is applied when the volume is uploaded
+	CurlNoiseConfig windConfig;
+	windConfig.dimensions = IntVec3(WIND_FIELD_SIZE, WIND_FIELD_SIZE, WIND_FIELD_SIZE);
+	windConfig.period = 4;
+	windConfig.numOctaves = 2;
+	windConfig.strength = 1.f;
+
+	m_windField.Bake(windConfig);
 
-void CloudManager::InitializeWorleyTexture(int width, int height, int depth, int cellSize, unsigned int seed)
+	m_windFieldBuffer = g_theRenderBackend->CreateStructuredBuffer(m_windField.GetVelocities().size(), sizeof(Vec3), true);
+}
+
+void CloudManager::UploadWindField(float windSpeed)
 {
-	m_worleyTexture = g_theRenderer->CreateTexture3DFromWorley(IntVec3(width, height, depth), cellSize, seed);
+	const std::vector<Vec3>& velocities = m_windField.GetVelocities();
+
+	std::vector<Vec3> scaledVelocities;
+	scaledVelocities.reserve(velocities.size());
+
+	for (const Vec3& velocity : velocities)
+	{
+		scaledVelocities.push_back(velocity * windSpeed);
+	}
+
+	g_theRenderBackend->CopyCPUToGPU(scaledVelocities.data(), scaledVelocities.size(), m_windFieldBuffer);
+	m_uploadedWindSpeed = windSpeed;
 }
 
-void CloudManager::BindNoiseTexture() const
+void CloudManager::InitializeBlueNoise()
 {
-	//g_theRenderer->SetLightConstants(m_sunDirection.GetNormalized(), m_sunIntensity, m_ambientIntensity);
-	g_theRenderer->SetModelConstants();
-	g_theRenderer->SetBlendMode(BlendMode::ALPHA);
-	g_theRenderer->BindTexture(nullptr);
-	g_theRenderer->BindShader(m_cloudShader);
-	//g_theRenderer->BindTexture3D(m_noiseTexture);
-	g_theRenderer->SetDepthMode(DepthMode::DISABLED);
-	g_theRenderer->SetRasterizerMode(RasterizerMode::SOLID_CULL_BACK);
-}
\ No newline at end of file
+	// Generating takes a moment, so the texture is cached next to the other generated data
+	BlueNoiseConfig blueNoiseConfig;
+	m_blueNoise.LoadOrGenerate(blueNoiseConfig, "Data/Cache");
+
+	const std::vector<float>& values = m_blueNoise.GetValues();
+	m_blueNoiseBuffer = g_theRenderBackend->CreateStructuredBuffer(values.size(), sizeof(float), true);
+	g_theRenderBackend->CopyCPUToGPU(values.data(), values.size(), m_blueNoiseBuffer);
+
+	m_rayJitterBuffer = g_theRenderBackend->CreateStructuredBuffer(1, sizeof(RayJitterGPU), true);
+}
+
+void CloudManager::BuildRayMarchScene(CloudRayMarchScene& scene, CloudRayMarchSettings& settings) const
+{
+	scene.clouds = m_cloudsGPU;
+	scene.prototypes.clear();
+	scene.voxels.clear();
+	scene.octreeNodes.clear();
+	if (m_scene)
+	{
+		scene.prototypes = m_scene->prototypes;
+		scene.voxels = m_scene->voxels;
+		scene.octreeNodes = m_scene->octreeNodes;
+	}
+	scene.occluders = m_sceneOccluders;
+	GetRayMarchSettings(settings);
+}
+
+void CloudManager::GetRayMarchSettings(CloudRayMarchSettings& settings) const
+{
+	// scatteringCoefficient and densityThreshold aren't driven from the Profiler, so the settings defaults stand
+	settings.voxelDimensions = m_cloudConstants.VoxelDimensions;
+	settings.sunDirection = m_game->m_weather.m_lightConstants.SunDirection;
+	settings.timeElapsed = m_frameConstants.timeElapsed;
+	settings.useDensity = m_cloudConstants.useDensity != 0;
+	settings.useNoise = m_cloudConstants.useNoise != 0;
+	settings.invertNoise = m_cloudConstants.invertNoise != 0;
+	settings.scrolling = m_cloudConstants.scrolling != 0;
+	settings.densityMultiplier = m_cloudConstants.densityMultiplier;
+	settings.extinctionCoefficient = m_cloudConstants.extinctionCoefficient;
+	settings.minStepSize = m_cloudConstants.minStepSize;
+	settings.noiseScale = m_cloudConstants.noiseScale;
+	settings.noiseLerpVal = m_cloudConstants.noiseLerpVal;
+	settings.densityNoiseLerpVal = m_cloudConstants.densityNoiseLerpVal;
+	settings.cloudVoxelDistanceLerpVal = m_cloudConstants.cloudVoxelDistanceLerpVal;
+	settings.minWorleyValue = m_cloudConstants.minWorleyValue;
+	settings.noisePowVal = m_cloudConstants.noisePowVal;
+	settings.scrollFactor = m_cloudConstants.scrollFactor;
+	settings.farDistanceThreshold = m_cloudConstants.farDistanceThreshold;
+	settings.farMultiplier = m_cloudConstants.farMultiplier;
+	settings.shadowFactorMin = m_cloudConstants.shadowFactorMin;
+	settings.powderBias = m_cloudConstants.powderBias;
+	settings.anisotropy = m_cloudConstants.anisotropy;
+	settings.windSpeed = m_uploadedWindSpeed;
+}
+
+void CloudManager::UploadRayJitter()
+{
+	RayJitterGPU rayJitter = BlueNoiseTexture::GetRayJitterForFrame(m_frameIndex++, m_rayJitterStrength);
+	g_theRenderBackend->CopyCPUToGPU(&rayJitter, 1, m_rayJitterBuffer);
+}
+
+void CloudManager::InitializeTemporalReprojection()
+{
+	IntVec2 dimensions = g_theRenderBackend->GetRenderDimensions();
+	m_cloudLowResTextures[0] = g_theRenderBackend->CreateEmptyTextureWithUAV("CloudLowResTexture2x2", IntVec2((dimensions.x + 1) / 2, (dimensions.y + 1) / 2));
+	m_cloudLowResTextures[1] = g_theRenderBackend->CreateEmptyTextureWithUAV("CloudLowResTexture4x4", IntVec2((dimensions.x + 3) / 4, (dimensions.y + 3) / 4));
+	m_cloudHistoryTextures[0] = g_theRenderBackend->CreateEmptyTextureWithUAV("CloudHistoryTexture0", dimensions);
+	m_cloudHistoryTextures[1] = g_theRenderBackend->CreateEmptyTextureWithUAV("CloudHistoryTexture1", dimensions);
+
+	m_cloudTemporalShader = g_theRenderBackend->CreateOrGetComputeShader("Data/Shaders/CloudTemporalShader", VertexType::VOXEL_CLOUDS);
+	m_temporalReprojectionBuffer = g_theRenderBackend->CreateStructuredBuffer(1, sizeof(TemporalReprojectionGPU), true);
+}
+
+void CloudManager::UploadTemporalReprojection(float deltaSeconds)
+{
+	IntVec2 dimensions = g_theRenderBackend->GetRenderDimensions();
+
+	TemporalReprojectionGPU temporal;
+	temporal.blockSize = m_temporalBlockSize;
+	temporal.outputWidth = dimensions.x;
+	temporal.outputHeight = dimensions.y;
+
+	if (m_temporalBlockSize > 1)
+	{
+		IntVec2 phase = GetTemporalFramePhase(m_temporalFrameIndex++, m_temporalBlockSize);
+		temporal.phaseX = phase.x;
+		temporal.phaseY = phase.y;
+		temporal.previousViewProjection = m_previousViewProjection;
+		temporal.historyValid = m_hasTemporalHistory ? 1 : 0;
+		temporal.cloudDrift = GetCloudNoiseVelocity(m_cloudConstants.scrollFactor, m_cloudConstants.noiseScale, m_voxelDimensions) * deltaSeconds;
+
+		// Last frame's output becomes the history this frame reads
+		m_temporalHistoryIndex = 1 - m_temporalHistoryIndex;
+	}
+	m_hasTemporalHistory = m_temporalBlockSize > 1;
+	m_previousViewProjection = m_game->m_player->m_playerCam.GetViewProjectionMatrix();
+
+	g_theRenderBackend->CopyCPUToGPU(&temporal, 1, m_temporalReprojectionBuffer);
+}
+
+void CloudManager::InitializeBilateralUpsample()
+{
+	// Colors in the top half, depths in the bottom half, so the march still writes a single UAV
+	IntVec2 dimensions = g_theRenderBackend->GetRenderDimensions();
+	m_cloudUpsampleAtlases[0] = g_theRenderBackend->CreateEmptyTextureWithUAV("CloudUpsampleAtlas2x2", IntVec2((dimensions.x + 1) / 2, ((dimensions.y + 1) / 2) * 2));
+	m_cloudUpsampleAtlases[1] = g_theRenderBackend->CreateEmptyTextureWithUAV("CloudUpsampleAtlas4x4", IntVec2((dimensions.x + 3) / 4, ((dimensions.y + 3) / 4) * 2));
+
+	m_cloudUpsampleShader = g_theRenderBackend->CreateOrGetComputeShader("Data/Shaders/CloudUpsampleShader", VertexType::VOXEL_CLOUDS);
+	m_cloudUpsampleBuffer = g_theRenderBackend->CreateStructuredBuffer(1, sizeof(CloudUpsampleGPU), true);
+	m_sceneOccluderBuffer = g_theRenderBackend->CreateStructuredBuffer(MAX_SCENE_OCCLUDERS, sizeof(SceneOccluderGPU), true);
+}
+
+void CloudManager::UploadBilateralUpsample()
+{
+	IntVec2 dimensions = g_theRenderBackend->GetRenderDimensions();
+
+	CloudUpsampleGPU upsample;
+	upsample.factor = (m_temporalBlockSize > 1) ? 1 : m_upsampleFactor;
+	upsample.outputWidth = dimensions.x;
+	upsample.outputHeight = dimensions.y;
+	upsample.numOccluders = (int)m_sceneOccluders.size();
+	upsample.depthSigma = m_upsampleDepthSigma;
+	g_theRenderBackend->CopyCPUToGPU(&upsample, 1, m_cloudUpsampleBuffer);
+
+	if (!m_sceneOccluders.empty())
+	{
+		g_theRenderBackend->CopyCPUToGPU(m_sceneOccluders.data(), upsample.numOccluders, m_sceneOccluderBuffer);
+	}
+}
+
+void CloudManager::InitializeParameters()
+{
+	// Bound straight to the values they tune, so nothing is copied per frame
+	m_parameters.AddFloat("extinctionCoefficient", "Extinction Coefficient", &m_cloudConstants.extinctionCoefficient, 1.f, .1f, 5.f);
+	m_parameters.AddFloat("densityMultiplier", "Density Multiplier", &m_cloudConstants.densityMultiplier, .37f, 0.f, 3.f);
+	m_parameters.AddFloat("minStepSize", "Min Step Size", &m_cloudConstants.minStepSize, 0.03f, 0.01f, 1.f);
+	m_parameters.AddFloat("noiseScale", "Noise Scale", &m_cloudConstants.noiseScale, .8f, 0.001f, 3.f, "%.3f");
+	m_parameters.AddFloat("noiseLerpVal", "Noise Lerp Value", &m_cloudConstants.noiseLerpVal, .5f, 0.f, 1.f);
+	m_parameters.AddFloat("densityNoiseLerpVal", "Density Noise Lerp Value", &m_cloudConstants.densityNoiseLerpVal, .92f, 0.f, 1.f);
+	m_parameters.AddFloat("cloudVoxelDistanceLerpVal", "Cloud Voxel Distance Lerp Value", &m_cloudConstants.cloudVoxelDistanceLerpVal, .87f, 0.f, 1.f);
+	m_parameters.AddFloat("minWorleyValue", "Min Worley Value", &m_cloudConstants.minWorleyValue, 0.32f, 0.f, 1.f);
+	m_parameters.AddFloat("noisePowVal", "Noise Pow Value", &m_cloudConstants.noisePowVal, 3.7f, 0.f, 5.f);
+	m_parameters.AddFloat("scrollFactor", "Scroll Factor", &m_cloudConstants.scrollFactor, 0.5f, .0f, 3.f, "%.1f");
+	m_parameters.AddFloat("farDistanceThreshold", "Far Distance Threshold", &m_cloudConstants.farDistanceThreshold, 50.f, 0.f, 200.f, "%.1f");
+	m_parameters.AddFloat("farMultiplier", "Far Multiplier", &m_cloudConstants.farMultiplier, 2.8f, 0.f, 10.f, "%.1f");
+	m_parameters.AddFloat("shadowFactorMin", "Shadow Factor Min", &m_cloudConstants.shadowFactorMin, 0.93f, 0.f, 1.f);
+	m_parameters.AddFloat("powderBias", "Powder Bias", &m_cloudConstants.powderBias, 0.9f, 0.f, 10.f, "%.1f");
+	m_parameters.AddFloat("anisotropy", "Anisotropy", &m_cloudConstants.anisotropy, 0.01f, 0.f, 1.f);
+	m_parameters.AddFloat("falloff", "Falloff", &m_cloudConstants.falloff, 0.5f, 0.f, 5.f);
+	m_parameters.AddFloat("rayIntensity", "Ray Intensity", &m_game->grc.intensity, 1.06f, 0.f, 5.f);
+	m_parameters.AddFloat("rayDecay", "Ray Decay", &m_game->grc.decay, .005f, 0.f, .1f, "%.3f");
+	m_parameters.AddFloat("shadowCastMin", "Minimum Shadow Cast", &m_game->sc.minShadow, .95f, 0.f, 1.f);
+	m_parameters.AddFloat("rayJitterStrength", "Ray Start Jitter", &m_rayJitterStrength, 1.f, 0.f, 1.f);
+	m_parameters.AddInt("temporalMode", "Temporal Amortization", &m_temporalMode, 0, "Off\0One ray per 2x2\0One ray per 4x4\0");
+	m_parameters.AddInt("upsampleMode", "Cloud Upsampling", &m_upsampleMode, 0, "Replicate 2x2\0Bilateral 2x2\0Bilateral 4x4\0");
+	m_parameters.AddFloat("upsampleDepthSigma", "Upsample Depth Sigma", &m_upsampleDepthSigma, 0.1f, 0.f, 1.f);
+	m_parameters.AddBool("useSunTransmittance", "Sun Transmittance Volume", &m_useSunTransmittance, true);
+	m_parameters.AddBool("useFrustumCulling", "Frustum Culling", &m_useFrustumCulling, true);
+	m_parameters.AddBool("useAsyncRebuild", "Async Rebuild", &m_useAsyncRebuild, true);
+	m_parameters.AddFloat("memoryBudgetMB", "Memory Budget MB (0 = none)", &m_memoryBudgetMB, 0.f, 0.f, 512.f, "%.0f");
+
+	// Without a file, or a default preset in it, the values above stand
+	if (m_parameters.LoadPresets(CLOUD_PRESETS_FILE_PATH) && !m_parameters.GetDefaultPresetName().empty())
+	{
+		m_parameters.ApplyPreset(m_parameters.GetDefaultPresetName());
+	}
+}
+
+bool CloudManager::ApplyParameterPreset(const std::string& presetName)
+{
+	return m_parameters.ApplyPreset(presetName);
+}
+
+void CloudManager::ApplyParameters()
+{
+	// Combo indices to block sizes; the cost heatmap needs every block's own ray
+	bool isCostView = m_costViewChannel >= 0;
+	m_isCostViewApplied = isCostView;
+	m_temporalBlockSize = (isCostView || m_temporalMode == 0) ? 1 : ((m_temporalMode == 1) ? 2 : 4);
+	m_upsampleFactor = (isCostView || m_upsampleMode == 0) ? 1 : ((m_upsampleMode == 1) ? 2 : 4);
+}
+
+void CloudManager::UploadConstants()
+{
+	LightConstants lightConstants;
+	lightConstants = m_game->m_weather.m_lightConstants;
+
+	g_theRenderBackend->SetCurrentCamera(PipelineStage::COMPUTE, m_game->m_player->m_playerCam);
+
+	// The constant buffers keep their contents and compute bindings between frames, so a block is only sent when its
+	// bytes changed: a parameter edit, a preset, the scene or the sun. The scroll time is in m_frameConstants instead.
+	bool forceUpload = !m_hasUploadedConstants;
+	if (forceUpload || memcmp(&lightConstants, &m_uploadedLightConstants, sizeof(LightConstants)) != 0)
+	{
+		g_theRenderBackend->SetLightConstants(PipelineStage::COMPUTE, lightConstants);
+		m_uploadedLightConstants = lightConstants;
+		m_constantUploadStats.numUploads++;
+	}
+	else
+	{
+		m_constantUploadStats.numSkipped++;
+	}
+
+	if (forceUpload || memcmp(&m_cloudConstants, &m_uploadedCloudConstants, sizeof(CloudConstants)) != 0)
+	{
+		g_theRenderBackend->SetCloudConstants(PipelineStage::COMPUTE, m_cloudConstants);
+		m_uploadedCloudConstants = m_cloudConstants;
+		m_constantUploadStats.numUploads++;
+	}
+	else
+	{
+		m_constantUploadStats.numSkipped++;
+	}
+
+	if (forceUpload || memcmp(&m_game->sc, &m_uploadedShadowConstants, sizeof(ShadowConstants)) != 0)
+	{
+		g_theRenderBackend->SetShadowConstants(PipelineStage::COMPUTE, m_game->sc);
+		m_uploadedShadowConstants = m_game->sc;
+		m_constantUploadStats.numUploads++;
+	}
+	else
+	{
+		m_constantUploadStats.numSkipped++;
+	}
+	m_hasUploadedConstants = true;
+}
+
+void CloudManager::InitializeCostView()
+{
+	m_costViewBuffer = g_theRenderBackend->CreateStructuredBuffer(1, sizeof(CloudCostViewGPU), true);
+}
+
+void CloudManager::UploadCostView()
+{
+	CloudCostViewGPU costView;
+	costView.channel = m_costViewChannel;
+	costView.maxValue = m_costViewMaxValue;
+	g_theRenderBackend->CopyCPUToGPU(&costView, 1, m_costViewBuffer);
+}
+
+void CloudManager::UploadFrameConstants()
+{
+	m_frameConstants.timeElapsed = (float)m_game->m_gameClock->GetTotalSeconds();
+	g_theRenderBackend->CopyCPUToGPU(&m_frameConstants, 1, m_frameConstantsBuffer);
+}
+
+void CloudManager::SetSceneOccluders(const std::vector<SceneOccluderGPU>& occluders)
+{
+	m_sceneOccluders = occluders;
+	if ((int)m_sceneOccluders.size() > MAX_SCENE_OCCLUDERS)
+	{
+		m_sceneOccluders.resize(MAX_SCENE_OCCLUDERS);
+	}
+}
+
+void CloudManager::InitializeSunTransmittance()
+{
+	// A single empty header: out-of-range reads come back zero too, so every cloud uses the voxel shadow map
+	SunTransmittanceVolumeGPU emptyVolume;
+	m_sunTransmittanceVolumeBuffer = g_theRenderBackend->CreateStructuredBuffer(1, sizeof(SunTransmittanceVolumeGPU), true);
+	g_theRenderBackend->CopyCPUToGPU(&emptyVolume, 1, m_sunTransmittanceVolumeBuffer);
+	m_sunTransmittanceBuffer = g_theRenderBackend->CreateStructuredBuffer(1, sizeof(float), true);
+	m_sunTransmittanceVolumeCapacity = 1;
+	m_sunTransmittanceCellCapacity = 1;
+}
+
+void CloudManager::UpdateSunTransmittance()
+{
+	PROFILE_SCOPE("Sun Transmittance");
+	if (!m_useSunTransmittance)
+	{
+		if (!m_sunTransmittance.GetVolumes().empty())
+		{
+			m_sunTransmittance.Clear();
+			std::vector<SunTransmittanceVolumeGPU> emptyVolumes(m_sunTransmittanceVolumeCapacity);
+			g_theRenderBackend->CopyCPUToGPU(emptyVolumes.data(), emptyVolumes.size(), m_sunTransmittanceVolumeBuffer);
+		}
+		return;
+	}
+
+	CloudRayMarchSettings settings;
+	GetRayMarchSettings(settings);
+	if (m_cloudsGPU.empty() || !m_sunTransmittance.NeedsRebuild(settings, m_sunTransmittanceConfig, m_scene->requestIndex))
+	{
+		return;
+	}
+
+	// The snapshot's volumes are built for its request's settings; when those moved since, or sun transmittance was
+	// just turned on, the frame builds them, and a sun that only moved re-sweeps the cell extinctions
+	CloudRayMarchScene scene;
+	BuildRayMarchScene(scene, settings);
+	CloudRayMarcher marcher(scene, m_noiseVolumes, settings);
+	marcher.SetWindField(&m_windField);
+	m_sunTransmittance.Build(scene, marcher, m_sunTransmittanceConfig, m_scene->requestIndex);
+	UploadSunTransmittance();
+}
+
+void CloudManager::UploadSunTransmittance()
+{
+	const std::vector<SunTransmittanceVolumeGPU>& volumes = m_sunTransmittance.GetVolumes();
+	const std::vector<float>& transmittance = m_sunTransmittance.GetTransmittance();
+	if (volumes.size() > m_sunTransmittanceVolumeCapacity)
+	{
+		delete m_sunTransmittanceVolumeBuffer;
+		m_sunTransmittanceVolumeBuffer = g_theRenderBackend->CreateStructuredBuffer(volumes.size(), sizeof(SunTransmittanceVolumeGPU), true);
+		m_sunTransmittanceVolumeCapacity = volumes.size();
+	}
+	if (transmittance.size() > m_sunTransmittanceCellCapacity)
+	{
+		delete m_sunTransmittanceBuffer;
+		m_sunTransmittanceBuffer = g_theRenderBackend->CreateStructuredBuffer(transmittance.size(), sizeof(float), true);
+		m_sunTransmittanceCellCapacity = transmittance.size();
+	}
+	g_theRenderBackend->CopyCPUToGPU(volumes.data(), volumes.size(), m_sunTransmittanceVolumeBuffer);
+	g_theRenderBackend->CopyCPUToGPU(transmittance.data(), transmittance.size(), m_sunTransmittanceBuffer);
+}
+
+void CloudManager::InitializeCloudVisibility()
+{
+	// Empty lists until the first update: a zero count tests no clouds
+	std::vector<unsigned int> emptyList(1, 0);
+	UploadVisibleClouds(emptyList, m_cameraVisibleCloudBuffer, m_cameraVisibleCloudCapacity);
+	UploadVisibleClouds(emptyList, m_lightVisibleCloudBuffer, m_lightVisibleCloudCapacity);
+}
+
+void CloudManager::UpdateCameraVisibility()
+{
+	PROFILE_SCOPE("Camera Culling");
+	std::chrono::steady_clock::time_point cullStart = std::chrono::steady_clock::now();
+	if (m_useFrustumCulling)
+	{
+		const Camera& playerCam = m_game->m_player->m_playerCam;
+		Mat44 cameraOrientation = playerCam.m_orientation.GetMatrix_XFwd_YLeft_ZUp();
+		IntVec2 dimensions = g_theRenderBackend->GetRenderDimensions();
+
+		CloudRayMarchCamera camera;
+		camera.position = playerCam.m_position;
+		camera.forward = cameraOrientation.GetIBasis3D();
+		camera.left = cameraOrientation.GetJBasis3D();
+		camera.up = cameraOrientation.GetKBasis3D();
+		camera.fovDegrees = 60.f;
+		camera.aspect = (float)dimensions.x / (float)dimensions.y;
+
+		CloudRayMarchSettings settings;
+		CullClouds(m_cloudsGPU, CloudCullFrustum::MakePerspective(camera, settings.maxDistance, m_cullMargin), m_cameraVisibleClouds);
+	}
+	else
+	{
+		MakeAllCloudsVisible((int)m_cloudsGPU.size(), m_cameraVisibleClouds);
+	}
+	UploadVisibleClouds(m_cameraVisibleClouds, m_cameraVisibleCloudBuffer, m_cameraVisibleCloudCapacity);
+
+	m_visibilityStats.numClouds = (int)m_cloudsGPU.size();
+	m_visibilityStats.numCameraVisible = (int)m_cameraVisibleClouds[0];
+	m_visibilityStats.cameraSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - cullStart).count();
+}
+
+void CloudManager::UpdateLightVisibility(const CloudOpacityShadowFrame& lightFrame)
+{
+	std::chrono::steady_clock::time_point cullStart = std::chrono::steady_clock::now();
+	if (m_useFrustumCulling)
+	{
+		CullClouds(m_cloudsGPU, CloudCullFrustum::MakeOrthographic(lightFrame, m_cullMargin), m_lightVisibleClouds);
+	}
+	else
+	{
+		MakeAllCloudsVisible((int)m_cloudsGPU.size(), m_lightVisibleClouds);
+	}
+	UploadVisibleClouds(m_lightVisibleClouds, m_lightVisibleCloudBuffer, m_lightVisibleCloudCapacity);
+
+	m_visibilityStats.numLightVisible = (int)m_lightVisibleClouds[0];
+	m_visibilityStats.lightSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - cullStart).count();
+}
+
+void CloudManager::UploadVisibleClouds(const std::vector<unsigned int>& visibleList, StructuredBuffer*& buffer, size_t& capacity)
+{
+	if (visibleList.size() > capacity)
+	{
+		delete buffer;
+		buffer = g_theRenderBackend->CreateStructuredBuffer(visibleList.size(), sizeof(unsigned int), true);
+		capacity = visibleList.size();
+	}
+	g_theRenderBackend->CopyCPUToGPU(visibleList.data(), visibleList.size(), buffer);
+}
+
+void CloudManager::UploadPersistentBuffers(const std::vector<OctreeNodeGPU>& gpuVoxelNodes, const std::vector<Voxel>& gpuVoxels,
+	const CloudSceneSnapshot* changedRanges)
+{
+	if (changedRanges != nullptr)
+	{
+		m_persistentCloudBuffer.Update(m_cloudsGPU.data(), m_cloudsGPU.size(), changedRanges->cloudRanges);
+		m_persistentVoxelBuffer.Update(gpuVoxels.data(), gpuVoxels.size(), changedRanges->voxelRanges);
+		m_persistentOctreeBuffer.Update(gpuVoxelNodes.data(), gpuVoxelNodes.size(), changedRanges->octreeNodeRanges);
+	}
+	else
+	{
+		m_persistentCloudBuffer.Update(m_cloudsGPU.data(), m_cloudsGPU.size());
+		m_persistentVoxelBuffer.Update(gpuVoxels.data(), gpuVoxels.size());
+		m_persistentOctreeBuffer.Update(gpuVoxelNodes.data(), gpuVoxelNodes.size());
+	}
+
+	m_lastRebuildUploadStats = m_persistentCloudBuffer.GetLastUpdateStats();
+	m_lastRebuildUploadStats.Add(m_persistentVoxelBuffer.GetLastUpdateStats());
+	m_lastRebuildUploadStats.Add(m_persistentOctreeBuffer.GetLastUpdateStats());
+
+	// A reallocation hands back a new buffer
+	m_inCloudBuffer = m_bufferBackend.GetBuffer(m_persistentCloudBuffer.GetHandle());
+	m_inVoxelBuffer = m_bufferBackend.GetBuffer(m_persistentVoxelBuffer.GetHandle());
+	m_voxelOctreeBuffer = m_bufferBackend.GetBuffer(m_persistentOctreeBuffer.GetHandle());
+}
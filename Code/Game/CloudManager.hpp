@@ -1,16 +1,49 @@
 #pragma once
 #include "Game/Cloud.hpp"
+#include "Game/CloudPrototype.hpp"
 #include "Game/Weather.hpp"
 #include <memory>
 #include "Game/Octree.hpp"
+#include "Game/CurlNoise.hpp"
+#include "Game/BlueNoise.hpp"
+#include "Game/CloudRayMarcher.hpp"
+#include "Game/CloudSunTransmittance.hpp"
+#include "Game/CloudOpacityShadowMap.hpp"
+#include "Game/CloudVisibility.hpp"
+#include "Game/CloudRendererBufferBackend.hpp"
+#include "Game/CloudDebugVoxels.hpp"
+#include "Game/CloudNoiseVolumes.hpp"
+#include "Game/CloudSceneSnapshot.hpp"
+#include "Game/ParameterRegistry.hpp"
+#include "Game/CloudMemoryBudget.hpp"
 
 class Game;
+struct CloudRayMarchScene;
+struct CloudRayMarchSettings;
+
+// Tuning values and their presets; saving a preset rewrites this file
+constexpr const char* CLOUD_PRESETS_FILE_PATH = "Data/GameConfig.xml";
+
+// What changes every frame, kept out of CloudConstants so that block is only re-sent after an edit (must match
+// CloudFrame in CloudShader.hlsl, CloudShadowShader.hlsl and CloudReshapedShader.hlsl)
+struct CloudFrameGPU
+{
+	float timeElapsed = 0.f;
+	float padding[3] = {};
+};
+
+struct CloudConstantUploadStats
+{
+	int numUploads = 0;
+	int numSkipped = 0;				// Constant blocks left as they were because nothing in them changed
+};
 
 class CloudManager
 {
 public:
 	int m_maxClouds = 200;
-	std::vector<Cloud> m_clouds;
+	CloudPrototypeLibrary m_prototypes;			// Generated shapes; each is one octree however often it is placed
+	std::vector<CloudInstance> m_cloudInstances;
 	std::vector<CloudGPU> m_cloudsGPU;
 public:
 	CloudManager(Game* game, int maxClouds = 50);
@@ -23,46 +56,122 @@ public:
 	void BeginFrame();
 	bool CreateTest();
 	bool CreateCloud(Vec3 location, IntVec3 dimesnions, float noiseScale, float threshold);
+
+	// Replaces the instances with numInstances random placements of the current prototypes inside a square of
+	// halfExtent around the test field, with scale, density and noise offset jitter
+	void ScatterInstances(int numInstances, float halfExtent, unsigned int seed);
 	void RemoveCloud(Cloud* cloud);
 	void UpdateClouds(float deltaSeconds, const Weather&weather);
 	void HandleInput(float deltaSeconds);
 	void RunCompute() const;
 	void RunCloudCompute() const;
-	void RunShadowCompute() const;
+	void RunTemporalReconstruction() const;
+	void RunBilateralUpsample() const;
+	void RunShadowCompute(const CloudOpacityShadowFrame& lightFrame) const;
 	void PrepareForRender();
 	void RenderClouds() const;
-	void RenderShadows() const;
+	void RenderShadows(const CloudOpacityShadowFrame& lightFrame);
 	void DebugRenderClouds() const;
+	void UpdateDebugVoxels();
 
 	//void BuildOctrees();
-	void SerializeOctreesToGPU(std::vector<OctreeNodeGPU>& gpuNodes, std::vector<Voxel>& gpuVoxels) const;
 	void SerializePositionOctreesToGPU(std::vector<OctreeNodeGPU>& gpuNodes, std::vector<Vec3>& gpuPositions) const;
 	//void SerializeCloudsToGPU(std::vector<CloudGPU>& gpuClouds, std::vector<Cloud>) const;
 
-	const std::vector<Cloud>& GetClouds() const { return m_clouds; }
+	const CloudPrototypeLibrary& GetPrototypes() const { return m_prototypes; }
+	const std::vector<CloudInstance>& GetCloudInstances() const { return m_cloudInstances; }
 	//void SetGlobalRenderState() const;
 
-	void InitializeNoiseTexture(int width, int height, int depth, float frequency, int octaves);
-	void InitializeWorleyTexture(int width, int height, int depth, int cellsize, unsigned int seed);
+	void InitializeNoiseVolumes();
 	void BindNoiseTexture() const;
+
+	void InitializeWindField();
+	void UploadWindField(float windSpeed);
+
+	void InitializeBlueNoise();
+	void UploadRayJitter();
+
+	void InitializeTemporalReprojection();
+	void UploadTemporalReprojection(float deltaSeconds);
+	Texture* GetCloudOutputTexture() const;
+
+	void InitializeBilateralUpsample();
+	void UploadBilateralUpsample();
+
+	// Cost heatmaps: the march shows one of its ray counters in false colour instead of the clouds (CloudRayCost.hpp)
+	void InitializeCostView();
+	void UploadCostView();
+	void UploadFrameConstants();
+
+	// Registers every tuning value with m_parameters and applies the default preset
+	void InitializeParameters();
+	void ApplyParameters();
+	void UploadConstants();
+
+	// Opaque boxes the clouds stop at; the full-res guide for the bilateral upsample
+	void SetSceneOccluders(const std::vector<SceneOccluderGPU>& occluders);
+
+	// Rebuilds the per-cloud sun transmittance volumes when the sun or the density changed, and uploads them
+	void InitializeSunTransmittance();
+	void UpdateSunTransmittance();
+	void UploadSunTransmittance();
+
+	// Culls the cloud boxes against the player camera (camera rays) and the light (shadow map) and uploads the lists
+	void InitializeCloudVisibility();
+	void UpdateCameraVisibility();
+	void UpdateLightVisibility(const CloudOpacityShadowFrame& lightFrame);
+	// changedRanges, when set, is a snapshot whose ranges lead from what the buffers hold to these arrays
+	void UploadPersistentBuffers(const std::vector<OctreeNodeGPU>& gpuVoxelNodes, const std::vector<Voxel>& gpuVoxels,
+		const CloudSceneSnapshot* changedRanges = nullptr);
+
+	// Makes a finished rebuild the scene that is uploaded, drawn and marched
+	void ApplySceneSnapshot(const std::shared_ptr<const CloudSceneSnapshot>& snapshot);
+	void UploadVisibleClouds(const std::vector<unsigned int>& visibleList, StructuredBuffer*& buffer, size_t& capacity);
+
+	// Copies the current GPU buffers and constants for the CPU reference marcher
+	void BuildRayMarchScene(CloudRayMarchScene& scene, CloudRayMarchSettings& settings) const;
+	void GetRayMarchSettings(CloudRayMarchSettings& settings) const;
+	const CurlNoiseField& GetWindField() const { return m_windField; }
+	const CloudNoiseVolumes& GetNoiseVolumes() const { return m_noiseVolumes; }
 	//const NoiseTexture* GetNoiseTexture() const { return m_noiseTexture; }
 
-	Texture3D* GetNoiseTexture3D() const { return m_noiseTexture; }
-	Texture3D* GetWorleyTexture3D() const { return m_worleyTexture; }
+	// Registered tuning values; a preset from CLOUD_PRESETS_FILE_PATH makes runs reproducible
+	ParameterRegistry& GetParameters() { return m_parameters; }
+	bool ApplyParameterPreset(const std::string& presetName);
+	const CloudConstantUploadStats& GetConstantUploadStats() const { return m_constantUploadStats; }
+
+	// Chooses every instance's detail level for the memory budget when the scene, the budget or the camera moved
+	// enough to matter, and asks for a rebuild if any level changed
+	void UpdateMemoryBudget();
+	void UpdateMemoryReport();
+	const CloudMemoryReport& GetMemoryReport() const { return m_memoryReport; }
+	const CloudMemoryBudgetResult& GetMemoryBudget() const { return m_memoryBudget; }
 
 
 public:
 	Texture* m_outShadowTexture = nullptr;
 
 private:
+	size_t GetNoiseVolumeBytesGPU() const;
+
 	//NoiseTexture* m_noiseTexture = nullptr;
 	//Shader* m_cloudShader = nullptr;
 	//std::vector<float> m_noiseTexture3D;
-	VertexBuffer* m_debugVoxelBuffer = nullptr;
-	IndexBuffer* m_debugIndexBuffer = nullptr;
+	CloudDebugVoxelView m_debugVoxelView;		// Filled from the voxels only while "Show Voxels" is on
+
+	// Rebuilds run on m_sceneBuilder's job; m_scene is the snapshot the buffers hold until a newer one finishes.
+	// Off waits for every rebuild inside the frame, like before.
+	CloudSceneBuilder m_sceneBuilder;
+	std::shared_ptr<const CloudSceneSnapshot> m_scene;
+	bool m_useAsyncRebuild = true;
 
-	VertexBuffer* m_debugWireframeVBO = nullptr;
-	IndexBuffer* m_debugWireframeIBO = nullptr;
+	// Persistent cloud, voxel and octree buffers: a rebuild that fits reuses them and only sends what changed.
+	// m_inCloudBuffer, m_inVoxelBuffer and m_voxelOctreeBuffer point at their current storage for binding.
+	RendererCloudBufferBackend m_bufferBackend;
+	PersistentCloudBuffer m_persistentCloudBuffer{ m_bufferBackend, sizeof(CloudGPU) };
+	PersistentCloudBuffer m_persistentVoxelBuffer{ m_bufferBackend, sizeof(Voxel) };
+	PersistentCloudBuffer m_persistentOctreeBuffer{ m_bufferBackend, sizeof(OctreeNodeGPU) };
+	CloudBufferUploadStats m_lastRebuildUploadStats;
 
 	StructuredBuffer* m_inCloudBuffer = nullptr;
 	StructuredBuffer* m_inVoxelBuffer = nullptr;
@@ -71,10 +180,86 @@ private:
 	StructuredBuffer* m_cloudOctreeBuffer = nullptr;
 	StructuredBuffer* m_voxelOctreeBuffer = nullptr;
 
+	// Perlin and Worley mip chains, every level back to back; the level table is shared since both have the same size.
+	// The CPU marcher and the sun transmittance sample the same volumes.
+	CloudNoiseVolumes m_noiseVolumes;
+	StructuredBuffer* m_perlinNoiseBuffer = nullptr;
+	StructuredBuffer* m_worleyNoiseBuffer = nullptr;
+	StructuredBuffer* m_noiseVolumeLevelBuffer = nullptr;
+	size_t m_noiseVolumeLevelCount = 0;
+
+	StructuredBuffer* m_windFieldBuffer = nullptr;
+	CurlNoiseField m_windField;
+	float m_uploadedWindSpeed = -1.f;
+
+	StructuredBuffer* m_blueNoiseBuffer = nullptr;
+	StructuredBuffer* m_rayJitterBuffer = nullptr;
+	BlueNoiseTexture m_blueNoise;
+	unsigned int m_frameIndex = 0;
+	float m_rayJitterStrength = 1.f;
+
+	// Temporal amortization: 1 = off, 2 or 4 = one ray per block per frame, the rest reprojected by CloudTemporalShader
+	int m_temporalBlockSize = 1;
+	unsigned int m_temporalFrameIndex = 0;
+	int m_temporalHistoryIndex = 0;				// Which history texture this frame writes; the other one is read
+	bool m_hasTemporalHistory = false;
+	Mat44 m_previousViewProjection;
+	StructuredBuffer* m_temporalReprojectionBuffer = nullptr;
+	Texture* m_cloudLowResTextures[2] = {};		// One texel per 2x2 and per 4x4 block
+	Texture* m_cloudHistoryTextures[2] = {};
+	ComputeShader* m_cloudTemporalShader = nullptr;
+
+	// Bilateral upsampling: 1 = replicate each 2x2 ray like ComputeMain always did, 2 or 4 = one ray per block
+	// resolved by CloudUpsampleShader against the scene depth. Temporal amortization takes precedence.
+	int m_upsampleFactor = 1;
+	float m_upsampleDepthSigma = 0.1f;
+	StructuredBuffer* m_cloudUpsampleBuffer = nullptr;
+	StructuredBuffer* m_sceneOccluderBuffer = nullptr;
+	std::vector<SceneOccluderGPU> m_sceneOccluders;
+	Texture* m_cloudUpsampleAtlases[2] = {};	// Colors over depths, per 2x2 and per 4x4 block
+	ComputeShader* m_cloudUpsampleShader = nullptr;
+
+	// Cost heatmap: -1 = off, otherwise a CloudRayCostChannel. While it is on every 2x2 block shows its own ray,
+	// so temporal amortization and upsampling are turned off rather than blending counters.
+	int m_costViewChannel = -1;
+	float m_costViewMaxValue = 256.f;
+	StructuredBuffer* m_costViewBuffer = nullptr;
+
+	// Sent every frame at t19; CloudConstants::timeElapsed stays 0 so the cloud block only changes on an edit
+	CloudFrameGPU m_frameConstants;
+	StructuredBuffer* m_frameConstantsBuffer = nullptr;
+
+	// Sun transmittance volumes: RayMarchOctree's self-shadowing in one trilinear lookup instead of the 3x3 PCF.
+	// Off uploads an empty header buffer, so every cloud falls back to the voxel shadow map.
+	bool m_useSunTransmittance = true;
+	// The scene job builds the volumes with each snapshot; the frame only re-sweeps them when the sun or the density
+	// settings move between rebuilds.
+	unsigned int m_sceneVersion = 0;			// Bumped whenever a rebuilt scene snapshot is applied
+	CloudSunTransmittanceConfig m_sunTransmittanceConfig;
+	CloudSunTransmittanceVolumes m_sunTransmittance;
+	StructuredBuffer* m_sunTransmittanceVolumeBuffer = nullptr;
+	StructuredBuffer* m_sunTransmittanceBuffer = nullptr;
+	size_t m_sunTransmittanceVolumeCapacity = 0;
+	size_t m_sunTransmittanceCellCapacity = 0;
+
+	// Fourier opacity shadow map: m_outShadowTexture holds two client-sized halves of coefficients and a last row
+	// with the depth range they cover (CloudOpacityShadowMap.hpp)
+	StructuredBuffer* m_opacityShadowMapBuffer = nullptr;
+
+	// Frustum culling: the shaders slab-test only the clouds in these lists, so per-ray cost follows what is visible.
+	// Off uploads every cloud.
+	bool m_useFrustumCulling = true;
+	float m_cullMargin = 1.f;					// World units every frustum plane is pushed out by
+	std::vector<unsigned int> m_cameraVisibleClouds;
+	std::vector<unsigned int> m_lightVisibleClouds;
+	StructuredBuffer* m_cameraVisibleCloudBuffer = nullptr;
+	StructuredBuffer* m_lightVisibleCloudBuffer = nullptr;
+	size_t m_cameraVisibleCloudCapacity = 0;
+	size_t m_lightVisibleCloudCapacity = 0;
+	CloudVisibilityStats m_visibilityStats;
+
 	Texture* m_outCloudTexture = nullptr;
 	
-	Texture3D* m_noiseTexture = nullptr;
-	Texture3D* m_worleyTexture = nullptr;
 	Shader* m_voxelShader = nullptr;
 	Shader* m_cloudShader = nullptr;
 	Shader* m_cloudDebugShader = nullptr;
@@ -87,11 +272,30 @@ private:
 
 	CloudConstants m_cloudConstants;
 
-	std::vector<Voxel> m_allVoxels;
+	// Tuning values, bound to m_cloudConstants and the members they set. Constant blocks are compared with what was
+	// last sent and skipped when equal.
+	ParameterRegistry m_parameters;
+	int m_temporalMode = 0;						// Combo indices, turned into m_temporalBlockSize / m_upsampleFactor
+	int m_upsampleMode = 0;
+	bool m_isCostViewApplied = false;
+	bool m_hasUploadedConstants = false;
+	CloudConstants m_uploadedCloudConstants;
+	LightConstants m_uploadedLightConstants;
+	ShadowConstants m_uploadedShadowConstants;
+	CloudConstantUploadStats m_constantUploadStats;
+
+	// Per-subsystem memory for the profiler panel, and the budget the scene is fitted into: past it, distant instances
+	// drop to their coarse prototypes and then out of the scene (CloudMemoryBudget.hpp). 0 MB = no budget.
+	CloudMemoryReport m_memoryReport;
+	float m_memoryBudgetMB = 0.f;
+	size_t m_appliedMemoryBudgetBytes = 0;
+	float m_memoryBudgetRefitDistance = 100.f;	// How far the camera moves before the levels are chosen again
+	Vec3 m_memoryBudgetViewPosition;
+	CloudMemoryBudgetResult m_memoryBudget;
+
 	std::vector<float> m_allDensities;
 
 	//one octree per cloud
-	std::vector<std::unique_ptr<Octree<Voxel>>> m_voxelOctrees;
 	std::vector<std::unique_ptr<Octree<Vec3>>> m_voxelPositionOctrees;
 	//std::vector<OctreeNodeGPU> m_gpuNodes;
 
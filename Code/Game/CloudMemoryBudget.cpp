@@ -0,0 +1,240 @@
+#include "Game/CloudMemoryBudget.hpp"
+#include "Game/Octree.hpp"
+#include "ThirdParty/ImGui/imgui.h"
+#include <algorithm>
+#include <cmath>
+
+//-----------------------------------------------------------------------------------------------
+void CloudMemoryReport::Add(const char* name, size_t cpuBytes, size_t gpuBytes)
+{
+	CloudMemoryUsage usage;
+	usage.name = name;
+	usage.cpuBytes = cpuBytes;
+	usage.gpuBytes = gpuBytes;
+	m_usages.push_back(usage);
+}
+
+size_t CloudMemoryReport::GetTotalCpuBytes() const
+{
+	size_t numBytes = 0;
+	for (const CloudMemoryUsage& usage : m_usages)
+	{
+		numBytes += usage.cpuBytes;
+	}
+	return numBytes;
+}
+
+size_t CloudMemoryReport::GetTotalGpuBytes() const
+{
+	size_t numBytes = 0;
+	for (const CloudMemoryUsage& usage : m_usages)
+	{
+		numBytes += usage.gpuBytes;
+	}
+	return numBytes;
+}
+
+void CloudMemoryReport::DrawImGui(size_t budgetBytes) const
+{
+	if (!ImGui::CollapsingHeader("Memory"))
+	{
+		return;
+	}
+
+	const double megabyte = 1024.0 * 1024.0;
+	ImGui::Columns(3, "CloudMemory");
+	ImGui::Text("Subsystem");	ImGui::NextColumn();
+	ImGui::Text("CPU MB");		ImGui::NextColumn();
+	ImGui::Text("GPU MB");		ImGui::NextColumn();
+	ImGui::Separator();
+	for (const CloudMemoryUsage& usage : m_usages)
+	{
+		ImGui::Text("%s", usage.name);							ImGui::NextColumn();
+		ImGui::Text("%.2f", (double)usage.cpuBytes / megabyte);	ImGui::NextColumn();
+		ImGui::Text("%.2f", (double)usage.gpuBytes / megabyte);	ImGui::NextColumn();
+	}
+	ImGui::Separator();
+	ImGui::Text("Total");											ImGui::NextColumn();
+	ImGui::Text("%.2f", (double)GetTotalCpuBytes() / megabyte);	ImGui::NextColumn();
+	ImGui::Text("%.2f", (double)GetTotalGpuBytes() / megabyte);	ImGui::NextColumn();
+	ImGui::Columns(1);
+	ImGui::Separator();
+
+	if (budgetBytes > 0)
+	{
+		double totalMegabytes = (double)(GetTotalCpuBytes() + GetTotalGpuBytes()) / megabyte;
+		ImGui::Text("CPU + GPU: %.2f of a %.2f MB budget", totalMegabytes, (double)budgetBytes / megabyte);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------
+// The snapshot's copy, the persistent buffer's CPU copy and the GPU buffer
+static constexpr size_t SCENE_COPIES = 3;
+
+static size_t GetPrototypeSceneBytes(const Cloud& prototype)
+{
+	// Leaves hold up to ELEMENTS_PER_LEAF voxels and are rarely full, so this allows a node per two voxels; dense
+	// prototypes need fewer, and the budget errs on the safe side
+	size_t numVoxels = prototype.m_voxels.size();
+	size_t numNodes = 1 + numVoxels * 2 / ELEMENTS_PER_LEAF;
+	return (numVoxels * sizeof(Voxel) + numNodes * sizeof(OctreeNodeGPU)) * SCENE_COPIES;
+}
+
+static int GetNumSunCells(float numVoxels, const CloudSunTransmittanceConfig& sunConfig)
+{
+	int numCells = (int)ceilf(numVoxels * sunConfig.cellsPerVoxel);
+	return (numCells < 1) ? 1 : ((numCells > sunConfig.maxCellsPerAxis) ? sunConfig.maxCellsPerAxis : numCells);
+}
+
+CloudMemoryCosts EstimateCloudMemoryCosts(CloudPrototypeLibrary& prototypes, const std::vector<CloudInstance>& instances,
+	const CloudSunTransmittanceConfig& sunConfig, size_t fixedBytes)
+{
+	CloudMemoryCosts costs;
+	costs.fixedBytes = fixedBytes;
+	for (int prototypeIndex = 0; prototypeIndex < prototypes.GetNumPrototypes(); ++prototypeIndex)
+	{
+		costs.prototypeBytes.push_back(GetPrototypeSceneBytes(prototypes.GetPrototype(prototypeIndex)));
+		costs.coarsePrototypeBytes.push_back(GetPrototypeSceneBytes(prototypes.GetCoarsePrototype(prototypeIndex)));
+	}
+
+	for (const CloudInstance& instance : instances)
+	{
+		// Voxels sit at whole multiples of the voxel size from the prototype's origin, so its box is gridDimensions
+		// voxels across either way; the sun volume follows the world box, which coarsening doesn't change
+		const Cloud& prototype = prototypes.GetPrototype(instance.prototypeIndex);
+		const IntVec3& dimensions = prototype.m_gridDimensions;
+		int numCells = GetNumSunCells((float)dimensions.x * instance.scale, sunConfig) * GetNumSunCells((float)dimensions.y * instance.scale, sunConfig) *
+			GetNumSunCells((float)dimensions.z * instance.scale, sunConfig);
+
+		size_t numBytes = sizeof(CloudGPU) * (SCENE_COPIES + 1);						// And CloudManager::m_cloudsGPU
+		numBytes += sizeof(unsigned int) * 4;											// Camera and light lists, CPU and GPU
+		numBytes += sizeof(SunTransmittanceVolumeGPU) * 3 + (size_t)numCells * sizeof(float) * 5;	// Transmittance and extinction in the snapshot and the frame's copy, and the GPU's
+		costs.instanceBytes.push_back(numBytes);
+
+		Vec3 halfExtent = Vec3((float)(dimensions.x - 1) * prototype.m_voxelDimensions.x, (float)(dimensions.y - 1) * prototype.m_voxelDimensions.y,
+			(float)(dimensions.z - 1) * prototype.m_voxelDimensions.z) * 0.5f;
+		costs.instanceCenters.push_back(instance.position + halfExtent * instance.scale);
+	}
+	return costs;
+}
+
+//-----------------------------------------------------------------------------------------------
+CloudMemoryBudgetResult FitCloudMemoryBudget(const std::vector<CloudInstance>& instances, const CloudMemoryCosts& costs, const Vec3& viewPosition,
+	size_t budgetBytes)
+{
+	CloudMemoryBudgetResult result;
+	result.levels.assign(instances.size(), CloudDetailLevel::FULL);
+
+	// Instances using each prototype at each level; a prototype costs its bytes while any does
+	std::vector<int> numFullUsers(costs.prototypeBytes.size(), 0);
+	std::vector<int> numCoarseUsers(costs.prototypeBytes.size(), 0);
+	size_t numBytes = costs.fixedBytes;
+	for (int instanceIndex = 0; instanceIndex < (int)instances.size(); ++instanceIndex)
+	{
+		int prototypeIndex = instances[instanceIndex].prototypeIndex;
+		if (numFullUsers[prototypeIndex]++ == 0)
+		{
+			numBytes += costs.prototypeBytes[prototypeIndex];
+		}
+		numBytes += costs.instanceBytes[instanceIndex];
+	}
+	result.numBytesFull = numBytes;
+
+	if (budgetBytes == 0 || numBytes <= budgetBytes)
+	{
+		result.numBytes = numBytes;
+		return result;
+	}
+
+	std::vector<int> farthestFirst(instances.size());
+	std::vector<float> distances(instances.size());
+	for (int instanceIndex = 0; instanceIndex < (int)instances.size(); ++instanceIndex)
+	{
+		farthestFirst[instanceIndex] = instanceIndex;
+		distances[instanceIndex] = (costs.instanceCenters[instanceIndex] - viewPosition).GetLength();
+	}
+	std::stable_sort(farthestFirst.begin(), farthestFirst.end(), [&distances](int a, int b)
+		{
+			return distances[a] > distances[b];
+		});
+
+	// A demotion can cost bytes while the full prototype still has nearer users, so this runs on until it fits
+	// rather than stopping at the first one that doesn't help
+	for (int order = 0; order < (int)farthestFirst.size() && numBytes > budgetBytes; ++order)
+	{
+		int instanceIndex = farthestFirst[order];
+		int prototypeIndex = instances[instanceIndex].prototypeIndex;
+		if (--numFullUsers[prototypeIndex] == 0)
+		{
+			numBytes -= costs.prototypeBytes[prototypeIndex];
+		}
+		if (numCoarseUsers[prototypeIndex]++ == 0)
+		{
+			numBytes += costs.coarsePrototypeBytes[prototypeIndex];
+		}
+		result.levels[instanceIndex] = CloudDetailLevel::COARSE;
+		result.numCoarse++;
+	}
+
+	for (int order = 0; order < (int)farthestFirst.size() && numBytes > budgetBytes; ++order)
+	{
+		int instanceIndex = farthestFirst[order];
+		int prototypeIndex = instances[instanceIndex].prototypeIndex;
+		if (--numCoarseUsers[prototypeIndex] == 0)
+		{
+			numBytes -= costs.coarsePrototypeBytes[prototypeIndex];
+		}
+		numBytes -= costs.instanceBytes[instanceIndex];
+		result.levels[instanceIndex] = CloudDetailLevel::EVICTED;
+		result.numCoarse--;
+		result.numEvicted++;
+	}
+
+	result.numBytes = numBytes;
+	result.fitsBudget = numBytes <= budgetBytes;
+	return result;
+}
+
+//-----------------------------------------------------------------------------------------------
+void MakeBudgetedScene(CloudPrototypeLibrary& prototypes, const std::vector<CloudInstance>& instances, const std::vector<CloudDetailLevel>& levels,
+	std::vector<std::shared_ptr<const Cloud>>& outPrototypes, std::vector<CloudInstance>& outInstances)
+{
+	outPrototypes.clear();
+	outInstances.clear();
+	outInstances.reserve(instances.size());
+
+	// Library index to request index, per level; -1 until an instance uses it
+	std::vector<int> fullIndices(prototypes.GetNumPrototypes(), -1);
+	std::vector<int> coarseIndices(prototypes.GetNumPrototypes(), -1);
+	for (int instanceIndex = 0; instanceIndex < (int)instances.size(); ++instanceIndex)
+	{
+		CloudDetailLevel level = (instanceIndex < (int)levels.size()) ? levels[instanceIndex] : CloudDetailLevel::FULL;
+		if (level == CloudDetailLevel::EVICTED)
+		{
+			continue;
+		}
+
+		CloudInstance instance = instances[instanceIndex];
+		int libraryIndex = instance.prototypeIndex;
+		if (level == CloudDetailLevel::COARSE)
+		{
+			if (coarseIndices[libraryIndex] < 0)
+			{
+				coarseIndices[libraryIndex] = (int)outPrototypes.size();
+				outPrototypes.push_back(prototypes.GetSharedCoarsePrototype(libraryIndex));
+			}
+			instance.prototypeIndex = coarseIndices[libraryIndex];
+			instance.scale *= 2.f;
+		}
+		else
+		{
+			if (fullIndices[libraryIndex] < 0)
+			{
+				fullIndices[libraryIndex] = (int)outPrototypes.size();
+				outPrototypes.push_back(prototypes.GetSharedPrototype(libraryIndex));
+			}
+			instance.prototypeIndex = fullIndices[libraryIndex];
+		}
+		outInstances.push_back(instance);
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "Game/CloudPrototype.hpp"
+#include "Game/CloudSunTransmittance.hpp"
+#include <memory>
+#include <vector>
+
+// Bytes one part of the cloud system holds. GPU bytes are estimates: buffer capacities times element sizes, and
+// texels times their size for textures the engine creates.
+struct CloudMemoryUsage
+{
+	const char* name = nullptr;		// String literal
+	size_t cpuBytes = 0;
+	size_t gpuBytes = 0;
+};
+
+// Per-subsystem memory counters, refilled by the owner of the data whenever it wants them current
+class CloudMemoryReport
+{
+public:
+	void Clear() { m_usages.clear(); }
+	void Add(const char* name, size_t cpuBytes, size_t gpuBytes);
+
+	const std::vector<CloudMemoryUsage>& GetUsages() const { return m_usages; }
+	size_t GetTotalCpuBytes() const;
+	size_t GetTotalGpuBytes() const;
+
+	// Counter table inside the current ImGui window; budgetBytes 0 means there is none
+	void DrawImGui(size_t budgetBytes) const;
+
+private:
+	std::vector<CloudMemoryUsage> m_usages;
+};
+
+enum class CloudDetailLevel
+{
+	FULL,
+	COARSE,			// The prototype's coarse variant at twice the scale (CloudPrototypeLibrary::GetCoarsePrototype)
+	EVICTED,		// Left out of the scene
+};
+
+// CPU plus GPU bytes each choice adds to the built scene
+struct CloudMemoryCosts
+{
+	std::vector<size_t> prototypeBytes;			// Paid once however many instances use the prototype
+	std::vector<size_t> coarsePrototypeBytes;
+	std::vector<size_t> instanceBytes;			// The same at either level
+	std::vector<Vec3> instanceCenters;
+	size_t fixedBytes = 0;						// What no level changes: the noise volumes, the prototype library, ...
+};
+
+struct CloudMemoryBudgetResult
+{
+	std::vector<CloudDetailLevel> levels;		// Per instance
+	size_t numBytesFull = 0;					// With every instance at full resolution
+	size_t numBytes = 0;						// At the chosen levels
+	int numCoarse = 0;
+	int numEvicted = 0;
+	bool fitsBudget = true;
+};
+
+// Each prototype's voxels and octree nodes, at both levels, as the snapshot, the persistent buffers' CPU copies and
+// the GPU hold them, and each instance's CloudGPU, visibility entries and sun transmittance volume. Node counts are
+// estimated from the voxel counts, since the octrees are only built with the scene.
+CloudMemoryCosts EstimateCloudMemoryCosts(CloudPrototypeLibrary& prototypes, const std::vector<CloudInstance>& instances,
+	const CloudSunTransmittanceConfig& sunConfig, size_t fixedBytes);
+
+// Lowers detail until the costs fit budgetBytes: instances drop to coarse farthest from viewPosition first, nearer
+// ones only while the scene still doesn't fit, and once every instance is coarse the farthest are evicted.
+// budgetBytes 0 keeps everything at full resolution.
+CloudMemoryBudgetResult FitCloudMemoryBudget(const std::vector<CloudInstance>& instances, const CloudMemoryCosts& costs, const Vec3& viewPosition,
+	size_t budgetBytes);
+
+// The prototypes and instances a scene request needs at these levels. Coarse instances point at their prototype's
+// coarse variant with twice the scale, evicted ones are dropped, and so is every prototype nothing uses any more.
+// The prototypes are the library's own, shared rather than copied.
+void MakeBudgetedScene(CloudPrototypeLibrary& prototypes, const std::vector<CloudInstance>& instances, const std::vector<CloudDetailLevel>& levels,
+	std::vector<std::shared_ptr<const Cloud>>& outPrototypes, std::vector<CloudInstance>& outInstances);
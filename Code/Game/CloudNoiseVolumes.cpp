@@ -0,0 +1,134 @@
+#include "Game/CloudNoiseVolumes.hpp"
+#include "Game/ParallelFor.hpp"
+#include "ThirdParty/Engine_Code_ThirdParty_Squirrel/SmoothNoise.hpp"
+#include <cmath>
+
+// Integer hash for the Worley feature points, returns [0,1)
+static float HashCellToZeroToOne(int x, int y, int z, unsigned int seed, unsigned int channel)
+{
+	unsigned int hash = (unsigned int)x * 0x8da6b343u ^ (unsigned int)y * 0xd8163841u ^ (unsigned int)z * 0xcb1ab31fu;
+	hash ^= seed * 0x68e31da4u + channel * 0xb5297a4du;
+	hash ^= hash >> 15;
+	hash *= 0x2c1b3c6du;
+	hash ^= hash >> 12;
+	hash *= 0x297a2d39u;
+	hash ^= hash >> 15;
+	return (float)(hash & 0x00FFFFFFu) / 16777216.f;
+}
+
+void FlattenVolumeMipChain(const VolumeMipChain& chain, std::vector<float>& outTexels, std::vector<NoiseVolumeLevelGPU>& outLevels)
+{
+	outTexels.clear();
+	outLevels.clear();
+	outTexels.reserve(chain.GetMemoryBytes() / sizeof(float));
+
+	for (int level = 0; level < chain.GetNumLevels(); ++level)
+	{
+		IntVec3 dimensions = chain.GetLevelDimensions(level);
+		NoiseVolumeLevelGPU levelGPU;
+		levelGPU.firstTexel = (int)outTexels.size();
+		levelGPU.sizeX = dimensions.x;
+		levelGPU.sizeY = dimensions.y;
+		levelGPU.sizeZ = dimensions.z;
+		outLevels.push_back(levelGPU);
+
+		const std::vector<float>& texels = chain.GetLevel(level);
+		outTexels.insert(outTexels.end(), texels.begin(), texels.end());
+	}
+}
+
+void CloudNoiseVolumes::LoadOrBake(const CloudNoiseVolumesConfig& config)
+{
+	m_config = config;
+
+	IntVec3 dimensions = IntVec3(config.size, config.size, config.size);
+	std::string sizeName = std::to_string(config.size);
+
+	m_perlin.LoadOrBuild(config.cacheDirectory + "/CloudPerlin_" + sizeName + ".bin", dimensions, config.mipConfig,
+		[this](std::vector<float>& values) { BakePerlin(values); });
+
+	m_worley.LoadOrBuild(config.cacheDirectory + "/CloudWorley_" + sizeName + "_" + std::to_string(config.worleySeed) + ".bin", dimensions, config.mipConfig,
+		[this](std::vector<float>& values) { BakeWorley(values); });
+}
+
+void CloudNoiseVolumes::BakePerlin(std::vector<float>& values) const
+{
+	int size = m_config.size;
+	float texelScale = 256.f / (float)size;
+
+	ParallelFor(size, [&](int zBegin, int zEnd)
+	{
+		for (int z = zBegin; z < zEnd; ++z)
+		{
+			for (int y = 0; y < size; ++y)
+			{
+				for (int x = 0; x < size; ++x)
+				{
+					float noise = Compute3dPerlinNoise((float)x * texelScale, (float)y * texelScale, (float)z * texelScale,
+						m_config.perlinScale, m_config.perlinOctaves, 0.5f, 2.f, true, 0);
+					values[((size_t)z * size + y) * size + x] = 0.5f * noise + 0.5f;
+				}
+			}
+		}
+	}, m_config.mipConfig.numThreads);
+}
+
+void CloudNoiseVolumes::BakeWorley(std::vector<float>& values) const
+{
+	int size = m_config.size;
+	int cells = m_config.worleyCellsPerAxis;
+	float cellsPerTexel = (float)cells / (float)size;
+
+	ParallelFor(size, [&](int zBegin, int zEnd)
+	{
+		for (int z = zBegin; z < zEnd; ++z)
+		{
+			for (int y = 0; y < size; ++y)
+			{
+				for (int x = 0; x < size; ++x)
+				{
+					float px = ((float)x + 0.5f) * cellsPerTexel;
+					float py = ((float)y + 0.5f) * cellsPerTexel;
+					float pz = ((float)z + 0.5f) * cellsPerTexel;
+
+					int cellX = (int)floorf(px);
+					int cellY = (int)floorf(py);
+					int cellZ = (int)floorf(pz);
+
+					// F1 distance, feature points hashed on the wrapped cell so the volume tiles
+					float minDistanceSquared = 1e30f;
+					for (int dz = -1; dz <= 1; ++dz)
+					{
+						for (int dy = -1; dy <= 1; ++dy)
+						{
+							for (int dx = -1; dx <= 1; ++dx)
+							{
+								int nx = cellX + dx;
+								int ny = cellY + dy;
+								int nz = cellZ + dz;
+
+								int wx = ((nx % cells) + cells) % cells;
+								int wy = ((ny % cells) + cells) % cells;
+								int wz = ((nz % cells) + cells) % cells;
+
+								float fx = (float)nx + HashCellToZeroToOne(wx, wy, wz, m_config.worleySeed, 0) - px;
+								float fy = (float)ny + HashCellToZeroToOne(wx, wy, wz, m_config.worleySeed, 1) - py;
+								float fz = (float)nz + HashCellToZeroToOne(wx, wy, wz, m_config.worleySeed, 2) - pz;
+
+								float distanceSquared = fx * fx + fy * fy + fz * fz;
+								if (distanceSquared < minDistanceSquared)
+								{
+									minDistanceSquared = distanceSquared;
+								}
+							}
+						}
+					}
+
+					// Inverted so feature points are the bright billows
+					float distance = sqrtf(minDistanceSquared);
+					values[((size_t)z * size + y) * size + x] = 1.f - (distance > 1.f ? 1.f : distance);
+				}
+			}
+		}
+	}, m_config.mipConfig.numThreads);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "Game/VolumeMipChain.hpp"
+#include <string>
+
+// Edge length of the volumes CloudManager bakes for the cloud shaders, the resolution of the old Texture3Ds
+constexpr int GPU_NOISE_VOLUME_SIZE = 256;
+
+struct CloudNoiseVolumesConfig
+{
+	int size = 128;						// Edge length of both volumes
+	float perlinScale = 100.f;			// In texels of a 256 volume, as passed to CreateTexture3DFromNoise
+	int perlinOctaves = 7;
+	int worleyCellsPerAxis = 8;			// 256 / cellSize 32, as passed to CreateTexture3DFromWorley
+	unsigned int worleySeed = 4;
+	VolumeMipConfig mipConfig;
+	std::string cacheDirectory = "Data/Cache";
+};
+
+// One mip level of a volume packed by FlattenVolumeMipChain (must match NoiseVolumeLevel in CloudShader.hlsl)
+struct NoiseVolumeLevelGPU
+{
+	int firstTexel = 0;
+	int sizeX = 0;
+	int sizeY = 0;
+	int sizeZ = 0;
+};
+
+// Every level of the chain back to back, level 0 first and x-fastest, for one structured buffer
+void FlattenVolumeMipChain(const VolumeMipChain& chain, std::vector<float>& outTexels, std::vector<NoiseVolumeLevelGPU>& outLevels);
+
+// The Perlin and Worley volumes the cloud shaders sample, with mip chains for the SampleNoise lookups at
+// lod 0.5 and 1. Baked once and cached to disk.
+class CloudNoiseVolumes
+{
+public:
+	CloudNoiseVolumes() = default;
+
+	void LoadOrBake(const CloudNoiseVolumesConfig& config);
+
+	float SamplePerlin(const Vec3& uvw, float lod) const { return m_perlin.SampleLevel(uvw, lod); }
+	float SampleWorley(const Vec3& uvw, float lod) const { return m_worley.SampleLevel(uvw, lod); }
+
+	const VolumeMipChain& GetPerlin() const { return m_perlin; }
+	const VolumeMipChain& GetWorley() const { return m_worley; }
+	size_t GetMemoryBytes() const { return m_perlin.GetMemoryBytes() + m_worley.GetMemoryBytes(); }
+
+private:
+	void BakePerlin(std::vector<float>& values) const;
+	void BakeWorley(std::vector<float>& values) const;
+
+private:
+	CloudNoiseVolumesConfig m_config;
+	VolumeMipChain m_perlin;
+	VolumeMipChain m_worley;
+};
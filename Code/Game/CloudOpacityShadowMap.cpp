@@ -0,0 +1,291 @@
+#include "Game/CloudOpacityShadowMap.hpp"
+#include "Game/ParallelFor.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+constexpr float OPACITY_SHADOW_TWO_PI = 6.28318530718f;
+constexpr float OPACITY_SHADOW_RANGE_MARGIN = 0.02f;	// Fraction of the range added on both ends
+
+//-----------------------------------------------------------------------------------------------
+static float ClampFloat(float value, float minValue, float maxValue)
+{
+	return (value < minValue) ? minValue : ((value > maxValue) ? maxValue : value);
+}
+
+static int ClampInt(int value, int minValue, int maxValue)
+{
+	return (value < minValue) ? minValue : ((value > maxValue) ? maxValue : value);
+}
+
+// Slab test like IntersectAABB in the shaders; false when the box is missed or behind the origin
+static bool IntersectBox(const Vec3& rayOrigin, const Vec3& invRayDir, const Vec3& minBounds, const Vec3& maxBounds, float& tEnter, float& tExit)
+{
+	float t1x = (minBounds.x - rayOrigin.x) * invRayDir.x;
+	float t2x = (maxBounds.x - rayOrigin.x) * invRayDir.x;
+	float t1y = (minBounds.y - rayOrigin.y) * invRayDir.y;
+	float t2y = (maxBounds.y - rayOrigin.y) * invRayDir.y;
+	float t1z = (minBounds.z - rayOrigin.z) * invRayDir.z;
+	float t2z = (maxBounds.z - rayOrigin.z) * invRayDir.z;
+	tEnter = std::max(std::max(std::min(t1x, t2x), std::min(t1y, t2y)), std::max(std::min(t1z, t2z), 0.f));
+	tExit = std::min(std::min(std::max(t1x, t2x), std::max(t1y, t2y)), std::max(t1z, t2z));
+	return tEnter <= tExit;
+}
+
+static Vec3 GetInverseDirection(const Vec3& direction)
+{
+	return Vec3((direction.x != 0.f) ? 1.f / direction.x : 1e30f, (direction.y != 0.f) ? 1.f / direction.y : 1e30f, (direction.z != 0.f) ? 1.f / direction.z : 1e30f);
+}
+
+//-----------------------------------------------------------------------------------------------
+CloudOpacityShadowMapGPU CloudOpacityShadowMap::ComputeDepthRange(const std::vector<CloudGPU>& clouds, const CloudOpacityShadowFrame& frame)
+{
+	CloudOpacityShadowMapGPU range;
+	if (clouds.empty())
+	{
+		return range;
+	}
+
+	float nearest = 1e30f;
+	float farthest = -1e30f;
+	for (const CloudGPU& cloud : clouds)
+	{
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			Vec3 position((corner & 1) ? cloud.maxBounds.x : cloud.minBounds.x, (corner & 2) ? cloud.maxBounds.y : cloud.minBounds.y, (corner & 4) ? cloud.maxBounds.z : cloud.minBounds.z);
+			float depth = DotProduct3D(position - frame.origin, frame.forward);
+			nearest = std::min(nearest, depth);
+			farthest = std::max(farthest, depth);
+		}
+	}
+
+	float margin = (farthest - nearest) * OPACITY_SHADOW_RANGE_MARGIN + 1e-3f;
+	range.depthMin = (nearest - margin) / frame.maxDistance;
+	range.depthMax = (farthest + margin) / frame.maxDistance;
+	return range;
+}
+
+//-----------------------------------------------------------------------------------------------
+// The extinction along the ray as a Fourier series over [0,1]: a_k = 2 sum(tau cos(2 pi k d)), b_k = 2 sum(tau sin(2 pi k d))
+void CloudOpacityShadowMap::AccumulateOpticalDepth(float* coefficients, float opticalDepth, float normalizedDepth)
+{
+	coefficients[0] += 2.f * opticalDepth;
+	for (int harmonic = 1; harmonic <= OPACITY_SHADOW_HARMONICS; ++harmonic)
+	{
+		float angle = OPACITY_SHADOW_TWO_PI * (float)harmonic * normalizedDepth;
+		coefficients[2 * harmonic - 1] += 2.f * opticalDepth * cosf(angle);
+		coefficients[2 * harmonic] += 2.f * opticalDepth * sinf(angle);
+	}
+}
+
+// Integral of the series from 0 to d: a0 d / 2 + sum(a_k sin(2 pi k d) + b_k (1 - cos(2 pi k d))) / (2 pi k).
+// Exact at both ends of the range; truncation rings in between, so it is kept within [0, total].
+float CloudOpacityShadowMap::ReconstructOpticalDepth(const float* coefficients, float normalizedDepth)
+{
+	float depth = ClampFloat(normalizedDepth, 0.f, 1.f);
+	float opticalDepth = 0.5f * coefficients[0] * depth;
+	for (int harmonic = 1; harmonic <= OPACITY_SHADOW_HARMONICS; ++harmonic)
+	{
+		float frequency = OPACITY_SHADOW_TWO_PI * (float)harmonic;
+		float angle = frequency * depth;
+		opticalDepth += (coefficients[2 * harmonic - 1] * sinf(angle) + coefficients[2 * harmonic] * (1.f - cosf(angle))) / frequency;
+	}
+	return ClampFloat(opticalDepth, 0.f, 0.5f * coefficients[0]);
+}
+
+//-----------------------------------------------------------------------------------------------
+template <typename VisitFunc>
+long long CloudOpacityShadowMap::MarchLightRay(const CloudRayMarchScene& scene, const CloudRayMarcher& marcher, const Vec3& rayOrigin, const Vec3& rayDirection, float maxDistance, float stepSize, VisitFunc visit)
+{
+	Vec3 invRayDir = GetInverseDirection(rayDirection);
+	CloudRayMarchStats samplingStats;
+	long long numSamples = 0;
+	for (int cloudIndex = 0; cloudIndex < (int)scene.clouds.size(); ++cloudIndex)
+	{
+		const CloudGPU& cloud = scene.clouds[cloudIndex];
+		float tEnter = 0.f;
+		float tExit = 0.f;
+		if (!IntersectBox(rayOrigin, invRayDir, cloud.minBounds, cloud.maxBounds, tEnter, tExit) || tEnter >= maxDistance)
+		{
+			continue;
+		}
+		tExit = std::min(tExit, maxDistance);
+
+		// Midpoint steps, so overlapping boxes just add up
+		int numSteps = std::max(1, (int)ceilf((tExit - tEnter) / stepSize));
+		float segment = (tExit - tEnter) / (float)numSteps;
+		for (int stepIndex = 0; stepIndex < numSteps; ++stepIndex)
+		{
+			float distance = tEnter + ((float)stepIndex + 0.5f) * segment;
+			float extinction = marcher.SampleCloudExtinction(cloudIndex, rayOrigin + rayDirection * distance, samplingStats);
+			visit(extinction * segment, distance, tEnter, tExit);
+		}
+		numSamples += numSteps;
+	}
+	return numSamples;
+}
+
+//-----------------------------------------------------------------------------------------------
+void CloudOpacityShadowMap::Build(const CloudRayMarchScene& scene, const CloudRayMarcher& marcher, const CloudOpacityShadowFrame& frame, const CloudOpacityShadowMapConfig& config)
+{
+	std::chrono::steady_clock::time_point buildStart = std::chrono::steady_clock::now();
+
+	m_frame = frame;
+	m_width = std::max(config.width, 1);
+	m_height = std::max(config.height, 1);
+	m_depthRange = ComputeDepthRange(scene.clouds, frame);
+	m_coefficients.assign((size_t)m_width * m_height * OPACITY_SHADOW_COEFFICIENTS, 0.f);
+	m_startEnd.assign((size_t)m_width * m_height, Vec3(1.f, 0.f, 1.f));
+
+	float depthScale = 1.f / (m_depthRange.depthMax - m_depthRange.depthMin);
+	std::vector<long long> rowSamples((size_t)m_height, 0);
+	std::vector<int> rowTexelsInCloud((size_t)m_height, 0);
+	ParallelFor(m_height, [&](int begin, int end)
+	{
+		for (int y = begin; y < end; ++y)
+		{
+			for (int x = 0; x < m_width; ++x)
+			{
+				float u = (((float)x + 0.5f) / (float)m_width) * 2.f - 1.f;
+				float v = (((float)y + 0.5f) / (float)m_height) * 2.f - 1.f;
+				Vec3 rayOrigin = frame.origin + frame.right * (u * frame.halfExtent) + frame.up * (v * frame.halfExtent);
+
+				size_t texelIndex = (size_t)y * m_width + x;
+				float* coefficients = &m_coefficients[texelIndex * OPACITY_SHADOW_COEFFICIENTS];
+				float firstDistance = frame.maxDistance;
+				float lastDistance = 0.f;
+				float opticalDepth = 0.f;
+				rowSamples[y] += MarchLightRay(scene, marcher, rayOrigin, frame.forward, frame.maxDistance, config.stepSize,
+					[&](float stepOpticalDepth, float distance, float tEnter, float tExit)
+				{
+					AccumulateOpticalDepth(coefficients, stepOpticalDepth, (distance / frame.maxDistance - m_depthRange.depthMin) * depthScale);
+					opticalDepth += stepOpticalDepth;
+					firstDistance = std::min(firstDistance, tEnter);
+					lastDistance = std::max(lastDistance, tExit);
+				});
+
+				if (lastDistance > 0.f)
+				{
+					m_startEnd[texelIndex] = Vec3(firstDistance / frame.maxDistance, 1.f - expf(-opticalDepth), lastDistance / frame.maxDistance);
+					rowTexelsInCloud[y]++;
+				}
+			}
+		}
+	}, config.numThreads);
+
+	m_stats.numTexels = (long long)m_width * m_height;
+	m_stats.numTexelsInCloud = 0;
+	m_stats.numExtinctionSamples = 0;
+	for (int y = 0; y < m_height; ++y)
+	{
+		m_stats.numTexelsInCloud += rowTexelsInCloud[y];
+		m_stats.numExtinctionSamples += rowSamples[y];
+	}
+	m_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - buildStart).count();
+}
+
+//-----------------------------------------------------------------------------------------------
+void CloudOpacityShadowMap::ProjectToMap(const Vec3& position, float& texelX, float& texelY, float& normalizedDepth, float& lightDepth) const
+{
+	Vec3 relative = position - m_frame.origin;
+	texelX = (DotProduct3D(relative, m_frame.right) / m_frame.halfExtent * 0.5f + 0.5f) * (float)m_width;
+	texelY = (DotProduct3D(relative, m_frame.up) / m_frame.halfExtent * 0.5f + 0.5f) * (float)m_height;
+	lightDepth = DotProduct3D(relative, m_frame.forward) / m_frame.maxDistance;
+	normalizedDepth = (lightDepth - m_depthRange.depthMin) / (m_depthRange.depthMax - m_depthRange.depthMin);
+}
+
+float CloudOpacityShadowMap::Sample(const Vec3& position) const
+{
+	if (m_coefficients.empty())
+	{
+		return 1.f;
+	}
+
+	float texelX = 0.f;
+	float texelY = 0.f;
+	float normalizedDepth = 0.f;
+	float lightDepth = 0.f;
+	ProjectToMap(position, texelX, texelY, normalizedDepth, lightDepth);
+
+	// Bilinear like the sampler, edge texels clamped
+	float localX = ClampFloat(texelX - 0.5f, 0.f, (float)(m_width - 1));
+	float localY = ClampFloat(texelY - 0.5f, 0.f, (float)(m_height - 1));
+	int x0 = (int)localX;
+	int y0 = (int)localY;
+	int x1 = std::min(x0 + 1, m_width - 1);
+	int y1 = std::min(y0 + 1, m_height - 1);
+	float fracX = localX - (float)x0;
+	float fracY = localY - (float)y0;
+
+	float filtered[OPACITY_SHADOW_COEFFICIENTS];
+	const float* c00 = &m_coefficients[((size_t)y0 * m_width + x0) * OPACITY_SHADOW_COEFFICIENTS];
+	const float* c10 = &m_coefficients[((size_t)y0 * m_width + x1) * OPACITY_SHADOW_COEFFICIENTS];
+	const float* c01 = &m_coefficients[((size_t)y1 * m_width + x0) * OPACITY_SHADOW_COEFFICIENTS];
+	const float* c11 = &m_coefficients[((size_t)y1 * m_width + x1) * OPACITY_SHADOW_COEFFICIENTS];
+	for (int index = 0; index < OPACITY_SHADOW_COEFFICIENTS; ++index)
+	{
+		float top = c00[index] + (c10[index] - c00[index]) * fracX;
+		float bottom = c01[index] + (c11[index] - c01[index]) * fracX;
+		filtered[index] = top + (bottom - top) * fracY;
+	}
+	return expf(-ReconstructOpticalDepth(filtered, normalizedDepth));
+}
+
+float CloudOpacityShadowMap::SampleStartEnd(const Vec3& position) const
+{
+	if (m_startEnd.empty())
+	{
+		return 1.f;
+	}
+
+	float texelX = 0.f;
+	float texelY = 0.f;
+	float normalizedDepth = 0.f;
+	float lightDepth = 0.f;
+	ProjectToMap(position, texelX, texelY, normalizedDepth, lightDepth);
+
+	int centerX = (int)floorf(texelX);
+	int centerY = (int)floorf(texelY);
+	float litSum = 0.f;
+	for (int offsetX = -1; offsetX <= 1; ++offsetX)
+	{
+		for (int offsetY = -1; offsetY <= 1; ++offsetY)
+		{
+			const Vec3& startEnd = m_startEnd[(size_t)ClampInt(centerY + offsetY, 0, m_height - 1) * m_width + ClampInt(centerX + offsetX, 0, m_width - 1)];
+			if (lightDepth < startEnd.x)
+			{
+				litSum += 1.f;
+			}
+			else if (lightDepth > startEnd.z)
+			{
+				litSum += 1.f - startEnd.y;
+			}
+			else
+			{
+				float t = ClampFloat((lightDepth - startEnd.x) / (startEnd.z - startEnd.x), 0.f, 1.f);
+				litSum += 1.f - startEnd.y * t;
+			}
+		}
+	}
+	return litSum / 9.f;
+}
+
+float CloudOpacityShadowMap::TraceTransmittance(const CloudRayMarchScene& scene, const CloudRayMarcher& marcher, const CloudOpacityShadowFrame& frame, const Vec3& position, float stepSize)
+{
+	Vec3 relative = position - frame.origin;
+	float lightDepth = DotProduct3D(relative, frame.forward);
+	Vec3 rayOrigin = position - frame.forward * lightDepth;
+
+	// March the whole ray on the same steps the texels took, counting only what lies in front of the position
+	float opticalDepth = 0.f;
+	MarchLightRay(scene, marcher, rayOrigin, frame.forward, frame.maxDistance, stepSize, [&](float stepOpticalDepth, float distance, float tEnter, float tExit)
+	{
+		if (distance < lightDepth)
+		{
+			opticalDepth += stepOpticalDepth;
+		}
+		(void)tEnter;
+		(void)tExit;
+	});
+	return expf(-opticalDepth);
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include "Game/CloudRayMarcher.hpp"
+
+// Cosine/sine pairs per texel on top of the constant term; 2 * 3 + 1 coefficients fill seven of the eight channels
+// in the shadow atlas, the eighth keeps the first density depth for GodRays.hlsl
+constexpr int OPACITY_SHADOW_HARMONICS = 3;
+constexpr int OPACITY_SHADOW_COEFFICIENTS = 2 * OPACITY_SHADOW_HARMONICS + 1;
+
+// Depth range the coefficients are expanded over, in light depth / maxDistance like the shadow map's depths
+// (must match OpacityShadowMap in CloudShadowShader.hlsl). The shader copies it into the atlas's last row, so the
+// pixel shaders that can only bind textures read it from there.
+struct CloudOpacityShadowMapGPU
+{
+	float depthMin = 0.f;
+	float depthMax = 1.f;
+	float padding[2] = {};
+};
+
+// The orthographic light the shadow map is rendered from: texel rays start on the plane through origin spanned by
+// right and up, halfExtent either way, and march maxDistance along forward (ComputeRayPosition in CloudShadowShader.hlsl)
+struct CloudOpacityShadowFrame
+{
+	Vec3 origin;
+	Vec3 forward = Vec3(0.f, 0.f, -1.f);
+	Vec3 right = Vec3(1.f, 0.f, 0.f);
+	Vec3 up = Vec3(0.f, 1.f, 0.f);
+	float halfExtent = 500.f;
+	float maxDistance = 1000.f;
+};
+
+struct CloudOpacityShadowMapConfig
+{
+	int width = 256;
+	int height = 256;
+	float stepSize = 1.f;
+	int numThreads = 0;
+};
+
+struct CloudOpacityShadowMapStats
+{
+	long long numTexels = 0;
+	long long numTexelsInCloud = 0;
+	long long numExtinctionSamples = 0;
+	double seconds = 0.0;
+};
+
+// Fourier opacity shadow map for the clouds. Instead of the first depth, total opacity and last depth per texel,
+// each texel keeps a truncated Fourier series of the extinction along its light ray over the clouds' depth range, so
+// the optical depth reaching any depth is a few sines and cosines. The coefficients are linear in the extinction,
+// which makes the map bilinearly filterable: one filtered fetch replaces the 3x3 PCF taps.
+// CPU builder and reference for the same accumulation CloudShadowShader.hlsl does per texel.
+class CloudOpacityShadowMap
+{
+public:
+	CloudOpacityShadowMap() = default;
+
+	// Nearest and farthest cloud box corner along the light, padded by a margin so nothing lands on the ends
+	static CloudOpacityShadowMapGPU ComputeDepthRange(const std::vector<CloudGPU>& clouds, const CloudOpacityShadowFrame& frame);
+
+	// Adds optical depth deposited at a normalized depth in [0,1] to the series
+	static void AccumulateOpticalDepth(float* coefficients, float opticalDepth, float normalizedDepth);
+
+	// Optical depth from the front of the range to normalizedDepth, clamped against ringing
+	static float ReconstructOpticalDepth(const float* coefficients, float normalizedDepth);
+
+	void Build(const CloudRayMarchScene& scene, const CloudRayMarcher& marcher, const CloudOpacityShadowFrame& frame, const CloudOpacityShadowMapConfig& config);
+
+	// Sun transmittance at a world position from the bilinearly filtered coefficients
+	float Sample(const Vec3& position) const;
+
+	// What the old map gave: 3x3 PCF over first depth, opacity and last depth, linear in between
+	float SampleStartEnd(const Vec3& position) const;
+
+	// Ground truth: the same march the texels accumulate, straight through the position's own light ray
+	static float TraceTransmittance(const CloudRayMarchScene& scene, const CloudRayMarcher& marcher, const CloudOpacityShadowFrame& frame, const Vec3& position, float stepSize);
+
+	const CloudOpacityShadowMapGPU& GetDepthRange() const { return m_depthRange; }
+	const std::vector<float>& GetCoefficients() const { return m_coefficients; }
+	const CloudOpacityShadowMapStats& GetStats() const { return m_stats; }
+
+private:
+	// Light-space texel coordinates (continuous, texel centers at +0.5) and normalized depth of a world position
+	void ProjectToMap(const Vec3& position, float& texelX, float& texelY, float& normalizedDepth, float& lightDepth) const;
+
+	// Extinction along one light ray, handed to visit(opticalDepth, distance) per step
+	template <typename VisitFunc>
+	static long long MarchLightRay(const CloudRayMarchScene& scene, const CloudRayMarcher& marcher, const Vec3& rayOrigin, const Vec3& rayDirection, float maxDistance, float stepSize, VisitFunc visit);
+
+private:
+	CloudOpacityShadowFrame m_frame;
+	CloudOpacityShadowMapGPU m_depthRange;
+	int m_width = 0;
+	int m_height = 0;
+	std::vector<float> m_coefficients;		// OPACITY_SHADOW_COEFFICIENTS per texel: a0, a1, b1, a2, b2, ...
+	std::vector<Vec3> m_startEnd;			// First depth, opacity, last depth per texel, in light depth / maxDistance
+	CloudOpacityShadowMapStats m_stats;
+};
@@ -0,0 +1,142 @@
+#include "Game/CloudPrototype.hpp"
+#include "Game/Octree.hpp"
+#include <cmath>
+#include <unordered_set>
+
+//-----------------------------------------------------------------------------------------------
+int CloudPrototypeLibrary::FindOrAdd(const IntVec3& dimensions, const Vec3& voxelDimensions, ECloudType type, bool useTest)
+{
+	for (int prototypeIndex = 0; prototypeIndex < (int)m_keys.size(); ++prototypeIndex)
+	{
+		const PrototypeKey& key = m_keys[prototypeIndex];
+		bool isSameSize = key.dimensions.x == dimensions.x && key.dimensions.y == dimensions.y && key.dimensions.z == dimensions.z;
+		if (isSameSize && key.voxelDimensions == voxelDimensions && key.type == type && key.useTest == useTest)
+		{
+			return prototypeIndex;
+		}
+	}
+
+	PrototypeKey key;
+	key.dimensions = dimensions;
+	key.voxelDimensions = voxelDimensions;
+	key.type = type;
+	key.useTest = useTest;
+	m_keys.push_back(key);
+
+	// The bounding box only follows the voxels, so it is fitted once here rather than on every scene build
+	std::shared_ptr<Cloud> prototype = std::make_shared<Cloud>(Vec3(0.f, 0.f, 0.f), dimensions, voxelDimensions, type, useTest);
+	prototype->FitBoundingBox();
+	m_prototypes.push_back(prototype);
+	return (int)m_prototypes.size() - 1;
+}
+
+void CloudPrototypeLibrary::Clear()
+{
+	m_prototypes.clear();
+	m_keys.clear();
+	m_coarsePrototypes.clear();
+}
+
+size_t CloudPrototypeLibrary::GetNumVoxels() const
+{
+	size_t numVoxels = 0;
+	for (const std::shared_ptr<const Cloud>& prototype : m_prototypes)
+	{
+		numVoxels += prototype->m_voxels.size();
+	}
+	return numVoxels;
+}
+
+const std::shared_ptr<const Cloud>& CloudPrototypeLibrary::GetSharedCoarsePrototype(int prototypeIndex)
+{
+	if (m_coarsePrototypes.size() < m_prototypes.size())
+	{
+		m_coarsePrototypes.resize(m_prototypes.size());
+	}
+	if (!m_coarsePrototypes[prototypeIndex])
+	{
+		std::shared_ptr<Cloud> coarse = std::make_shared<Cloud>(MakeCoarseCloud(*m_prototypes[prototypeIndex]));
+		coarse->FitBoundingBox();
+		m_coarsePrototypes[prototypeIndex] = coarse;
+	}
+	return m_coarsePrototypes[prototypeIndex];
+}
+
+bool CloudPrototypeLibrary::HasCoarsePrototype(int prototypeIndex) const
+{
+	return prototypeIndex < (int)m_coarsePrototypes.size() && m_coarsePrototypes[prototypeIndex] != nullptr;
+}
+
+size_t CloudPrototypeLibrary::GetMemoryBytes() const
+{
+	size_t numBytes = 0;
+	for (const std::shared_ptr<const Cloud>& prototype : m_prototypes)
+	{
+		numBytes += prototype->GetMemoryBytes();
+	}
+	for (const std::shared_ptr<const Cloud>& coarsePrototype : m_coarsePrototypes)
+	{
+		numBytes += coarsePrototype ? coarsePrototype->GetMemoryBytes() : 0;
+	}
+	return numBytes;
+}
+
+//-----------------------------------------------------------------------------------------------
+Cloud MakeCoarseCloud(const Cloud& prototype)
+{
+	Cloud coarse(prototype);
+	coarse.m_densityField = std::vector<float>();
+	coarse.m_voxelPositions = std::vector<Vec3>();
+	coarse.m_voxels = std::vector<Voxel>();
+	coarse.m_gridDimensions = IntVec3((prototype.m_gridDimensions.x + 1) / 2, (prototype.m_gridDimensions.y + 1) / 2, (prototype.m_gridDimensions.z + 1) / 2);
+
+	// Voxels sit at whole multiples of the voxel size; the quarter keeps rounding from moving one into the next block
+	const Vec3& voxelSize = prototype.m_voxelDimensions;
+	std::unordered_map<Vec3, int, Vec3Hasher> blockIndices;
+	std::unordered_set<Vec3, Vec3Hasher> voxelPositions;
+	for (const Voxel& voxel : prototype.m_voxels)
+	{
+		// The first voxel at a position wins, as in the serialized octree
+		if (!voxelPositions.insert(voxel.m_position).second)
+		{
+			continue;
+		}
+
+		Vec3 block = Vec3(floorf(voxel.m_position.x / (2.f * voxelSize.x) + 0.25f), floorf(voxel.m_position.y / (2.f * voxelSize.y) + 0.25f),
+			floorf(voxel.m_position.z / (2.f * voxelSize.z) + 0.25f));
+		auto found = blockIndices.find(block);
+		if (found == blockIndices.end())
+		{
+			Vec3 position = Vec3((block.x + 0.25f) * voxelSize.x, (block.y + 0.25f) * voxelSize.y, (block.z + 0.25f) * voxelSize.z);
+			found = blockIndices.emplace(block, (int)coarse.m_voxels.size()).first;
+			coarse.m_voxels.push_back(Voxel(position, 0.f));
+			coarse.m_voxelPositions.push_back(position);
+		}
+		coarse.m_voxels[found->second].m_density += voxel.m_density * 0.125f;
+	}
+
+	coarse.m_densityField.reserve(coarse.m_voxels.size());
+	for (const Voxel& voxel : coarse.m_voxels)
+	{
+		coarse.m_densityField.push_back(voxel.m_density);
+	}
+	coarse.m_structureChanged = true;
+	coarse.m_octreeIndex = -1;
+	return coarse;
+}
+
+//-----------------------------------------------------------------------------------------------
+CloudGPU MakeCloudInstanceGPU(const CloudGPU& prototype, const CloudInstance& instance)
+{
+	CloudGPU cloudGPU = prototype;
+	cloudGPU.center = instance.position;
+	cloudGPU.scale = instance.scale;
+	cloudGPU.densityScale = instance.densityScale;
+	cloudGPU.noiseOffset = instance.noiseOffset;
+	cloudGPU.prototypeIndex = (unsigned int)instance.prototypeIndex;
+
+	// A positive scale keeps the box's corners in order
+	cloudGPU.minBounds = GetWorldPosition(cloudGPU, prototype.minBounds);
+	cloudGPU.maxBounds = GetWorldPosition(cloudGPU, prototype.maxBounds);
+	return cloudGPU;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "Game/Cloud.hpp"
+#include <memory>
+#include <vector>
+
+// Where one cloud sits and how it differs from its prototype's shape
+struct CloudInstance
+{
+	int prototypeIndex = 0;
+	Vec3 position;					// World position of the prototype's origin
+	float scale = 1.f;
+	float densityScale = 1.f;
+	Vec3 noiseOffset;
+};
+
+// Generated cloud shapes, each built into one octree however many instances place it. Prototypes are generated at
+// the origin, so voxel and octree memory follow the number of distinct shapes rather than the number of clouds.
+// They never change once generated, so scene requests share them instead of copying.
+class CloudPrototypeLibrary
+{
+public:
+	// The prototype generated with these settings, generating it on first use
+	int FindOrAdd(const IntVec3& dimensions, const Vec3& voxelDimensions, ECloudType type, bool useTest);
+	void Clear();
+
+	int GetNumPrototypes() const { return (int)m_prototypes.size(); }
+	const Cloud& GetPrototype(int prototypeIndex) const { return *m_prototypes[prototypeIndex]; }
+	const std::shared_ptr<const Cloud>& GetSharedPrototype(int prototypeIndex) const { return m_prototypes[prototypeIndex]; }
+	const std::vector<std::shared_ptr<const Cloud>>& GetPrototypes() const { return m_prototypes; }
+	size_t GetNumVoxels() const;
+
+	// The prototype at half resolution, built on first use (MakeCoarseCloud); an instance shows it at twice its scale
+	const Cloud& GetCoarsePrototype(int prototypeIndex) { return *GetSharedCoarsePrototype(prototypeIndex); }
+	const std::shared_ptr<const Cloud>& GetSharedCoarsePrototype(int prototypeIndex);
+	bool HasCoarsePrototype(int prototypeIndex) const;
+
+	// CPU bytes of every prototype and the coarse ones built so far
+	size_t GetMemoryBytes() const;
+
+private:
+	struct PrototypeKey
+	{
+		IntVec3 dimensions;
+		Vec3 voxelDimensions;
+		ECloudType type = ECloudType::CLOUD_TEST;
+		bool useTest = false;
+	};
+
+	std::vector<std::shared_ptr<const Cloud>> m_prototypes;
+	std::vector<PrototypeKey> m_keys;
+	std::vector<std::shared_ptr<const Cloud>> m_coarsePrototypes;		// Null until asked for
+};
+
+// Each voxel of the result is the mean density of a 2x2x2 block of the prototype's (missing ones count as 0), at
+// half the prototype's coordinates with the same voxel size: at twice the scale it covers the prototype's space
+// with an eighth of the voxels.
+Cloud MakeCoarseCloud(const Cloud& prototype);
+
+// The instance's CloudGPU: the prototype's voxel range and octree, with its bounds placed in the world
+CloudGPU MakeCloudInstanceGPU(const CloudGPU& prototype, const CloudInstance& instance);
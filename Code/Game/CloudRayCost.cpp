@@ -0,0 +1,147 @@
+#include "Game/CloudRayCost.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+//-----------------------------------------------------------------------------------------------
+void CloudRayCostMap::Resize(int width, int height)
+{
+	m_width = width;
+	m_height = height;
+	for (std::vector<float>& values : m_values)
+	{
+		values.assign((size_t)width * height, 0.f);
+	}
+}
+
+void CloudRayCostMap::SetPixel(int x, int y, const CloudRayCounters& counters, float terminationDistance)
+{
+	size_t index = (size_t)y * m_width + x;
+	m_values[(int)CloudRayCostChannel::STEPS][index] = (float)counters.numSteps;
+	m_values[(int)CloudRayCostChannel::NODES_VISITED][index] = (float)counters.numNodesVisited;
+	m_values[(int)CloudRayCostChannel::VOXEL_TESTS][index] = (float)counters.numVoxelTests;
+	m_values[(int)CloudRayCostChannel::NOISE_SAMPLES][index] = (float)counters.numNoiseSamples;
+	m_values[(int)CloudRayCostChannel::TERMINATION_DISTANCE][index] = terminationDistance;
+	m_values[(int)CloudRayCostChannel::INTERVAL_REFILLS][index] = (float)counters.numIntervalRefills;
+}
+
+CloudRayCostSummary CloudRayCostMap::Summarize(CloudRayCostChannel channel) const
+{
+	CloudRayCostSummary summary;
+	const std::vector<float>& values = m_values[(int)channel];
+	if (values.empty())
+	{
+		return summary;
+	}
+
+	std::vector<float> sorted = values;
+	std::sort(sorted.begin(), sorted.end());
+
+	double total = 0.0;
+	for (float value : sorted)
+	{
+		total += value;
+	}
+
+	auto getPercentile = [&sorted](double fraction)
+	{
+		size_t rank = (size_t)ceil(fraction * (double)sorted.size());
+		return sorted[(rank > 0) ? rank - 1 : 0];
+	};
+
+	summary.numPixels = (int)sorted.size();
+	summary.minValue = sorted.front();
+	summary.meanValue = (float)(total / (double)sorted.size());
+	summary.p50 = getPercentile(0.50);
+	summary.p90 = getPercentile(0.90);
+	summary.p99 = getPercentile(0.99);
+	summary.maxValue = sorted.back();
+	return summary;
+}
+
+void CloudRayCostMap::RenderHeatmap(CloudRayCostChannel channel, FloatImage& image, float maxValue) const
+{
+	if (maxValue <= 0.f)
+	{
+		maxValue = Summarize(channel).p99;
+	}
+	float inverseMax = (maxValue > 0.f) ? 1.f / maxValue : 0.f;
+
+	image.Resize(m_width, m_height);
+	const std::vector<float>& values = m_values[(int)channel];
+	for (int y = 0; y < m_height; ++y)
+	{
+		for (int x = 0; x < m_width; ++x)
+		{
+			image.SetPixel(x, y, GetHeatColor(values[(size_t)y * m_width + x] * inverseMax));
+		}
+	}
+}
+
+std::string CloudRayCostMap::GetSummaryText() const
+{
+	std::string text;
+	char line[192];
+	for (int channelIndex = 0; channelIndex < (int)CloudRayCostChannel::COUNT; ++channelIndex)
+	{
+		CloudRayCostChannel channel = (CloudRayCostChannel)channelIndex;
+		CloudRayCostSummary summary = Summarize(channel);
+		snprintf(line, sizeof(line), "%-20s min %8.1f  mean %8.1f  p50 %8.1f  p90 %8.1f  p99 %8.1f  max %8.1f\n", GetChannelName(channel),
+			summary.minValue, summary.meanValue, summary.p50, summary.p90, summary.p99, summary.maxValue);
+		text += line;
+	}
+	return text;
+}
+
+//-----------------------------------------------------------------------------------------------
+const char* CloudRayCostMap::GetChannelName(CloudRayCostChannel channel)
+{
+	switch (channel)
+	{
+	case CloudRayCostChannel::STEPS:					return "Steps";
+	case CloudRayCostChannel::NODES_VISITED:			return "Nodes Visited";
+	case CloudRayCostChannel::VOXEL_TESTS:				return "Voxel Tests";
+	case CloudRayCostChannel::NOISE_SAMPLES:			return "Noise Samples";
+	case CloudRayCostChannel::TERMINATION_DISTANCE:		return "Termination Distance";
+	case CloudRayCostChannel::INTERVAL_REFILLS:			return "Interval Refills";
+	default:											return "?";
+	}
+}
+
+float CloudRayCostMap::GetDefaultMaxValue(CloudRayCostChannel channel)
+{
+	switch (channel)
+	{
+	case CloudRayCostChannel::STEPS:					return 256.f;
+	case CloudRayCostChannel::NODES_VISITED:			return 2048.f;
+	case CloudRayCostChannel::VOXEL_TESTS:				return 512.f;
+	case CloudRayCostChannel::NOISE_SAMPLES:			return 256.f;
+	case CloudRayCostChannel::TERMINATION_DISTANCE:		return 500.f;
+	case CloudRayCostChannel::INTERVAL_REFILLS:			return 8.f;
+	default:											return 1.f;
+	}
+}
+
+Vec4 CloudRayCostMap::GetHeatColor(float t)
+{
+	static const Vec4 STOPS[5] =
+	{
+		Vec4(0.02f, 0.02f, 0.2f, 1.f),
+		Vec4(0.f, 0.35f, 1.f, 1.f),
+		Vec4(0.f, 0.85f, 0.3f, 1.f),
+		Vec4(1.f, 0.85f, 0.f, 1.f),
+		Vec4(1.f, 0.1f, 0.f, 1.f),
+	};
+
+	float scaled = fminf(fmaxf(t, 0.f), 1.f) * 4.f;
+	int stop = (int)scaled;
+	if (stop >= 4)
+	{
+		return STOPS[4];
+	}
+
+	float blend = scaled - (float)stop;
+	const Vec4& a = STOPS[stop];
+	const Vec4& b = STOPS[stop + 1];
+	return Vec4(a.x + (b.x - a.x) * blend, a.y + (b.y - a.y) * blend, a.z + (b.z - a.z) * blend, 1.f);
+}
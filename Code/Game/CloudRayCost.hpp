@@ -0,0 +1,71 @@
+#pragma once
+#include "Game/CloudRayMarcher.hpp"
+#include "Game/FloatImage.hpp"
+#include <string>
+#include <vector>
+
+// What a cost heatmap shows; the order matches COST_VIEW_* in CloudShader.hlsl
+enum class CloudRayCostChannel
+{
+	STEPS,
+	NODES_VISITED,
+	VOXEL_TESTS,					// Voxel BoxSDF tests on the octree path, DDA cells visited on the grid path
+	NOISE_SAMPLES,					// Noise texture fetches
+	TERMINATION_DISTANCE,			// Where the ray went opaque or stopped at the scene depth
+	INTERVAL_REFILLS,				// Cloud interval lists rebuilt because more clouds were on the ray than fit
+	COUNT
+};
+
+// Per-frame parameters for the shader's cost view (must match CloudCostView in CloudShader.hlsl)
+struct CloudCostViewGPU
+{
+	int channel = -1;				// CloudRayCostChannel, -1 = off
+	float maxValue = 1.f;			// Mapped to the hot end of the ramp
+	float padding[2] = {};
+};
+
+struct CloudRayCostSummary
+{
+	int numPixels = 0;
+	float minValue = 0.f;
+	float meanValue = 0.f;
+	float p50 = 0.f;
+	float p90 = 0.f;
+	float p99 = 0.f;
+	float maxValue = 0.f;
+};
+
+// Per-pixel ray costs filled by CloudRayMarcher::Render, one value per channel. Pixels of a block share its ray.
+class CloudRayCostMap
+{
+public:
+	void Resize(int width, int height);
+	void SetPixel(int x, int y, const CloudRayCounters& counters, float terminationDistance);
+
+	float GetValue(int x, int y, CloudRayCostChannel channel) const { return m_values[(int)channel][(size_t)y * m_width + x]; }
+	const std::vector<float>& GetValues(CloudRayCostChannel channel) const { return m_values[(int)channel]; }
+	int GetWidth() const { return m_width; }
+	int GetHeight() const { return m_height; }
+
+	// Exact (nearest-rank) percentiles over every pixel
+	CloudRayCostSummary Summarize(CloudRayCostChannel channel) const;
+
+	// False colour with GetHeatColor; maxValue 0 scales to the channel's 99th percentile
+	void RenderHeatmap(CloudRayCostChannel channel, FloatImage& image, float maxValue = 0.f) const;
+
+	// One line per channel: min / mean / p50 / p90 / p99 / max
+	std::string GetSummaryText() const;
+
+	static const char* GetChannelName(CloudRayCostChannel channel);
+
+	// Fixed scale the in-game view starts at, so frames compare without the range moving
+	static float GetDefaultMaxValue(CloudRayCostChannel channel);
+
+	// Dark blue, blue, green, yellow, red over [0,1], clamped; the same ramp as CostHeatColor in CloudShader.hlsl
+	static Vec4 GetHeatColor(float t);
+
+private:
+	int m_width = 0;
+	int m_height = 0;
+	std::vector<float> m_values[(int)CloudRayCostChannel::COUNT];
+};
@@ -0,0 +1,1710 @@
+#include "Game/CloudRayMarcher.hpp"
+#include "Game/CloudNoiseVolumes.hpp"
+#include "Game/CloudRayCost.hpp"
+#include "Game/CloudStepPolicy.hpp"
+#include "Game/CloudSunTransmittance.hpp"
+#include "Game/CurlNoise.hpp"
+#include "Game/ParallelFor.hpp"
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <emmintrin.h>
+#include <mutex>
+
+constexpr int CLOUD_RAY_MARCH_TILE_SIZE = 32;
+constexpr int CLOUD_RAY_MARCH_STACK_SIZE = 1024;
+constexpr float CLOUD_RAY_MARCH_CELL_NUDGE = 0.001f;
+
+//-----------------------------------------------------------------------------------------------
+// HLSL intrinsics used by RayMarchOctree
+static float Saturate(float value)
+{
+	return (value < 0.f) ? 0.f : ((value > 1.f) ? 1.f : value);
+}
+
+static float Frac(float value)
+{
+	return value - floorf(value);
+}
+
+static Vec3 Frac(const Vec3& value)
+{
+	return Vec3(Frac(value.x), Frac(value.y), Frac(value.z));
+}
+
+static float SmoothStep(float edge0, float edge1, float value)
+{
+	float t = Saturate((value - edge0) / (edge1 - edge0));
+	return t * t * (3.f - 2.f * t);
+}
+
+static float BoxSDF(const Vec3& point, const Vec3& boxCenter, const Vec3& boxHalfSize)
+{
+	float dx = fabsf(point.x - boxCenter.x) - boxHalfSize.x;
+	float dy = fabsf(point.y - boxCenter.y) - boxHalfSize.y;
+	float dz = fabsf(point.z - boxCenter.z) - boxHalfSize.z;
+
+	float ox = (dx > 0.f) ? dx : 0.f;
+	float oy = (dy > 0.f) ? dy : 0.f;
+	float oz = (dz > 0.f) ? dz : 0.f;
+
+	float outsideDistance = sqrtf(ox * ox + oy * oy + oz * oz);
+	float maxDistance = (dx > dy) ? dx : dy;
+	maxDistance = (maxDistance > dz) ? maxDistance : dz;
+	float insideDistance = (maxDistance < 0.f) ? maxDistance : 0.f;
+	return outsideDistance + insideDistance;
+}
+
+static float HenyeyGreenstein(const Vec3& viewDir, const Vec3& lightDir, float g)
+{
+	float cosTheta = DotProduct3D(viewDir, lightDir);
+	float gSquared = g * g;
+	float denominator = 1.f + gSquared - 2.f * g * cosTheta;
+	return (1.f - gSquared) / (denominator * sqrtf(denominator));
+}
+
+static float PowderEffect(const Vec3& viewDir, const Vec3& lightDir, float bias, float scatteringCoefficient)
+{
+	float dotVL = DotProduct3D(viewDir.GetNormalized(), lightDir.GetNormalized());
+	float shiftedDot = Saturate(fmaxf(dotVL, 0.f) + bias);
+	return powf(shiftedDot, scatteringCoefficient);
+}
+
+//-----------------------------------------------------------------------------------------------
+// PCG hash (Jarzynski & Olano); the shaders' delta tracking uses the same one
+static unsigned int HashPCG(unsigned int value)
+{
+	unsigned int state = value * 747796405u + 2891336453u;
+	unsigned int word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+// Uniform in [0,1)
+static float NextRandom(unsigned int& rngState)
+{
+	rngState = HashPCG(rngState);
+	return (float)(rngState >> 8) * (1.f / 16777216.f);
+}
+
+// A world ray direction in the instance's prototype space; ray distances stay the same, so t needs no conversion
+static Vec3 GetPrototypeDirection(const CloudGPU& cloud, const Vec3& direction)
+{
+	return direction * (1.f / cloud.scale);
+}
+
+static bool IsInsideBox(const Vec3& point, const Vec3& minBounds, const Vec3& maxBounds)
+{
+	return point.x >= minBounds.x && point.y >= minBounds.y && point.z >= minBounds.z
+		&& point.x <= maxBounds.x && point.y <= maxBounds.y && point.z <= maxBounds.z;
+}
+
+// Slab test; tEnter is clamped to 0 for rays that start inside
+static bool IntersectBox(const Vec3& rayOrigin, const Vec3& invRayDir, const Vec3& minBounds, const Vec3& maxBounds, float& tEnter, float& tExit)
+{
+	float t1x = (minBounds.x - rayOrigin.x) * invRayDir.x;
+	float t2x = (maxBounds.x - rayOrigin.x) * invRayDir.x;
+	float t1y = (minBounds.y - rayOrigin.y) * invRayDir.y;
+	float t2y = (maxBounds.y - rayOrigin.y) * invRayDir.y;
+	float t1z = (minBounds.z - rayOrigin.z) * invRayDir.z;
+	float t2z = (maxBounds.z - rayOrigin.z) * invRayDir.z;
+
+	tEnter = fmaxf(fmaxf(fminf(t1x, t2x), fminf(t1y, t2y)), fmaxf(fminf(t1z, t2z), 0.f));
+	tExit = fminf(fminf(fmaxf(t1x, t2x), fmaxf(t1y, t2y)), fmaxf(t1z, t2z));
+	return tEnter <= tExit;
+}
+
+//-----------------------------------------------------------------------------------------------
+SceneOccluderGPU MakeSceneOccluder(const Vec3& center, const Vec3& axisX, const Vec3& axisY, const Vec3& axisZ)
+{
+	SceneOccluderGPU occluder;
+	occluder.center = center;
+	occluder.inverseAxisX = axisX / DotProduct3D(axisX, axisX);
+	occluder.inverseAxisY = axisY / DotProduct3D(axisY, axisY);
+	occluder.inverseAxisZ = axisZ / DotProduct3D(axisZ, axisZ);
+	return occluder;
+}
+
+float FindSceneDepth(const std::vector<SceneOccluderGPU>& occluders, const Vec3& rayOrigin, const Vec3& rayDirection, float maxDistance)
+{
+	float depth = maxDistance;
+	for (const SceneOccluderGPU& occluder : occluders)
+	{
+		Vec3 offset = rayOrigin - occluder.center;
+		Vec3 localOrigin = Vec3(DotProduct3D(offset, occluder.inverseAxisX), DotProduct3D(offset, occluder.inverseAxisY), DotProduct3D(offset, occluder.inverseAxisZ));
+		Vec3 localDirection = Vec3(DotProduct3D(rayDirection, occluder.inverseAxisX), DotProduct3D(rayDirection, occluder.inverseAxisY), DotProduct3D(rayDirection, occluder.inverseAxisZ));
+		Vec3 invLocalDir = Vec3(1.f / localDirection.x, 1.f / localDirection.y, 1.f / localDirection.z);
+
+		float tEnter = 0.f;
+		float tExit = 0.f;
+		if (IntersectBox(localOrigin, invLocalDir, Vec3(-0.5f, -0.5f, -0.5f), Vec3(0.5f, 0.5f, 0.5f), tEnter, tExit) && tEnter < depth)
+		{
+			depth = tEnter;
+		}
+	}
+	return depth;
+}
+
+//-----------------------------------------------------------------------------------------------
+Vec3 CloudRayMarchCamera::ComputeRayDirection(float u, float v) const
+{
+	float tanHalfFov = tanf(0.5f * fovDegrees * 3.14159265f / 180.f);
+	Vec3 direction = forward + left * (-u * tanHalfFov * aspect) + up * (-v * tanHalfFov);
+	return direction.GetNormalized();
+}
+
+bool CloudRayMarchCamera::ProjectToUV(const Vec3& worldPosition, float& u, float& v) const
+{
+	Vec3 toPosition = worldPosition - position;
+	float forwardDistance = DotProduct3D(toPosition, forward);
+	if (forwardDistance <= 0.f)
+	{
+		return false;
+	}
+
+	float tanHalfFov = tanf(0.5f * fovDegrees * 3.14159265f / 180.f);
+	u = -DotProduct3D(toPosition, left) / (forwardDistance * tanHalfFov * aspect);
+	v = -DotProduct3D(toPosition, up) / (forwardDistance * tanHalfFov);
+	return true;
+}
+
+void CloudRayMarchStats::Add(const CloudRayMarchStats& other)
+{
+	numRays += other.numRays;
+	numSteps += other.numSteps;
+	numNoiseSamples += other.numNoiseSamples;
+	numVoxelTests += other.numVoxelTests;
+	numIntervalRefills += other.numIntervalRefills;
+	numDensityLookups += other.numDensityLookups;
+	numNodesVisited += other.numNodesVisited;
+	numEarlyTerminations += other.numEarlyTerminations;
+	stepsPerRay.Add(other.stepsPerRay);
+	densitySamplesPerRay.Add(other.densitySamplesPerRay);
+	nodesVisitedPerRay.Add(other.nodesVisitedPerRay);
+}
+
+void CloudRayHistogram::Record(int value)
+{
+	int bucket = 0;
+	for (int upperBound = value; upperBound > 0 && bucket < CLOUD_RAY_HISTOGRAM_BUCKETS - 1; upperBound >>= 1)
+	{
+		bucket++;
+	}
+
+	buckets[bucket]++;
+	numRays++;
+	total += value;
+	maxValue = (value > maxValue) ? value : maxValue;
+}
+
+void CloudRayHistogram::Add(const CloudRayHistogram& other)
+{
+	for (int bucket = 0; bucket < CLOUD_RAY_HISTOGRAM_BUCKETS; ++bucket)
+	{
+		buckets[bucket] += other.buckets[bucket];
+	}
+	numRays += other.numRays;
+	total += other.total;
+	maxValue = (other.maxValue > maxValue) ? other.maxValue : maxValue;
+}
+
+int CloudRayHistogram::GetBucketUpperBound(int bucket)
+{
+	return (bucket == 0) ? 0 : (1 << bucket) - 1;
+}
+
+int CloudRayHistogram::GetPercentile(float fraction) const
+{
+	long long target = (long long)ceil((double)fraction * (double)numRays);
+	long long count = 0;
+	for (int bucket = 0; bucket < CLOUD_RAY_HISTOGRAM_BUCKETS; ++bucket)
+	{
+		count += buckets[bucket];
+		if (count >= target && count > 0)
+		{
+			return (bucket == CLOUD_RAY_HISTOGRAM_BUCKETS - 1) ? maxValue : GetBucketUpperBound(bucket);
+		}
+	}
+	return maxValue;
+}
+
+//-----------------------------------------------------------------------------------------------
+CloudRayMarcher::CloudRayMarcher(const CloudRayMarchScene& scene, const CloudNoiseVolumes& noiseVolumes, const CloudRayMarchSettings& settings)
+	: m_scene(scene)
+	, m_noiseVolumes(noiseVolumes)
+	, m_settings(settings)
+{
+	m_sunPosition = settings.sunDirection.GetNormalized() * -10000.f;
+	m_stepPolicy = CreateCloudStepPolicy(settings);
+
+	for (const CloudGPU& cloud : scene.clouds)
+	{
+		m_cloudCentersX.push_back(0.5f * (cloud.minBounds.x + cloud.maxBounds.x));
+		m_cloudCentersY.push_back(0.5f * (cloud.minBounds.y + cloud.maxBounds.y));
+		m_cloudCentersZ.push_back(0.5f * (cloud.minBounds.z + cloud.maxBounds.z));
+		m_cloudHalfSizesX.push_back(0.5f * (cloud.maxBounds.x - cloud.minBounds.x));
+		m_cloudHalfSizesY.push_back(0.5f * (cloud.maxBounds.y - cloud.minBounds.y));
+		m_cloudHalfSizesZ.push_back(0.5f * (cloud.maxBounds.z - cloud.minBounds.z));
+	}
+
+	if (settings.useOccupancyGrid)
+	{
+		BuildOccupancyGrids();
+	}
+}
+
+void CloudRayMarcher::BuildOccupancyGrids()
+{
+	// One grid per prototype, in its space; every instance of it looks up the same one
+	const Vec3& cellSize = m_settings.voxelDimensions;
+	m_occupancyGrids.resize(m_scene.prototypes.size());
+
+	std::vector<int> voxelIndices;
+	std::vector<unsigned int> nodeStack;
+
+	for (int prototypeIndex = 0; prototypeIndex < (int)m_scene.prototypes.size(); ++prototypeIndex)
+	{
+		const CloudGPU& cloud = m_scene.prototypes[prototypeIndex];
+
+		// The prototype's voxels are whatever its octree leaves reference
+		voxelIndices.clear();
+		nodeStack.assign(1, cloud.octreeIndex);
+		while (!nodeStack.empty())
+		{
+			const OctreeNodeGPU& node = m_scene.octreeNodes[nodeStack.back()];
+			nodeStack.pop_back();
+
+			for (int childIndex = 0; childIndex < node.numChildren; ++childIndex)
+			{
+				nodeStack.push_back((unsigned int)(node.firstChildIndex + childIndex));
+			}
+			for (int elementIndex = 0; elementIndex < node.numElements && node.numChildren == 0; ++elementIndex)
+			{
+				voxelIndices.push_back(node.firstElementIndex + elementIndex);
+			}
+		}
+
+		// Cloud bounds are the union of voxel boxes, so they sit exactly on the voxel grid
+		Vec3 extent = cloud.maxBounds - cloud.minBounds;
+		IntVec3 dimensions = IntVec3((int)(extent.x / cellSize.x + 0.5f), (int)(extent.y / cellSize.y + 0.5f), (int)(extent.z / cellSize.z + 0.5f));
+		m_occupancyGrids[prototypeIndex].Build(cloud.minBounds, cellSize, dimensions, m_scene.voxels, voxelIndices);
+	}
+}
+
+float CloudRayMarcher::SampleNoise(const Vec3& rayPos, CloudRayMarchStats& stats) const
+{
+	const CloudRayMarchSettings& s = m_settings;
+
+	Vec3 scaledPos = Vec3(rayPos.x * s.noiseScale / s.voxelDimensions.x, rayPos.y * s.noiseScale / s.voxelDimensions.y, rayPos.z * s.noiseScale / s.voxelDimensions.z);
+	Vec3 scroll = Vec3(s.timeElapsed * 0.1f, -s.timeElapsed * 0.05f, -s.timeElapsed * 0.01f) * s.scrollFactor;
+
+	Vec3 noiseCoords = Frac(scaledPos + scroll);
+	Vec3 worleyCoords = noiseCoords;
+	if (!s.scrolling)
+	{
+		noiseCoords = scaledPos;
+	}
+	else if (m_windField != nullptr)
+	{
+		// Trilinear with wrapping, like SampleWindField
+		Vec3 wind = m_windField->SampleVelocity(Frac(scaledPos)) * s.windSpeed;
+		worleyCoords = Frac(worleyCoords + wind * (s.scrollFactor * 0.1f));
+	}
+
+	// The shader also samples medium, detail and mask Worley octaves, but none of them reach the returned value,
+	// so the compiler strips them; only the two live samples are reproduced
+	float perlinVal = m_noiseVolumes.SamplePerlin(noiseCoords, 0.f);
+	float worleyBase = m_noiseVolumes.SampleWorley(worleyCoords, 0.f);
+	stats.numNoiseSamples += 2;
+
+	if (worleyBase <= s.minWorleyValue)
+	{
+		worleyBase = 0.f;
+	}
+
+	float lerpWeight = powf(s.noiseLerpVal, 1.5f);
+	float noiseValue = Saturate(perlinVal + (worleyBase - perlinVal) * lerpWeight);
+
+	if (!s.useNoise) noiseValue = 0.5f;
+	if (s.invertNoise) noiseValue = 1.f - noiseValue;
+
+	return powf(Saturate(noiseValue), s.noisePowVal);
+}
+
+float CloudRayMarcher::AccumulateDensity(const Voxel& voxel, float noiseValue) const
+{
+	if (!m_settings.useDensity)
+	{
+		return 1.f;
+	}
+	return (voxel.m_density + (noiseValue - voxel.m_density) * m_settings.densityNoiseLerpVal) * m_settings.densityMultiplier;
+}
+
+void CloudRayMarcher::TraverseOctree(unsigned int rootNodeIndex, const Vec3& rayPos, float& minSDF, unsigned int& closestNodeIndex, int* numNodesVisited) const
+{
+	unsigned int stack[CLOUD_RAY_MARCH_STACK_SIZE];
+	int stackPointer = 0;
+	stack[stackPointer++] = rootNodeIndex;
+
+	while (stackPointer > 0)
+	{
+		unsigned int nodeIndex = stack[--stackPointer];
+		const OctreeNodeGPU& node = m_scene.octreeNodes[nodeIndex];
+		if (numNodesVisited != nullptr)
+		{
+			(*numNodesVisited)++;
+		}
+
+		Vec3 nodeCenter = (node.minBounds + node.maxBounds) * 0.5f;
+		Vec3 nodeHalfSize = (node.maxBounds - node.minBounds) * 0.5f;
+		float distanceToNode = BoxSDF(rayPos, nodeCenter, nodeHalfSize);
+
+		if (distanceToNode < minSDF)
+		{
+			minSDF = distanceToNode;
+		}
+
+		if (distanceToNode <= 0.f)
+		{
+			closestNodeIndex = nodeIndex;
+
+			if (node.densitySum < m_settings.densityThreshold)
+			{
+				continue;
+			}
+
+			for (int i = 0; i < node.numChildren && stackPointer < CLOUD_RAY_MARCH_STACK_SIZE; ++i)
+			{
+				stack[stackPointer++] = (unsigned int)(node.firstChildIndex + i);
+			}
+		}
+	}
+}
+
+float CloudRayMarcher::SampleShadow(CloudRayState& ray, int cloudIndex, CloudRayMarchStats& stats) const
+{
+	if (m_settings.useRatioTrackingShadows)
+	{
+		return EstimateSunTransmittance(ray.position, ray.rngState, stats);
+	}
+	if (m_sunTransmittance != nullptr && m_sunTransmittance->HasVolume(cloudIndex))
+	{
+		return m_sunTransmittance->Sample(cloudIndex, ray.position);
+	}
+	if (m_shadowLookup)
+	{
+		return m_shadowLookup(ray.position);
+	}
+	return 1.f;
+}
+
+float CloudRayMarcher::ComputePhase(const Vec3& rayPos, const Vec3& rayDir) const
+{
+	Vec3 directionToSun = (m_sunPosition - rayPos).GetNormalized();
+	float powder = PowderEffect(rayDir, directionToSun * -1.f, m_settings.powderBias, m_settings.scatteringCoefficient);
+	float hg = HenyeyGreenstein(rayDir, directionToSun * -1.f, m_settings.anisotropy);
+	return powder * hg;
+}
+
+CloudRayState CloudRayMarcher::StartRay(const Vec3& rayOrigin, const Vec3& rayDirection, float jitter) const
+{
+	CloudRayState ray;
+	ray.origin = rayOrigin;
+	ray.position = rayOrigin;
+	ray.direction = rayDirection;
+	ray.maxDistance = FindSceneDepth(m_scene.occluders, rayOrigin, rayDirection, m_settings.maxDistance);
+	ray.firstHitDistance = ray.maxDistance;
+	ray.isFinished = !(0.f < ray.maxDistance);
+
+	// Start a jittered fraction of a step in, like RayMarchOctree; the intervals stay measured from the origin
+	ray.entryOffset = jitter * m_settings.minStepSize * m_settings.voxelDimensions.x;
+	ray.position += rayDirection * ray.entryOffset;
+	ray.distanceTraveled = ray.entryOffset;
+
+	if (m_settings.useCloudIntervals)
+	{
+		BuildCloudIntervals(ray);
+	}
+	return ray;
+}
+
+float CloudRayMarcher::SampleRayJitter(int pixelX, int pixelY) const
+{
+	if (m_blueNoise == nullptr || !m_blueNoise->IsGenerated())
+	{
+		return 0.f;
+	}
+
+	int textureSize = m_rayJitter.textureSize;
+	float value = m_blueNoise->GetValue((pixelX + m_rayJitter.offsetX) % textureSize, (pixelY + m_rayJitter.offsetY) % textureSize);
+	return Frac(value + m_rayJitter.rotation) * m_rayJitter.strength;
+}
+
+void CloudRayMarcher::BuildCloudIntervals(CloudRayState& ray) const
+{
+	const Vec3& rayOrigin = ray.origin;
+	Vec3 invRayDir = Vec3(1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z);
+
+	ray.numIntervals = 0;
+	bool isOverflowing = false;
+	for (int cloudIndex = 0; cloudIndex < (int)m_scene.clouds.size(); ++cloudIndex)
+	{
+		const CloudGPU& cloud = m_scene.clouds[cloudIndex];
+
+		// Slab test
+		float t1x = (cloud.minBounds.x - rayOrigin.x) * invRayDir.x;
+		float t2x = (cloud.maxBounds.x - rayOrigin.x) * invRayDir.x;
+		float t1y = (cloud.minBounds.y - rayOrigin.y) * invRayDir.y;
+		float t2y = (cloud.maxBounds.y - rayOrigin.y) * invRayDir.y;
+		float t1z = (cloud.minBounds.z - rayOrigin.z) * invRayDir.z;
+		float t2z = (cloud.maxBounds.z - rayOrigin.z) * invRayDir.z;
+
+		float tEnter = fmaxf(fmaxf(fminf(t1x, t2x), fminf(t1y, t2y)), fmaxf(fminf(t1z, t2z), 0.f));
+		float tExit = fminf(fminf(fmaxf(t1x, t2x), fmaxf(t1y, t2y)), fmaxf(t1z, t2z));
+
+		if (!(tEnter <= tExit) || tEnter >= ray.maxDistance || tExit < ray.distanceTraveled)
+		{
+			continue;
+		}
+
+		// Insertion sort; past capacity the farthest entry is dropped
+		int slot = (ray.numIntervals < CLOUD_RAY_MAX_INTERVALS) ? ray.numIntervals : CLOUD_RAY_MAX_INTERVALS - 1;
+		isOverflowing |= ray.numIntervals == CLOUD_RAY_MAX_INTERVALS;
+		if (ray.numIntervals == CLOUD_RAY_MAX_INTERVALS && tEnter >= ray.intervals[slot].tEnter)
+		{
+			continue;
+		}
+
+		while (slot > 0 && ray.intervals[slot - 1].tEnter > tEnter)
+		{
+			ray.intervals[slot] = ray.intervals[slot - 1];
+			--slot;
+		}
+
+		ray.intervals[slot].tEnter = tEnter;
+		ray.intervals[slot].tExit = tExit;
+		ray.intervals[slot].cloudIndex = cloudIndex;
+		if (ray.numIntervals < CLOUD_RAY_MAX_INTERVALS)
+		{
+			++ray.numIntervals;
+		}
+	}
+
+	// A dropped cloud may start at the last kept entry. If the ray is already past it, every kept cloud is active and
+	// nothing else fits until the first of them ends.
+	ray.intervalRefillDistance = 100000.f;
+	if (isOverflowing)
+	{
+		ray.intervalRefillDistance = ray.intervals[CLOUD_RAY_MAX_INTERVALS - 1].tEnter;
+		if (ray.intervalRefillDistance <= ray.distanceTraveled)
+		{
+			ray.intervalRefillDistance = 100000.f;
+			for (const CloudRayInterval& interval : ray.intervals)
+			{
+				ray.intervalRefillDistance = fminf(ray.intervalRefillDistance, interval.tExit);
+			}
+		}
+	}
+}
+
+void CloudRayMarcher::UpdateCloudIntervals(CloudRayState& ray, CloudRayMarchStats& stats) const
+{
+	if (ray.distanceTraveled >= ray.intervalRefillDistance)
+	{
+		BuildCloudIntervals(ray);
+		stats.numIntervalRefills++;
+		ray.counters.numIntervalRefills++;
+	}
+}
+
+void CloudRayMarcher::FindClosestCloudInterval(const CloudRayState& ray, float& minDistCloud, int& closestCloudIndex) const
+{
+	minDistCloud = 100000.f;
+	closestCloudIndex = -1;
+
+	for (int intervalIndex = 0; intervalIndex < ray.numIntervals; ++intervalIndex)
+	{
+		const CloudRayInterval& interval = ray.intervals[intervalIndex];
+
+		// Nothing active: the gap to the next entry becomes the step, so the ray jumps straight there, keeping its
+		// jitter so the skip doesn't line every ray up on the box face again
+		if (interval.tEnter > ray.distanceTraveled + 0.1f)
+		{
+			if (closestCloudIndex < 0)
+			{
+				minDistCloud = interval.tEnter + ray.entryOffset - ray.distanceTraveled;
+			}
+			return;
+		}
+
+		if (interval.tExit < ray.distanceTraveled)
+		{
+			continue;
+		}
+
+		int cloudIndex = interval.cloudIndex;
+		Vec3 cloudCenter = Vec3(m_cloudCentersX[cloudIndex], m_cloudCentersY[cloudIndex], m_cloudCentersZ[cloudIndex]);
+		Vec3 cloudHalfSize = Vec3(m_cloudHalfSizesX[cloudIndex], m_cloudHalfSizesY[cloudIndex], m_cloudHalfSizesZ[cloudIndex]);
+		float distToCloud = BoxSDF(ray.position, cloudCenter, cloudHalfSize);
+
+		if (distToCloud < minDistCloud)
+		{
+			minDistCloud = distToCloud;
+			closestCloudIndex = cloudIndex;
+		}
+	}
+}
+
+void CloudRayMarcher::FindClosestCloud(const CloudRayState& ray, float& minDistCloud, int& closestCloudIndex) const
+{
+	if (m_settings.useCloudIntervals)
+	{
+		FindClosestCloudInterval(ray, minDistCloud, closestCloudIndex);
+		return;
+	}
+
+	const Vec3& rayPos = ray.position;
+	minDistCloud = 100000.f;
+	closestCloudIndex = -1;
+
+	for (int cloudIndex = 0; cloudIndex < (int)m_cloudCentersX.size(); ++cloudIndex)
+	{
+		Vec3 cloudCenter = Vec3(m_cloudCentersX[cloudIndex], m_cloudCentersY[cloudIndex], m_cloudCentersZ[cloudIndex]);
+		Vec3 cloudHalfSize = Vec3(m_cloudHalfSizesX[cloudIndex], m_cloudHalfSizesY[cloudIndex], m_cloudHalfSizesZ[cloudIndex]);
+		float distToCloud = BoxSDF(rayPos, cloudCenter, cloudHalfSize);
+
+		if (distToCloud > m_settings.maxDistance)
+		{
+			continue;
+		}
+
+		if (distToCloud < minDistCloud)
+		{
+			minDistCloud = distToCloud;
+			closestCloudIndex = cloudIndex;
+		}
+	}
+}
+
+float CloudRayMarcher::ComputeVoxelDensity(const Vec3& rayPos, const CloudGPU& cloud, const Voxel& voxel, CloudRayMarchStats& stats) const
+{
+	const CloudRayMarchSettings& s = m_settings;
+	Vec3 voxelHalfSize = s.voxelDimensions * 0.5f;
+
+	stats.numDensityLookups++;
+	float noiseVal = SampleNoise(rayPos + cloud.noiseOffset, stats);
+	float densityVal = AccumulateDensity(voxel, noiseVal);
+
+	// Voxels are in prototype space; the ratio to the voxel radius is the same in either
+	float voxelDist = (GetPrototypePosition(cloud, rayPos) - voxel.m_position).GetLength();
+	float voxelMaxRadius = voxelHalfSize.GetLength();
+	float normalizedVoxelDist = Saturate(voxelDist / voxelMaxRadius);
+
+	Vec3 cloudCenter = (cloud.maxBounds + cloud.minBounds) * 0.5f;
+	float cloudDist = (rayPos - cloudCenter).GetLength();
+	float cloudMaxRadius = fabsf(cloud.maxBounds.z - cloud.minBounds.z);
+	float normalizedCloudDist = Saturate(cloudDist / cloudMaxRadius);
+
+	float combinedNorm = normalizedVoxelDist + (normalizedCloudDist - normalizedVoxelDist) * s.cloudVoxelDistanceLerpVal;
+	float falloff = SmoothStep(0.f, 0.95f, combinedNorm);
+	densityVal *= (1.f - falloff);
+
+	// Horizontal fade towards the cloud's XY edges
+	float radialX = rayPos.x - cloudCenter.x;
+	float radialY = rayPos.y - cloudCenter.y;
+	float radialDist = sqrtf(radialX * radialX + radialY * radialY);
+	float halfSizeX = 0.5f * (cloud.maxBounds.x - cloud.minBounds.x);
+	float halfSizeY = 0.5f * (cloud.maxBounds.y - cloud.minBounds.y);
+	float bigRadius = sqrtf(halfSizeX * halfSizeX + halfSizeY * halfSizeY);
+	float radialFalloff = 1.f - Saturate(radialDist / bigRadius);
+	densityVal *= radialFalloff * radialFalloff;
+	return densityVal * cloud.densityScale;
+}
+
+bool CloudRayMarcher::ShadeVoxel(CloudRayState& ray, int cloudIndex, const Voxel& voxel, float minSDF, float& phase, float& stepSize, CloudRayMarchStats& stats) const
+{
+	const CloudRayMarchSettings& s = m_settings;
+	const CloudGPU& cloud = m_scene.clouds[cloudIndex];
+
+	float densityVal = ComputeVoxelDensity(ray.position, cloud, voxel, stats);
+	ray.counters.numDensitySamples++;
+	ray.counters.numNoiseSamples += 2;	// SampleNoise's Perlin and Worley fetches
+
+	CloudStepContext stepContext;
+	stepContext.minStep = s.minStepSize * s.voxelDimensions.x;
+	stepContext.minSDF = minSDF;
+	stepContext.density = densityVal;
+	stepContext.distanceTraveled = ray.distanceTraveled;
+	stepContext.transmittance = ray.transmittance;
+	stepContext.previousDensity = ray.previousDensity;
+	stepContext.previousDistance = ray.previousDistance;
+	stepSize = m_stepPolicy->GetSampleStep(stepContext);
+
+	ray.previousDensity = densityVal;
+	ray.previousDistance = ray.distanceTraveled;
+
+	// Powder and HG only depend on the sample position, which is fixed for the whole voxel loop
+	if (phase < 0.f)
+	{
+		phase = ComputePhase(ray.position, ray.direction);
+	}
+	float voxelShadowFactor = s.shadowFactorMin + SampleShadow(ray, cloudIndex, stats);
+	float opticalDepth = s.extinctionCoefficient * densityVal * stepSize;
+
+	if (ray.isDeferringSamples)
+	{
+		ray.hasPendingSample = true;
+		ray.pendingOpticalDepth = opticalDepth;
+		ray.pendingPhase = phase;
+		ray.pendingShadowFactor = voxelShadowFactor;
+		return false;
+	}
+	return ApplySample(ray, expf(-opticalDepth), phase, voxelShadowFactor);
+}
+
+bool CloudRayMarcher::AdvanceInOctree(CloudRayState& ray, int cloudIndex, float phase, float& stepSize, CloudRayMarchStats& stats) const
+{
+	const CloudGPU& cloud = m_scene.clouds[cloudIndex];
+	float minDist = 0.02f;
+	Vec3 voxelHalfSize = m_settings.voxelDimensions * 0.5f;
+
+	// 3) Nearest octree node, in the prototype's space and scaled back to world distances
+	Vec3 prototypePosition = GetPrototypePosition(cloud, ray.position);
+	float minSDF = 100000.f;
+	unsigned int closestNodeIndex = 0xFFFFFFFF;
+	TraverseOctree(cloud.octreeIndex, prototypePosition, minSDF, closestNodeIndex, &ray.counters.numNodesVisited);
+	minSDF *= cloud.scale;
+
+	// 4) Shade the leaf's voxels
+	if (minSDF <= minDist && closestNodeIndex != 0xFFFFFFFF)
+	{
+		const OctreeNodeGPU& node = m_scene.octreeNodes[closestNodeIndex];
+
+		if (node.numChildren == 0)
+		{
+			ray.lastLeafIndex = (int)closestNodeIndex;
+			for (int v = 0; v < node.numElements; ++v)
+			{
+				// A second voxel in the same step needs the first one's transmittance, so that sample can't wait
+				if (ray.hasPendingSample && ResolvePendingSample(ray, expf(-ray.pendingOpticalDepth)))
+				{
+					return true;
+				}
+
+				const Voxel& voxel = m_scene.voxels[node.firstElementIndex + v];
+				stats.numVoxelTests++;
+				ray.counters.numVoxelTests++;
+
+				float distToVoxel = BoxSDF(prototypePosition, voxel.m_position, voxelHalfSize) * cloud.scale;
+				if (distToVoxel < minDist && ShadeVoxel(ray, cloudIndex, voxel, minSDF, phase, stepSize, stats))
+				{
+					return true;
+				}
+			}
+		}
+		else
+		{
+			CloudStepContext stepContext;
+			stepContext.minStep = m_settings.minStepSize * m_settings.voxelDimensions.x;
+			stepContext.minSDF = minSDF;
+			stepContext.distanceTraveled = ray.distanceTraveled;
+			stepContext.transmittance = ray.transmittance;
+			stepContext.baseStep = stepSize;
+			stepContext.nodeDepth = node.depth;
+			stepSize = m_stepPolicy->GetInteriorStep(stepContext);
+		}
+	}
+	return false;
+}
+
+bool CloudRayMarcher::AdvanceInGrid(CloudRayState& ray, int cloudIndex, float phase, float& stepSize, CloudRayMarchStats& stats) const
+{
+	// Clouds overlap, so every cloud the ray is inside counts, the closest one first.
+	// Without intervals that means checking all of them.
+	int candidates[CLOUD_RAY_MAX_INTERVALS + 1];
+	int numCandidates = 0;
+	candidates[numCandidates++] = cloudIndex;
+
+	int numOtherClouds = m_settings.useCloudIntervals ? ray.numIntervals : (int)m_scene.clouds.size();
+	for (int otherIndex = 0; otherIndex < numOtherClouds && numCandidates <= CLOUD_RAY_MAX_INTERVALS; ++otherIndex)
+	{
+		int otherCloudIndex = otherIndex;
+		if (m_settings.useCloudIntervals)
+		{
+			const CloudRayInterval& interval = ray.intervals[otherIndex];
+			if (interval.tEnter > ray.distanceTraveled || interval.tExit < ray.distanceTraveled)
+			{
+				continue;
+			}
+			otherCloudIndex = interval.cloudIndex;
+		}
+
+		if (otherCloudIndex != cloudIndex)
+		{
+			candidates[numCandidates++] = otherCloudIndex;
+		}
+	}
+
+	// O(1) lookup of the cell under the ray. Like the octree path only the closest cloud is shaded; inside another
+	// cloud's voxel the ray keeps the default step, since that cloud may become the closest further on.
+	for (int candidate = 0; candidate < numCandidates; ++candidate)
+	{
+		IntVec3 cell;
+		const CloudGPU& candidateCloud = m_scene.clouds[candidates[candidate]];
+		const VoxelOccupancyGrid& grid = m_occupancyGrids[candidateCloud.prototypeIndex];
+		Vec3 prototypePosition = GetPrototypePosition(candidateCloud, ray.position);
+		if (!grid.FindCell(prototypePosition, cell))
+		{
+			continue;
+		}
+
+		stats.numVoxelTests++;
+		ray.counters.numVoxelTests++;
+		int voxelIndex = grid.GetVoxelIndex(cell);
+		if (voxelIndex < 0)
+		{
+			continue;
+		}
+
+		if (candidate != 0)
+		{
+			return false;
+		}
+
+		const Voxel& voxel = m_scene.voxels[voxelIndex];
+		ray.lastLeafIndex = voxelIndex;
+		float minSDF = BoxSDF(prototypePosition, voxel.m_position, m_settings.voxelDimensions * 0.5f) * candidateCloud.scale;
+		return ShadeVoxel(ray, cloudIndex, voxel, minSDF, phase, stepSize, stats);
+	}
+
+	// Empty cell: DDA to the nearest occupied cell of any of those clouds, or out of the closest one's grid,
+	// nudged past the face so the next step lands inside. Never past another cloud's entry either.
+	float tJump = GetNextCloudEntry(ray, cloudIndex);
+	float tMax = ray.maxDistance - ray.distanceTraveled;
+
+	// The grids are in prototype space, where the scaled direction keeps every t a world distance
+	const CloudGPU& cloud = m_scene.clouds[cloudIndex];
+	float tEnter = 0.f;
+	float tExit = 0.f;
+	if (m_occupancyGrids[cloud.prototypeIndex].IntersectBounds(GetPrototypePosition(cloud, ray.position), GetPrototypeDirection(cloud, ray.direction), tEnter, tExit))
+	{
+		tJump = fminf(tJump, tExit);
+	}
+
+	for (int candidate = 0; candidate < numCandidates; ++candidate)
+	{
+		VoxelGridHit hit;
+		int numCellsVisited = 0;
+		const CloudGPU& candidateCloud = m_scene.clouds[candidates[candidate]];
+		Vec3 prototypePosition = GetPrototypePosition(candidateCloud, ray.position);
+		Vec3 prototypeDirection = GetPrototypeDirection(candidateCloud, ray.direction);
+		if (m_occupancyGrids[candidateCloud.prototypeIndex].FindFirstOccupied(prototypePosition, prototypeDirection, fminf(tJump, tMax), hit, &numCellsVisited))
+		{
+			tJump = hit.tEnter;
+		}
+		stats.numVoxelTests += numCellsVisited;
+		ray.counters.numVoxelTests += numCellsVisited;
+	}
+
+	stepSize = fmaxf(tJump + CLOUD_RAY_MARCH_CELL_NUDGE, CLOUD_RAY_MARCH_CELL_NUDGE);
+	return false;
+}
+
+float CloudRayMarcher::GetNextCloudEntry(const CloudRayState& ray, int currentCloudIndex) const
+{
+	for (int intervalIndex = 0; intervalIndex < ray.numIntervals; ++intervalIndex)
+	{
+		const CloudRayInterval& interval = ray.intervals[intervalIndex];
+		if (interval.cloudIndex != currentCloudIndex && interval.tEnter > ray.distanceTraveled)
+		{
+			return interval.tEnter - ray.distanceTraveled;
+		}
+	}
+	return 100000.f;
+}
+
+void CloudRayMarcher::AdvanceRay(CloudRayState& ray, float minDistCloud, int closestCloudIndex, float phase, CloudRayMarchStats& stats) const
+{
+	float minStep = m_settings.minStepSize * m_settings.voxelDimensions.x;
+
+	stats.numSteps++;
+	ray.counters.numSteps++;
+
+	// 2) Sphere-trace towards the nearest cloud unless we're inside
+	float stepSize = fmaxf(minDistCloud, minStep);
+
+	if (closestCloudIndex >= 0 && minDistCloud < 0.1f)
+	{
+		bool isOpaque = m_settings.useOccupancyGrid ? AdvanceInGrid(ray, closestCloudIndex, phase, stepSize, stats) : AdvanceInOctree(ray, closestCloudIndex, phase, stepSize, stats);
+		if (isOpaque)
+		{
+			return;
+		}
+	}
+
+	// The packet resolves the held-back sample first, since it may end the ray here
+	if (ray.hasPendingSample)
+	{
+		ray.pendingStepSize = stepSize;
+		return;
+	}
+	StepRay(ray, stepSize, stats);
+}
+
+void CloudRayMarcher::StepRay(CloudRayState& ray, float stepSize, CloudRayMarchStats& stats) const
+{
+	// 5) Advance
+	ray.position += ray.direction * stepSize;
+	ray.distanceTraveled += stepSize;
+	ray.isFinished = !(ray.distanceTraveled < ray.maxDistance);
+	if (m_settings.useCloudIntervals && !ray.isFinished)
+	{
+		UpdateCloudIntervals(ray, stats);
+	}
+}
+
+bool CloudRayMarcher::ApplySample(CloudRayState& ray, float transmittanceDecay, float phase, float shadowFactor) const
+{
+	Vec3 scatterColor = Vec3(0.85f, 0.85f, 1.f);
+
+	float alpha = 1.f - transmittanceDecay;
+	if (alpha > 0.f)
+	{
+		ray.firstHitDistance = fminf(ray.firstHitDistance, ray.distanceTraveled);
+	}
+
+	ray.color += scatterColor * (ray.transmittance * alpha * phase * shadowFactor);
+	ray.transmittance *= transmittanceDecay;
+
+	if (ray.transmittance < 0.01f)
+	{
+		ray.isFinished = true;
+		ray.isOpaque = true;
+		return true;
+	}
+	return false;
+}
+
+bool CloudRayMarcher::ResolvePendingSample(CloudRayState& ray, float transmittanceDecay) const
+{
+	ray.hasPendingSample = false;
+	return ApplySample(ray, transmittanceDecay, ray.pendingPhase, ray.pendingShadowFactor);
+}
+
+Vec4 CloudRayMarcher::ResolveRay(const CloudRayState& ray) const
+{
+	if (ray.isOpaque)
+	{
+		return Vec4(ray.color.x, ray.color.y, ray.color.z, 1.f);
+	}
+	return Vec4(Saturate(ray.color.x), Saturate(ray.color.y), Saturate(ray.color.z), 1.f - ray.transmittance);
+}
+
+void CloudRayMarcher::RecordRayCounters(const CloudRayState& ray, CloudRayMarchStats& stats) const
+{
+	stats.stepsPerRay.Record(ray.counters.numSteps);
+	stats.densitySamplesPerRay.Record(ray.counters.numDensitySamples);
+	stats.nodesVisitedPerRay.Record(ray.counters.numNodesVisited);
+	stats.numNodesVisited += ray.counters.numNodesVisited;
+	stats.numEarlyTerminations += ray.isOpaque ? 1 : 0;
+}
+
+Vec4 CloudRayMarcher::MarchRay(const Vec3& rayOrigin, const Vec3& rayDirection, CloudRayMarchStats& stats) const
+{
+	CloudRayState ray = StartRay(rayOrigin, rayDirection);
+	stats.numRays++;
+
+	while (!ray.isFinished)
+	{
+		// 1) Nearest cloud bounding box
+		float minDistCloud = 0.f;
+		int closestCloudIndex = -1;
+		FindClosestCloud(ray, minDistCloud, closestCloudIndex);
+
+		AdvanceRay(ray, minDistCloud, closestCloudIndex, -1.f, stats);
+	}
+
+	RecordRayCounters(ray, stats);
+	return ResolveRay(ray);
+}
+
+//-----------------------------------------------------------------------------------------------
+// Delta tracking (Woodcock): free flights against a majorant, accepted as real collisions with probability
+// extinction / majorant. Leaves bound their density by densityMax, so the expensive noise lookup only happens at
+// tentative collisions instead of every march step.
+float CloudRayMarcher::FindMajorant(unsigned int rootNodeIndex, const Vec3& rayPos, const Vec3& invRayDir, float& regionLength) const
+{
+	const CloudRayMarchSettings& s = m_settings;
+	regionLength = 100000.f;
+
+	unsigned int nodeIndex = rootNodeIndex;
+	for (;;)
+	{
+		const OctreeNodeGPU& node = m_scene.octreeNodes[nodeIndex];
+
+		float tEnter = 0.f;
+		float tExit = 0.f;
+		bool isHit = IntersectBox(rayPos, invRayDir, node.minBounds, node.maxBounds, tEnter, tExit);
+		if (!IsInsideBox(rayPos, node.minBounds, node.maxBounds))
+		{
+			// Only reachable at the root, just outside the cloud bounds: empty until the ray enters
+			regionLength = isHit ? fminf(regionLength, tEnter) : 0.f;
+			return 0.f;
+		}
+		regionLength = fminf(regionLength, tExit);
+
+		if (node.numChildren == 0)
+		{
+			// AccumulateDensity lerps the voxel density towards noise in [0,1], and the falloffs only scale it down
+			if (!s.useDensity)
+			{
+				return s.extinctionCoefficient;
+			}
+			return s.extinctionCoefficient * fmaxf(node.densityMax, 1.f) * s.densityMultiplier;
+		}
+
+		int containingChild = -1;
+		float nextChildEntry = regionLength;
+		for (int childIndex = 0; childIndex < node.numChildren; ++childIndex)
+		{
+			const OctreeNodeGPU& child = m_scene.octreeNodes[node.firstChildIndex + childIndex];
+			if (containingChild < 0 && IsInsideBox(rayPos, child.minBounds, child.maxBounds))
+			{
+				containingChild = node.firstChildIndex + childIndex;
+			}
+			else if (IntersectBox(rayPos, invRayDir, child.minBounds, child.maxBounds, tEnter, tExit) && tEnter > 0.f)
+			{
+				nextChildEntry = fminf(nextChildEntry, tEnter);
+			}
+		}
+
+		// Between children: no voxels until the next child box
+		if (containingChild < 0)
+		{
+			regionLength = nextChildEntry;
+			return 0.f;
+		}
+		nodeIndex = (unsigned int)containingChild;
+	}
+}
+
+bool CloudRayMarcher::SampleTentativeCollision(CloudRayState& walker, float& majorant, CloudRayMarchStats& stats) const
+{
+	Vec3 invRayDir = Vec3(1.f / walker.direction.x, 1.f / walker.direction.y, 1.f / walker.direction.z);
+
+	while (walker.distanceTraveled < walker.maxDistance)
+	{
+		stats.numSteps++;
+		UpdateCloudIntervals(walker, stats);
+
+		// Max over every cloud the walker is in, valid up to the nearest region boundary among them
+		majorant = 0.f;
+		float regionLength = walker.maxDistance - walker.distanceTraveled;
+		for (int intervalIndex = 0; intervalIndex < walker.numIntervals; ++intervalIndex)
+		{
+			const CloudRayInterval& interval = walker.intervals[intervalIndex];
+			if (interval.tEnter > walker.distanceTraveled)
+			{
+				regionLength = fminf(regionLength, interval.tEnter - walker.distanceTraveled);
+				break;
+			}
+			if (interval.tExit <= walker.distanceTraveled)
+			{
+				continue;
+			}
+
+			// In the instance's prototype space; the scaled direction keeps the region length a world distance
+			const CloudGPU& cloud = m_scene.clouds[interval.cloudIndex];
+			float cloudRegionLength = 0.f;
+			float cloudMajorant = FindMajorant(cloud.octreeIndex, GetPrototypePosition(cloud, walker.position), invRayDir * cloud.scale, cloudRegionLength);
+			majorant = fmaxf(majorant, cloudMajorant * cloud.densityScale);
+			regionLength = fminf(regionLength, fminf(cloudRegionLength, interval.tExit - walker.distanceTraveled));
+		}
+
+		float freeFlight = (majorant > 0.f) ? -logf(1.f - NextRandom(walker.rngState)) / majorant : regionLength + 1.f;
+		if (freeFlight < regionLength)
+		{
+			walker.position += walker.direction * freeFlight;
+			walker.distanceTraveled += freeFlight;
+			return true;
+		}
+
+		// Free flights are memoryless, so crossing into the next region just restarts with its majorant
+		float stepSize = regionLength + CLOUD_RAY_MARCH_CELL_NUDGE;
+		walker.position += walker.direction * stepSize;
+		walker.distanceTraveled += stepSize;
+	}
+	return false;
+}
+
+float CloudRayMarcher::EvaluateExtinction(const CloudRayState& walker, CloudRayMarchStats& stats) const
+{
+	// Same cloud and voxel selection as AdvanceInOctree: only the closest cloud contributes
+	float minDistCloud = 0.f;
+	int closestCloudIndex = -1;
+	FindClosestCloudInterval(walker, minDistCloud, closestCloudIndex);
+	if (closestCloudIndex < 0 || minDistCloud >= 0.1f)
+	{
+		return 0.f;
+	}
+
+	return SampleCloudExtinction(closestCloudIndex, walker.position, stats);
+}
+
+float CloudRayMarcher::SampleCloudExtinction(int cloudIndex, const Vec3& position, CloudRayMarchStats& stats) const
+{
+	const CloudGPU& cloud = m_scene.clouds[cloudIndex];
+	Vec3 prototypePosition = GetPrototypePosition(cloud, position);
+	float minDist = 0.02f;
+	float minSDF = 100000.f;
+	unsigned int closestNodeIndex = 0xFFFFFFFF;
+	TraverseOctree(cloud.octreeIndex, prototypePosition, minSDF, closestNodeIndex);
+	minSDF *= cloud.scale;
+	if (minSDF > minDist || closestNodeIndex == 0xFFFFFFFF || m_scene.octreeNodes[closestNodeIndex].numChildren != 0)
+	{
+		return 0.f;
+	}
+
+	const OctreeNodeGPU& node = m_scene.octreeNodes[closestNodeIndex];
+	for (int v = 0; v < node.numElements; ++v)
+	{
+		const Voxel& voxel = m_scene.voxels[node.firstElementIndex + v];
+		stats.numVoxelTests++;
+		if (BoxSDF(prototypePosition, voxel.m_position, m_settings.voxelDimensions * 0.5f) * cloud.scale < minDist)
+		{
+			return m_settings.extinctionCoefficient * ComputeVoxelDensity(position, cloud, voxel, stats);
+		}
+	}
+	return 0.f;
+}
+
+Vec4 CloudRayMarcher::TrackRay(const Vec3& rayOrigin, const Vec3& rayDirection, unsigned int& rngState, CloudRayMarchStats& stats, float* collisionDistance) const
+{
+	CloudRayState walker;
+	walker.origin = rayOrigin;
+	walker.position = rayOrigin;
+	walker.direction = rayDirection;
+	walker.maxDistance = FindSceneDepth(m_scene.occluders, rayOrigin, rayDirection, m_settings.maxDistance);
+	walker.firstHitDistance = walker.maxDistance;
+	walker.rngState = rngState;
+	BuildCloudIntervals(walker);
+	stats.numRays++;
+
+	Vec4 result = Vec4(0.f, 0.f, 0.f, 0.f);
+	float majorant = 0.f;
+	while (SampleTentativeCollision(walker, majorant, stats))
+	{
+		// Tentative collisions that fail the test are null collisions and the flight continues
+		float extinction = EvaluateExtinction(walker, stats);
+		if (NextRandom(walker.rngState) * majorant >= extinction)
+		{
+			continue;
+		}
+
+		float minDistCloud = 0.f;
+		int closestCloudIndex = -1;
+		FindClosestCloudInterval(walker, minDistCloud, closestCloudIndex);
+
+		Vec3 scatterColor = Vec3(0.85f, 0.85f, 1.f);
+		float voxelShadowFactor = m_settings.shadowFactorMin + SampleShadow(walker, closestCloudIndex, stats);
+		Vec3 color = scatterColor * (ComputePhase(walker.position, rayDirection) * voxelShadowFactor);
+		result = Vec4(color.x, color.y, color.z, 1.f);
+		walker.firstHitDistance = walker.distanceTraveled;
+		break;
+	}
+
+	if (collisionDistance != nullptr)
+	{
+		*collisionDistance = walker.firstHitDistance;
+	}
+	rngState = walker.rngState;
+	return result;
+}
+
+// Ratio tracking: the same tentative collisions, but each one scales the transmittance by the null-collision
+// probability instead of terminating. Russian roulette stops walkers that carry little light without adding bias.
+float CloudRayMarcher::EstimateSunTransmittance(const Vec3& rayPos, unsigned int& rngState, CloudRayMarchStats& stats) const
+{
+	CloudRayState walker;
+	walker.origin = rayPos;
+	walker.position = rayPos;
+	walker.direction = (m_sunPosition - rayPos).GetNormalized();
+	walker.maxDistance = m_settings.maxDistance;
+	walker.rngState = rngState;
+	BuildCloudIntervals(walker);
+
+	float transmittance = 1.f;
+	float majorant = 0.f;
+	while (SampleTentativeCollision(walker, majorant, stats))
+	{
+		float extinction = EvaluateExtinction(walker, stats);
+		transmittance *= fmaxf(1.f - extinction / majorant, 0.f);
+
+		if (transmittance < 0.1f)
+		{
+			if (NextRandom(walker.rngState) >= 0.5f)
+			{
+				transmittance = 0.f;
+				break;
+			}
+			transmittance *= 2.f;
+		}
+	}
+
+	rngState = walker.rngState;
+	return transmittance;
+}
+
+// Lane-wise select: mask ? a : b
+static __m128 Select4(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static __m128i Select4(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// Four lanes of BoxSDF
+static __m128 BoxSDF4(__m128 pointX, __m128 pointY, __m128 pointZ, __m128 centerX, __m128 centerY, __m128 centerZ, __m128 halfSizeX,
+	__m128 halfSizeY, __m128 halfSizeZ)
+{
+	const __m128 signMask = _mm_set1_ps(-0.f);
+	const __m128 zero = _mm_setzero_ps();
+
+	__m128 dx = _mm_sub_ps(_mm_andnot_ps(signMask, _mm_sub_ps(pointX, centerX)), halfSizeX);
+	__m128 dy = _mm_sub_ps(_mm_andnot_ps(signMask, _mm_sub_ps(pointY, centerY)), halfSizeY);
+	__m128 dz = _mm_sub_ps(_mm_andnot_ps(signMask, _mm_sub_ps(pointZ, centerZ)), halfSizeZ);
+
+	__m128 ox = _mm_max_ps(dx, zero);
+	__m128 oy = _mm_max_ps(dy, zero);
+	__m128 oz = _mm_max_ps(dz, zero);
+	__m128 outsideDistance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, ox), _mm_mul_ps(oy, oy)), _mm_mul_ps(oz, oz)));
+	__m128 insideDistance = _mm_min_ps(_mm_max_ps(dx, _mm_max_ps(dy, dz)), zero);
+	return _mm_add_ps(outsideDistance, insideDistance);
+}
+
+// Four lanes of expf, Cephes' polynomial: e^x = 2^n * e^r with |r| <= ln(2)/2. Within 2 ulp of expf over the
+// range that matters here; below -87 the result stays at the smallest normal float instead of reaching zero.
+static __m128 Exp4(__m128 x)
+{
+	x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-87.3f)), _mm_set1_ps(88.3f));
+
+	// n = floor(x / ln(2) + 0.5), truncation corrected for negative values
+	__m128 scaled = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f)), _mm_set1_ps(0.5f));
+	__m128 n = _mm_cvtepi32_ps(_mm_cvttps_epi32(scaled));
+	n = _mm_sub_ps(n, _mm_and_ps(_mm_cmpgt_ps(n, scaled), _mm_set1_ps(1.f)));
+
+	// r = x - n ln(2), with ln(2) split in two so the product stays exact
+	x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(0.693359375f)));
+	x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(-2.12194440e-4f)));
+
+	__m128 polynomial = _mm_set1_ps(1.9875691500e-4f);
+	polynomial = _mm_add_ps(_mm_mul_ps(polynomial, x), _mm_set1_ps(1.3981999507e-3f));
+	polynomial = _mm_add_ps(_mm_mul_ps(polynomial, x), _mm_set1_ps(8.3334519073e-3f));
+	polynomial = _mm_add_ps(_mm_mul_ps(polynomial, x), _mm_set1_ps(4.1665795894e-2f));
+	polynomial = _mm_add_ps(_mm_mul_ps(polynomial, x), _mm_set1_ps(1.6666665459e-1f));
+	polynomial = _mm_add_ps(_mm_mul_ps(polynomial, x), _mm_set1_ps(5.0000001201e-1f));
+	polynomial = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(polynomial, x), x), x), _mm_set1_ps(1.f));
+
+	// 2^n straight into the exponent bits
+	__m128i exponent = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127)), 23);
+	return _mm_mul_ps(polynomial, _mm_castsi128_ps(exponent));
+}
+
+// Four lanes of FindClosestCloud without intervals. SSE2 is part of x64, so no dispatch is needed.
+void CloudRayMarcher::FindClosestCloud4(const CloudRayState* rays, const int* lanes, float* minDistCloud, int* closestCloudIndex) const
+{
+	const CloudRayState& ray0 = rays[lanes[0]];
+	const CloudRayState& ray1 = rays[lanes[1]];
+	const CloudRayState& ray2 = rays[lanes[2]];
+	const CloudRayState& ray3 = rays[lanes[3]];
+	const __m128 maxDistance = _mm_set1_ps(m_settings.maxDistance);
+
+	__m128 positionX = _mm_setr_ps(ray0.position.x, ray1.position.x, ray2.position.x, ray3.position.x);
+	__m128 positionY = _mm_setr_ps(ray0.position.y, ray1.position.y, ray2.position.y, ray3.position.y);
+	__m128 positionZ = _mm_setr_ps(ray0.position.z, ray1.position.z, ray2.position.z, ray3.position.z);
+
+	__m128 bestDist = _mm_set1_ps(100000.f);
+	__m128i bestIndex = _mm_set1_epi32(-1);
+
+	for (int cloudIndex = 0; cloudIndex < (int)m_cloudCentersX.size(); ++cloudIndex)
+	{
+		__m128 distToCloud = BoxSDF4(positionX, positionY, positionZ, _mm_set1_ps(m_cloudCentersX[cloudIndex]), _mm_set1_ps(m_cloudCentersY[cloudIndex]),
+			_mm_set1_ps(m_cloudCentersZ[cloudIndex]), _mm_set1_ps(m_cloudHalfSizesX[cloudIndex]), _mm_set1_ps(m_cloudHalfSizesY[cloudIndex]),
+			_mm_set1_ps(m_cloudHalfSizesZ[cloudIndex]));
+
+		// Masked select instead of the scalar continue/branch
+		__m128 isCloser = _mm_and_ps(_mm_cmple_ps(distToCloud, maxDistance), _mm_cmplt_ps(distToCloud, bestDist));
+		bestDist = Select4(isCloser, distToCloud, bestDist);
+		bestIndex = Select4(_mm_castps_si128(isCloser), _mm_set1_epi32(cloudIndex), bestIndex);
+	}
+
+	float bestDistLanes[4];
+	int bestIndexLanes[4];
+	_mm_storeu_ps(bestDistLanes, bestDist);
+	_mm_storeu_si128((__m128i*)bestIndexLanes, bestIndex);
+	for (int lane = 0; lane < 4; ++lane)
+	{
+		minDistCloud[lanes[lane]] = bestDistLanes[lane];
+		closestCloudIndex[lanes[lane]] = bestIndexLanes[lane];
+	}
+}
+
+// Four lanes of FindClosestCloudInterval. Every lane walks its own list, so slot k is gathered from each and the
+// lanes past their first not-yet-entered interval (or their list's end) are masked off until all four are.
+void CloudRayMarcher::FindClosestCloudInterval4(const CloudRayState* rays, const int* lanes, float* minDistCloud, int* closestCloudIndex) const
+{
+	const CloudRayState* lanesRays[4] = { &rays[lanes[0]], &rays[lanes[1]], &rays[lanes[2]], &rays[lanes[3]] };
+
+	int maxIntervals = 0;
+	for (const CloudRayState* ray : lanesRays)
+	{
+		maxIntervals = (ray->numIntervals > maxIntervals) ? ray->numIntervals : maxIntervals;
+	}
+
+	__m128 positionX = _mm_setr_ps(lanesRays[0]->position.x, lanesRays[1]->position.x, lanesRays[2]->position.x, lanesRays[3]->position.x);
+	__m128 positionY = _mm_setr_ps(lanesRays[0]->position.y, lanesRays[1]->position.y, lanesRays[2]->position.y, lanesRays[3]->position.y);
+	__m128 positionZ = _mm_setr_ps(lanesRays[0]->position.z, lanesRays[1]->position.z, lanesRays[2]->position.z, lanesRays[3]->position.z);
+	__m128 distanceTraveled = _mm_setr_ps(lanesRays[0]->distanceTraveled, lanesRays[1]->distanceTraveled, lanesRays[2]->distanceTraveled,
+		lanesRays[3]->distanceTraveled);
+	__m128 entryOffset = _mm_setr_ps(lanesRays[0]->entryOffset, lanesRays[1]->entryOffset, lanesRays[2]->entryOffset, lanesRays[3]->entryOffset);
+	__m128 aheadDistance = _mm_add_ps(distanceTraveled, _mm_set1_ps(0.1f));
+	__m128i numIntervals = _mm_setr_epi32(lanesRays[0]->numIntervals, lanesRays[1]->numIntervals, lanesRays[2]->numIntervals, lanesRays[3]->numIntervals);
+
+	__m128 bestDist = _mm_set1_ps(100000.f);
+	__m128i bestIndex = _mm_set1_epi32(-1);
+	__m128 isSearching = _mm_castsi128_ps(_mm_cmpgt_epi32(numIntervals, _mm_setzero_si128()));
+
+	for (int intervalIndex = 0; intervalIndex < maxIntervals && _mm_movemask_ps(isSearching) != 0; ++intervalIndex)
+	{
+		// Lanes whose list is shorter read cloud 0 and are masked off
+		float tEnterLanes[4];
+		float tExitLanes[4];
+		int cloudLanes[4];
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			bool hasInterval = intervalIndex < lanesRays[lane]->numIntervals;
+			const CloudRayInterval& interval = lanesRays[lane]->intervals[hasInterval ? intervalIndex : 0];
+			tEnterLanes[lane] = hasInterval ? interval.tEnter : 0.f;
+			tExitLanes[lane] = hasInterval ? interval.tExit : 0.f;
+			cloudLanes[lane] = hasInterval ? interval.cloudIndex : 0;
+		}
+
+		__m128 isActive = _mm_and_ps(isSearching, _mm_castsi128_ps(_mm_cmpgt_epi32(numIntervals, _mm_set1_epi32(intervalIndex))));
+		__m128 tEnter = _mm_loadu_ps(tEnterLanes);
+		__m128 tExit = _mm_loadu_ps(tExitLanes);
+		__m128i cloudIndex = _mm_loadu_si128((const __m128i*)cloudLanes);
+
+		// Nothing active yet: the gap to the next entry becomes the step, and the lane stops searching
+		__m128 isAhead = _mm_and_ps(isActive, _mm_cmpgt_ps(tEnter, aheadDistance));
+		__m128 hasNoCloud = _mm_castsi128_ps(_mm_cmplt_epi32(bestIndex, _mm_setzero_si128()));
+		bestDist = Select4(_mm_and_ps(isAhead, hasNoCloud), _mm_sub_ps(_mm_add_ps(tEnter, entryOffset), distanceTraveled), bestDist);
+		isSearching = _mm_andnot_ps(isAhead, isSearching);
+
+		// Inside the interval: nearest box
+		__m128 isInside = _mm_andnot_ps(_mm_or_ps(isAhead, _mm_cmplt_ps(tExit, distanceTraveled)), isActive);
+		if (_mm_movemask_ps(isInside) == 0)
+		{
+			continue;
+		}
+
+		__m128 distToCloud = BoxSDF4(positionX, positionY, positionZ,
+			_mm_setr_ps(m_cloudCentersX[cloudLanes[0]], m_cloudCentersX[cloudLanes[1]], m_cloudCentersX[cloudLanes[2]], m_cloudCentersX[cloudLanes[3]]),
+			_mm_setr_ps(m_cloudCentersY[cloudLanes[0]], m_cloudCentersY[cloudLanes[1]], m_cloudCentersY[cloudLanes[2]], m_cloudCentersY[cloudLanes[3]]),
+			_mm_setr_ps(m_cloudCentersZ[cloudLanes[0]], m_cloudCentersZ[cloudLanes[1]], m_cloudCentersZ[cloudLanes[2]], m_cloudCentersZ[cloudLanes[3]]),
+			_mm_setr_ps(m_cloudHalfSizesX[cloudLanes[0]], m_cloudHalfSizesX[cloudLanes[1]], m_cloudHalfSizesX[cloudLanes[2]], m_cloudHalfSizesX[cloudLanes[3]]),
+			_mm_setr_ps(m_cloudHalfSizesY[cloudLanes[0]], m_cloudHalfSizesY[cloudLanes[1]], m_cloudHalfSizesY[cloudLanes[2]], m_cloudHalfSizesY[cloudLanes[3]]),
+			_mm_setr_ps(m_cloudHalfSizesZ[cloudLanes[0]], m_cloudHalfSizesZ[cloudLanes[1]], m_cloudHalfSizesZ[cloudLanes[2]], m_cloudHalfSizesZ[cloudLanes[3]]));
+
+		__m128 isCloser = _mm_and_ps(isInside, _mm_cmplt_ps(distToCloud, bestDist));
+		bestDist = Select4(isCloser, distToCloud, bestDist);
+		bestIndex = Select4(_mm_castps_si128(isCloser), cloudIndex, bestIndex);
+	}
+
+	float bestDistLanes[4];
+	int bestIndexLanes[4];
+	_mm_storeu_ps(bestDistLanes, bestDist);
+	_mm_storeu_si128((__m128i*)bestIndexLanes, bestIndex);
+	for (int lane = 0; lane < 4; ++lane)
+	{
+		minDistCloud[lanes[lane]] = bestDistLanes[lane];
+		closestCloudIndex[lanes[lane]] = bestIndexLanes[lane];
+	}
+}
+
+// Four lanes of ComputePhase. HG uses d * sqrt(d) for pow(d, 1.5); only powder's arbitrary exponent stays scalar.
+void CloudRayMarcher::ComputePhase4(const CloudRayState* rays, const int* lanes, float* phase) const
+{
+	const CloudRayMarchSettings& s = m_settings;
+	const CloudRayState& ray0 = rays[lanes[0]];
+	const CloudRayState& ray1 = rays[lanes[1]];
+	const CloudRayState& ray2 = rays[lanes[2]];
+	const CloudRayState& ray3 = rays[lanes[3]];
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+
+	__m128 viewX = _mm_setr_ps(ray0.direction.x, ray1.direction.x, ray2.direction.x, ray3.direction.x);
+	__m128 viewY = _mm_setr_ps(ray0.direction.y, ray1.direction.y, ray2.direction.y, ray3.direction.y);
+	__m128 viewZ = _mm_setr_ps(ray0.direction.z, ray1.direction.z, ray2.direction.z, ray3.direction.z);
+
+	// Light direction is -(sun - position), normalized
+	__m128 lightX = _mm_sub_ps(_mm_setr_ps(ray0.position.x, ray1.position.x, ray2.position.x, ray3.position.x), _mm_set1_ps(m_sunPosition.x));
+	__m128 lightY = _mm_sub_ps(_mm_setr_ps(ray0.position.y, ray1.position.y, ray2.position.y, ray3.position.y), _mm_set1_ps(m_sunPosition.y));
+	__m128 lightZ = _mm_sub_ps(_mm_setr_ps(ray0.position.z, ray1.position.z, ray2.position.z, ray3.position.z), _mm_set1_ps(m_sunPosition.z));
+	__m128 lightLength = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(lightX, lightX), _mm_mul_ps(lightY, lightY)), _mm_mul_ps(lightZ, lightZ)));
+	lightX = _mm_div_ps(lightX, lightLength);
+	lightY = _mm_div_ps(lightY, lightLength);
+	lightZ = _mm_div_ps(lightZ, lightLength);
+
+	__m128 cosTheta = _mm_add_ps(_mm_add_ps(_mm_mul_ps(viewX, lightX), _mm_mul_ps(viewY, lightY)), _mm_mul_ps(viewZ, lightZ));
+
+	// Henyey-Greenstein
+	__m128 g = _mm_set1_ps(s.anisotropy);
+	__m128 gSquared = _mm_mul_ps(g, g);
+	__m128 denominator = _mm_sub_ps(_mm_add_ps(one, gSquared), _mm_mul_ps(_mm_add_ps(g, g), cosTheta));
+	__m128 hg = _mm_div_ps(_mm_sub_ps(one, gSquared), _mm_mul_ps(denominator, _mm_sqrt_ps(denominator)));
+
+	// Powder base: saturate(max(dot(normalize(view), light), 0) + bias)
+	__m128 viewLength = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(viewX, viewX), _mm_mul_ps(viewY, viewY)), _mm_mul_ps(viewZ, viewZ)));
+	__m128 dotVL = _mm_div_ps(cosTheta, viewLength);
+	__m128 shiftedDot = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_max_ps(dotVL, zero), _mm_set1_ps(s.powderBias)), zero), one);
+
+	float hgLanes[4];
+	float shiftedDotLanes[4];
+	_mm_storeu_ps(hgLanes, hg);
+	_mm_storeu_ps(shiftedDotLanes, shiftedDot);
+
+	for (int lane = 0; lane < 4; ++lane)
+	{
+		phase[lanes[lane]] = powf(shiftedDotLanes[lane], s.scatteringCoefficient) * hgLanes[lane];
+	}
+}
+
+template <int N>
+void CloudRayMarcher::MarchPacket(CloudRayState* rays, CloudRayMarchStats& stats) const
+{
+	static_assert(N % 4 == 0, "Packets are made of SSE groups of four rays");
+
+	float minDistCloud[N];
+	int closestCloudIndex[N];
+	float phase[N];
+	long long laneKeys[N];		// Cloud and leaf each lane shaded in last step, empty space sorting last
+	int lanes[N + 3];			// Active lanes in key order, padded to whole SSE groups by repeating the last one
+	int pendingLanes[N + 3];
+
+	for (int lane = 0; lane < N; ++lane)
+	{
+		if (!rays[lane].isFinished)
+		{
+			stats.numRays++;
+		}
+		rays[lane].isDeferringSamples = true;
+		laneKeys[lane] = 0;
+	}
+
+	for (;;)
+	{
+		// Split by divergence: finished lanes drop out and the rest are grouped by the cloud and octree leaf they were
+		// in, so an SSE group holds lanes doing the same work, and groups only skipping empty space skip the phase
+		int numActive = 0;
+		for (int lane = 0; lane < N; ++lane)
+		{
+			if (rays[lane].isFinished)
+			{
+				continue;
+			}
+
+			int slot = numActive++;
+			while (slot > 0 && laneKeys[lanes[slot - 1]] > laneKeys[lane])
+			{
+				lanes[slot] = lanes[slot - 1];
+				--slot;
+			}
+			lanes[slot] = lane;
+		}
+
+		if (numActive == 0)
+		{
+			return;
+		}
+
+		// Once three quarters of the packet is done, lockstep only wastes width, so finish the stragglers one at a time
+		if (numActive * 4 <= N)
+		{
+			for (int slot = 0; slot < numActive; ++slot)
+			{
+				CloudRayState& ray = rays[lanes[slot]];
+				ray.isDeferringSamples = false;
+				while (!ray.isFinished)
+				{
+					float rayMinDistCloud = 0.f;
+					int rayClosestCloudIndex = -1;
+					FindClosestCloud(ray, rayMinDistCloud, rayClosestCloudIndex);
+					AdvanceRay(ray, rayMinDistCloud, rayClosestCloudIndex, -1.f, stats);
+				}
+			}
+			return;
+		}
+
+		int numGrouped = (numActive + 3) & ~3;
+		for (int slot = numActive; slot < numGrouped; ++slot)
+		{
+			lanes[slot] = lanes[numActive - 1];
+		}
+
+		// 1) Nearest cloud, from each lane's interval list or from every cloud
+		for (int group = 0; group < numGrouped; group += 4)
+		{
+			if (m_settings.useCloudIntervals)
+			{
+				FindClosestCloudInterval4(rays, lanes + group, minDistCloud, closestCloudIndex);
+			}
+			else
+			{
+				FindClosestCloud4(rays, lanes + group, minDistCloud, closestCloudIndex);
+			}
+		}
+
+		// Powder x Henyey-Greenstein, only for groups with a lane about to shade
+		for (int group = 0; group < numGrouped; group += 4)
+		{
+			bool anyShading = false;
+			for (int slot = group; slot < group + 4; ++slot)
+			{
+				anyShading |= closestCloudIndex[lanes[slot]] >= 0 && minDistCloud[lanes[slot]] < 0.1f;
+			}
+
+			if (anyShading)
+			{
+				ComputePhase4(rays, lanes + group, phase);
+			}
+			else
+			{
+				for (int slot = group; slot < group + 4; ++slot)
+				{
+					phase[lanes[slot]] = -1.f;
+				}
+			}
+		}
+
+		// 2-4) Octree and voxel lookups diverge per ray, so each lane continues on its own; a shaded sample waits
+		int numPending = 0;
+		for (int slot = 0; slot < numActive; ++slot)
+		{
+			int lane = lanes[slot];
+			CloudRayState& ray = rays[lane];
+			AdvanceRay(ray, minDistCloud[lane], closestCloudIndex[lane], phase[lane], stats);
+			if (ray.hasPendingSample)
+			{
+				pendingLanes[numPending++] = lane;
+			}
+
+			bool isShading = closestCloudIndex[lane] >= 0 && minDistCloud[lane] < 0.1f;
+			laneKeys[lane] = isShading ? ((long long)closestCloudIndex[lane] << 32) + (unsigned int)ray.lastLeafIndex : LLONG_MAX;
+		}
+
+		// 5) Beer-Lambert four lanes at a time, then the steps the samples held back
+		for (int first = 0; first < numPending; first += 4)
+		{
+			float opticalDepth[4];
+			for (int lane = 0; lane < 4; ++lane)
+			{
+				int slot = (first + lane < numPending) ? first + lane : numPending - 1;
+				opticalDepth[lane] = rays[pendingLanes[slot]].pendingOpticalDepth;
+			}
+
+			float transmittanceDecay[4];
+			_mm_storeu_ps(transmittanceDecay, Exp4(_mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(opticalDepth))));
+
+			for (int lane = 0; lane < 4 && first + lane < numPending; ++lane)
+			{
+				CloudRayState& ray = rays[pendingLanes[first + lane]];
+				if (!ResolvePendingSample(ray, transmittanceDecay[lane]))
+				{
+					StepRay(ray, ray.pendingStepSize, stats);
+				}
+			}
+		}
+	}
+}
+
+void CloudRayMarcher::Render(const CloudRayMarchCamera& camera, FloatImage& image, int numThreads, FloatImage* depthImage, CloudRayCostMap* costMap)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	int width = image.GetWidth();
+	int height = image.GetHeight();
+	int blockSize = (m_settings.pixelBlockSize > 0) ? m_settings.pixelBlockSize : 1;
+	if (depthImage != nullptr)
+	{
+		depthImage->Resize(width, height);
+	}
+	if (costMap != nullptr)
+	{
+		costMap->Resize(width, height);
+	}
+
+	// Packets cover 2x2 (4 rays) or 4x2 (8 rays) neighbouring blocks
+	bool isDeltaTracking = m_settings.estimator == CloudTransmittanceEstimator::DELTA_TRACKING;
+	int packetSize = isDeltaTracking ? 1 : m_settings.packetSize;
+	int samplesPerPixel = (m_settings.samplesPerPixel > 0) ? m_settings.samplesPerPixel : 1;
+	int packetWidth = (packetSize == 8) ? 4 : ((packetSize == 4) ? 2 : 1);
+	int packetHeight = (packetSize == 8 || packetSize == 4) ? 2 : 1;
+
+	// Rays are per block, tiles are groups of blocks
+	int numBlocksX = (width + blockSize - 1) / blockSize;
+	int numBlocksY = (height + blockSize - 1) / blockSize;
+	int numTilesX = (numBlocksX + CLOUD_RAY_MARCH_TILE_SIZE - 1) / CLOUD_RAY_MARCH_TILE_SIZE;
+	int numTilesY = (numBlocksY + CLOUD_RAY_MARCH_TILE_SIZE - 1) / CLOUD_RAY_MARCH_TILE_SIZE;
+	int numTiles = numTilesX * numTilesY;
+
+	// Tiles are handed out one at a time since empty sky is far cheaper than cloud
+	std::atomic<int> nextTile(0);
+	std::mutex statsMutex;
+	m_stats = CloudRayMarchStats();
+
+	int numWorkers = GetNumWorkerThreads(numThreads);
+	ParallelFor(numWorkers, [&](int, int)
+	{
+		CloudRayMarchStats workerStats;
+		CloudRayState rays[8];
+		int rayBlockX[8];
+		int rayBlockY[8];
+
+		for (int tile = nextTile++; tile < numTiles; tile = nextTile++)
+		{
+			int firstBlockX = (tile % numTilesX) * CLOUD_RAY_MARCH_TILE_SIZE;
+			int firstBlockY = (tile / numTilesX) * CLOUD_RAY_MARCH_TILE_SIZE;
+			int endBlockX = (firstBlockX + CLOUD_RAY_MARCH_TILE_SIZE < numBlocksX) ? firstBlockX + CLOUD_RAY_MARCH_TILE_SIZE : numBlocksX;
+			int endBlockY = (firstBlockY + CLOUD_RAY_MARCH_TILE_SIZE < numBlocksY) ? firstBlockY + CLOUD_RAY_MARCH_TILE_SIZE : numBlocksY;
+
+			for (int packetY = firstBlockY; packetY < endBlockY; packetY += packetHeight)
+			{
+				for (int packetX = firstBlockX; packetX < endBlockX; packetX += packetWidth)
+				{
+					int numRays = 0;
+					for (int blockY = packetY; blockY < packetY + packetHeight; ++blockY)
+					{
+						for (int blockX = packetX; blockX < packetX + packetWidth; ++blockX)
+						{
+							CloudRayState& ray = rays[numRays];
+							rayBlockX[numRays] = blockX;
+							rayBlockY[numRays] = blockY;
+							++numRays;
+
+							// Lanes past the tile edge stay finished and are never written
+							if (blockX >= endBlockX || blockY >= endBlockY)
+							{
+								ray = CloudRayState();
+								ray.isFinished = true;
+								continue;
+							}
+
+							// Same block center and clamping as ComputeMain
+							int centerX = blockX * blockSize + ((m_settings.blockSampleX >= 0) ? m_settings.blockSampleX : blockSize / 2);
+							int centerY = blockY * blockSize + ((m_settings.blockSampleY >= 0) ? m_settings.blockSampleY : blockSize / 2);
+							if (centerX >= width) centerX = width - 1;
+							if (centerY >= height) centerY = height - 1;
+
+							float u = ((float)centerX / (float)width) * 2.f - 1.f;
+							float v = ((float)centerY / (float)height) * 2.f - 1.f;
+							// Delta tracking starts at the camera, like DeltaTrackOctree
+							float jitter = isDeltaTracking ? 0.f : SampleRayJitter(centerX, centerY);
+							ray = StartRay(camera.position, camera.ComputeRayDirection(u, v), jitter);
+							ray.rngState = HashPCG((unsigned int)(blockY * numBlocksX + blockX) ^ HashPCG(m_settings.randomSeed));
+						}
+					}
+
+					if (numRays == 8)
+					{
+						MarchPacket<8>(rays, workerStats);
+					}
+					else if (numRays == 4)
+					{
+						MarchPacket<4>(rays, workerStats);
+					}
+					else if (isDeltaTracking)
+					{
+						// The averaged paths go back into the ray state so ResolveRay treats both estimators alike
+						CloudRayState& ray = rays[0];
+						CloudRayMarchStats statsBefore = workerStats;
+						Vec4 sum = Vec4(0.f, 0.f, 0.f, 0.f);
+						for (int sample = 0; sample < samplesPerPixel && !ray.isFinished; ++sample)
+						{
+							float collisionDistance = ray.maxDistance;
+							Vec4 color = TrackRay(ray.position, ray.direction, ray.rngState, workerStats, &collisionDistance);
+							ray.firstHitDistance = fminf(ray.firstHitDistance, collisionDistance);
+							sum = Vec4(sum.x + color.x, sum.y + color.y, sum.z + color.z, sum.w + color.w);
+						}
+						ray.color = Vec3(sum.x, sum.y, sum.z) / (float)samplesPerPixel;
+						ray.transmittance = 1.f - sum.w / (float)samplesPerPixel;
+
+						// Tracking runs on one ray at a time, so its share of the worker's stats is this pixel's cost,
+						// and it stops at the collision
+						ray.counters.numSteps = (int)(workerStats.numSteps - statsBefore.numSteps);
+						ray.counters.numDensitySamples = (int)(workerStats.numDensityLookups - statsBefore.numDensityLookups);
+						ray.counters.numVoxelTests = (int)(workerStats.numVoxelTests - statsBefore.numVoxelTests);
+						ray.counters.numNoiseSamples = (int)(workerStats.numNoiseSamples - statsBefore.numNoiseSamples);
+						ray.counters.numIntervalRefills = (int)(workerStats.numIntervalRefills - statsBefore.numIntervalRefills);
+						ray.distanceTraveled = ray.firstHitDistance;
+					}
+					else
+					{
+						CloudRayState& ray = rays[0];
+						workerStats.numRays += ray.isFinished ? 0 : 1;
+						while (!ray.isFinished)
+						{
+							float minDistCloud = 0.f;
+							int closestCloudIndex = -1;
+							FindClosestCloud(ray, minDistCloud, closestCloudIndex);
+							AdvanceRay(ray, minDistCloud, closestCloudIndex, -1.f, workerStats);
+						}
+					}
+
+					for (int rayIndex = 0; rayIndex < numRays; ++rayIndex)
+					{
+						if (rayBlockX[rayIndex] >= endBlockX || rayBlockY[rayIndex] >= endBlockY)
+						{
+							continue;
+						}
+
+						if (!isDeltaTracking)
+						{
+							RecordRayCounters(rays[rayIndex], workerStats);
+						}
+
+						Vec4 color = ResolveRay(rays[rayIndex]);
+						int baseX = rayBlockX[rayIndex] * blockSize;
+						int baseY = rayBlockY[rayIndex] * blockSize;
+
+						Vec4 depth = Vec4(rays[rayIndex].firstHitDistance, rays[rayIndex].maxDistance, 0.f, 0.f);
+						float terminationDistance = fminf(rays[rayIndex].distanceTraveled, rays[rayIndex].maxDistance);
+
+						for (int y = baseY; y < baseY + blockSize && y < height; ++y)
+						{
+							for (int x = baseX; x < baseX + blockSize && x < width; ++x)
+							{
+								image.SetPixel(x, y, color);
+								if (depthImage != nullptr)
+								{
+									depthImage->SetPixel(x, y, depth);
+								}
+								if (costMap != nullptr)
+								{
+									costMap->SetPixel(x, y, rays[rayIndex].counters, terminationDistance);
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(statsMutex);
+		m_stats.Add(workerStats);
+	}, numWorkers);
+
+	m_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,328 @@
+#pragma once
+#include "Game/BlueNoise.hpp"
+#include "Game/Octree.hpp"
+#include "Game/FloatImage.hpp"
+#include "Game/VoxelOccupancyGrid.hpp"
+#include <functional>
+#include <memory>
+#include <vector>
+
+class CloudNoiseVolumes;
+class CurlNoiseField;
+class CloudStepPolicy;
+class CloudSunTransmittanceVolumes;
+class CloudRayCostMap;
+
+// Opaque box in the scene the clouds can hide behind: the unit cube [-0.5, 0.5]^3 placed by center and axes.
+// Axes are stored as axis / |axis|^2 so a dot product gives the local coordinate (must match SceneOccluder in
+// CloudShader.hlsl and CloudUpsampleShader.hlsl).
+struct SceneOccluderGPU
+{
+	Vec3 center;
+	Vec3 inverseAxisX;
+	Vec3 inverseAxisY;
+	Vec3 inverseAxisZ;
+};
+
+SceneOccluderGPU MakeSceneOccluder(const Vec3& center, const Vec3& axisX, const Vec3& axisY, const Vec3& axisZ);
+
+// Distance to the nearest occluder along the ray, maxDistance when it misses them all
+float FindSceneDepth(const std::vector<SceneOccluderGPU>& occluders, const Vec3& rayOrigin, const Vec3& rayDirection, float maxDistance);
+
+// The same buffers CloudManager uploads to t0, t1, t4 and t13
+struct CloudRayMarchScene
+{
+	std::vector<CloudGPU> clouds;				// Instances; voxels and octree nodes are in their prototype's space
+	std::vector<CloudGPU> prototypes;
+	std::vector<Voxel> voxels;
+	std::vector<OctreeNodeGPU> octreeNodes;
+	std::vector<SceneOccluderGPU> occluders;	// Rays stop at the nearest one
+};
+
+// How a view ray turns density into color and opacity
+enum class CloudTransmittanceEstimator
+{
+	RAY_MARCH,			// RayMarchOctree's adaptive Beer-Lambert steps
+	DELTA_TRACKING,		// Woodcock free-flight sampling against the octree majorants; unbiased but noisy
+};
+
+// How the ray-march estimator sizes its steps inside clouds (CloudStepPolicy.hpp)
+enum class CloudStepPolicyType
+{
+	SHADER,				// RayMarchOctree: max of the density and distance factors, node depth in interior nodes
+	FIXED,				// minStep everywhere
+	DENSITY_ADAPTIVE,	// Low-density stretch only
+	DISTANCE_ADAPTIVE,	// Far-distance stretch only
+	ERROR_CONTROLLED,	// Largest step within stepErrorTolerance
+};
+
+// The CloudConstants/LightConstants values RayMarchOctree reads. Defaults match the Profiler sliders.
+struct CloudRayMarchSettings
+{
+	Vec3 voxelDimensions = Vec3(20.f, 20.f, 20.f);
+	Vec3 sunDirection = Vec3(0.f, 0.f, -1.f);
+	float timeElapsed = 0.f;
+	bool useDensity = true;
+	bool useNoise = true;
+	bool invertNoise = false;
+	bool scrolling = false;
+	float densityMultiplier = 0.37f;
+	float extinctionCoefficient = 1.f;
+	float scatteringCoefficient = 1.22f;
+	float minStepSize = 0.03f;
+	float noiseScale = 0.8f;
+	float noiseLerpVal = 0.5f;
+	float densityNoiseLerpVal = 0.92f;
+	float cloudVoxelDistanceLerpVal = 0.87f;
+	float minWorleyValue = 0.32f;
+	float noisePowVal = 3.7f;
+	float densityThreshold = 0.f;
+	float scrollFactor = 0.5f;
+	float farDistanceThreshold = 50.f;
+	float farMultiplier = 2.8f;
+	float shadowFactorMin = 0.93f;
+	float powderBias = 0.9f;
+	float anisotropy = 0.01f;
+	float windSpeed = 0.f;
+	float maxDistance = 500.f;
+	int pixelBlockSize = 2;				// ComputeMain marches one ray per 2x2 block and replicates it
+	int blockSampleX = -1;				// Pixel inside each block the ray goes through, -1 = the center like ComputeMain
+	int blockSampleY = -1;
+	int packetSize = 1;					// 1 = one ray at a time, 4 or 8 = neighbouring rays marched in lockstep
+	bool useCloudIntervals = true;		// Slab-tested [tEnter, tExit] per cloud instead of sphere-tracing BoxSDF, like the shaders
+	bool useOccupancyGrid = false;		// Walk each cloud's voxel grid with DDA instead of re-traversing the octree every step
+	CloudTransmittanceEstimator estimator = CloudTransmittanceEstimator::RAY_MARCH;
+	int samplesPerPixel = 1;			// Delta-tracked paths averaged per block; packets don't apply
+	bool useRatioTrackingShadows = false;	// Sun transmittance by ratio tracking through the clouds instead of the shadow lookup
+	unsigned int randomSeed = 0;
+	CloudStepPolicyType stepPolicy = CloudStepPolicyType::SHADER;
+	float stepErrorTolerance = 0.01f;	// Optical depth error per step allowed by the error-controlled policy
+	float maxStepMultiplier = 8.f;		// Error-controlled steps never exceed minStep times this
+};
+
+// Perspective camera in game basis (x forward, y left, z up), vertical field of view
+struct CloudRayMarchCamera
+{
+	Vec3 position;
+	Vec3 forward = Vec3(1.f, 0.f, 0.f);
+	Vec3 left = Vec3(0.f, 1.f, 0.f);
+	Vec3 up = Vec3(0.f, 0.f, 1.f);
+	float fovDegrees = 60.f;
+	float aspect = 2.f;
+
+	// uv in [-1,1] with +y down the screen, same as the compute shader's uv
+	Vec3 ComputeRayDirection(float u, float v) const;
+
+	// Inverse of ComputeRayDirection; false behind the camera
+	bool ProjectToUV(const Vec3& worldPosition, float& u, float& v) const;
+};
+
+constexpr int CLOUD_RAY_HISTOGRAM_BUCKETS = 16;
+
+// Per-ray counts in power-of-two buckets: bucket 0 holds 0, bucket i holds [2^(i-1), 2^i), the last one the rest
+struct CloudRayHistogram
+{
+	long long buckets[CLOUD_RAY_HISTOGRAM_BUCKETS] = {};
+	long long numRays = 0;
+	long long total = 0;
+	int maxValue = 0;
+
+	void Record(int value);
+	void Add(const CloudRayHistogram& other);
+	double GetMean() const { return (numRays > 0) ? (double)total / (double)numRays : 0.0; }
+
+	// Upper bound of the bucket the given fraction of rays falls in, e.g. 0.95 for the 95th percentile
+	int GetPercentile(float fraction) const;
+	static int GetBucketUpperBound(int bucket);
+};
+
+struct CloudRayMarchStats
+{
+	long long numRays = 0;
+	long long numSteps = 0;
+	long long numNoiseSamples = 0;
+	long long numVoxelTests = 0;		// Voxel BoxSDF tests on the octree path, DDA cells visited on the grid path
+	long long numIntervalRefills = 0;	// Interval lists rebuilt because more clouds were on a ray than CLOUD_RAY_MAX_INTERVALS
+	long long numDensityLookups = 0;	// Full voxel density evaluations (noise + falloffs), the cost delta tracking trades against
+	long long numNodesVisited = 0;		// Octree nodes tested by the ray-march estimator
+	long long numEarlyTerminations = 0;	// Rays that went opaque before leaving the clouds
+	double seconds = 0.0;
+
+	// Ray-march estimator only, the one step policies apply to
+	CloudRayHistogram stepsPerRay;
+	CloudRayHistogram densitySamplesPerRay;
+	CloudRayHistogram nodesVisitedPerRay;
+
+	void Add(const CloudRayMarchStats& other);
+};
+
+// Small enough for the shaders to keep in registers; longer lists are rebuilt as the ray goes (MAX_CLOUD_INTERVALS)
+constexpr int CLOUD_RAY_MAX_INTERVALS = 16;
+
+// Stretch of the ray inside one cloud's bounds, from the slab test
+struct CloudRayInterval
+{
+	float tEnter = 0.f;
+	float tExit = 0.f;
+	int cloudIndex = -1;
+};
+
+// What one ray cost, for the histograms in CloudRayMarchStats and the per-pixel CloudRayCostMap
+struct CloudRayCounters
+{
+	int numSteps = 0;
+	int numDensitySamples = 0;
+	int numNodesVisited = 0;
+	int numVoxelTests = 0;
+	int numNoiseSamples = 0;
+	int numIntervalRefills = 0;
+};
+
+// Per-ray march state, shared by the single-ray and packet paths
+struct CloudRayState
+{
+	Vec3 origin;					// Interval distances are measured from here
+	Vec3 position;
+	Vec3 direction;
+	float distanceTraveled = 0.f;
+	float maxDistance = 500.f;		// settings.maxDistance, cut short by the scene depth
+	float firstHitDistance = 500.f;	// Where density first showed up, maxDistance if it never did
+	float transmittance = 1.f;
+	Vec3 color;
+	bool isFinished = false;
+	bool isOpaque = false;			// Hit the early-out, so the color is returned unclamped like the shader does
+	float entryOffset = 0.f;		// Ray-start jitter distance, applied again at every cloud entry the ray jumps to
+
+	// Packets hold back the Beer-Lambert update of the sample shaded this step, so the exponentials run four lanes
+	// at a time (MarchPacket). The rest of the sample is kept here until then.
+	bool isDeferringSamples = false;
+	bool hasPendingSample = false;
+	float pendingOpticalDepth = 0.f;
+	float pendingPhase = 0.f;
+	float pendingShadowFactor = 0.f;
+	float pendingStepSize = 0.f;
+	int lastLeafIndex = -1;			// Octree leaf or grid voxel last shaded, so packets can group lanes doing the same work
+	unsigned int rngState = 1;		// Delta/ratio tracking only
+	float previousDensity = 0.f;	// Last density sample, for the error-controlled step policy
+	float previousDistance = -1.f;
+	CloudRayCounters counters;
+
+	// Sorted by entry, nearest first (BuildCloudIntervals in the shaders)
+	CloudRayInterval intervals[CLOUD_RAY_MAX_INTERVALS];
+	int numIntervals = 0;
+	float intervalRefillDistance = 100000.f;	// Clouds were dropped that may start here, so the list is rebuilt once the ray gets there
+};
+
+// CPU port of RayMarchOctree in CloudShader.hlsl, kept step-for-step identical so it can be profiled,
+// regression-tested and batch-rendered without D3D11.
+class CloudRayMarcher
+{
+public:
+	CloudRayMarcher(const CloudRayMarchScene& scene, const CloudNoiseVolumes& noiseVolumes, const CloudRayMarchSettings& settings);
+
+	// Optional: wind warp (CurlNoiseField, scaled by settings.windSpeed) and the voxel shadow map lookup,
+	// which returns the averaged lit fraction in [0,1]. Without a lookup every sample is treated as lit.
+	void SetWindField(const CurlNoiseField* windField) { m_windField = windField; }
+	void SetShadowLookup(const std::function<float(const Vec3& position)>& shadowLookup) { m_shadowLookup = shadowLookup; }
+
+	// Optional: per-cloud sun transmittance volumes, used instead of the shadow lookup when set (CloudSunTransmittance.hpp)
+	void SetSunTransmittance(const CloudSunTransmittanceVolumes* sunTransmittance) { m_sunTransmittance = sunTransmittance; }
+
+	// Optional: blue-noise ray-start jitter for Render, as SampleRayJitter does it with the same texture and parameters
+	void SetRayJitter(const BlueNoiseTexture* blueNoise, const RayJitterGPU& rayJitter) { m_blueNoise = blueNoise; m_rayJitter = rayJitter; }
+
+	// Replaces the policy settings.stepPolicy picked, e.g. with a custom one being tuned
+	void SetStepPolicy(const std::shared_ptr<const CloudStepPolicy>& stepPolicy) { m_stepPolicy = stepPolicy; }
+	const CloudStepPolicy& GetStepPolicy() const { return *m_stepPolicy; }
+
+	Vec4 MarchRay(const Vec3& rayOrigin, const Vec3& rayDirection, CloudRayMarchStats& stats) const;
+
+	// One delta-tracked path: the first real collision is lit like a marcher sample and returned with alpha 1,
+	// a ray that escapes returns zero. Averages converge to the marcher's result at vanishing step size.
+	// collisionDistance gets the real collision, or the scene depth when the path escapes.
+	Vec4 TrackRay(const Vec3& rayOrigin, const Vec3& rayDirection, unsigned int& rngState, CloudRayMarchStats& stats, float* collisionDistance = nullptr) const;
+
+	// Renders in tiles on all worker threads; the image keeps its size. depthImage, when given, is resized to match
+	// and gets each block's first hit distance in x and scene depth in y, like the bilateral atlas in ComputeMain.
+	// costMap, when given, is resized too and gets each block's ray counters and termination distance.
+	void Render(const CloudRayMarchCamera& camera, FloatImage& image, int numThreads = 0, FloatImage* depthImage = nullptr,
+		CloudRayCostMap* costMap = nullptr);
+
+	const CloudRayMarchStats& GetStats() const { return m_stats; }
+	const CloudRayMarchSettings& GetSettings() const { return m_settings; }
+
+	// Extinction (extinctionCoefficient x density) of one cloud at a point, zero outside its voxels
+	float SampleCloudExtinction(int cloudIndex, const Vec3& position, CloudRayMarchStats& stats) const;
+
+private:
+	// jitter is a fraction of the minimum step to start the ray at
+	CloudRayState StartRay(const Vec3& rayOrigin, const Vec3& rayDirection, float jitter = 0.f) const;
+	float SampleRayJitter(int pixelX, int pixelY) const;
+	// Clouds the ray has left by its distanceTraveled are skipped
+	void BuildCloudIntervals(CloudRayState& ray) const;
+	void UpdateCloudIntervals(CloudRayState& ray, CloudRayMarchStats& stats) const;
+	void FindClosestCloud(const CloudRayState& ray, float& minDistCloud, int& closestCloudIndex) const;
+	void FindClosestCloudInterval(const CloudRayState& ray, float& minDistCloud, int& closestCloudIndex) const;
+
+	// One iteration of the march loop after the cloud search; phase < 0 computes powder x HG on demand. A deferred
+	// sample leaves the step to the caller.
+	void AdvanceRay(CloudRayState& ray, float minDistCloud, int closestCloudIndex, float phase, CloudRayMarchStats& stats) const;
+	void StepRay(CloudRayState& ray, float stepSize, CloudRayMarchStats& stats) const;
+	Vec4 ResolveRay(const CloudRayState& ray) const;
+	void RecordRayCounters(const CloudRayState& ray, CloudRayMarchStats& stats) const;
+
+	// Inside a cloud: find the voxel(s) at the ray position and shade them, or pick the step through empty space.
+	// Return true once the ray is opaque.
+	bool AdvanceInOctree(CloudRayState& ray, int cloudIndex, float phase, float& stepSize, CloudRayMarchStats& stats) const;
+	bool AdvanceInGrid(CloudRayState& ray, int cloudIndex, float phase, float& stepSize, CloudRayMarchStats& stats) const;
+	bool ShadeVoxel(CloudRayState& ray, int cloudIndex, const Voxel& voxel, float minSDF, float& phase, float& stepSize, CloudRayMarchStats& stats) const;
+	// Beer-Lambert and in-scattering for one sample; true once the ray is opaque
+	bool ApplySample(CloudRayState& ray, float transmittanceDecay, float phase, float shadowFactor) const;
+	bool ResolvePendingSample(CloudRayState& ray, float transmittanceDecay) const;
+	float GetNextCloudEntry(const CloudRayState& ray, int currentCloudIndex) const;
+	void BuildOccupancyGrids();
+
+	// Marches N (4 or 8) rays in lockstep: cloud search, phase and Beer-Lambert run in SSE groups of four, octree and
+	// voxel lookups continue per lane. The four-lane helpers read rays[lanes[0..3]] and write their results by lane.
+	template <int N>
+	void MarchPacket(CloudRayState* rays, CloudRayMarchStats& stats) const;
+	void FindClosestCloud4(const CloudRayState* rays, const int* lanes, float* minDistCloud, int* closestCloudIndex) const;
+	void FindClosestCloudInterval4(const CloudRayState* rays, const int* lanes, float* minDistCloud, int* closestCloudIndex) const;
+	void ComputePhase4(const CloudRayState* rays, const int* lanes, float* phase) const;
+
+	float ComputePhase(const Vec3& rayPos, const Vec3& rayDir) const;
+	float SampleNoise(const Vec3& rayPos, CloudRayMarchStats& stats) const;
+	float AccumulateDensity(const Voxel& voxel, float noiseValue) const;
+	void TraverseOctree(unsigned int rootNodeIndex, const Vec3& rayPos, float& minSDF, unsigned int& closestNodeIndex, int* numNodesVisited = nullptr) const;
+	float SampleShadow(CloudRayState& ray, int cloudIndex, CloudRayMarchStats& stats) const;
+	float ComputeVoxelDensity(const Vec3& rayPos, const CloudGPU& cloud, const Voxel& voxel, CloudRayMarchStats& stats) const;
+
+	// Delta/ratio tracking. The majorant is piecewise constant: a leaf's densityMax bound, or zero between children.
+	float FindMajorant(unsigned int rootNodeIndex, const Vec3& rayPos, const Vec3& invRayDir, float& regionLength) const;
+	bool SampleTentativeCollision(CloudRayState& walker, float& majorant, CloudRayMarchStats& stats) const;
+	float EvaluateExtinction(const CloudRayState& walker, CloudRayMarchStats& stats) const;
+	float EstimateSunTransmittance(const Vec3& rayPos, unsigned int& rngState, CloudRayMarchStats& stats) const;
+
+private:
+	const CloudRayMarchScene& m_scene;
+	const CloudNoiseVolumes& m_noiseVolumes;
+	CloudRayMarchSettings m_settings;
+	const CurlNoiseField* m_windField = nullptr;
+	std::function<float(const Vec3& position)> m_shadowLookup;
+	const CloudSunTransmittanceVolumes* m_sunTransmittance = nullptr;
+	const BlueNoiseTexture* m_blueNoise = nullptr;
+	RayJitterGPU m_rayJitter;
+	std::shared_ptr<const CloudStepPolicy> m_stepPolicy;
+	CloudRayMarchStats m_stats;
+	Vec3 m_sunPosition;
+
+	// Cloud boxes as structure-of-arrays for the packet path
+	std::vector<float> m_cloudCentersX;
+	std::vector<float> m_cloudCentersY;
+	std::vector<float> m_cloudCentersZ;
+	std::vector<float> m_cloudHalfSizesX;
+	std::vector<float> m_cloudHalfSizesY;
+	std::vector<float> m_cloudHalfSizesZ;
+
+	std::vector<VoxelOccupancyGrid> m_occupancyGrids;	// Per prototype, in its space, when settings.useOccupancyGrid
+};
@@ -0,0 +1,44 @@
+#include "Game/CloudRendererBufferBackend.hpp"
+#include "Game/GameCommon.hpp"
+#include "Game/GameRenderBackend.hpp"
+#include "Engine/Renderer/Renderer.hpp"
+#include "Engine/Renderer/StructuredBuffer.hpp"
+
+//-----------------------------------------------------------------------------------------------
+RendererCloudBufferBackend::~RendererCloudBufferBackend()
+{
+	for (StructuredBuffer*& buffer : m_buffers)
+	{
+		delete buffer;
+		buffer = nullptr;
+	}
+}
+
+int RendererCloudBufferBackend::CreateBuffer(size_t capacity, size_t elementSize)
+{
+	m_buffers.push_back(g_theRenderBackend->CreateStructuredBuffer(capacity, elementSize, true));
+	return (int)m_buffers.size();
+}
+
+void RendererCloudBufferBackend::DestroyBuffer(int handle)
+{
+	delete m_buffers[handle - 1];
+	m_buffers[handle - 1] = nullptr;
+}
+
+void RendererCloudBufferBackend::UploadRanges(int handle, const void* elements, size_t elementSize, const std::vector<CloudBufferRange>& ranges)
+{
+	if (ranges.empty())
+	{
+		return;
+	}
+
+	size_t numElements = ranges.back().firstElement + ranges.back().numElements;
+	g_theRenderBackend->CopyCPUToGPU(elements, numElements, elementSize, m_buffers[handle - 1]);
+	m_numBytesSent += (long long)(numElements * elementSize);
+}
+
+StructuredBuffer* RendererCloudBufferBackend::GetBuffer(int handle) const
+{
+	return (handle > 0) ? m_buffers[handle - 1] : nullptr;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "Game/CloudGpuBuffers.hpp"
+
+class StructuredBuffer;
+
+// PersistentCloudBuffer backend on g_theRenderBackend's structured buffers
+class RendererCloudBufferBackend : public CloudBufferBackend
+{
+public:
+	RendererCloudBufferBackend() = default;
+	~RendererCloudBufferBackend();
+
+	int CreateBuffer(size_t capacity, size_t elementSize) override;
+	void DestroyBuffer(int handle) override;
+
+	// CopyCPUToGPU always writes from the first element, so the ranges go up as one prefix ending at the last of them
+	void UploadRanges(int handle, const void* elements, size_t elementSize, const std::vector<CloudBufferRange>& ranges) override;
+
+	StructuredBuffer* GetBuffer(int handle) const;
+	long long GetNumBytesSent() const { return m_numBytesSent; }
+
+private:
+	std::vector<StructuredBuffer*> m_buffers;	// Handle - 1, nullptr once destroyed
+	long long m_numBytesSent = 0;
+};
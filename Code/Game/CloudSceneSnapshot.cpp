@@ -0,0 +1,191 @@
+#include "Game/CloudSceneSnapshot.hpp"
+#include "Game/CpuProfiler.hpp"
+#include "Game/CloudRayMarcher.hpp"
+#include <chrono>
+
+//-----------------------------------------------------------------------------------------------
+CloudSceneBuilder::~CloudSceneBuilder()
+{
+	// The job owns copies only, but it must not outlive the builder it reports to
+	if (m_job.valid())
+	{
+		m_job.wait();
+	}
+}
+
+unsigned int CloudSceneBuilder::Request(CloudSceneRequest&& request)
+{
+	m_stats.numRequests++;
+	if (m_hasPendingRequest)
+	{
+		m_stats.numCoalesced++;
+	}
+
+	m_pendingRequest = std::move(request);
+	m_pendingRequestIndex = ++m_numRequests;
+	m_hasPendingRequest = true;
+
+	if (!m_job.valid())
+	{
+		StartPendingRequest();
+	}
+	return m_pendingRequestIndex;
+}
+
+std::shared_ptr<const CloudSceneSnapshot> CloudSceneBuilder::Poll()
+{
+	std::shared_ptr<const CloudSceneSnapshot> newest;
+	if (m_job.valid() && m_job.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+	{
+		Finish(m_job.get(), newest);
+		if (m_hasPendingRequest)
+		{
+			StartPendingRequest();
+		}
+	}
+	return newest;
+}
+
+std::shared_ptr<const CloudSceneSnapshot> CloudSceneBuilder::Wait()
+{
+	std::shared_ptr<const CloudSceneSnapshot> newest;
+	if (!IsBusy())
+	{
+		return newest;
+	}
+
+	PROFILE_SCOPE("CloudSceneBuilder::Wait");
+	m_stats.numBlockingWaits++;
+	auto startTime = std::chrono::high_resolution_clock::now();
+	while (IsBusy())
+	{
+		if (!m_job.valid())
+		{
+			StartPendingRequest();
+		}
+		Finish(m_job.get(), newest);
+	}
+	m_stats.lastWaitSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+	return newest;
+}
+
+void CloudSceneBuilder::StartPendingRequest()
+{
+	m_hasPendingRequest = false;
+	m_pendingRequest.previousSnapshot = m_newestSnapshot;
+	m_job = std::async(std::launch::async, &CloudSceneBuilder::Build, std::move(m_pendingRequest), m_pendingRequestIndex);
+	m_pendingRequest = CloudSceneRequest();
+}
+
+void CloudSceneBuilder::Finish(std::shared_ptr<const CloudSceneSnapshot> snapshot, std::shared_ptr<const CloudSceneSnapshot>& newest)
+{
+	m_stats.numBuilds++;
+	m_stats.lastBuildSeconds = snapshot->buildSeconds;
+	m_newestSnapshot = snapshot;
+	newest = snapshot;
+}
+
+//-----------------------------------------------------------------------------------------------
+std::shared_ptr<const CloudSceneSnapshot> CloudSceneBuilder::Build(CloudSceneRequest request, unsigned int requestIndex)
+{
+	CpuProfiler::Get().SetThreadName("Scene Build");
+	PROFILE_SCOPE("CloudSceneBuilder::Build");
+	auto startTime = std::chrono::high_resolution_clock::now();
+	std::shared_ptr<CloudSceneSnapshot> snapshot = std::make_shared<CloudSceneSnapshot>();
+	snapshot->voxelDimensions = request.voxelDimensions;
+	snapshot->requestIndex = requestIndex;
+
+	// The octrees point into the prototypes' voxels, which the request keeps alive until they are serialized. Every
+	// prototype gets a fresh tree; nothing carries over from the previous snapshot. Instances only add a CloudGPU.
+	std::vector<std::unique_ptr<Octree<Voxel>>> octrees;
+	std::vector<int> octreeIndices;
+	octrees.reserve(request.prototypes.size());
+
+	{
+		PROFILE_SCOPE("Octree Build");
+		int octreeIndex = 0;
+		for (const std::shared_ptr<const Cloud>& prototype : request.prototypes)
+		{
+			octreeIndices.push_back(octreeIndex);
+			octrees.push_back(std::make_unique<Octree<Voxel>>(prototype->boundingBox, DefaultGetDensity<Voxel>()));
+			octrees.back()->Build(prototype->GetVoxels(), request.voxelDimensions);
+			octreeIndex += (int)octrees.back()->GetAllChildrenSize();
+		}
+	}
+
+	std::vector<unsigned int> voxelOffsets;
+	{
+		PROFILE_SCOPE("Serialize");
+		SerializeOctrees(octrees, snapshot->octreeNodes, snapshot->voxels, voxelOffsets);
+	}
+
+	unsigned int densityOffset = 0;
+	snapshot->prototypes.reserve(request.prototypes.size());
+	for (int prototypeIndex = 0; prototypeIndex < (int)request.prototypes.size(); ++prototypeIndex)
+	{
+		unsigned int voxelOffset = voxelOffsets[prototypeIndex];
+		CloudGPU prototypeGPU = request.prototypes[prototypeIndex]->GetCloudGPU(voxelOffset, densityOffset);
+		prototypeGPU.octreeIndex = octreeIndices[prototypeIndex];
+		prototypeGPU.voxelOffset = voxelOffsets[prototypeIndex];
+		prototypeGPU.voxelCount = voxelOffsets[prototypeIndex + 1] - voxelOffsets[prototypeIndex];
+		prototypeGPU.prototypeIndex = (unsigned int)prototypeIndex;
+		snapshot->prototypes.push_back(prototypeGPU);
+	}
+
+	snapshot->clouds.reserve(request.instances.size());
+	for (const CloudInstance& instance : request.instances)
+	{
+		snapshot->clouds.push_back(MakeCloudInstanceGPU(snapshot->prototypes[instance.prototypeIndex], instance));
+	}
+
+	if (request.noiseVolumes != nullptr && !snapshot->clouds.empty())
+	{
+		PROFILE_SCOPE("Sun Transmittance");
+		// The marcher reads a CloudRayMarchScene, so the voxels and nodes are lent to one and handed back after
+		CloudRayMarchScene scene;
+		scene.clouds = snapshot->clouds;
+		scene.prototypes = snapshot->prototypes;
+		scene.voxels.swap(snapshot->voxels);
+		scene.octreeNodes.swap(snapshot->octreeNodes);
+
+		CloudRayMarcher marcher(scene, *request.noiseVolumes, request.raySettings);
+		marcher.SetWindField(request.windField);
+		snapshot->sunTransmittance.Build(scene, marcher, request.sunConfig, requestIndex);
+
+		snapshot->voxels.swap(scene.voxels);
+		snapshot->octreeNodes.swap(scene.octreeNodes);
+	}
+
+	if (request.previousSnapshot)
+	{
+		PROFILE_SCOPE("Buffer Ranges");
+		const CloudSceneSnapshot& previous = *request.previousSnapshot;
+		snapshot->baseRequestIndex = previous.requestIndex;
+		size_t mergeGap = PersistentCloudBuffer::DEFAULT_MERGE_GAP;
+		PersistentCloudBuffer::FindChangedRanges(previous.clouds.data(), previous.clouds.size(), snapshot->clouds.data(), snapshot->clouds.size(),
+			sizeof(CloudGPU), mergeGap, snapshot->cloudRanges);
+		PersistentCloudBuffer::FindChangedRanges(previous.voxels.data(), previous.voxels.size(), snapshot->voxels.data(), snapshot->voxels.size(),
+			sizeof(Voxel), mergeGap, snapshot->voxelRanges);
+		PersistentCloudBuffer::FindChangedRanges(previous.octreeNodes.data(), previous.octreeNodes.size(), snapshot->octreeNodes.data(),
+			snapshot->octreeNodes.size(), sizeof(OctreeNodeGPU), mergeGap, snapshot->octreeNodeRanges);
+	}
+
+	snapshot->buildSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+	return snapshot;
+}
+
+void CloudSceneBuilder::SerializeOctrees(const std::vector<std::unique_ptr<Octree<Voxel>>>& octrees, std::vector<OctreeNodeGPU>& gpuNodes,
+	std::vector<Voxel>& gpuVoxels, std::vector<unsigned int>& voxelOffsets)
+{
+	gpuNodes.clear();
+	gpuVoxels.clear();
+	voxelOffsets.clear();
+
+	for (const auto& octree : octrees) {
+		// Unique voxels by position, per prototype: every prototype sits at the origin, so theirs overlap
+		std::unordered_map<Vec3, int, Vec3Hasher> voxelMap;
+		voxelOffsets.push_back((unsigned int)gpuVoxels.size());
+		octree->SerializeToGPU(gpuNodes, gpuVoxels, voxelMap);
+	}
+	voxelOffsets.push_back((unsigned int)gpuVoxels.size());
+}
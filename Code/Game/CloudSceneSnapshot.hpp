@@ -0,0 +1,102 @@
+#pragma once
+#include "Game/Cloud.hpp"
+#include "Game/CloudGpuBuffers.hpp"
+#include "Game/CloudPrototype.hpp"
+#include "Game/CloudSunTransmittance.hpp"
+#include "Game/Octree.hpp"
+#include <future>
+#include <memory>
+#include <vector>
+
+// Everything the renderer and the CPU marcher read about the cloud scene, built once and never changed after.
+// The buffers are uploaded from it when it becomes current, and the previous one stays in use until then.
+struct CloudSceneSnapshot
+{
+	std::vector<CloudGPU> clouds;			// One per instance
+	std::vector<CloudGPU> prototypes;		// In prototype space; the instances share their voxels and octrees
+	std::vector<OctreeNodeGPU> octreeNodes;
+	std::vector<Voxel> voxels;
+	Vec3 voxelDimensions;
+	unsigned int requestIndex = 0;		// Which CloudSceneBuilder::Request produced it
+	double buildSeconds = 0.0;
+
+	// Built with the scene when the request had noise volumes; otherwise never built
+	CloudSunTransmittanceVolumes sunTransmittance;
+
+	// What the persistent buffers send to go from baseRequestIndex's snapshot to this one, so the frame that applies
+	// it doesn't compare the arrays. 0 when there was no earlier snapshot.
+	unsigned int baseRequestIndex = 0;
+	std::vector<CloudBufferRange> cloudRanges;
+	std::vector<CloudBufferRange> voxelRanges;
+	std::vector<CloudBufferRange> octreeNodeRanges;
+};
+
+// What a rebuild starts from. The prototypes are the library's, which never change once generated; everything else
+// is a copy, apart from the noise volumes and wind field, which are baked once at startup and outlive the builder.
+struct CloudSceneRequest
+{
+	std::vector<std::shared_ptr<const Cloud>> prototypes;
+	std::vector<CloudInstance> instances;
+	Vec3 voxelDimensions;
+
+	// Sun transmittance at these settings; null noise volumes leave it unbuilt
+	const CloudNoiseVolumes* noiseVolumes = nullptr;
+	const CurlNoiseField* windField = nullptr;
+	CloudRayMarchSettings raySettings;
+	CloudSunTransmittanceConfig sunConfig;
+
+	// The newest snapshot when the job starts, for the buffer ranges; set by the builder
+	std::shared_ptr<const CloudSceneSnapshot> previousSnapshot;
+};
+
+struct CloudSceneBuildStats
+{
+	int numRequests = 0;
+	int numBuilds = 0;
+	int numCoalesced = 0;				// Requests replaced by a newer one before they started
+	int numBlockingWaits = 0;			// Frames that waited for a build instead of keeping the previous scene
+	double lastBuildSeconds = 0.0;		// On the job thread
+	double lastWaitSeconds = 0.0;		// On the frame, last blocking wait only
+};
+
+// Runs octree builds, serialization, the sun transmittance and the buffer diffs on one background job. A request while a job is running
+// waits for it, and only the newest waiting request is kept. The frame polls for finished snapshots.
+class CloudSceneBuilder
+{
+public:
+	CloudSceneBuilder() = default;
+	CloudSceneBuilder(const CloudSceneBuilder& copy) = delete;
+	~CloudSceneBuilder();
+
+	// Returns the request index the snapshot will carry
+	unsigned int Request(CloudSceneRequest&& request);
+
+	// The newest finished snapshot since the last call, or nullptr; starts the waiting request if there is one
+	std::shared_ptr<const CloudSceneSnapshot> Poll();
+
+	// Blocks until nothing is running or waiting, and returns the newest snapshot like Poll
+	std::shared_ptr<const CloudSceneSnapshot> Wait();
+
+	bool IsBusy() const { return m_job.valid() || m_hasPendingRequest; }
+	const CloudSceneBuildStats& GetStats() const { return m_stats; }
+
+	// The whole rebuild, on whichever thread calls it
+	static std::shared_ptr<const CloudSceneSnapshot> Build(CloudSceneRequest request, unsigned int requestIndex);
+
+	// Octree nodes of every prototype back to back, with the voxels they index. Each prototype's voxels are one
+	// contiguous range; voxelOffsets gets where each starts.
+	static void SerializeOctrees(const std::vector<std::unique_ptr<Octree<Voxel>>>& octrees, std::vector<OctreeNodeGPU>& gpuNodes,
+		std::vector<Voxel>& gpuVoxels, std::vector<unsigned int>& voxelOffsets);
+
+private:
+	void StartPendingRequest();
+	void Finish(std::shared_ptr<const CloudSceneSnapshot> snapshot, std::shared_ptr<const CloudSceneSnapshot>& newest);
+
+	std::future<std::shared_ptr<const CloudSceneSnapshot>> m_job;
+	CloudSceneRequest m_pendingRequest;
+	std::shared_ptr<const CloudSceneSnapshot> m_newestSnapshot;
+	bool m_hasPendingRequest = false;
+	unsigned int m_pendingRequestIndex = 0;
+	unsigned int m_numRequests = 0;
+	CloudSceneBuildStats m_stats;
+};
@@ -0,0 +1,90 @@
+#include "Game/CloudStepPolicy.hpp"
+#include <cmath>
+
+// Local constants in RayMarchOctree (the second one shadows the cbuffer's densityMultiplier there)
+constexpr float STEP_LOW_DENSITY_THRESHOLD = 0.1f;
+constexpr float STEP_LOW_DENSITY_MULTIPLIER = 2.f;
+constexpr float STEP_MAX_OPTICAL_DEPTH = 0.5f;			// Per step, for the error-controlled policy
+
+//-----------------------------------------------------------------------------------------------
+float CloudStepPolicy::GetInteriorStep(const CloudStepContext& context) const
+{
+	return (context.nodeDepth != 0) ? context.baseStep * (float)context.nodeDepth : context.baseStep;
+}
+
+float CloudStepPolicy::GetDensityFactor(float density) const
+{
+	return (density < STEP_LOW_DENSITY_THRESHOLD) ? STEP_LOW_DENSITY_MULTIPLIER : 1.f;
+}
+
+float CloudStepPolicy::GetDistanceFactor(float distanceTraveled) const
+{
+	float t = distanceTraveled / m_settings.farDistanceThreshold;
+	t = (t < 0.f) ? 0.f : ((t > 1.f) ? 1.f : t);
+	return 1.f + (m_settings.farMultiplier - 1.f) * t;
+}
+
+//-----------------------------------------------------------------------------------------------
+float ShaderStepPolicy::GetSampleStep(const CloudStepContext& context) const
+{
+	return fmaxf(context.minSDF, context.minStep) * fmaxf(GetDensityFactor(context.density), GetDistanceFactor(context.distanceTraveled));
+}
+
+float FixedStepPolicy::GetSampleStep(const CloudStepContext& context) const
+{
+	return context.minStep;
+}
+
+float FixedStepPolicy::GetInteriorStep(const CloudStepContext& context) const
+{
+	return context.baseStep;
+}
+
+float DensityAdaptiveStepPolicy::GetSampleStep(const CloudStepContext& context) const
+{
+	return fmaxf(context.minSDF, context.minStep) * GetDensityFactor(context.density);
+}
+
+float DistanceAdaptiveStepPolicy::GetSampleStep(const CloudStepContext& context) const
+{
+	return fmaxf(context.minSDF, context.minStep) * GetDistanceFactor(context.distanceTraveled);
+}
+
+float ErrorControlledStepPolicy::GetSampleStep(const CloudStepContext& context) const
+{
+	float maxStep = context.minStep * m_settings.maxStepMultiplier;
+	if (context.previousDistance < 0.f)
+	{
+		return context.minStep;
+	}
+
+	// Each sample's density is held over its whole step, so a density slope leaves an optical depth error of
+	// about extinction * |slope| * step^2 / 2
+	float tolerance = m_settings.stepErrorTolerance / fmaxf(context.transmittance, 0.05f);
+	float separation = fmaxf(context.distanceTraveled - context.previousDistance, 1e-3f);
+	float densitySlope = fabsf(context.density - context.previousDensity) / separation;
+	float extinctionSlope = m_settings.extinctionCoefficient * densitySlope;
+
+	float step = (extinctionSlope > 0.f) ? sqrtf(2.f * tolerance / extinctionSlope) : maxStep;
+
+	// Flat but dense: cap the optical depth of a single step so cores aren't crossed in one go
+	float extinction = m_settings.extinctionCoefficient * context.density;
+	if (extinction > 0.f)
+	{
+		step = fminf(step, STEP_MAX_OPTICAL_DEPTH / extinction);
+	}
+	return fminf(fmaxf(step, context.minStep), maxStep);
+}
+
+//-----------------------------------------------------------------------------------------------
+std::shared_ptr<const CloudStepPolicy> CreateCloudStepPolicy(const CloudRayMarchSettings& settings)
+{
+	switch (settings.stepPolicy)
+	{
+	case CloudStepPolicyType::FIXED:				return std::make_shared<FixedStepPolicy>(settings);
+	case CloudStepPolicyType::DENSITY_ADAPTIVE:		return std::make_shared<DensityAdaptiveStepPolicy>(settings);
+	case CloudStepPolicyType::DISTANCE_ADAPTIVE:	return std::make_shared<DistanceAdaptiveStepPolicy>(settings);
+	case CloudStepPolicyType::ERROR_CONTROLLED:		return std::make_shared<ErrorControlledStepPolicy>(settings);
+	default:										return std::make_shared<ShaderStepPolicy>(settings);
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "Game/CloudRayMarcher.hpp"
+#include <memory>
+
+// What a policy sees when it picks the next step inside a cloud
+struct CloudStepContext
+{
+	float minStep = 0.f;				// minStepSize * voxel width
+	float minSDF = 0.f;					// Distance to the nearest octree node (negative inside)
+	float density = 0.f;				// This sample's density, after the falloffs
+	float distanceTraveled = 0.f;
+	float transmittance = 1.f;			// Before this sample
+	float previousDensity = 0.f;		// Last density sample on this ray
+	float previousDistance = -1.f;		// Where it was taken, negative before the first one
+	float baseStep = 0.f;				// Interior nodes: the sphere-traced step RayMarchOctree starts from
+	int nodeDepth = 0;					// Interior nodes: the node's depth in its octree
+};
+
+// Picks the march step inside clouds. RayMarchOctree's rules are one policy among several, so their cost and error
+// can be measured against each other with the per-ray counters in CloudRayMarchStats.
+class CloudStepPolicy
+{
+public:
+	explicit CloudStepPolicy(const CloudRayMarchSettings& settings) : m_settings(settings) {}
+	virtual ~CloudStepPolicy() = default;
+
+	virtual const char* GetName() const = 0;
+
+	// Step after a density sample; it is also the length that sample's Beer-Lambert term integrates over
+	virtual float GetSampleStep(const CloudStepContext& context) const = 0;
+
+	// Step while near, but not inside, an interior node. RayMarchOctree scales the step by the node's depth.
+	virtual float GetInteriorStep(const CloudStepContext& context) const;
+
+protected:
+	float GetDensityFactor(float density) const;
+	float GetDistanceFactor(float distanceTraveled) const;
+
+protected:
+	CloudRayMarchSettings m_settings;
+};
+
+// RayMarchOctree as written: max of the density and distance factors
+class ShaderStepPolicy : public CloudStepPolicy
+{
+public:
+	using CloudStepPolicy::CloudStepPolicy;
+	const char* GetName() const override { return "shader"; }
+	float GetSampleStep(const CloudStepContext& context) const override;
+};
+
+// minStep everywhere, interior nodes included; the slow baseline the others are judged against
+class FixedStepPolicy : public CloudStepPolicy
+{
+public:
+	using CloudStepPolicy::CloudStepPolicy;
+	const char* GetName() const override { return "fixed"; }
+	float GetSampleStep(const CloudStepContext& context) const override;
+	float GetInteriorStep(const CloudStepContext& context) const override;
+};
+
+// Only the low-density stretch
+class DensityAdaptiveStepPolicy : public CloudStepPolicy
+{
+public:
+	using CloudStepPolicy::CloudStepPolicy;
+	const char* GetName() const override { return "density"; }
+	float GetSampleStep(const CloudStepContext& context) const override;
+};
+
+// Only the far-distance stretch
+class DistanceAdaptiveStepPolicy : public CloudStepPolicy
+{
+public:
+	using CloudStepPolicy::CloudStepPolicy;
+	const char* GetName() const override { return "distance"; }
+	float GetSampleStep(const CloudStepContext& context) const override;
+};
+
+// Largest step whose error stays under stepErrorTolerance: the density's rate of change along the ray bounds the
+// optical depth error, and the tolerance loosens as transmittance drops since less of the sample reaches the eye
+class ErrorControlledStepPolicy : public CloudStepPolicy
+{
+public:
+	using CloudStepPolicy::CloudStepPolicy;
+	const char* GetName() const override { return "error"; }
+	float GetSampleStep(const CloudStepContext& context) const override;
+};
+
+std::shared_ptr<const CloudStepPolicy> CreateCloudStepPolicy(const CloudRayMarchSettings& settings);
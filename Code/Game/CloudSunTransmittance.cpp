@@ -0,0 +1,275 @@
+#include "Game/CloudSunTransmittance.hpp"
+#include "Game/ParallelFor.hpp"
+#include <chrono>
+#include <cmath>
+
+constexpr float SUN_TRANSMITTANCE_DIRECTION_EPSILON = 1e-5f;
+
+//-----------------------------------------------------------------------------------------------
+static float GetAxis(const Vec3& vec, int axis)
+{
+	return (axis == 0) ? vec.x : ((axis == 1) ? vec.y : vec.z);
+}
+
+static float ClampFloat(float value, float minValue, float maxValue)
+{
+	return (value < minValue) ? minValue : ((value > maxValue) ? maxValue : value);
+}
+
+static int GetNumCells(const SunTransmittanceVolumeGPU& volume)
+{
+	return volume.numCellsX * volume.numCellsY * volume.numCellsZ;
+}
+
+// Everything ComputeVoxelDensity and the extinction read, apart from the scroll time
+static bool HaveDensitySettingsChanged(const CloudRayMarchSettings& a, const CloudRayMarchSettings& b)
+{
+	return !(a.voxelDimensions == b.voxelDimensions) || a.useDensity != b.useDensity || a.useNoise != b.useNoise || a.invertNoise != b.invertNoise
+		|| a.scrolling != b.scrolling || a.densityMultiplier != b.densityMultiplier || a.extinctionCoefficient != b.extinctionCoefficient
+		|| a.noiseScale != b.noiseScale || a.noiseLerpVal != b.noiseLerpVal || a.densityNoiseLerpVal != b.densityNoiseLerpVal
+		|| a.cloudVoxelDistanceLerpVal != b.cloudVoxelDistanceLerpVal || a.minWorleyValue != b.minWorleyValue || a.noisePowVal != b.noisePowVal
+		|| a.densityThreshold != b.densityThreshold;
+}
+
+static bool HaveConfigsChanged(const CloudSunTransmittanceConfig& a, const CloudSunTransmittanceConfig& b)
+{
+	return a.cellsPerVoxel != b.cellsPerVoxel || a.maxCellsPerAxis != b.maxCellsPerAxis || a.samplesPerAxis != b.samplesPerAxis;
+}
+
+//-----------------------------------------------------------------------------------------------
+void CloudSunTransmittanceVolumes::Build(const CloudRayMarchScene& scene, const CloudRayMarcher& marcher, const CloudSunTransmittanceConfig& config, unsigned int sceneVersion)
+{
+	const CloudRayMarchSettings& settings = marcher.GetSettings();
+	bool isDensityDirty = !m_isBuilt || sceneVersion != m_builtSceneVersion || m_volumes.size() != scene.clouds.size()
+		|| HaveDensitySettingsChanged(settings, m_builtSettings) || HaveConfigsChanged(config, m_builtConfig);
+
+	// The extinction only depends on the density, so a sun that moved just re-sweeps m_extinction
+	if (isDensityDirty)
+	{
+		std::chrono::steady_clock::time_point extinctionStart = std::chrono::steady_clock::now();
+
+		m_volumes.resize(scene.clouds.size());
+		int numCells = 0;
+		for (int cloudIndex = 0; cloudIndex < (int)scene.clouds.size(); ++cloudIndex)
+		{
+			const CloudGPU& cloud = scene.clouds[cloudIndex];
+			Vec3 extent = cloud.maxBounds - cloud.minBounds;
+			int cells[3];
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				int numCellsOnAxis = (int)ceilf(GetAxis(extent, axis) / GetAxis(settings.voxelDimensions, axis) * config.cellsPerVoxel);
+				cells[axis] = (numCellsOnAxis < 1) ? 1 : ((numCellsOnAxis > config.maxCellsPerAxis) ? config.maxCellsPerAxis : numCellsOnAxis);
+			}
+
+			SunTransmittanceVolumeGPU& volume = m_volumes[cloudIndex];
+			volume.minBounds = cloud.minBounds;
+			volume.firstCell = numCells;
+			volume.inverseCellSize = Vec3((float)cells[0] / extent.x, (float)cells[1] / extent.y, (float)cells[2] / extent.z);
+			volume.numCellsX = cells[0];
+			volume.numCellsY = cells[1];
+			volume.numCellsZ = cells[2];
+			numCells += GetNumCells(volume);
+		}
+
+		// Average extinction per cell
+		m_extinction.assign((size_t)numCells, 0.f);
+		m_transmittance.assign((size_t)numCells, 1.f);
+		int samplesPerAxis = (config.samplesPerAxis > 0) ? config.samplesPerAxis : 1;
+		float sampleWeight = 1.f / (float)(samplesPerAxis * samplesPerAxis * samplesPerAxis);
+
+		std::vector<int> cellClouds((size_t)numCells);
+		for (int cloudIndex = 0; cloudIndex < (int)m_volumes.size(); ++cloudIndex)
+		{
+			for (int cell = 0; cell < GetNumCells(m_volumes[cloudIndex]); ++cell)
+			{
+				cellClouds[(size_t)(m_volumes[cloudIndex].firstCell + cell)] = cloudIndex;
+			}
+		}
+
+		ParallelFor(numCells, [&](int begin, int end)
+		{
+			CloudRayMarchStats samplingStats;
+			for (int cellIndex = begin; cellIndex < end; ++cellIndex)
+			{
+				const SunTransmittanceVolumeGPU& volume = m_volumes[cellClouds[cellIndex]];
+				int localIndex = cellIndex - volume.firstCell;
+				int x = localIndex % volume.numCellsX;
+				int y = (localIndex / volume.numCellsX) % volume.numCellsY;
+				int z = localIndex / (volume.numCellsX * volume.numCellsY);
+				Vec3 cellSize = Vec3(1.f / volume.inverseCellSize.x, 1.f / volume.inverseCellSize.y, 1.f / volume.inverseCellSize.z);
+
+				float extinctionSum = 0.f;
+				for (int sampleZ = 0; sampleZ < samplesPerAxis; ++sampleZ)
+				{
+					for (int sampleY = 0; sampleY < samplesPerAxis; ++sampleY)
+					{
+						for (int sampleX = 0; sampleX < samplesPerAxis; ++sampleX)
+						{
+							Vec3 position = volume.minBounds + Vec3(cellSize.x * ((float)x + ((float)sampleX + 0.5f) / (float)samplesPerAxis),
+								cellSize.y * ((float)y + ((float)sampleY + 0.5f) / (float)samplesPerAxis),
+								cellSize.z * ((float)z + ((float)sampleZ + 0.5f) / (float)samplesPerAxis));
+							extinctionSum += marcher.SampleCloudExtinction(cellClouds[cellIndex], position, samplingStats);
+						}
+					}
+				}
+				m_extinction[cellIndex] = extinctionSum * sampleWeight;
+			}
+		}, config.numThreads);
+
+		m_stats.numCells = numCells;
+		m_stats.numExtinctionSamples = (long long)numCells * samplesPerAxis * samplesPerAxis * samplesPerAxis;
+		m_stats.extinctionSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - extinctionStart).count();
+	}
+
+	std::chrono::steady_clock::time_point sweepStart = std::chrono::steady_clock::now();
+	Vec3 directionToSun = settings.sunDirection.GetNormalized() * -1.f;
+	ParallelFor((int)m_volumes.size(), [&](int begin, int end)
+	{
+		for (int cloudIndex = begin; cloudIndex < end; ++cloudIndex)
+		{
+			SweepCloud(cloudIndex, directionToSun);
+		}
+	}, config.numThreads);
+	m_stats.sweepSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - sweepStart).count();
+
+	m_isBuilt = true;
+	m_builtSettings = settings;
+	m_builtConfig = config;
+	m_builtSceneVersion = sceneVersion;
+	m_stats.numBuilds++;
+}
+
+void CloudSunTransmittanceVolumes::SweepCloud(int cloudIndex, const Vec3& directionToSun)
+{
+	const SunTransmittanceVolumeGPU& volume = m_volumes[cloudIndex];
+	int numCells[3] = { volume.numCellsX, volume.numCellsY, volume.numCellsZ };
+	float cellSize[3] = { 1.f / volume.inverseCellSize.x, 1.f / volume.inverseCellSize.y, 1.f / volume.inverseCellSize.z };
+
+	// Slices are perpendicular to the axis the sun ray crosses fastest; the two others index within a slice
+	int sliceAxis = 0;
+	for (int axis = 1; axis < 3; ++axis)
+	{
+		if (fabsf(GetAxis(directionToSun, axis)) > fabsf(GetAxis(directionToSun, sliceAxis)))
+		{
+			sliceAxis = axis;
+		}
+	}
+	int axisU = (sliceAxis == 0) ? 1 : 0;
+	int axisV = (sliceAxis == 2) ? 1 : 2;
+
+	// From a cell center, the sun ray meets the previous slice's center plane after segmentLength,
+	// offset by the same number of cells everywhere
+	float sunOnSliceAxis = fabsf(GetAxis(directionToSun, sliceAxis));
+	float segmentLength = cellSize[sliceAxis] / sunOnSliceAxis;
+	float offsetU = GetAxis(directionToSun, axisU) * segmentLength / cellSize[axisU];
+	float offsetV = GetAxis(directionToSun, axisV) * segmentLength / cellSize[axisV];
+	int sliceStep = (GetAxis(directionToSun, sliceAxis) > 0.f) ? -1 : 1;
+	int firstSlice = (sliceStep > 0) ? 0 : numCells[sliceAxis] - 1;
+
+	int strides[3] = { 1, numCells[0], numCells[0] * numCells[1] };
+	float* transmittance = m_transmittance.data() + volume.firstCell;
+	const float* extinction = m_extinction.data() + volume.firstCell;
+
+	for (int slice = firstSlice; slice >= 0 && slice < numCells[sliceAxis]; slice += sliceStep)
+	{
+		int sliceOffset = slice * strides[sliceAxis];
+		int previousSliceOffset = (slice - sliceStep) * strides[sliceAxis];
+		bool isFirstSlice = (slice == firstSlice);
+
+		for (int cellV = 0; cellV < numCells[axisV]; ++cellV)
+		{
+			for (int cellU = 0; cellU < numCells[axisU]; ++cellU)
+			{
+				int cellIndex = sliceOffset + cellU * strides[axisU] + cellV * strides[axisV];
+				float cellExtinction = extinction[cellIndex];
+
+				// Light reaching the previous slice, or 1 when the sun ray enters through the box's faces instead
+				float upstreamTransmittance = 1.f;
+				float upstreamExtinction = 0.f;
+				float length = isFirstSlice ? 0.5f * segmentLength : segmentLength;
+				float u = (float)cellU + offsetU;
+				float v = (float)cellV + offsetV;
+				bool isInside = !isFirstSlice && u >= -0.5f && v >= -0.5f && u <= (float)numCells[axisU] - 0.5f && v <= (float)numCells[axisV] - 0.5f;
+				if (isInside)
+				{
+					u = ClampFloat(u, 0.f, (float)(numCells[axisU] - 1));
+					v = ClampFloat(v, 0.f, (float)(numCells[axisV] - 1));
+					int u0 = (int)u;
+					int v0 = (int)v;
+					int u1 = (u0 + 1 < numCells[axisU]) ? u0 + 1 : u0;
+					int v1 = (v0 + 1 < numCells[axisV]) ? v0 + 1 : v0;
+					float fracU = u - (float)u0;
+					float fracV = v - (float)v0;
+
+					int i00 = previousSliceOffset + u0 * strides[axisU] + v0 * strides[axisV];
+					int i10 = previousSliceOffset + u1 * strides[axisU] + v0 * strides[axisV];
+					int i01 = previousSliceOffset + u0 * strides[axisU] + v1 * strides[axisV];
+					int i11 = previousSliceOffset + u1 * strides[axisU] + v1 * strides[axisV];
+					float w00 = (1.f - fracU) * (1.f - fracV);
+					float w10 = fracU * (1.f - fracV);
+					float w01 = (1.f - fracU) * fracV;
+					float w11 = fracU * fracV;
+					upstreamTransmittance = transmittance[i00] * w00 + transmittance[i10] * w10 + transmittance[i01] * w01 + transmittance[i11] * w11;
+					upstreamExtinction = extinction[i00] * w00 + extinction[i10] * w10 + extinction[i01] * w01 + extinction[i11] * w11;
+				}
+
+				// Trapezoid rule over the segment
+				transmittance[cellIndex] = upstreamTransmittance * expf(-0.5f * (upstreamExtinction + cellExtinction) * length);
+			}
+		}
+	}
+}
+
+bool CloudSunTransmittanceVolumes::NeedsRebuild(const CloudRayMarchSettings& settings, const CloudSunTransmittanceConfig& config, unsigned int sceneVersion) const
+{
+	if (!m_isBuilt || sceneVersion != m_builtSceneVersion || HaveDensitySettingsChanged(settings, m_builtSettings) || HaveConfigsChanged(config, m_builtConfig))
+	{
+		return true;
+	}
+
+	Vec3 sunDirection = settings.sunDirection.GetNormalized();
+	Vec3 builtSunDirection = m_builtSettings.sunDirection.GetNormalized();
+	return DotProduct3D(sunDirection, builtSunDirection) < 1.f - SUN_TRANSMITTANCE_DIRECTION_EPSILON;
+}
+
+void CloudSunTransmittanceVolumes::Clear()
+{
+	m_volumes.clear();
+	m_transmittance.clear();
+	m_extinction.clear();
+	m_isBuilt = false;
+}
+
+bool CloudSunTransmittanceVolumes::HasVolume(int cloudIndex) const
+{
+	return cloudIndex >= 0 && cloudIndex < (int)m_volumes.size() && m_volumes[cloudIndex].numCellsX > 0;
+}
+
+float CloudSunTransmittanceVolumes::Sample(int cloudIndex, const Vec3& position) const
+{
+	// Cell centers hold the values; outside the box the nearest face's value stands
+	const SunTransmittanceVolumeGPU& volume = m_volumes[cloudIndex];
+	Vec3 local = position - volume.minBounds;
+	float x = ClampFloat(local.x * volume.inverseCellSize.x - 0.5f, 0.f, (float)(volume.numCellsX - 1));
+	float y = ClampFloat(local.y * volume.inverseCellSize.y - 0.5f, 0.f, (float)(volume.numCellsY - 1));
+	float z = ClampFloat(local.z * volume.inverseCellSize.z - 0.5f, 0.f, (float)(volume.numCellsZ - 1));
+
+	int x0 = (int)x;
+	int y0 = (int)y;
+	int z0 = (int)z;
+	int stepX = (x0 + 1 < volume.numCellsX) ? 1 : 0;
+	int stepY = (y0 + 1 < volume.numCellsY) ? volume.numCellsX : 0;
+	int stepZ = (z0 + 1 < volume.numCellsZ) ? volume.numCellsX * volume.numCellsY : 0;
+	float fracX = x - (float)x0;
+	float fracY = y - (float)y0;
+	float fracZ = z - (float)z0;
+
+	const float* cell = m_transmittance.data() + volume.firstCell + (z0 * volume.numCellsY + y0) * volume.numCellsX + x0;
+	float c00 = cell[0] + (cell[stepX] - cell[0]) * fracX;
+	float c10 = cell[stepY] + (cell[stepY + stepX] - cell[stepY]) * fracX;
+	float c01 = cell[stepZ] + (cell[stepZ + stepX] - cell[stepZ]) * fracX;
+	float c11 = cell[stepZ + stepY] + (cell[stepZ + stepY + stepX] - cell[stepZ + stepY]) * fracX;
+	float c0 = c00 + (c10 - c00) * fracY;
+	float c1 = c01 + (c11 - c01) * fracY;
+	return c0 + (c1 - c0) * fracZ;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "Game/CloudRayMarcher.hpp"
+
+// Per-cloud volume header (must match SunTransmittanceVolume in CloudShader.hlsl). A volume with no cells
+// means the cloud falls back to the voxel shadow map.
+struct SunTransmittanceVolumeGPU
+{
+	Vec3 minBounds;
+	int firstCell = 0;					// Into the shared transmittance buffer, x fastest
+	Vec3 inverseCellSize;
+	int numCellsX = 0;
+	int numCellsY = 0;
+	int numCellsZ = 0;
+	float padding[2] = {};
+};
+
+struct CloudSunTransmittanceConfig
+{
+	float cellsPerVoxel = 2.f;			// Resolution relative to the voxel grid
+	int maxCellsPerAxis = 32;
+	int samplesPerAxis = 1;				// Extinction is averaged over samplesPerAxis^3 points per cell
+	int numThreads = 0;
+};
+
+struct CloudSunTransmittanceStats
+{
+	int numBuilds = 0;
+	long long numCells = 0;
+	long long numExtinctionSamples = 0;
+	double extinctionSeconds = 0.0;		// Last build, parallel over every cell of every cloud
+	double sweepSeconds = 0.0;			// Last build, parallel over clouds, slice by slice inside each
+};
+
+// Low-resolution sun transmittance per cloud, so lighting a sample is one trilinear fetch instead of the 3x3 PCF
+// on the voxel shadow map. Each cloud's box is split into cells, the marcher's extinction is averaged per cell,
+// then slices perpendicular to the sun's dominant axis are swept from the sun side: every cell takes the
+// transmittance of the previous slice where the sun ray crosses it and attenuates over the segment in between.
+// Self-shadowing only; light entering through a cloud's sides or sun-facing slice is 1.
+class CloudSunTransmittanceVolumes
+{
+public:
+	CloudSunTransmittanceVolumes() = default;
+
+	// The scene's cloud boxes at marcher.GetSettings().sunDirection; sceneVersion identifies the voxels
+	void Build(const CloudRayMarchScene& scene, const CloudRayMarcher& marcher, const CloudSunTransmittanceConfig& config, unsigned int sceneVersion);
+
+	// True when the sun moved or anything that feeds the density did. Scrolling time is ignored: the volume is
+	// too coarse to follow the noise, so it keeps the scroll offset it was built at.
+	bool NeedsRebuild(const CloudRayMarchSettings& settings, const CloudSunTransmittanceConfig& config, unsigned int sceneVersion) const;
+	void Clear();
+
+	bool HasVolume(int cloudIndex) const;
+	float Sample(int cloudIndex, const Vec3& position) const;
+
+	const std::vector<SunTransmittanceVolumeGPU>& GetVolumes() const { return m_volumes; }
+	const std::vector<float>& GetTransmittance() const { return m_transmittance; }
+	const CloudSunTransmittanceStats& GetStats() const { return m_stats; }
+	size_t GetMemoryBytes() const { return m_volumes.size() * sizeof(SunTransmittanceVolumeGPU) + (m_transmittance.size() + m_extinction.size()) * sizeof(float); }
+
+private:
+	void SweepCloud(int cloudIndex, const Vec3& directionToSun);
+
+private:
+	std::vector<SunTransmittanceVolumeGPU> m_volumes;
+	std::vector<float> m_transmittance;
+	std::vector<float> m_extinction;		// Cell averages, kept so a sun change only re-sweeps
+
+	bool m_isBuilt = false;
+	CloudRayMarchSettings m_builtSettings;
+	CloudSunTransmittanceConfig m_builtConfig;
+	unsigned int m_builtSceneVersion = 0;
+	CloudSunTransmittanceStats m_stats;
+};
@@ -0,0 +1,172 @@
+#include "Game/CloudTemporalReprojection.hpp"
+#include <cmath>
+
+//-----------------------------------------------------------------------------------------------
+// Rank -> pixel for the 2x2 and 4x4 Bayer matrices
+static const int BAYER_ORDER_2X2[4][2] = { { 0, 0 }, { 1, 1 }, { 1, 0 }, { 0, 1 } };
+static const int BAYER_ORDER_4X4[16][2] = {
+	{ 0, 0 }, { 2, 2 }, { 2, 0 }, { 0, 2 }, { 1, 1 }, { 3, 3 }, { 3, 1 }, { 1, 3 },
+	{ 1, 0 }, { 3, 2 }, { 3, 0 }, { 1, 2 }, { 0, 1 }, { 2, 3 }, { 2, 1 }, { 0, 3 } };
+
+IntVec2 GetTemporalFramePhase(unsigned int frameIndex, int blockSize)
+{
+	if (blockSize == 4)
+	{
+		const int* pixel = BAYER_ORDER_4X4[frameIndex % 16];
+		return IntVec2(pixel[0], pixel[1]);
+	}
+	if (blockSize == 2)
+	{
+		const int* pixel = BAYER_ORDER_2X2[frameIndex % 4];
+		return IntVec2(pixel[0], pixel[1]);
+	}
+	return IntVec2(0, 0);
+}
+
+Vec3 GetCloudNoiseVelocity(float scrollFactor, float noiseScale, const Vec3& voxelDimensions)
+{
+	// SampleNoise offsets the noise coordinates by (0.1, -0.05, -0.01) * t * scrollFactor, in voxel units / noiseScale,
+	// so features move the opposite way in the world
+	Vec3 scrollPerSecond = Vec3(0.1f, -0.05f, -0.01f) * scrollFactor;
+	return Vec3(-scrollPerSecond.x * voxelDimensions.x, -scrollPerSecond.y * voxelDimensions.y, -scrollPerSecond.z * voxelDimensions.z) / noiseScale;
+}
+
+//-----------------------------------------------------------------------------------------------
+CloudTemporalReprojector::CloudTemporalReprojector(const std::vector<CloudGPU>& clouds, int blockSize, float maxDistance)
+	: m_clouds(clouds)
+	, m_blockSize(blockSize > 0 ? blockSize : 1)
+	, m_maxDistance(maxDistance)
+{
+}
+
+float CloudTemporalReprojector::FindReprojectionDepth(const Vec3& rayOrigin, const Vec3& rayDirection) const
+{
+	Vec3 invRayDir = Vec3(1.f / rayDirection.x, 1.f / rayDirection.y, 1.f / rayDirection.z);
+	float depth = m_maxDistance;
+
+	for (const CloudGPU& cloud : m_clouds)
+	{
+		float t1x = (cloud.minBounds.x - rayOrigin.x) * invRayDir.x;
+		float t2x = (cloud.maxBounds.x - rayOrigin.x) * invRayDir.x;
+		float t1y = (cloud.minBounds.y - rayOrigin.y) * invRayDir.y;
+		float t2y = (cloud.maxBounds.y - rayOrigin.y) * invRayDir.y;
+		float t1z = (cloud.minBounds.z - rayOrigin.z) * invRayDir.z;
+		float t2z = (cloud.maxBounds.z - rayOrigin.z) * invRayDir.z;
+
+		float tEnter = fmaxf(fmaxf(fminf(t1x, t2x), fminf(t1y, t2y)), fmaxf(fminf(t1z, t2z), 0.f));
+		float tExit = fminf(fminf(fmaxf(t1x, t2x), fmaxf(t1y, t2y)), fmaxf(t1z, t2z));
+		if (tEnter <= tExit && tEnter < depth)
+		{
+			depth = tEnter;
+		}
+	}
+	return depth;
+}
+
+Vec4 CloudTemporalReprojector::SampleHistory(float x, float y) const
+{
+	int width = m_history.GetWidth();
+	int height = m_history.GetHeight();
+
+	int x0 = (int)floorf(x);
+	int y0 = (int)floorf(y);
+	float fracX = x - (float)x0;
+	float fracY = y - (float)y0;
+	int x1 = (x0 + 1 < width) ? x0 + 1 : x0;
+	int y1 = (y0 + 1 < height) ? y0 + 1 : y0;
+
+	const Vec4& p00 = m_history.GetPixel(x0, y0);
+	const Vec4& p10 = m_history.GetPixel(x1, y0);
+	const Vec4& p01 = m_history.GetPixel(x0, y1);
+	const Vec4& p11 = m_history.GetPixel(x1, y1);
+
+	float w00 = (1.f - fracX) * (1.f - fracY);
+	float w10 = fracX * (1.f - fracY);
+	float w01 = (1.f - fracX) * fracY;
+	float w11 = fracX * fracY;
+	return Vec4(p00.x * w00 + p10.x * w10 + p01.x * w01 + p11.x * w11,
+		p00.y * w00 + p10.y * w10 + p01.y * w01 + p11.y * w11,
+		p00.z * w00 + p10.z * w10 + p01.z * w01 + p11.z * w11,
+		p00.w * w00 + p10.w * w10 + p01.w * w01 + p11.w * w11);
+}
+
+void CloudTemporalReprojector::Resolve(const FloatImage& current, const CloudRayMarchCamera& camera, const Vec3& cloudDrift, FloatImage& output)
+{
+	int width = current.GetWidth();
+	int height = current.GetHeight();
+	int blockSize = m_blockSize;
+	IntVec2 phase = GetFramePhase();
+
+	bool hasHistory = m_hasHistory && m_history.GetWidth() == width && m_history.GetHeight() == height;
+	output.Resize(width, height);
+
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			// The current image repeats each block's fresh ray over the whole block
+			const Vec4& fresh = current.GetPixel(x, y);
+			if (!hasHistory || (x % blockSize == phase.x && y % blockSize == phase.y))
+			{
+				output.SetPixel(x, y, fresh);
+				m_stats.numFresh += hasHistory ? 1 : 0;
+				m_stats.numRejected += hasHistory ? 0 : 1;
+				continue;
+			}
+
+			float u = ((float)x / (float)width) * 2.f - 1.f;
+			float v = ((float)y / (float)height) * 2.f - 1.f;
+			Vec3 rayDirection = camera.ComputeRayDirection(u, v);
+			Vec3 worldPosition = camera.position + rayDirection * FindReprojectionDepth(camera.position, rayDirection);
+
+			float previousU = 0.f;
+			float previousV = 0.f;
+			float historyX = -1.f;
+			float historyY = -1.f;
+			if (m_previousCamera.ProjectToUV(worldPosition - cloudDrift, previousU, previousV))
+			{
+				historyX = (previousU + 1.f) * 0.5f * (float)width;
+				historyY = (previousV + 1.f) * 0.5f * (float)height;
+			}
+
+			if (historyX < 0.f || historyY < 0.f || historyX > (float)(width - 1) || historyY > (float)(height - 1))
+			{
+				output.SetPixel(x, y, fresh);
+				m_stats.numRejected++;
+				continue;
+			}
+
+			// Neighbourhood clamp against the fresh rays of the 3x3 surrounding blocks
+			Vec4 minColor = fresh;
+			Vec4 maxColor = fresh;
+			int blockX = x / blockSize;
+			int blockY = y / blockSize;
+			for (int offsetY = -1; offsetY <= 1; ++offsetY)
+			{
+				for (int offsetX = -1; offsetX <= 1; ++offsetX)
+				{
+					int sampleX = (blockX + offsetX) * blockSize;
+					int sampleY = (blockY + offsetY) * blockSize;
+					if (sampleX < 0 || sampleY < 0 || sampleX >= width || sampleY >= height)
+					{
+						continue;
+					}
+
+					const Vec4& neighbour = current.GetPixel(sampleX, sampleY);
+					minColor = Vec4(fminf(minColor.x, neighbour.x), fminf(minColor.y, neighbour.y), fminf(minColor.z, neighbour.z), fminf(minColor.w, neighbour.w));
+					maxColor = Vec4(fmaxf(maxColor.x, neighbour.x), fmaxf(maxColor.y, neighbour.y), fmaxf(maxColor.z, neighbour.z), fmaxf(maxColor.w, neighbour.w));
+				}
+			}
+
+			Vec4 history = SampleHistory(historyX, historyY);
+			output.SetPixel(x, y, Vec4(fminf(fmaxf(history.x, minColor.x), maxColor.x), fminf(fmaxf(history.y, minColor.y), maxColor.y),
+				fminf(fmaxf(history.z, minColor.z), maxColor.z), fminf(fmaxf(history.w, minColor.w), maxColor.w)));
+			m_stats.numReprojected++;
+		}
+	}
+
+	m_history = output;
+	m_previousCamera = camera;
+	m_hasHistory = true;
+	m_frameIndex++;
+}
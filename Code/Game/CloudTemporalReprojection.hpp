@@ -0,0 +1,68 @@
+#pragma once
+#include "Game/CloudRayMarcher.hpp"
+#include "Engine/Math/IntVec2.hpp"
+#include "Engine/Math/Mat44.hpp"
+
+constexpr int TEMPORAL_MAX_BLOCK_SIZE = 4;
+
+// Per-frame reprojection parameters (must match TemporalReprojection in CloudShader.hlsl and CloudTemporalShader.hlsl)
+struct TemporalReprojectionGPU
+{
+	Mat44 previousViewProjection;		// Last frame's player camera, world to clip
+	Vec3 cloudDrift;					// How far the noise moved since last frame, in world units
+	int blockSize = 1;					// 1 = off; 2 or 4 = one ray per block per frame, the rest reprojected
+	int phaseX = 0;						// Pixel of each block that gets this frame's ray
+	int phaseY = 0;
+	int historyValid = 0;
+	int outputWidth = 0;
+	int outputHeight = 0;
+	float padding[3] = {};
+};
+
+// Which pixel of each block gets the ray on a frame: Bayer order, so consecutive frames land far apart
+IntVec2 GetTemporalFramePhase(unsigned int frameIndex, int blockSize);
+
+// World-space velocity of the Worley layer's scroll in SampleNoise (the voxels themselves don't move)
+Vec3 GetCloudNoiseVelocity(float scrollFactor, float noiseScale, const Vec3& voxelDimensions);
+
+struct CloudTemporalStats
+{
+	long long numReprojected = 0;		// Pixels taken from the clamped history
+	long long numRejected = 0;			// History off screen or missing, fell back to the block's fresh sample
+	long long numFresh = 0;				// Pixels that got a ray this frame
+};
+
+// CPU mirror of CloudTemporalShader.hlsl. Rebuilds the full-resolution image from this frame's one-ray-per-block
+// render and last frame's output, reprojected through the cloud depth and clamped to the neighbouring fresh samples.
+class CloudTemporalReprojector
+{
+public:
+	CloudTemporalReprojector(const std::vector<CloudGPU>& clouds, int blockSize, float maxDistance = 500.f);
+
+	void Reset() { m_hasHistory = false; }
+
+	// Render the current frame with pixelBlockSize = blockSize and blockSample = this, so each block holds its fresh ray
+	IntVec2 GetFramePhase() const { return GetTemporalFramePhase(m_frameIndex, m_blockSize); }
+
+	// Consumes the frame: output becomes next frame's history
+	void Resolve(const FloatImage& current, const CloudRayMarchCamera& camera, const Vec3& cloudDrift, FloatImage& output);
+
+	int GetBlockSize() const { return m_blockSize; }
+	const CloudTemporalStats& GetStats() const { return m_stats; }
+
+private:
+	// Entry distance of the first cloud box along the ray, maxDistance when it misses them all
+	float FindReprojectionDepth(const Vec3& rayOrigin, const Vec3& rayDirection) const;
+	Vec4 SampleHistory(float x, float y) const;
+
+private:
+	std::vector<CloudGPU> m_clouds;
+	int m_blockSize = 1;
+	float m_maxDistance = 500.f;
+
+	FloatImage m_history;
+	CloudRayMarchCamera m_previousCamera;
+	bool m_hasHistory = false;
+	unsigned int m_frameIndex = 0;
+	CloudTemporalStats m_stats;
+};
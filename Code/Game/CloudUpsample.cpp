@@ -0,0 +1,79 @@
+#include "Game/CloudUpsample.hpp"
+#include <cmath>
+
+//-----------------------------------------------------------------------------------------------
+void UpsampleCloudsBilateral(const FloatImage& blockColor, const FloatImage& blockDepth, const std::vector<SceneOccluderGPU>& occluders,
+	const CloudRayMarchCamera& camera, const CloudUpsampleSettings& settings, FloatImage& output)
+{
+	int width = blockColor.GetWidth();
+	int height = blockColor.GetHeight();
+	int factor = (settings.factor > 0) ? settings.factor : 1;
+	int lowWidth = (width + factor - 1) / factor;
+	int lowHeight = (height + factor - 1) / factor;
+
+	output.Resize(width, height);
+
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			float u = ((float)x / (float)width) * 2.f - 1.f;
+			float v = ((float)y / (float)height) * 2.f - 1.f;
+			float pixelDepth = FindSceneDepth(occluders, camera.position, camera.ComputeRayDirection(u, v), settings.maxDistance);
+
+			// Block b was marched through pixel b * factor + factor / 2
+			float lowX = ((float)x - (float)(factor / 2)) / (float)factor;
+			float lowY = ((float)y - (float)(factor / 2)) / (float)factor;
+			int lowBaseX = (int)floorf(lowX);
+			int lowBaseY = (int)floorf(lowY);
+			float fracX = lowX - (float)lowBaseX;
+			float fracY = lowY - (float)lowBaseY;
+
+			Vec4 colorSum = Vec4(0.f, 0.f, 0.f, 0.f);
+			float weightSum = 0.f;
+			Vec4 nearestColor = Vec4(0.f, 0.f, 0.f, 0.f);
+			float nearestPenalty = 1e30f;
+			float depthScale = 1.f / fmaxf(settings.depthSigma * pixelDepth, 1e-3f);
+
+			for (int tapY = 0; tapY <= 1; ++tapY)
+			{
+				for (int tapX = 0; tapX <= 1; ++tapX)
+				{
+					int blockX = lowBaseX + tapX;
+					int blockY = lowBaseY + tapY;
+					blockX = (blockX < 0) ? 0 : ((blockX > lowWidth - 1) ? lowWidth - 1 : blockX);
+					blockY = (blockY < 0) ? 0 : ((blockY > lowHeight - 1) ? lowHeight - 1 : blockY);
+
+					const Vec4& tapColor = blockColor.GetPixel(blockX * factor, blockY * factor);
+					const Vec4& tapDepth = blockDepth.GetPixel(blockX * factor, blockY * factor);
+
+					// The tap saw cloud behind this pixel's surface, or sits on geometry in front of it
+					float behind = fmaxf(tapDepth.x - pixelDepth, 0.f) * depthScale;
+					float inFront = fmaxf(pixelDepth - tapDepth.y, 0.f) * depthScale;
+					float penalty = behind * behind + inFront * inFront;
+
+					float bilinear = ((tapX == 0) ? 1.f - fracX : fracX) * ((tapY == 0) ? 1.f - fracY : fracY);
+					float weight = (settings.depthSigma > 0.f) ? bilinear * expf(-penalty) : bilinear;
+					colorSum = Vec4(colorSum.x + tapColor.x * weight, colorSum.y + tapColor.y * weight, colorSum.z + tapColor.z * weight, colorSum.w + tapColor.w * weight);
+					weightSum += weight;
+
+					if (penalty < nearestPenalty)
+					{
+						nearestPenalty = penalty;
+						nearestColor = tapColor;
+					}
+				}
+			}
+
+			// Every tap disagrees with this pixel's depth: fall back to the closest match
+			if (weightSum > 1e-4f)
+			{
+				output.SetPixel(x, y, Vec4(colorSum.x / weightSum, colorSum.y / weightSum, colorSum.z / weightSum, colorSum.w / weightSum));
+			}
+			else
+			{
+				output.SetPixel(x, y, nearestColor);
+			}
+		}
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "Game/CloudRayMarcher.hpp"
+
+constexpr int MAX_SCENE_OCCLUDERS = 16;
+
+// Per-frame parameters for the bilateral upsample (must match CloudUpsample in CloudShader.hlsl and CloudUpsampleShader.hlsl)
+struct CloudUpsampleGPU
+{
+	int factor = 1;						// 1 = off; 2 or 4 = one ray per block, resolved by CloudUpsampleShader
+	int outputWidth = 0;
+	int outputHeight = 0;
+	int numOccluders = 0;
+	float depthSigma = 0.1f;			// Depth tolerance as a fraction of the pixel's scene depth; 0 = plain bilinear
+	float maxDistance = 500.f;
+	float padding[2] = {};
+};
+
+struct CloudUpsampleSettings
+{
+	int factor = 2;
+	float depthSigma = 0.1f;
+	float maxDistance = 500.f;
+};
+
+// CPU mirror of CloudUpsampleShader.hlsl. blockColor and blockDepth come from CloudRayMarcher::Render with
+// pixelBlockSize = factor and the default block centers, so every block repeats its one ray; the full-res guide is
+// the scene depth of each output pixel's own ray.
+void UpsampleCloudsBilateral(const FloatImage& blockColor, const FloatImage& blockDepth, const std::vector<SceneOccluderGPU>& occluders,
+	const CloudRayMarchCamera& camera, const CloudUpsampleSettings& settings, FloatImage& output);
@@ -0,0 +1,84 @@
+#include "Game/CloudVisibility.hpp"
+#include <cmath>
+
+//-----------------------------------------------------------------------------------------------
+static CloudCullPlane MakePlane(const Vec3& inwardNormal, const Vec3& pointOnPlane, float margin)
+{
+	CloudCullPlane plane;
+	plane.normal = inwardNormal.GetNormalized();
+	plane.distance = -DotProduct3D(plane.normal, pointOnPlane) + margin;
+	return plane;
+}
+
+//-----------------------------------------------------------------------------------------------
+CloudCullFrustum CloudCullFrustum::MakePerspective(const CloudRayMarchCamera& camera, float farDistance, float margin)
+{
+	// Same extents as CloudRayMarchCamera::ComputeRayDirection at uv = +-1
+	float tanHalfFovY = tanf(0.5f * camera.fovDegrees * 3.14159265f / 180.f);
+	float tanHalfFovX = tanHalfFovY * camera.aspect;
+
+	CloudCullFrustum frustum;
+	frustum.planes[0] = MakePlane(camera.forward, camera.position, margin);
+	frustum.planes[1] = MakePlane(camera.forward * -1.f, camera.position + camera.forward * farDistance, margin);
+	frustum.planes[2] = MakePlane(camera.forward * tanHalfFovX + camera.left, camera.position, margin);
+	frustum.planes[3] = MakePlane(camera.forward * tanHalfFovX - camera.left, camera.position, margin);
+	frustum.planes[4] = MakePlane(camera.forward * tanHalfFovY + camera.up, camera.position, margin);
+	frustum.planes[5] = MakePlane(camera.forward * tanHalfFovY - camera.up, camera.position, margin);
+	frustum.numPlanes = 6;
+	return frustum;
+}
+
+CloudCullFrustum CloudCullFrustum::MakeOrthographic(const CloudOpacityShadowFrame& frame, float margin)
+{
+	CloudCullFrustum frustum;
+	frustum.planes[0] = MakePlane(frame.forward, frame.origin, margin);
+	frustum.planes[1] = MakePlane(frame.forward * -1.f, frame.origin + frame.forward * frame.maxDistance, margin);
+	frustum.planes[2] = MakePlane(frame.right, frame.origin - frame.right * frame.halfExtent, margin);
+	frustum.planes[3] = MakePlane(frame.right * -1.f, frame.origin + frame.right * frame.halfExtent, margin);
+	frustum.planes[4] = MakePlane(frame.up, frame.origin - frame.up * frame.halfExtent, margin);
+	frustum.planes[5] = MakePlane(frame.up * -1.f, frame.origin + frame.up * frame.halfExtent, margin);
+	frustum.numPlanes = 6;
+	return frustum;
+}
+
+bool CloudCullFrustum::IsBoxVisible(const Vec3& minBounds, const Vec3& maxBounds) const
+{
+	for (int planeIndex = 0; planeIndex < numPlanes; ++planeIndex)
+	{
+		// The corner furthest along the normal; if even that is outside, the whole box is
+		const CloudCullPlane& plane = planes[planeIndex];
+		Vec3 corner((plane.normal.x >= 0.f) ? maxBounds.x : minBounds.x, (plane.normal.y >= 0.f) ? maxBounds.y : minBounds.y,
+			(plane.normal.z >= 0.f) ? maxBounds.z : minBounds.z);
+		if (DotProduct3D(plane.normal, corner) + plane.distance < 0.f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------
+void CullClouds(const std::vector<CloudGPU>& clouds, const CloudCullFrustum& frustum, std::vector<unsigned int>& visibleList)
+{
+	visibleList.resize(clouds.size() + 1);
+	unsigned int numVisible = 0;
+	for (int cloudIndex = 0; cloudIndex < (int)clouds.size(); ++cloudIndex)
+	{
+		if (frustum.IsBoxVisible(clouds[cloudIndex].minBounds, clouds[cloudIndex].maxBounds))
+		{
+			visibleList[++numVisible] = (unsigned int)cloudIndex;
+		}
+	}
+	visibleList[0] = numVisible;
+	visibleList.resize(numVisible + 1);
+}
+
+void MakeAllCloudsVisible(int numClouds, std::vector<unsigned int>& visibleList)
+{
+	visibleList.resize((size_t)numClouds + 1);
+	visibleList[0] = (unsigned int)numClouds;
+	for (int cloudIndex = 0; cloudIndex < numClouds; ++cloudIndex)
+	{
+		visibleList[cloudIndex + 1] = (unsigned int)cloudIndex;
+	}
+}
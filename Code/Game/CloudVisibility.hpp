@@ -0,0 +1,42 @@
+#pragma once
+#include "Game/CloudRayMarcher.hpp"
+#include "Game/CloudOpacityShadowMap.hpp"
+
+// dot(normal, p) + distance >= 0 on the inside
+struct CloudCullPlane
+{
+	Vec3 normal;
+	float distance = 0.f;
+};
+
+// Convex volume of up to six planes the cloud boxes are tested against
+struct CloudCullFrustum
+{
+	CloudCullPlane planes[6];
+	int numPlanes = 0;
+
+	// The camera's view rays out to farDistance (the march's maxDistance); margin pushes every plane outward
+	static CloudCullFrustum MakePerspective(const CloudRayMarchCamera& camera, float farDistance, float margin = 0.f);
+
+	// The box the shadow map's light rays sweep
+	static CloudCullFrustum MakeOrthographic(const CloudOpacityShadowFrame& frame, float margin = 0.f);
+
+	// Conservative: false only when the box is entirely behind one plane
+	bool IsBoxVisible(const Vec3& minBounds, const Vec3& maxBounds) const;
+};
+
+struct CloudVisibilityStats
+{
+	int numClouds = 0;
+	int numCameraVisible = 0;
+	int numLightVisible = 0;
+	double cameraSeconds = 0.0;
+	double lightSeconds = 0.0;
+};
+
+// Writes the visible clouds as the shaders' VisibleClouds buffer: the count, then the indices into the full cloud
+// list in ascending order. Indices stay global so per-cloud data (octrees, sun volumes) needs no remapping.
+void CullClouds(const std::vector<CloudGPU>& clouds, const CloudCullFrustum& frustum, std::vector<unsigned int>& visibleList);
+
+// Every cloud, for when culling is off
+void MakeAllCloudsVisible(int numClouds, std::vector<unsigned int>& visibleList);
@@ -29,7 +29,7 @@ void CloudsBuffer::Create()
 	bufferDesc.CPUAccessFlags = 0;
 
 	D3D11_SUBRESOURCE_DATA voxelData = {};
-	voxelData.pSysMem = m_manager->m_clouds.data();
+	voxelData.pSysMem = m_manager->m_prototypes.GetPrototypes().data();
 
 	m_device->CreateBuffer(&bufferDesc, &voxelData, &m_buffer);
 
@@ -0,0 +1,484 @@
+#include "Game/CpuProfiler.hpp"
+#include "ThirdParty/ImGui/imgui.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+static constexpr unsigned long long PROFILE_RING_CAPACITY = 1 << 14;	// Events a thread may close between two EndFrames
+
+//-----------------------------------------------------------------------------------------------
+class CpuProfileThreadBuffer
+{
+public:
+	CpuProfileEvent m_events[PROFILE_RING_CAPACITY];
+	std::atomic<unsigned long long> m_numWritten{ 0 };		// Only the owning thread stores
+	unsigned long long m_numRead = 0;						// Only EndFrame touches, under the threads mutex
+	std::atomic<bool> m_isRetired{ false };					// The owning thread exited; the ring can go to a new one
+	int m_threadIndex = 0;
+	std::string m_name;
+};
+
+// The calling thread's ring and zone depth. A thread that exits hands its ring back for reuse, so short-lived
+// worker threads (ParallelFor) don't each leave one behind.
+struct CpuProfileThreadSlot
+{
+	CpuProfileThreadBuffer* m_buffer = nullptr;
+	int m_depth = 0;
+
+	~CpuProfileThreadSlot()
+	{
+		if (m_buffer != nullptr)
+		{
+			m_buffer->m_isRetired.store(true, std::memory_order_release);
+		}
+	}
+};
+
+static thread_local CpuProfileThreadSlot t_profileThread;
+
+//-----------------------------------------------------------------------------------------------
+CpuProfiler& CpuProfiler::Get()
+{
+	static CpuProfiler* s_profiler = new CpuProfiler();
+	return *s_profiler;
+}
+
+long long CpuProfiler::GetTimeNs()
+{
+	static const std::chrono::steady_clock::time_point s_origin = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_origin).count();
+}
+
+CpuProfiler::CpuProfiler()
+{
+	m_frameStartNs = GetTimeNs();
+}
+
+CpuProfiler::~CpuProfiler()
+{
+}
+
+void CpuProfiler::BeginFrame()
+{
+	m_frameStartNs = GetTimeNs();
+	if (m_frameIndex == 0)
+	{
+		SetThreadName("Main Thread");
+	}
+}
+
+void CpuProfiler::EndFrame()
+{
+	CpuProfileFrame frame;
+	frame.frameIndex = m_frameIndex++;
+	frame.startNs = m_frameStartNs;
+	frame.endNs = GetTimeNs();
+
+	{
+		std::lock_guard<std::mutex> lock(m_threadsMutex);
+		for (const std::unique_ptr<CpuProfileThreadBuffer>& buffer : m_threads)
+		{
+			unsigned long long numWritten = buffer->m_numWritten.load(std::memory_order_acquire);
+			unsigned long long first = buffer->m_numRead;
+			if (numWritten - first > PROFILE_RING_CAPACITY)
+			{
+				m_numDroppedEvents += (long long)(numWritten - first - PROFILE_RING_CAPACITY);
+				first = numWritten - PROFILE_RING_CAPACITY;
+			}
+
+			size_t firstCopied = frame.events.size();
+			for (unsigned long long eventIndex = first; eventIndex < numWritten; ++eventIndex)
+			{
+				frame.events.push_back(buffer->m_events[eventIndex % PROFILE_RING_CAPACITY]);
+			}
+
+			// A writer that went all the way around during the copy may have overwritten the oldest copies
+			unsigned long long numWrittenAfter = buffer->m_numWritten.load(std::memory_order_acquire);
+			if (numWrittenAfter - first > PROFILE_RING_CAPACITY)
+			{
+				unsigned long long numStale = std::min(numWrittenAfter - first - PROFILE_RING_CAPACITY, numWritten - first);
+				frame.events.erase(frame.events.begin() + firstCopied, frame.events.begin() + firstCopied + (size_t)numStale);
+				m_numDroppedEvents += (long long)numStale;
+			}
+			buffer->m_numRead = numWritten;
+		}
+	}
+
+	std::sort(frame.events.begin(), frame.events.end(), [](const CpuProfileEvent& a, const CpuProfileEvent& b)
+		{
+			return (a.startNs != b.startNs) ? (a.startNs < b.startNs) : (a.depth < b.depth);
+		});
+	UpdateZoneStats(frame);
+
+	m_history.push_back(std::move(frame));
+	while ((int)m_history.size() > m_numHistoryFrames)
+	{
+		m_history.pop_front();
+	}
+	if (!m_isFrozen)
+	{
+		m_lastFrame = m_history.back();
+	}
+}
+
+void CpuProfiler::SetThreadName(const char* name)
+{
+	CpuProfileThreadBuffer* buffer = GetThreadBuffer();
+	std::lock_guard<std::mutex> lock(m_threadsMutex);
+	buffer->m_name = name;
+}
+
+void CpuProfiler::Record(const char* name, long long startNs, long long endNs, int depth)
+{
+	CpuProfileThreadBuffer* buffer = GetThreadBuffer();
+	unsigned long long eventIndex = buffer->m_numWritten.load(std::memory_order_relaxed);
+
+	CpuProfileEvent& event = buffer->m_events[eventIndex % PROFILE_RING_CAPACITY];
+	event.name = name;
+	event.startNs = startNs;
+	event.endNs = endNs;
+	event.threadIndex = buffer->m_threadIndex;
+	event.depth = depth;
+
+	buffer->m_numWritten.store(eventIndex + 1, std::memory_order_release);
+}
+
+CpuProfileThreadBuffer* CpuProfiler::GetThreadBuffer()
+{
+	if (t_profileThread.m_buffer != nullptr)
+	{
+		return t_profileThread.m_buffer;
+	}
+
+	std::lock_guard<std::mutex> lock(m_threadsMutex);
+	CpuProfileThreadBuffer* buffer = nullptr;
+	for (const std::unique_ptr<CpuProfileThreadBuffer>& candidate : m_threads)
+	{
+		// Only once EndFrame has drained what the previous owner wrote
+		if (candidate->m_isRetired.load(std::memory_order_acquire) && candidate->m_numRead == candidate->m_numWritten.load(std::memory_order_acquire))
+		{
+			buffer = candidate.get();
+			buffer->m_isRetired.store(false, std::memory_order_relaxed);
+			break;
+		}
+	}
+
+	if (buffer == nullptr)
+	{
+		m_threads.push_back(std::make_unique<CpuProfileThreadBuffer>());
+		buffer = m_threads.back().get();
+		buffer->m_threadIndex = (int)m_threads.size() - 1;
+	}
+
+	char name[32];
+	snprintf(name, sizeof(name), "Worker %d", buffer->m_threadIndex);
+	buffer->m_name = name;
+	t_profileThread.m_buffer = buffer;
+	return buffer;
+}
+
+//-----------------------------------------------------------------------------------------------
+void CpuProfiler::UpdateZoneStats(const CpuProfileFrame& frame)
+{
+	for (CpuProfileZoneStats& stats : m_zoneStats)
+	{
+		stats.numCalls = 0;
+		stats.lastMs = 0.0;
+	}
+
+	// Zones are few, so a linear search by name beats hashing; names are compared by text because the same literal
+	// can have a different address in each translation unit
+	for (const CpuProfileEvent& event : frame.events)
+	{
+		CpuProfileZoneStats* zone = nullptr;
+		for (CpuProfileZoneStats& stats : m_zoneStats)
+		{
+			if (stats.name == event.name || strcmp(stats.name, event.name) == 0)
+			{
+				zone = &stats;
+				break;
+			}
+		}
+		if (zone == nullptr)
+		{
+			m_zoneStats.push_back(CpuProfileZoneStats());
+			zone = &m_zoneStats.back();
+			zone->name = event.name;
+		}
+		zone->numCalls++;
+		zone->lastMs += (double)(event.endNs - event.startNs) * 1e-6;
+	}
+
+	for (CpuProfileZoneStats& stats : m_zoneStats)
+	{
+		if (stats.numCalls == 0)
+		{
+			continue;
+		}
+		stats.averageMs = (stats.averageMs > 0.0) ? (stats.averageMs * 0.9 + stats.lastMs * 0.1) : stats.lastMs;
+		stats.peakMs = std::max(stats.peakMs, stats.lastMs);
+	}
+}
+
+const CpuProfileZoneStats* CpuProfiler::FindZoneStats(const char* name) const
+{
+	for (const CpuProfileZoneStats& stats : m_zoneStats)
+	{
+		if (strcmp(stats.name, name) == 0)
+		{
+			return &stats;
+		}
+	}
+	return nullptr;
+}
+
+int CpuProfiler::GetNumThreads() const
+{
+	std::lock_guard<std::mutex> lock(m_threadsMutex);
+	return (int)m_threads.size();
+}
+
+std::string CpuProfiler::GetThreadName(int threadIndex) const
+{
+	std::lock_guard<std::mutex> lock(m_threadsMutex);
+	return (threadIndex >= 0 && threadIndex < (int)m_threads.size()) ? m_threads[threadIndex]->m_name : std::string("?");
+}
+
+void CpuProfiler::ResetStats()
+{
+	m_zoneStats.clear();
+	m_numDroppedEvents = 0;
+}
+
+//-----------------------------------------------------------------------------------------------
+static void AppendJsonString(std::string& json, const char* text)
+{
+	json += '"';
+	for (const char* character = text; *character != '\0'; ++character)
+	{
+		if (*character == '"' || *character == '\\')
+		{
+			json += '\\';
+		}
+		json += *character;
+	}
+	json += '"';
+}
+
+std::string CpuProfiler::ToChromeTrace() const
+{
+	std::string json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+	char line[160];
+	bool isFirst = true;
+
+	int numThreads = GetNumThreads();
+	for (int threadIndex = 0; threadIndex < numThreads; ++threadIndex)
+	{
+		snprintf(line, sizeof(line), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", isFirst ? "" : ",\n", threadIndex);
+		json += line;
+		AppendJsonString(json, GetThreadName(threadIndex).c_str());
+		json += "}}";
+		isFirst = false;
+	}
+
+	for (const CpuProfileFrame& frame : m_history)
+	{
+		for (const CpuProfileEvent& event : frame.events)
+		{
+			json += isFirst ? "{\"name\":" : ",\n{\"name\":";
+			AppendJsonString(json, event.name);
+			snprintf(line, sizeof(line), ",\"cat\":\"cpu\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"frame\":%u}}",
+				(double)event.startNs * 1e-3, (double)(event.endNs - event.startNs) * 1e-3, event.threadIndex, frame.frameIndex);
+			json += line;
+			isFirst = false;
+		}
+	}
+	json += "\n]}\n";
+	return json;
+}
+
+bool CpuProfiler::WriteChromeTrace(const std::string& filePath) const
+{
+	std::ofstream file(filePath, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	std::string json = ToChromeTrace();
+	file.write(json.data(), (std::streamsize)json.size());
+	return file.good();
+}
+
+//-----------------------------------------------------------------------------------------------
+static ImU32 GetZoneColor(const char* name)
+{
+	unsigned int hash = 2166136261u;
+	for (const char* character = name; *character != '\0'; ++character)
+	{
+		hash = (hash ^ (unsigned char)*character) * 16777619u;
+	}
+	return IM_COL32(90 + (hash & 0x7f), 90 + ((hash >> 8) & 0x7f), 90 + ((hash >> 16) & 0x7f), 255);
+}
+
+void CpuProfiler::DrawImGui()
+{
+	if (!ImGui::CollapsingHeader("CPU Timings"))
+	{
+		return;
+	}
+
+	bool isEnabled = IsEnabled();
+	ImGui::Checkbox("Record", &isEnabled);
+	SetEnabled(isEnabled);
+	ImGui::SameLine();
+	ImGui::Checkbox("Freeze", &m_isFrozen);
+	ImGui::SameLine();
+	if (ImGui::Button("Reset"))
+	{
+		ResetStats();
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Export Trace"))
+	{
+		const char* tracePath = "Data/ProfileTrace.json";
+		bool wasWritten = WriteChromeTrace(tracePath);
+		m_lastExportMessage = std::string(wasWritten ? "Wrote " : "Could not write ") + tracePath;
+	}
+
+	const CpuProfileFrame& frame = m_lastFrame;
+	double frameMs = (double)(frame.endNs - frame.startNs) * 1e-6;
+	ImGui::Text("Frame %u: %.2f ms, %d zones, %lld dropped", frame.frameIndex, frameMs, (int)frame.events.size(), m_numDroppedEvents);
+	if (!m_lastExportMessage.empty())
+	{
+		ImGui::Text("%s", m_lastExportMessage.c_str());
+	}
+
+	// Zone table, most expensive first
+	std::vector<const CpuProfileZoneStats*> sortedZones;
+	for (const CpuProfileZoneStats& stats : m_zoneStats)
+	{
+		sortedZones.push_back(&stats);
+	}
+	std::sort(sortedZones.begin(), sortedZones.end(), [](const CpuProfileZoneStats* a, const CpuProfileZoneStats* b)
+		{
+			return a->averageMs > b->averageMs;
+		});
+
+	ImGui::Columns(5, "CpuProfileZones");
+	ImGui::Text("Zone");		ImGui::NextColumn();
+	ImGui::Text("Calls");		ImGui::NextColumn();
+	ImGui::Text("Last ms");		ImGui::NextColumn();
+	ImGui::Text("Avg ms");		ImGui::NextColumn();
+	ImGui::Text("Peak ms");		ImGui::NextColumn();
+	ImGui::Separator();
+	for (const CpuProfileZoneStats* stats : sortedZones)
+	{
+		ImGui::Text("%s", stats->name);				ImGui::NextColumn();
+		ImGui::Text("%d", stats->numCalls);			ImGui::NextColumn();
+		ImGui::Text("%.3f", stats->lastMs);			ImGui::NextColumn();
+		ImGui::Text("%.3f", stats->averageMs);		ImGui::NextColumn();
+		ImGui::Text("%.3f", stats->peakMs);			ImGui::NextColumn();
+	}
+	ImGui::Columns(1);
+	ImGui::Separator();
+
+	// Flame view: one lane per thread that had zones, nested zones stacked under their parents
+	if (frame.events.empty() || frame.endNs <= frame.startNs)
+	{
+		return;
+	}
+
+	int numThreads = GetNumThreads();
+	std::vector<int> laneDepths((size_t)numThreads, 0);
+	for (const CpuProfileEvent& event : frame.events)
+	{
+		if (event.threadIndex < numThreads)
+		{
+			laneDepths[event.threadIndex] = std::max(laneDepths[event.threadIndex], event.depth + 1);
+		}
+	}
+
+	float rowHeight = ImGui::GetTextLineHeight() + 2.f;
+	std::vector<float> laneTops((size_t)numThreads, 0.f);
+	float height = 0.f;
+	for (int threadIndex = 0; threadIndex < numThreads; ++threadIndex)
+	{
+		if (laneDepths[threadIndex] == 0)
+		{
+			continue;
+		}
+		laneTops[threadIndex] = height + rowHeight;			// Under the lane's name
+		height += rowHeight * (float)(laneDepths[threadIndex] + 1);
+	}
+
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	ImVec2 origin = ImGui::GetCursorScreenPos();
+	float width = std::max(ImGui::GetContentRegionAvail().x, 100.f);
+	double pixelsPerNs = (double)width / (double)(frame.endNs - frame.startNs);
+
+	for (int threadIndex = 0; threadIndex < numThreads; ++threadIndex)
+	{
+		if (laneDepths[threadIndex] > 0)
+		{
+			drawList->AddText(ImVec2(origin.x, origin.y + laneTops[threadIndex] - rowHeight), IM_COL32(200, 200, 200, 255),
+				GetThreadName(threadIndex).c_str());
+		}
+	}
+
+	for (const CpuProfileEvent& event : frame.events)
+	{
+		if (event.threadIndex >= numThreads)
+		{
+			continue;
+		}
+
+		// Zones from other threads can straddle the frame; only the part inside it is drawn
+		long long startNs = std::max(event.startNs, frame.startNs);
+		long long endNs = std::min(event.endNs, frame.endNs);
+		if (endNs <= startNs)
+		{
+			continue;
+		}
+
+		ImVec2 boxMin((float)(origin.x + (double)(startNs - frame.startNs) * pixelsPerNs), origin.y + laneTops[event.threadIndex] + rowHeight * (float)event.depth);
+		ImVec2 boxMax(std::max((float)(origin.x + (double)(endNs - frame.startNs) * pixelsPerNs), boxMin.x + 1.f), boxMin.y + rowHeight - 1.f);
+		drawList->AddRectFilled(boxMin, boxMax, GetZoneColor(event.name));
+		if (boxMax.x - boxMin.x > 24.f)
+		{
+			drawList->PushClipRect(boxMin, boxMax, true);
+			drawList->AddText(ImVec2(boxMin.x + 2.f, boxMin.y), IM_COL32(0, 0, 0, 255), event.name);
+			drawList->PopClipRect();
+		}
+		if (ImGui::IsMouseHoveringRect(boxMin, boxMax))
+		{
+			ImGui::SetTooltip("%s\n%.3f ms on %s", event.name, (double)(event.endNs - event.startNs) * 1e-6, GetThreadName(event.threadIndex).c_str());
+		}
+	}
+	ImGui::Dummy(ImVec2(width, height));
+}
+
+//-----------------------------------------------------------------------------------------------
+CpuProfileScope::CpuProfileScope(const char* name)
+	: m_name(name)
+{
+	if (CpuProfiler::Get().IsEnabled())
+	{
+		m_depth = t_profileThread.m_depth++;
+		m_startNs = CpuProfiler::GetTimeNs();
+	}
+}
+
+CpuProfileScope::~CpuProfileScope()
+{
+	if (m_depth < 0)
+	{
+		return;
+	}
+
+	long long endNs = CpuProfiler::GetTimeNs();
+	t_profileThread.m_depth--;
+	CpuProfiler::Get().Record(m_name, m_startNs, endNs, m_depth);
+}
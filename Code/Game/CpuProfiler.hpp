@@ -0,0 +1,116 @@
+#pragma once
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// One closed zone. name must be a string literal (or otherwise outlive the profiler); only the pointer is kept.
+struct CpuProfileEvent
+{
+	const char* name = nullptr;
+	long long startNs = 0;			// Since the profiler started
+	long long endNs = 0;
+	int threadIndex = 0;
+	int depth = 0;					// Zones open on the same thread when this one began
+};
+
+// Events collected by one EndFrame; zones still open, or closed on other threads after it, land in a later frame
+struct CpuProfileFrame
+{
+	unsigned int frameIndex = 0;
+	long long startNs = 0;
+	long long endNs = 0;
+	std::vector<CpuProfileEvent> events;
+};
+
+struct CpuProfileZoneStats
+{
+	const char* name = nullptr;
+	int numCalls = 0;				// Last frame
+	double lastMs = 0.0;			// Last frame, summed over calls and threads
+	double averageMs = 0.0;			// Exponential average of lastMs over frames that had the zone
+	double peakMs = 0.0;			// Since the last ResetStats
+};
+
+// Per-thread event ring written by exactly one thread and drained by EndFrame; defined in CpuProfiler.cpp
+class CpuProfileThreadBuffer;
+
+// Scoped CPU zones with nanosecond timestamps. Each thread writes closed zones into its own ring without locking;
+// EndFrame drains every ring into a frame, updates the per-zone stats and keeps recent frames for a Chrome trace.
+class CpuProfiler
+{
+public:
+	// The one profiler every zone reports to; it lives until the process exits, so late worker threads are safe
+	static CpuProfiler& Get();
+	static long long GetTimeNs();
+
+	CpuProfiler(const CpuProfiler& copy) = delete;
+	~CpuProfiler();
+
+	void BeginFrame();
+	void EndFrame();
+
+	// Off, zones cost one relaxed load
+	void SetEnabled(bool isEnabled) { m_isEnabled.store(isEnabled, std::memory_order_relaxed); }
+	bool IsEnabled() const { return m_isEnabled.load(std::memory_order_relaxed); }
+
+	// Names the calling thread in the views and the trace
+	void SetThreadName(const char* name);
+
+	// Called by CpuProfileScope on the thread the zone ran on
+	void Record(const char* name, long long startNs, long long endNs, int depth);
+
+	const CpuProfileFrame& GetLastFrame() const { return m_lastFrame; }
+	const std::vector<CpuProfileZoneStats>& GetZoneStats() const { return m_zoneStats; }
+	const CpuProfileZoneStats* FindZoneStats(const char* name) const;
+	long long GetNumDroppedEvents() const { return m_numDroppedEvents; }
+	int GetNumThreads() const;
+	std::string GetThreadName(int threadIndex) const;
+	void ResetStats();
+
+	// Trace Event Format ("X" events in microseconds), loadable in chrome://tracing or Perfetto, over the kept frames
+	std::string ToChromeTrace() const;
+	bool WriteChromeTrace(const std::string& filePath) const;
+	void SetNumHistoryFrames(int numFrames) { m_numHistoryFrames = (numFrames > 0) ? numFrames : 1; }
+
+	// Zone table and a flame view of the last frame, one lane per thread, inside the current ImGui window
+	void DrawImGui();
+
+private:
+	CpuProfiler();
+	CpuProfileThreadBuffer* GetThreadBuffer();
+	void UpdateZoneStats(const CpuProfileFrame& frame);
+
+	std::atomic<bool> m_isEnabled{ true };
+	mutable std::mutex m_threadsMutex;			// Guards the list, not the rings
+	std::vector<std::unique_ptr<CpuProfileThreadBuffer>> m_threads;
+
+	unsigned int m_frameIndex = 0;
+	long long m_frameStartNs = 0;
+	bool m_isFrozen = false;					// The views keep showing the frame they had
+	CpuProfileFrame m_lastFrame;
+	std::deque<CpuProfileFrame> m_history;
+	int m_numHistoryFrames = 240;
+	std::vector<CpuProfileZoneStats> m_zoneStats;
+	long long m_numDroppedEvents = 0;
+	std::string m_lastExportMessage;
+};
+
+// Times its own lifetime as one zone on the calling thread
+class CpuProfileScope
+{
+public:
+	explicit CpuProfileScope(const char* name);
+	~CpuProfileScope();
+
+private:
+	const char* m_name = nullptr;
+	long long m_startNs = 0;
+	int m_depth = -1;				// -1 when the profiler was off at construction
+};
+
+#define PROFILE_SCOPE_JOIN2(a, b) a##b
+#define PROFILE_SCOPE_JOIN(a, b) PROFILE_SCOPE_JOIN2(a, b)
+#define PROFILE_SCOPE(name) CpuProfileScope PROFILE_SCOPE_JOIN(profileScope_, __LINE__)(name)
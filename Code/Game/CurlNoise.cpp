@@ -0,0 +1,125 @@
+#include "Game/CurlNoise.hpp"
+#include "Game/Perlin3D.hpp"
+#include "Game/ParallelFor.hpp"
+#include <cmath>
+
+Vec3 CurlNoiseField::ComputeCurl(const Vec3& position, int period, int numOctaves, float persistence, int seed)
+{
+	// Three independent potentials psi = (psiX, psiY, psiZ); the field is curl(psi)
+	Vec3 dPsiX;
+	Vec3 dPsiY;
+	Vec3 dPsiZ;
+
+	float amplitude = 1.f;
+	float frequency = 1.f;
+	int octavePeriod = period;
+
+	for (int octave = 0; octave < numOctaves; ++octave)
+	{
+		// Doubling the period alongside the frequency keeps every octave tileable over the same volume
+		float px = position.x * frequency;
+		float py = position.y * frequency;
+		float pz = position.z * frequency;
+
+		PerlinSample sampleX = PerlinNoise3DWithDerivative(px, py, pz, octavePeriod, seed * 3 + 0);
+		PerlinSample sampleY = PerlinNoise3DWithDerivative(px, py, pz, octavePeriod, seed * 3 + 1);
+		PerlinSample sampleZ = PerlinNoise3DWithDerivative(px, py, pz, octavePeriod, seed * 3 + 2);
+
+		float derivativeScale = amplitude * frequency;
+		dPsiX += sampleX.derivative * derivativeScale;
+		dPsiY += sampleY.derivative * derivativeScale;
+		dPsiZ += sampleZ.derivative * derivativeScale;
+
+		amplitude *= persistence;
+		frequency *= 2.f;
+		octavePeriod *= 2;
+	}
+
+	return Vec3(dPsiZ.y - dPsiY.z, dPsiX.z - dPsiZ.x, dPsiY.x - dPsiX.y);
+}
+
+void CurlNoiseField::Bake(const CurlNoiseConfig& config)
+{
+	m_config = config;
+
+	int width = config.dimensions.x;
+	int height = config.dimensions.y;
+	int depth = config.dimensions.z;
+
+	m_velocities.assign((size_t)width * height * depth, Vec3());
+
+	float cellsPerTexelX = (float)config.period / (float)width;
+	float cellsPerTexelY = (float)config.period / (float)height;
+	float cellsPerTexelZ = (float)config.period / (float)depth;
+
+	ParallelFor(depth, [&](int zBegin, int zEnd)
+	{
+		for (int z = zBegin; z < zEnd; ++z)
+		{
+			for (int y = 0; y < height; ++y)
+			{
+				for (int x = 0; x < width; ++x)
+				{
+					Vec3 latticePos = Vec3(x * cellsPerTexelX, y * cellsPerTexelY, z * cellsPerTexelZ);
+					Vec3 curl = ComputeCurl(latticePos, config.period, config.numOctaves, config.persistence, config.seed);
+
+					// Derivatives are per lattice cell; convert to per-tile units so strength means "tiles per second"
+					m_velocities[(size_t)z * width * height + y * width + x] = curl * (config.strength / (float)config.period);
+				}
+			}
+		}
+	}, config.numThreads);
+}
+
+Vec3 CurlNoiseField::GetVelocityAt(int x, int y, int z) const
+{
+	int width = m_config.dimensions.x;
+	int height = m_config.dimensions.y;
+	int depth = m_config.dimensions.z;
+
+	x = ((x % width) + width) % width;
+	y = ((y % height) + height) % height;
+	z = ((z % depth) + depth) % depth;
+
+	return m_velocities[(size_t)z * width * height + y * width + x];
+}
+
+Vec3 CurlNoiseField::SampleVelocity(const Vec3& uvw) const
+{
+	if (m_velocities.empty())
+	{
+		return Vec3();
+	}
+
+	// Texel centers sit at (i + 0.5) / size, same convention as a wrapped bilinear texture fetch
+	float fx = uvw.x * m_config.dimensions.x - 0.5f;
+	float fy = uvw.y * m_config.dimensions.y - 0.5f;
+	float fz = uvw.z * m_config.dimensions.z - 0.5f;
+
+	int x0 = (int)std::floor(fx);
+	int y0 = (int)std::floor(fy);
+	int z0 = (int)std::floor(fz);
+
+	float tx = fx - x0;
+	float ty = fy - y0;
+	float tz = fz - z0;
+
+	Vec3 c000 = GetVelocityAt(x0, y0, z0);
+	Vec3 c100 = GetVelocityAt(x0 + 1, y0, z0);
+	Vec3 c010 = GetVelocityAt(x0, y0 + 1, z0);
+	Vec3 c110 = GetVelocityAt(x0 + 1, y0 + 1, z0);
+	Vec3 c001 = GetVelocityAt(x0, y0, z0 + 1);
+	Vec3 c101 = GetVelocityAt(x0 + 1, y0, z0 + 1);
+	Vec3 c011 = GetVelocityAt(x0, y0 + 1, z0 + 1);
+	Vec3 c111 = GetVelocityAt(x0 + 1, y0 + 1, z0 + 1);
+
+	Vec3 cx00 = c000 + (c100 - c000) * tx;
+	Vec3 cx10 = c010 + (c110 - c010) * tx;
+	Vec3 cx01 = c001 + (c101 - c001) * tx;
+	Vec3 cx11 = c011 + (c111 - c011) * tx;
+
+	Vec3 cxy0 = cx00 + (cx10 - cx00) * ty;
+	Vec3 cxy1 = cx01 + (cx11 - cx01) * ty;
+
+	return cxy0 + (cxy1 - cxy0) * tz;
+}
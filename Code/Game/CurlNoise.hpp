@@ -0,0 +1,44 @@
+#pragma once
+#include "Engine/Math/Vec3.hpp"
+#include "Engine/Math/IntVec3.hpp"
+#include <vector>
+
+// Edge length of the wind volume uploaded to the cloud shaders (must match WIND_FIELD_SIZE in CloudShader.hlsl)
+constexpr int WIND_FIELD_SIZE = 32;
+
+struct CurlNoiseConfig
+{
+	IntVec3 dimensions = IntVec3(WIND_FIELD_SIZE, WIND_FIELD_SIZE, WIND_FIELD_SIZE);
+	int period = 4;				// Lattice cells across the volume; the field tiles after this many cells
+	int numOctaves = 2;
+	float persistence = 0.5f;
+	float strength = 1.f;
+	int seed = 0;
+	int numThreads = 0;			// 0 = all hardware threads
+};
+
+// Divergence-free velocity volume built from the curl of three tileable Perlin potentials.
+// Velocities are stored x-fastest, matching the shader's texel indexing.
+class CurlNoiseField
+{
+public:
+	CurlNoiseField() = default;
+
+	void Bake(const CurlNoiseConfig& config);
+
+	// Curl of the potential at a position in lattice units
+	static Vec3 ComputeCurl(const Vec3& position, int period, int numOctaves, float persistence, int seed);
+
+	// Trilinear sample with wrap addressing, uvw in texture space (1.0 = one full tile)
+	Vec3 SampleVelocity(const Vec3& uvw) const;
+
+	Vec3 GetVelocityAt(int x, int y, int z) const;
+
+	IntVec3 GetDimensions() const { return m_config.dimensions; }
+	const std::vector<Vec3>& GetVelocities() const { return m_velocities; }
+	bool IsBaked() const { return !m_velocities.empty(); }
+
+private:
+	CurlNoiseConfig m_config;
+	std::vector<Vec3> m_velocities;
+};
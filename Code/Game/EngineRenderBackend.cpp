@@ -0,0 +1,233 @@
+#include "Game/EngineRenderBackend.hpp"
+#include "Game/GameCommon.hpp"
+#include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Core/DebugRenderSystem.hpp"
+
+extern Window* g_theWindow;
+
+//-----------------------------------------------------------------------------------------------
+IntVec2 EngineRenderBackend::GetRenderDimensions() const
+{
+	return g_theWindow->GetClientDimensions();
+}
+
+float EngineRenderBackend::GetRenderAspect() const
+{
+	return g_theWindow->GetAspect();
+}
+
+//-----------------------------------------------------------------------------------------------
+Shader* EngineRenderBackend::CreateOrGetShader(const char* shaderName, VertexType vertexType)
+{
+	return g_theRenderer->CreateOrGetShader(shaderName, vertexType);
+}
+
+ComputeShader* EngineRenderBackend::CreateOrGetComputeShader(const char* shaderName, VertexType vertexType)
+{
+	return g_theRenderer->CreateOrGetComputeShader(shaderName, vertexType);
+}
+
+Texture* EngineRenderBackend::CreateOrGetTextureFromFile(const char* imageFilePath)
+{
+	return g_theRenderer->CreateOrGetTextureFromFile(imageFilePath);
+}
+
+Texture* EngineRenderBackend::GetTextureForFileName(const char* imageFilePath)
+{
+	return g_theRenderer->GetTextureForFileName(imageFilePath);
+}
+
+Texture* EngineRenderBackend::CreateEmptyTextureWithUAV(const char* name, const IntVec2& dimensions)
+{
+	return g_theRenderer->CreateEmptyTextureWithUAV(name, dimensions);
+}
+
+Texture3D* EngineRenderBackend::CreateTexture3DFromNoise(const IntVec3& dimensions, float scale, int octaves, float persistence, float lacunarity, bool tileable)
+{
+	return g_theRenderer->CreateTexture3DFromNoise(dimensions, scale, octaves, persistence, lacunarity, tileable);
+}
+
+Texture3D* EngineRenderBackend::CreateTexture3DFromWorley(const IntVec3& dimensions, int cellSize, unsigned int seed)
+{
+	return g_theRenderer->CreateTexture3DFromWorley(dimensions, cellSize, seed);
+}
+
+StructuredBuffer* EngineRenderBackend::CreateStructuredBuffer(size_t numElements, size_t elementSize, bool isWritable)
+{
+	return g_theRenderer->CreateStructuredBuffer(numElements, elementSize, isWritable);
+}
+
+void EngineRenderBackend::CopyCPUToGPU(const void* data, size_t numElements, size_t elementSize, StructuredBuffer* buffer)
+{
+	// The structured buffer already knows its stride
+	UNUSED(elementSize);
+	g_theRenderer->CopyCPUToGPU(data, numElements, buffer);
+}
+
+//-----------------------------------------------------------------------------------------------
+void EngineRenderBackend::BeginCamera(const Camera& camera)
+{
+	g_theRenderer->BeginCamera(camera);
+}
+
+void EngineRenderBackend::EndCamera(const Camera& camera)
+{
+	g_theRenderer->EndCamera(camera);
+}
+
+void EngineRenderBackend::ClearScreen(const Rgba8& clearColor)
+{
+	g_theRenderer->ClearScreen(clearColor);
+}
+
+void EngineRenderBackend::PreRenderMain()
+{
+	g_theRenderer->PreRenderMain();
+}
+
+void EngineRenderBackend::PreRenderShadowMap()
+{
+	g_theRenderer->PreRenderShadowMap();
+}
+
+void EngineRenderBackend::RenderGodRays()
+{
+	g_theRenderer->RenderGodRays();
+}
+
+void EngineRenderBackend::RenderDebugWorld(const Camera& camera)
+{
+	DebugRenderWorld(camera);
+}
+
+void EngineRenderBackend::RenderDebugScreen(const Camera& camera)
+{
+	DebugRenderScreen(camera);
+}
+
+void EngineRenderBackend::SetCurrentCamera(PipelineStage stage, const Camera& camera)
+{
+	g_theRenderer->SetCurrentCamera(stage, camera);
+}
+
+void EngineRenderBackend::SetModelConstants()
+{
+	g_theRenderer->SetModelConstants();
+}
+
+void EngineRenderBackend::SetModelConstants(const Mat44& modelMatrix, const Rgba8& modelColor)
+{
+	g_theRenderer->SetModelConstants(modelMatrix, modelColor);
+}
+
+void EngineRenderBackend::SetLightConstants(PipelineStage stage, const LightConstants& lightConstants)
+{
+	g_theRenderer->SetLightConstants(stage, lightConstants);
+}
+
+void EngineRenderBackend::SetCloudConstants(PipelineStage stage, const CloudConstants& cloudConstants)
+{
+	g_theRenderer->SetCloudConstants(stage, cloudConstants);
+}
+
+void EngineRenderBackend::SetShadowConstants(const ShadowConstants& shadowConstants)
+{
+	g_theRenderer->SetShadowConstants(shadowConstants);
+}
+
+void EngineRenderBackend::SetShadowConstants(PipelineStage stage, const ShadowConstants& shadowConstants)
+{
+	g_theRenderer->SetShadowConstants(stage, shadowConstants);
+}
+
+void EngineRenderBackend::SetGodRaysConstants(const GodRaysConstants& godRaysConstants)
+{
+	g_theRenderer->SetGodRaysConstants(godRaysConstants);
+}
+
+//-----------------------------------------------------------------------------------------------
+void EngineRenderBackend::SetBlendMode(BlendMode blendMode)
+{
+	g_theRenderer->SetBlendMode(blendMode);
+}
+
+void EngineRenderBackend::SetDepthMode(DepthMode depthMode)
+{
+	g_theRenderer->SetDepthMode(depthMode);
+}
+
+void EngineRenderBackend::SetRasterizerMode(RasterizerMode rasterizerMode)
+{
+	g_theRenderer->SetRasterizerMode(rasterizerMode);
+}
+
+void EngineRenderBackend::SetSamplerMode(SamplerMode samplerMode)
+{
+	g_theRenderer->SetSamplerMode(samplerMode);
+}
+
+void EngineRenderBackend::BindShader(Shader* shader)
+{
+	g_theRenderer->BindShader(shader);
+}
+
+void EngineRenderBackend::BindComputeShader(ComputeShader* computeShader)
+{
+	g_theRenderer->BindComputeShader(computeShader);
+}
+
+void EngineRenderBackend::UnbindComputeShader()
+{
+	g_theRenderer->UnbindComputeShader();
+}
+
+void EngineRenderBackend::BindTexture()
+{
+	g_theRenderer->BindTexture();
+}
+
+void EngineRenderBackend::BindTexture(Texture* texture, int slot)
+{
+	g_theRenderer->BindTexture(texture, slot);
+}
+
+void EngineRenderBackend::BindTexture(PipelineStage stage, Texture* texture, int slot)
+{
+	g_theRenderer->BindTexture(stage, texture, slot);
+}
+
+void EngineRenderBackend::BindTexture3D(PipelineStage stage, Texture3D* texture, int slot)
+{
+	g_theRenderer->BindTexture3D(stage, texture, slot);
+}
+
+void EngineRenderBackend::BindTextureWithUAV(PipelineStage stage, Texture* texture)
+{
+	g_theRenderer->BindTextureWithUAV(stage, texture);
+}
+
+void EngineRenderBackend::BindShaderResources(Texture* texture, int slot)
+{
+	g_theRenderer->BindShaderResources(texture->GetShaderResourceView(), slot);
+}
+
+void EngineRenderBackend::BindStructuredBufferToWrite(int slot, StructuredBuffer* buffer)
+{
+	g_theRenderer->BindStructuredBufferToWrite(slot, buffer);
+}
+
+//-----------------------------------------------------------------------------------------------
+void EngineRenderBackend::DispatchComputeJob(ComputeShader* computeShader, int threadGroupsX, int threadGroupsY, int threadGroupsZ)
+{
+	g_theRenderer->DispatchComputeJob(computeShader, threadGroupsX, threadGroupsY, threadGroupsZ);
+}
+
+void EngineRenderBackend::DrawVertexArray(int numVertexes, const Vertex_PCU* vertexes)
+{
+	g_theRenderer->DrawVertexArray(numVertexes, vertexes);
+}
+
+void EngineRenderBackend::DrawFullScreenQuad()
+{
+	g_theRenderer->DrawFullScreenQuad();
+}
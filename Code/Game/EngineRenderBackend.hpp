@@ -0,0 +1,57 @@
+#pragma once
+#include "Game/GameRenderBackend.hpp"
+
+// GameRenderBackend on g_theRenderer and g_theWindow
+class EngineRenderBackend : public GameRenderBackend
+{
+public:
+	IntVec2 GetRenderDimensions() const override;
+	float GetRenderAspect() const override;
+
+	Shader* CreateOrGetShader(const char* shaderName, VertexType vertexType) override;
+	ComputeShader* CreateOrGetComputeShader(const char* shaderName, VertexType vertexType) override;
+	Texture* CreateOrGetTextureFromFile(const char* imageFilePath) override;
+	Texture* GetTextureForFileName(const char* imageFilePath) override;
+	Texture* CreateEmptyTextureWithUAV(const char* name, const IntVec2& dimensions) override;
+	Texture3D* CreateTexture3DFromNoise(const IntVec3& dimensions, float scale, int octaves, float persistence, float lacunarity, bool tileable) override;
+	Texture3D* CreateTexture3DFromWorley(const IntVec3& dimensions, int cellSize, unsigned int seed) override;
+	StructuredBuffer* CreateStructuredBuffer(size_t numElements, size_t elementSize, bool isWritable) override;
+	void CopyCPUToGPU(const void* data, size_t numElements, size_t elementSize, StructuredBuffer* buffer) override;
+	using GameRenderBackend::CopyCPUToGPU;
+
+	void BeginCamera(const Camera& camera) override;
+	void EndCamera(const Camera& camera) override;
+	void ClearScreen(const Rgba8& clearColor) override;
+	void PreRenderMain() override;
+	void PreRenderShadowMap() override;
+	void RenderGodRays() override;
+	void RenderDebugWorld(const Camera& camera) override;
+	void RenderDebugScreen(const Camera& camera) override;
+	void SetCurrentCamera(PipelineStage stage, const Camera& camera) override;
+	void SetModelConstants() override;
+	void SetModelConstants(const Mat44& modelMatrix, const Rgba8& modelColor) override;
+	void SetLightConstants(PipelineStage stage, const LightConstants& lightConstants) override;
+	void SetCloudConstants(PipelineStage stage, const CloudConstants& cloudConstants) override;
+	void SetShadowConstants(const ShadowConstants& shadowConstants) override;
+	void SetShadowConstants(PipelineStage stage, const ShadowConstants& shadowConstants) override;
+	void SetGodRaysConstants(const GodRaysConstants& godRaysConstants) override;
+
+	void SetBlendMode(BlendMode blendMode) override;
+	void SetDepthMode(DepthMode depthMode) override;
+	void SetRasterizerMode(RasterizerMode rasterizerMode) override;
+	void SetSamplerMode(SamplerMode samplerMode) override;
+	void BindShader(Shader* shader) override;
+	void BindComputeShader(ComputeShader* computeShader) override;
+	void UnbindComputeShader() override;
+	void BindTexture() override;
+	void BindTexture(Texture* texture, int slot = 0) override;
+	void BindTexture(PipelineStage stage, Texture* texture, int slot) override;
+	void BindTexture3D(PipelineStage stage, Texture3D* texture, int slot) override;
+	void BindTextureWithUAV(PipelineStage stage, Texture* texture) override;
+	void BindShaderResources(Texture* texture, int slot) override;
+	void BindStructuredBufferToWrite(int slot, StructuredBuffer* buffer) override;
+
+	void DispatchComputeJob(ComputeShader* computeShader, int threadGroupsX, int threadGroupsY, int threadGroupsZ) override;
+	void DrawVertexArray(int numVertexes, const Vertex_PCU* vertexes) override;
+	void DrawFullScreenQuad() override;
+};
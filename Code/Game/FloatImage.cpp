@@ -0,0 +1,255 @@
+#include "Game/FloatImage.hpp"
+#include <cstdint>
+#include <fstream>
+
+static void AppendUInt32BigEndian(std::vector<unsigned char>& bytes, uint32_t value)
+{
+	bytes.push_back((unsigned char)(value >> 24));
+	bytes.push_back((unsigned char)(value >> 16));
+	bytes.push_back((unsigned char)(value >> 8));
+	bytes.push_back((unsigned char)(value));
+}
+
+template <typename T>
+static void AppendLittleEndian(std::vector<unsigned char>& bytes, T value)
+{
+	const unsigned char* valueBytes = reinterpret_cast<const unsigned char*>(&value);
+	bytes.insert(bytes.end(), valueBytes, valueBytes + sizeof(T));
+}
+
+static void AppendString(std::vector<unsigned char>& bytes, const char* text)
+{
+	while (*text)
+	{
+		bytes.push_back((unsigned char)*text++);
+	}
+	bytes.push_back(0);
+}
+
+static uint32_t ComputeCRC32(const unsigned char* data, size_t size, uint32_t crc = 0)
+{
+	static uint32_t s_table[256] = {};
+	static bool s_isTableBuilt = false;
+	if (!s_isTableBuilt)
+	{
+		for (uint32_t n = 0; n < 256; ++n)
+		{
+			uint32_t c = n;
+			for (int k = 0; k < 8; ++k)
+			{
+				c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+			}
+			s_table[n] = c;
+		}
+		s_isTableBuilt = true;
+	}
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; ++i)
+	{
+		crc = s_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+static void AppendPNGChunk(std::vector<unsigned char>& file, const char type[4], const std::vector<unsigned char>& data)
+{
+	AppendUInt32BigEndian(file, (uint32_t)data.size());
+
+	size_t typeStart = file.size();
+	file.insert(file.end(), type, type + 4);
+	file.insert(file.end(), data.begin(), data.end());
+
+	AppendUInt32BigEndian(file, ComputeCRC32(file.data() + typeStart, file.size() - typeStart));
+}
+
+static unsigned char FloatToByte(float value)
+{
+	value = (value < 0.f) ? 0.f : ((value > 1.f) ? 1.f : value);
+	return (unsigned char)(value * 255.f + 0.5f);
+}
+
+FloatImage::FloatImage(int width, int height)
+{
+	Resize(width, height);
+}
+
+void FloatImage::Resize(int width, int height)
+{
+	m_width = width;
+	m_height = height;
+	m_pixels.assign((size_t)width * height, Vec4(0.f, 0.f, 0.f, 0.f));
+}
+
+bool FloatImage::WritePNG(const std::string& filePath) const
+{
+	// Raw scanlines, each prefixed with filter type 0
+	std::vector<unsigned char> raw;
+	raw.reserve((size_t)m_height * (m_width * 4 + 1));
+	for (int y = 0; y < m_height; ++y)
+	{
+		raw.push_back(0);
+		for (int x = 0; x < m_width; ++x)
+		{
+			const Vec4& pixel = GetPixel(x, y);
+			raw.push_back(FloatToByte(pixel.x));
+			raw.push_back(FloatToByte(pixel.y));
+			raw.push_back(FloatToByte(pixel.z));
+			raw.push_back(FloatToByte(pixel.w));
+		}
+	}
+
+	// zlib stream made of stored deflate blocks (max 65535 bytes each) plus an Adler-32 trailer
+	std::vector<unsigned char> zlib;
+	zlib.push_back(0x78);
+	zlib.push_back(0x01);
+
+	size_t offset = 0;
+	do
+	{
+		size_t blockSize = raw.size() - offset;
+		if (blockSize > 65535)
+		{
+			blockSize = 65535;
+		}
+		bool isFinal = (offset + blockSize == raw.size());
+
+		zlib.push_back(isFinal ? 1 : 0);
+		zlib.push_back((unsigned char)(blockSize & 0xFF));
+		zlib.push_back((unsigned char)(blockSize >> 8));
+		zlib.push_back((unsigned char)(~blockSize & 0xFF));
+		zlib.push_back((unsigned char)((~blockSize >> 8) & 0xFF));
+		zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+
+		offset += blockSize;
+	} while (offset < raw.size());
+
+	uint32_t adlerA = 1;
+	uint32_t adlerB = 0;
+	for (unsigned char byte : raw)
+	{
+		adlerA = (adlerA + byte) % 65521u;
+		adlerB = (adlerB + adlerA) % 65521u;
+	}
+	AppendUInt32BigEndian(zlib, (adlerB << 16) | adlerA);
+
+	std::vector<unsigned char> header;
+	AppendUInt32BigEndian(header, (uint32_t)m_width);
+	AppendUInt32BigEndian(header, (uint32_t)m_height);
+	header.push_back(8);	// Bit depth
+	header.push_back(6);	// RGBA
+	header.push_back(0);	// Deflate
+	header.push_back(0);	// Adaptive filtering
+	header.push_back(0);	// No interlace
+
+	std::vector<unsigned char> file = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	AppendPNGChunk(file, "IHDR", header);
+	AppendPNGChunk(file, "IDAT", zlib);
+	AppendPNGChunk(file, "IEND", std::vector<unsigned char>());
+
+	std::ofstream stream(filePath, std::ios::binary);
+	if (!stream)
+	{
+		return false;
+	}
+	stream.write(reinterpret_cast<const char*>(file.data()), (std::streamsize)file.size());
+	return stream.good();
+}
+
+bool FloatImage::WriteEXR(const std::string& filePath) const
+{
+	std::vector<unsigned char> file;
+
+	// Magic number and version 2, single-part scanline
+	AppendLittleEndian<int32_t>(file, 20000630);
+	AppendLittleEndian<int32_t>(file, 2);
+
+	// Channels must be listed alphabetically; pixel data follows the same order
+	static const char* s_channelNames[4] = { "A", "B", "G", "R" };
+	std::vector<unsigned char> channels;
+	for (const char* name : s_channelNames)
+	{
+		AppendString(channels, name);
+		AppendLittleEndian<int32_t>(channels, 2);	// FLOAT
+		AppendLittleEndian<int32_t>(channels, 0);	// pLinear + reserved
+		AppendLittleEndian<int32_t>(channels, 1);	// xSampling
+		AppendLittleEndian<int32_t>(channels, 1);	// ySampling
+	}
+	channels.push_back(0);
+
+	AppendString(file, "channels");
+	AppendString(file, "chlist");
+	AppendLittleEndian<int32_t>(file, (int32_t)channels.size());
+	file.insert(file.end(), channels.begin(), channels.end());
+
+	AppendString(file, "compression");
+	AppendString(file, "compression");
+	AppendLittleEndian<int32_t>(file, 1);
+	file.push_back(0);	// NO_COMPRESSION
+
+	for (const char* windowName : { "dataWindow", "displayWindow" })
+	{
+		AppendString(file, windowName);
+		AppendString(file, "box2i");
+		AppendLittleEndian<int32_t>(file, 16);
+		AppendLittleEndian<int32_t>(file, 0);
+		AppendLittleEndian<int32_t>(file, 0);
+		AppendLittleEndian<int32_t>(file, m_width - 1);
+		AppendLittleEndian<int32_t>(file, m_height - 1);
+	}
+
+	AppendString(file, "lineOrder");
+	AppendString(file, "lineOrder");
+	AppendLittleEndian<int32_t>(file, 1);
+	file.push_back(0);	// INCREASING_Y
+
+	AppendString(file, "pixelAspectRatio");
+	AppendString(file, "float");
+	AppendLittleEndian<int32_t>(file, 4);
+	AppendLittleEndian<float>(file, 1.f);
+
+	AppendString(file, "screenWindowCenter");
+	AppendString(file, "v2f");
+	AppendLittleEndian<int32_t>(file, 8);
+	AppendLittleEndian<float>(file, 0.f);
+	AppendLittleEndian<float>(file, 0.f);
+
+	AppendString(file, "screenWindowWidth");
+	AppendString(file, "float");
+	AppendLittleEndian<int32_t>(file, 4);
+	AppendLittleEndian<float>(file, 1.f);
+
+	file.push_back(0);	// End of header
+
+	// Offset table, one chunk per scanline
+	int32_t lineDataSize = m_width * 4 * (int32_t)sizeof(float);
+	uint64_t chunkOffset = file.size() + (uint64_t)m_height * sizeof(uint64_t);
+	for (int y = 0; y < m_height; ++y)
+	{
+		AppendLittleEndian<uint64_t>(file, chunkOffset);
+		chunkOffset += 8 + lineDataSize;
+	}
+
+	for (int y = 0; y < m_height; ++y)
+	{
+		AppendLittleEndian<int32_t>(file, y);
+		AppendLittleEndian<int32_t>(file, lineDataSize);
+		for (int channel = 0; channel < 4; ++channel)
+		{
+			for (int x = 0; x < m_width; ++x)
+			{
+				const Vec4& pixel = GetPixel(x, y);
+				float value = (channel == 0) ? pixel.w : ((channel == 1) ? pixel.z : ((channel == 2) ? pixel.y : pixel.x));
+				AppendLittleEndian<float>(file, value);
+			}
+		}
+	}
+
+	std::ofstream stream(filePath, std::ios::binary);
+	if (!stream)
+	{
+		return false;
+	}
+	stream.write(reinterpret_cast<const char*>(file.data()), (std::streamsize)file.size());
+	return stream.good();
+}
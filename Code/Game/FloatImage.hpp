@@ -0,0 +1,32 @@
+#pragma once
+#include "Engine/Math/Vec4.hpp"
+#include <string>
+#include <vector>
+
+// Linear float RGBA image for offline renders. Row 0 is the top of the image.
+class FloatImage
+{
+public:
+	FloatImage() = default;
+	FloatImage(int width, int height);
+
+	void Resize(int width, int height);
+
+	const Vec4& GetPixel(int x, int y) const { return m_pixels[(size_t)y * m_width + x]; }
+	void SetPixel(int x, int y, const Vec4& rgba) { m_pixels[(size_t)y * m_width + x] = rgba; }
+
+	int GetWidth() const { return m_width; }
+	int GetHeight() const { return m_height; }
+	const std::vector<Vec4>& GetPixels() const { return m_pixels; }
+
+	// 8-bit RGBA, values clamped to [0,1]. Uses stored (uncompressed) deflate blocks, so no zlib dependency.
+	bool WritePNG(const std::string& filePath) const;
+
+	// Uncompressed 32-bit float scanline OpenEXR
+	bool WriteEXR(const std::string& filePath) const;
+
+private:
+	int m_width = 0;
+	int m_height = 0;
+	std::vector<Vec4> m_pixels;
+};
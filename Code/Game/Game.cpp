@@ -3,6 +3,7 @@
 #include "Game/Entity.hpp"
 #include "Game/app.hpp"
 #include "Game/GameCommon.hpp"
+#include "Game/GameRenderBackend.hpp"
 #include "Game/Player.hpp"
 #include "Game/Prop.hpp"
 #include "Engine/Core/VertexUtils.hpp"
@@ -16,6 +17,9 @@
 #include "Engine/Core/DebugRenderSystem.hpp"
 #include "ThirdParty/Engine_Code_ThirdParty_Squirrel/SmoothNoise.hpp"
 #include "Game/Perlin3D.hpp"
+#include "Game/CloudBenchmarks.hpp"
+#include "Game/CloudOpacityShadowMap.hpp"
+#include "Game/CpuProfiler.hpp"
 
 extern InputSystem* g_theInputSystem;
 extern AudioSystem* g_theAudioSystem;
@@ -31,6 +35,7 @@ Game::Game()
 {
 	SubscribeEventCallbackFunction("SetGameScale", Event_SetGameTimeScale);
 	SubscribeEventCallbackFunction("Controls", Event_Controls);
+	SubscribeCloudBenchmarkEvents();
 
 	//m_worldCamera
 
@@ -52,7 +57,7 @@ Game::~Game()
 
 void Game::Startup()
 {
-	g_theRenderer->SetRasterizerMode(RasterizerMode::SOLID_CULL_BACK);
+	g_theRenderBackend->SetRasterizerMode(RasterizerMode::SOLID_CULL_BACK);
 
 	m_entities[0] = new Player(this, Vec3(-10, -200, 140));
 	m_entities[0]->m_orientationDegrees.m_yawDegrees = 90.f;	
@@ -135,7 +140,7 @@ void Game::Startup()
 
 	m_player = (Player*)m_entities[0];
 
-	float aspect = g_theWindow->GetAspect();
+	float aspect = g_theRenderBackend->GetRenderAspect();
 
 	m_player->m_playerCam.SetPerspView(aspect, 60.f, 0.1f, 10000.f);
 	m_player->m_playerCam.SetRenderBasis(Vec3::DIRECTX11_IBASIS, Vec3::DIRECTX11_JBASIS, Vec3::DIRECTX11_KBASIS);
@@ -189,7 +194,7 @@ void Game::Startup()
 	//{
 	//	cloud->BuildVerts();
 	//}
-	m_shadowShader = g_theRenderer->CreateOrGetShader("Data/Shaders/DefaultShadows", VertexType::VERTEX_PCU);
+	m_shadowShader = g_theRenderBackend->CreateOrGetShader("Data/Shaders/DefaultShadows", VertexType::VERTEX_PCU);
 
 }
 
@@ -254,6 +259,7 @@ void Game::Shutdown()
 
 void Game::Update()
 {
+	PROFILE_SCOPE("Game::Update");
 	float deltaSeconds = m_gameClock->GetDeltaSeoconds();
 
 	if(g_theInputSystem->WasKeyJustPressed('P'))
@@ -399,6 +405,10 @@ void Game::Update()
 			//update stuff
 			m_rotationoffset +=  10 * deltaSeconds;
 
+			std::vector<SceneOccluderGPU> sceneOccluders;
+			GatherSceneOccluders(sceneOccluders);
+			m_singleCloudManager->SetSceneOccluders(sceneOccluders);
+
 			//m_weather.Update(deltaSeconds, *m_cloudManager);
 			m_weather.Update(deltaSeconds, *m_singleCloudManager);
 			//m_cloudManager.UpdateClouds(deltaSeconds, m_weather);
@@ -413,7 +423,7 @@ void Game::Update()
 
 	m_screenCamera.SetOrthoView(Vec2(0.f, 0.f), Vec2(1600.f, 800.f));
 
-	float aspect = g_theWindow->GetAspect();
+	float aspect = g_theRenderBackend->GetRenderAspect();
 
 	m_player->m_playerCam.SetPerspView(aspect, 60.f, 0.1f, 1000.f);
 		
@@ -430,6 +440,22 @@ void Game::RunCompute()
 {
 }
 
+void Game::GatherSceneOccluders(std::vector<SceneOccluderGPU>& occluders) const
+{
+	// Box props are unit cubes scaled by their model matrix; the clouds stop at them
+	for (int i = 0; i < maxEntities; i++)
+	{
+		Prop* prop = dynamic_cast<Prop*>(m_entities[i]);
+		if (prop == nullptr || (prop->GetType() != ObjectType::Cube && prop->GetType() != ObjectType::UniformColorCube))
+		{
+			continue;
+		}
+
+		const Mat44& model = prop->m_modelMatrix;
+		occluders.push_back(MakeSceneOccluder(model.GetTranslation3D(), model.GetIBasis3D(), model.GetJBasis3D(), model.GetKBasis3D()));
+	}
+}
+
 void Game::PrepareForRender()
 {
 }
@@ -521,7 +547,8 @@ void Game::EndFrame()
 
 void Game::RenderShadowMap()
 {
-	g_theRenderer->PreRenderShadowMap();
+	PROFILE_SCOPE("Game::RenderShadowMap");
+	g_theRenderBackend->PreRenderShadowMap();
 
 	//Vec3 sunDirection = m_sunOrientation.GetMatrix_XFwd_YLeft_ZUp().GetIBasis3D();
 
@@ -566,16 +593,16 @@ void Game::RenderShadowMap()
 
 	
 
-	g_theRenderer->BeginCamera(m_lightCamera);
+	g_theRenderBackend->BeginCamera(m_lightCamera);
 
-	g_theRenderer->SetModelConstants();
+	g_theRenderBackend->SetModelConstants();
 	//g_theRenderer->SetBlendMode(BlendMode::ALPHA);
-	g_theRenderer->BindTexture(nullptr);
+	g_theRenderBackend->BindTexture(nullptr);
 	//g_theRenderer->BindTexture(nullptr);
 	//g_theRenderer->BindShader(nullptr);
 
-	g_theRenderer->SetDepthMode(DepthMode::ENABLED);
-	g_theRenderer->SetRasterizerMode(RasterizerMode::SOLID_CULL_BACK);
+	g_theRenderBackend->SetDepthMode(DepthMode::ENABLED);
+	g_theRenderBackend->SetRasterizerMode(RasterizerMode::SOLID_CULL_BACK);
 
 	m_entities[1]->RenderShadow();
 
@@ -583,7 +610,7 @@ void Game::RenderShadowMap()
 
 	m_entities[3]->RenderShadow();
 
-	m_singleCloudManager->RenderShadows();
+	m_singleCloudManager->RenderShadows(MakeLightShadowFrame());
 
 	for (int i = 0; i < maxEntities; i++)
 	{
@@ -595,21 +622,38 @@ void Game::RenderShadowMap()
 
 	
 
-	g_theRenderer->EndCamera(m_lightCamera);
+	g_theRenderBackend->EndCamera(m_lightCamera);
+}
+
+// The light camera RenderShadowMap sets up, as the frame CloudShadowShader marches the opacity map in
+CloudOpacityShadowFrame Game::MakeLightShadowFrame() const
+{
+	Vec3 iBasis, jBasis, kBasis;
+	m_lightCamera.m_orientation.GetVectors_XFwd_YLeft_ZUp(iBasis, jBasis, kBasis);
+
+	CloudOpacityShadowFrame frame;
+	frame.origin = m_lightCamera.m_position;
+	frame.forward = iBasis;
+	frame.right = jBasis * -1.f;
+	frame.up = kBasis;
+	frame.halfExtent = 500.f;
+	frame.maxDistance = 1000.f;
+	return frame;
 }
 
 void Game::Render()
 {
+	PROFILE_SCOPE("Game::Render");
 	RenderShadowMap();
 
-	g_theRenderer->ClearScreen(Rgba8(135, 206, 235, 1));
+	g_theRenderBackend->ClearScreen(Rgba8(135, 206, 235, 1));
 
-	g_theRenderer->PreRenderMain();
+	g_theRenderBackend->PreRenderMain();
 
-	g_theRenderer->BeginCamera(m_player->m_playerCam);
+	g_theRenderBackend->BeginCamera(m_player->m_playerCam);
 
 	//g_theRenderer->SetLightConstants(m_sunDirection.GetNormalized(), m_sunIntensity, m_ambientIntensity);
-	g_theRenderer->SetModelConstants();
+	g_theRenderBackend->SetModelConstants();
 
 	
 
@@ -617,23 +661,23 @@ void Game::Render()
 
 	sc.lightProjection = ViewProjectionMatrix;
 
-	g_theRenderer->SetShadowConstants(sc);
-	g_theRenderer->SetBlendMode(BlendMode::OPAQUE);
-	g_theRenderer->BindTexture(nullptr);
-	g_theRenderer->BindTexture(g_theRenderer->GetTextureForFileName("ShadowMap"), 1);
-	g_theRenderer->BindTexture(m_singleCloudManager->m_outShadowTexture, 2);
+	g_theRenderBackend->SetShadowConstants(sc);
+	g_theRenderBackend->SetBlendMode(BlendMode::OPAQUE);
+	g_theRenderBackend->BindTexture(nullptr);
+	g_theRenderBackend->BindTexture(g_theRenderBackend->GetTextureForFileName("ShadowMap"), 1);
+	g_theRenderBackend->BindTexture(m_singleCloudManager->m_outShadowTexture, 2);
 	//g_theRenderer->BindTexture(nullptr);
-	g_theRenderer->BindShader(m_shadowShader);
+	g_theRenderBackend->BindShader(m_shadowShader);
 
 	//g_theRenderer->BindTexture3D(m_noiseTexture);
-	g_theRenderer->SetDepthMode(DepthMode::ENABLED);
-	g_theRenderer->SetRasterizerMode(RasterizerMode::SOLID_CULL_BACK);
+	g_theRenderBackend->SetDepthMode(DepthMode::ENABLED);
+	g_theRenderBackend->SetRasterizerMode(RasterizerMode::SOLID_CULL_BACK);
 
 	if (!m_attract)
 	{
-		g_theRenderer->DrawVertexArray((int)m_sunVerts.size(), m_sunVerts.data());
-		g_theRenderer->SetRasterizerMode(RasterizerMode::WIREFRAME_CULL_BACK);
-		g_theRenderer->DrawVertexArray((int)m_sunWireframeVerts.size(), m_sunWireframeVerts.data());
+		g_theRenderBackend->DrawVertexArray((int)m_sunVerts.size(), m_sunVerts.data());
+		g_theRenderBackend->SetRasterizerMode(RasterizerMode::WIREFRAME_CULL_BACK);
+		g_theRenderBackend->DrawVertexArray((int)m_sunWireframeVerts.size(), m_sunWireframeVerts.data());
 
 		std::vector<Vertex_PCU> sunPointverts;
 
@@ -647,13 +691,13 @@ void Game::Render()
 
 		AddVertsForArrow3D(sunPointverts, m_lightCamera.m_position, m_lightCamera.m_position + (direction * 5.f), .7f, .2f, .3f, Rgba8::RED);
 
-		g_theRenderer->DrawVertexArray((int)sunPointverts.size(), sunPointverts.data());
+		g_theRenderBackend->DrawVertexArray((int)sunPointverts.size(), sunPointverts.data());
 
-		g_theRenderer->SetRasterizerMode(RasterizerMode::SOLID_CULL_BACK);
+		g_theRenderBackend->SetRasterizerMode(RasterizerMode::SOLID_CULL_BACK);
 
 		m_singleCloudManager->DebugRenderClouds();
 
-		g_theRenderer->BindTexture();
+		g_theRenderBackend->BindTexture();
 		for (int i = 0; i < maxEntities; i++)
 		{
 			if (m_entities[i] != nullptr)
@@ -665,10 +709,10 @@ void Game::Render()
 		
 		m_singleCloudManager->RenderClouds();
 
-		DebugRenderWorld(m_player->m_playerCam);
+		g_theRenderBackend->RenderDebugWorld(m_player->m_playerCam);
 	}
 
-	g_theRenderer->EndCamera(m_player->m_playerCam);
+	g_theRenderBackend->EndCamera(m_player->m_playerCam);
 
 
 	// Transform sun position from world-space to clip-space
@@ -698,17 +742,17 @@ void Game::Render()
 
 	grc.viewProj = m_player->m_playerCam.GetViewProjectionMatrix();
 
-	g_theRenderer->SetGodRaysConstants(grc);
+	g_theRenderBackend->SetGodRaysConstants(grc);
 
-	g_theRenderer->BindTexture(m_singleCloudManager->m_outShadowTexture, 1);
+	g_theRenderBackend->BindTexture(m_singleCloudManager->m_outShadowTexture, 1);
 
-	g_theRenderer->RenderGodRays();
+	g_theRenderBackend->RenderGodRays();
 
-	g_theRenderer->PreRenderMain();
+	g_theRenderBackend->PreRenderMain();
 #pragma region ScreenCamera
 
 	//create new camera for UI stuff that is bigger than the world camera
-	g_theRenderer->BeginCamera(m_screenCamera);
+	g_theRenderBackend->BeginCamera(m_screenCamera);
 
 
 	//render attract screen on UI
@@ -721,7 +765,7 @@ void Game::Render()
 	//render game if we are not in attract mode
 	if (!m_attract)
 	{
-		DebugRenderScreen(m_screenCamera);
+		g_theRenderBackend->RenderDebugScreen(m_screenCamera);
 // 		Vertex_PCU tempPlay1Verts[3];
 // 
 // 		Vertex_PCU m_playButtonVerts[3];
@@ -745,7 +789,7 @@ void Game::Render()
 
 	
 
-	g_theRenderer->EndCamera(m_screenCamera);
+	g_theRenderBackend->EndCamera(m_screenCamera);
 
 #pragma endregion ScreenCameraStuff
 }
@@ -30,11 +30,13 @@ class Game
 
 	void RunCompute();
 	void PrepareForRender();
+	void GatherSceneOccluders(std::vector<SceneOccluderGPU>& occluders) const;
 
 	void BeginFrame();
 	void EndFrame();
 
 	void RenderShadowMap();
+	CloudOpacityShadowFrame MakeLightShadowFrame() const;
 
 	void Render();
 	void RenderAttractScreen();
@@ -1,4 +1,5 @@
 #include "GameCommon.hpp"
+#include "Game/GameRenderBackend.hpp"
 #include <Engine/Core/Vertex_PCU.hpp>
 #include "Engine/Renderer/Renderer.hpp"
 #include "Engine/Core/VertexUtils.hpp"
@@ -118,7 +119,7 @@ void DebugDrawLine(Vec2 const& start, Vec2 const& end, float thickness, Rgba8 co
 		//TransformVertexArrayXY3D(NUM_SEGMENTS, verts, 1.f, Atan2Degrees(end.y - start.y, end.x - start.x), Vec2(0, 0));
 		g_theRenderer -> DrawVertexArray(NUM_VERTS, verts);
 		*/
-		g_theRenderer -> DrawVertexArray(NUM_VERTS, verts);
+		g_theRenderBackend->DrawVertexArray(NUM_VERTS, verts);
 }
 
 
@@ -172,8 +173,8 @@ void DebugDrawRing(Vec2 const& center, float radius, float thickness, Rgba8 cons
 		verts[vertIndexD].m_color = color;
 		verts[vertIndexE].m_color = color;
 		verts[vertIndexF].m_color = color;
-		g_theRenderer->BindTexture(nullptr);
-		g_theRenderer -> DrawVertexArray(NUM_VERTS, verts);
+		g_theRenderBackend->BindTexture(nullptr);
+		g_theRenderBackend->DrawVertexArray(NUM_VERTS, verts);
 	}
 }
 
@@ -9,9 +9,11 @@
 #include "Engine/Math/RandomNumberGenerator.hpp"
 
 class App;
+class GameRenderBackend;
 	
 	extern App* g_theApp;
 	extern Renderer* g_theRenderer;
+	extern GameRenderBackend* g_theRenderBackend;
 	extern InputSystem* g_theInputSystem;
 	extern AudioSystem* g_theAudioSystem;
 	extern RandomNumberGenerator* g_theRandom;
@@ -0,0 +1,364 @@
+#include "Game/GameRenderBackend.hpp"
+#include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Core/Vertex_PCU.hpp"
+#include <cstdio>
+
+//-----------------------------------------------------------------------------------------------
+int RenderBackendCounters::GetTotalCalls() const
+{
+	int total = 0;
+	for (int callIndex = 0; callIndex < (int)RenderBackendCall::COUNT; ++callIndex)
+	{
+		total += numCalls[callIndex];
+	}
+	return total;
+}
+
+void RenderBackendCounters::Add(const RenderBackendCounters& other)
+{
+	for (int callIndex = 0; callIndex < (int)RenderBackendCall::COUNT; ++callIndex)
+	{
+		numCalls[callIndex] += other.numCalls[callIndex];
+	}
+	numUploadBytes += other.numUploadBytes;
+	numConstantBytes += other.numConstantBytes;
+	numVertexBytes += other.numVertexBytes;
+	numThreadGroups += other.numThreadGroups;
+	numVertexes += other.numVertexes;
+}
+
+// Sizes of the CameraConstants (b2, compute layout) and ModelConstants (b3) blocks in the shaders
+static constexpr size_t CAMERA_CONSTANTS_BYTES = sizeof(Mat44) * 4 + sizeof(float) * 8;
+static constexpr size_t MODEL_CONSTANTS_BYTES = sizeof(Mat44) + sizeof(float) * 4;
+
+//-----------------------------------------------------------------------------------------------
+NullRenderBackend::NullRenderBackend(const IntVec2& renderDimensions)
+	: m_renderDimensions(renderDimensions)
+{
+}
+
+std::string NullRenderBackend::GetSummary() const
+{
+	std::string summary;
+	char line[128];
+	for (int callIndex = 0; callIndex < (int)RenderBackendCall::COUNT; ++callIndex)
+	{
+		snprintf(line, sizeof(line), "%s %d, ", GetCallName((RenderBackendCall)callIndex), m_counters.numCalls[callIndex]);
+		summary += line;
+	}
+	snprintf(line, sizeof(line), "uploads %lld B, constants %lld B, vertexes %lld B, thread groups %lld", m_counters.numUploadBytes,
+		m_counters.numConstantBytes, m_counters.numVertexBytes, m_counters.numThreadGroups);
+	summary += line;
+	return summary;
+}
+
+const char* NullRenderBackend::GetCallName(RenderBackendCall call)
+{
+	switch (call)
+	{
+	case RenderBackendCall::CREATE_RESOURCE:	return "create";
+	case RenderBackendCall::UPLOAD:				return "upload";
+	case RenderBackendCall::PASS:				return "pass";
+	case RenderBackendCall::CONSTANTS:			return "constants";
+	case RenderBackendCall::STATE:				return "state";
+	case RenderBackendCall::BIND:				return "bind";
+	case RenderBackendCall::DISPATCH:			return "dispatch";
+	case RenderBackendCall::DRAW:				return "draw";
+	default:									return "?";
+	}
+}
+
+float NullRenderBackend::GetRenderAspect() const
+{
+	return (m_renderDimensions.y > 0) ? (float)m_renderDimensions.x / (float)m_renderDimensions.y : 1.f;
+}
+
+//-----------------------------------------------------------------------------------------------
+Shader* NullRenderBackend::CreateOrGetShader(const char* shaderName, VertexType vertexType)
+{
+	UNUSED(shaderName);
+	UNUSED(vertexType);
+	Count(RenderBackendCall::CREATE_RESOURCE);
+	return nullptr;
+}
+
+ComputeShader* NullRenderBackend::CreateOrGetComputeShader(const char* shaderName, VertexType vertexType)
+{
+	UNUSED(shaderName);
+	UNUSED(vertexType);
+	Count(RenderBackendCall::CREATE_RESOURCE);
+	return nullptr;
+}
+
+Texture* NullRenderBackend::CreateOrGetTextureFromFile(const char* imageFilePath)
+{
+	UNUSED(imageFilePath);
+	Count(RenderBackendCall::CREATE_RESOURCE);
+	return nullptr;
+}
+
+Texture* NullRenderBackend::GetTextureForFileName(const char* imageFilePath)
+{
+	UNUSED(imageFilePath);
+	return nullptr;
+}
+
+Texture* NullRenderBackend::CreateEmptyTextureWithUAV(const char* name, const IntVec2& dimensions)
+{
+	UNUSED(name);
+	UNUSED(dimensions);
+	Count(RenderBackendCall::CREATE_RESOURCE);
+	return nullptr;
+}
+
+Texture3D* NullRenderBackend::CreateTexture3DFromNoise(const IntVec3& dimensions, float scale, int octaves, float persistence, float lacunarity, bool tileable)
+{
+	UNUSED(dimensions);
+	UNUSED(scale);
+	UNUSED(octaves);
+	UNUSED(persistence);
+	UNUSED(lacunarity);
+	UNUSED(tileable);
+	Count(RenderBackendCall::CREATE_RESOURCE);
+	return nullptr;
+}
+
+Texture3D* NullRenderBackend::CreateTexture3DFromWorley(const IntVec3& dimensions, int cellSize, unsigned int seed)
+{
+	UNUSED(dimensions);
+	UNUSED(cellSize);
+	UNUSED(seed);
+	Count(RenderBackendCall::CREATE_RESOURCE);
+	return nullptr;
+}
+
+StructuredBuffer* NullRenderBackend::CreateStructuredBuffer(size_t numElements, size_t elementSize, bool isWritable)
+{
+	UNUSED(numElements);
+	UNUSED(elementSize);
+	UNUSED(isWritable);
+	Count(RenderBackendCall::CREATE_RESOURCE);
+	return nullptr;
+}
+
+void NullRenderBackend::CopyCPUToGPU(const void* data, size_t numElements, size_t elementSize, StructuredBuffer* buffer)
+{
+	UNUSED(data);
+	UNUSED(buffer);
+	Count(RenderBackendCall::UPLOAD);
+	m_counters.numUploadBytes += (long long)(numElements * elementSize);
+}
+
+//-----------------------------------------------------------------------------------------------
+void NullRenderBackend::BeginCamera(const Camera& camera)
+{
+	UNUSED(camera);
+	Count(RenderBackendCall::PASS);
+}
+
+void NullRenderBackend::EndCamera(const Camera& camera)
+{
+	UNUSED(camera);
+	Count(RenderBackendCall::PASS);
+}
+
+void NullRenderBackend::ClearScreen(const Rgba8& clearColor)
+{
+	UNUSED(clearColor);
+	Count(RenderBackendCall::PASS);
+}
+
+void NullRenderBackend::PreRenderMain()
+{
+	Count(RenderBackendCall::PASS);
+}
+
+void NullRenderBackend::PreRenderShadowMap()
+{
+	Count(RenderBackendCall::PASS);
+}
+
+void NullRenderBackend::RenderGodRays()
+{
+	Count(RenderBackendCall::DRAW);
+}
+
+void NullRenderBackend::RenderDebugWorld(const Camera& camera)
+{
+	UNUSED(camera);
+	Count(RenderBackendCall::PASS);
+}
+
+void NullRenderBackend::RenderDebugScreen(const Camera& camera)
+{
+	UNUSED(camera);
+	Count(RenderBackendCall::PASS);
+}
+
+void NullRenderBackend::SetCurrentCamera(PipelineStage stage, const Camera& camera)
+{
+	UNUSED(stage);
+	UNUSED(camera);
+	Count(RenderBackendCall::CONSTANTS);
+	m_counters.numConstantBytes += (long long)CAMERA_CONSTANTS_BYTES;
+}
+
+void NullRenderBackend::SetModelConstants()
+{
+	Count(RenderBackendCall::CONSTANTS);
+	m_counters.numConstantBytes += (long long)MODEL_CONSTANTS_BYTES;
+}
+
+void NullRenderBackend::SetModelConstants(const Mat44& modelMatrix, const Rgba8& modelColor)
+{
+	UNUSED(modelMatrix);
+	UNUSED(modelColor);
+	Count(RenderBackendCall::CONSTANTS);
+	m_counters.numConstantBytes += (long long)MODEL_CONSTANTS_BYTES;
+}
+
+void NullRenderBackend::SetLightConstants(PipelineStage stage, const LightConstants& lightConstants)
+{
+	UNUSED(stage);
+	Count(RenderBackendCall::CONSTANTS);
+	m_counters.numConstantBytes += (long long)sizeof(lightConstants);
+}
+
+void NullRenderBackend::SetCloudConstants(PipelineStage stage, const CloudConstants& cloudConstants)
+{
+	UNUSED(stage);
+	Count(RenderBackendCall::CONSTANTS);
+	m_counters.numConstantBytes += (long long)sizeof(cloudConstants);
+}
+
+void NullRenderBackend::SetShadowConstants(const ShadowConstants& shadowConstants)
+{
+	Count(RenderBackendCall::CONSTANTS);
+	m_counters.numConstantBytes += (long long)sizeof(shadowConstants);
+}
+
+void NullRenderBackend::SetShadowConstants(PipelineStage stage, const ShadowConstants& shadowConstants)
+{
+	UNUSED(stage);
+	Count(RenderBackendCall::CONSTANTS);
+	m_counters.numConstantBytes += (long long)sizeof(shadowConstants);
+}
+
+void NullRenderBackend::SetGodRaysConstants(const GodRaysConstants& godRaysConstants)
+{
+	Count(RenderBackendCall::CONSTANTS);
+	m_counters.numConstantBytes += (long long)sizeof(godRaysConstants);
+}
+
+//-----------------------------------------------------------------------------------------------
+void NullRenderBackend::SetBlendMode(BlendMode blendMode)
+{
+	UNUSED(blendMode);
+	Count(RenderBackendCall::STATE);
+}
+
+void NullRenderBackend::SetDepthMode(DepthMode depthMode)
+{
+	UNUSED(depthMode);
+	Count(RenderBackendCall::STATE);
+}
+
+void NullRenderBackend::SetRasterizerMode(RasterizerMode rasterizerMode)
+{
+	UNUSED(rasterizerMode);
+	Count(RenderBackendCall::STATE);
+}
+
+void NullRenderBackend::SetSamplerMode(SamplerMode samplerMode)
+{
+	UNUSED(samplerMode);
+	Count(RenderBackendCall::STATE);
+}
+
+void NullRenderBackend::BindShader(Shader* shader)
+{
+	UNUSED(shader);
+	Count(RenderBackendCall::BIND);
+}
+
+void NullRenderBackend::BindComputeShader(ComputeShader* computeShader)
+{
+	UNUSED(computeShader);
+	Count(RenderBackendCall::BIND);
+}
+
+void NullRenderBackend::UnbindComputeShader()
+{
+	Count(RenderBackendCall::BIND);
+}
+
+void NullRenderBackend::BindTexture()
+{
+	Count(RenderBackendCall::BIND);
+}
+
+void NullRenderBackend::BindTexture(Texture* texture, int slot)
+{
+	UNUSED(texture);
+	UNUSED(slot);
+	Count(RenderBackendCall::BIND);
+}
+
+void NullRenderBackend::BindTexture(PipelineStage stage, Texture* texture, int slot)
+{
+	UNUSED(stage);
+	UNUSED(texture);
+	UNUSED(slot);
+	Count(RenderBackendCall::BIND);
+}
+
+void NullRenderBackend::BindTexture3D(PipelineStage stage, Texture3D* texture, int slot)
+{
+	UNUSED(stage);
+	UNUSED(texture);
+	UNUSED(slot);
+	Count(RenderBackendCall::BIND);
+}
+
+void NullRenderBackend::BindTextureWithUAV(PipelineStage stage, Texture* texture)
+{
+	UNUSED(stage);
+	UNUSED(texture);
+	Count(RenderBackendCall::BIND);
+}
+
+void NullRenderBackend::BindShaderResources(Texture* texture, int slot)
+{
+	UNUSED(texture);
+	UNUSED(slot);
+	Count(RenderBackendCall::BIND);
+}
+
+void NullRenderBackend::BindStructuredBufferToWrite(int slot, StructuredBuffer* buffer)
+{
+	UNUSED(slot);
+	UNUSED(buffer);
+	Count(RenderBackendCall::BIND);
+}
+
+//-----------------------------------------------------------------------------------------------
+void NullRenderBackend::DispatchComputeJob(ComputeShader* computeShader, int threadGroupsX, int threadGroupsY, int threadGroupsZ)
+{
+	UNUSED(computeShader);
+	Count(RenderBackendCall::DISPATCH);
+	m_counters.numThreadGroups += (long long)threadGroupsX * threadGroupsY * threadGroupsZ;
+}
+
+void NullRenderBackend::DrawVertexArray(int numVertexes, const Vertex_PCU* vertexes)
+{
+	UNUSED(vertexes);
+	Count(RenderBackendCall::DRAW);
+	m_counters.numVertexes += numVertexes;
+	m_counters.numVertexBytes += (long long)numVertexes * (long long)sizeof(Vertex_PCU);
+}
+
+void NullRenderBackend::DrawFullScreenQuad()
+{
+	Count(RenderBackendCall::DRAW);
+	m_counters.numVertexes += 3;
+}
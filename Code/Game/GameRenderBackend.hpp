@@ -0,0 +1,171 @@
+#pragma once
+#include "Engine/Renderer/Renderer.hpp"
+#include "Engine/Math/IntVec2.hpp"
+#include "Engine/Math/IntVec3.hpp"
+#include <string>
+
+class Camera;
+class Shader;
+class ComputeShader;
+class Texture;
+class Texture3D;
+class StructuredBuffer;
+struct Vertex_PCU;
+
+// Everything Game, CloudManager and Prop ask of the renderer and window. EngineRenderBackend forwards to
+// g_theRenderer; NullRenderBackend only counts, so the CPU side of a frame can run without a device.
+class GameRenderBackend
+{
+public:
+	virtual ~GameRenderBackend() = default;
+
+	virtual IntVec2 GetRenderDimensions() const = 0;
+	virtual float GetRenderAspect() const = 0;
+
+	// Resources; the null backend hands back nullptr for all of them
+	virtual Shader* CreateOrGetShader(const char* shaderName, VertexType vertexType) = 0;
+	virtual ComputeShader* CreateOrGetComputeShader(const char* shaderName, VertexType vertexType) = 0;
+	virtual Texture* CreateOrGetTextureFromFile(const char* imageFilePath) = 0;
+	virtual Texture* GetTextureForFileName(const char* imageFilePath) = 0;
+	virtual Texture* CreateEmptyTextureWithUAV(const char* name, const IntVec2& dimensions) = 0;
+	virtual Texture3D* CreateTexture3DFromNoise(const IntVec3& dimensions, float scale, int octaves, float persistence, float lacunarity, bool tileable) = 0;
+	virtual Texture3D* CreateTexture3DFromWorley(const IntVec3& dimensions, int cellSize, unsigned int seed) = 0;
+	virtual StructuredBuffer* CreateStructuredBuffer(size_t numElements, size_t elementSize, bool isWritable) = 0;
+	virtual void CopyCPUToGPU(const void* data, size_t numElements, size_t elementSize, StructuredBuffer* buffer) = 0;
+
+	template <typename T>
+	void CopyCPUToGPU(const T* data, size_t numElements, StructuredBuffer* buffer) { CopyCPUToGPU(data, numElements, sizeof(T), buffer); }
+
+	// Passes and constants
+	virtual void BeginCamera(const Camera& camera) = 0;
+	virtual void EndCamera(const Camera& camera) = 0;
+	virtual void ClearScreen(const Rgba8& clearColor) = 0;
+	virtual void PreRenderMain() = 0;
+	virtual void PreRenderShadowMap() = 0;
+	virtual void RenderGodRays() = 0;
+	virtual void RenderDebugWorld(const Camera& camera) = 0;
+	virtual void RenderDebugScreen(const Camera& camera) = 0;
+	virtual void SetCurrentCamera(PipelineStage stage, const Camera& camera) = 0;
+	virtual void SetModelConstants() = 0;
+	virtual void SetModelConstants(const Mat44& modelMatrix, const Rgba8& modelColor) = 0;
+	virtual void SetLightConstants(PipelineStage stage, const LightConstants& lightConstants) = 0;
+	virtual void SetCloudConstants(PipelineStage stage, const CloudConstants& cloudConstants) = 0;
+	virtual void SetShadowConstants(const ShadowConstants& shadowConstants) = 0;
+	virtual void SetShadowConstants(PipelineStage stage, const ShadowConstants& shadowConstants) = 0;
+	virtual void SetGodRaysConstants(const GodRaysConstants& godRaysConstants) = 0;
+
+	// State and bindings
+	virtual void SetBlendMode(BlendMode blendMode) = 0;
+	virtual void SetDepthMode(DepthMode depthMode) = 0;
+	virtual void SetRasterizerMode(RasterizerMode rasterizerMode) = 0;
+	virtual void SetSamplerMode(SamplerMode samplerMode) = 0;
+	virtual void BindShader(Shader* shader) = 0;
+	virtual void BindComputeShader(ComputeShader* computeShader) = 0;
+	virtual void UnbindComputeShader() = 0;
+	virtual void BindTexture() = 0;
+	virtual void BindTexture(Texture* texture, int slot = 0) = 0;
+	virtual void BindTexture(PipelineStage stage, Texture* texture, int slot) = 0;
+	virtual void BindTexture3D(PipelineStage stage, Texture3D* texture, int slot) = 0;
+	virtual void BindTextureWithUAV(PipelineStage stage, Texture* texture) = 0;
+	virtual void BindShaderResources(Texture* texture, int slot) = 0;
+	virtual void BindStructuredBufferToWrite(int slot, StructuredBuffer* buffer) = 0;
+
+	// Work
+	virtual void DispatchComputeJob(ComputeShader* computeShader, int threadGroupsX, int threadGroupsY, int threadGroupsZ) = 0;
+	virtual void DrawVertexArray(int numVertexes, const Vertex_PCU* vertexes) = 0;
+	virtual void DrawFullScreenQuad() = 0;
+};
+
+enum class RenderBackendCall
+{
+	CREATE_RESOURCE,
+	UPLOAD,
+	PASS,
+	CONSTANTS,
+	STATE,
+	BIND,
+	DISPATCH,
+	DRAW,
+	COUNT
+};
+
+struct RenderBackendCounters
+{
+	int numCalls[(int)RenderBackendCall::COUNT] = {};
+	long long numUploadBytes = 0;		// Structured buffer uploads
+	long long numConstantBytes = 0;		// Constant buffer contents
+	long long numVertexBytes = 0;		// DrawVertexArray vertexes
+	long long numThreadGroups = 0;
+	long long numVertexes = 0;
+
+	int GetTotalCalls() const;
+	void Add(const RenderBackendCounters& other);
+};
+
+// Records what a frame would have sent to the GPU and nothing else
+class NullRenderBackend : public GameRenderBackend
+{
+public:
+	explicit NullRenderBackend(const IntVec2& renderDimensions);
+
+	const RenderBackendCounters& GetCounters() const { return m_counters; }
+	void ResetCounters() { m_counters = RenderBackendCounters(); }
+	std::string GetSummary() const;
+	static const char* GetCallName(RenderBackendCall call);
+
+	IntVec2 GetRenderDimensions() const override { return m_renderDimensions; }
+	float GetRenderAspect() const override;
+
+	Shader* CreateOrGetShader(const char* shaderName, VertexType vertexType) override;
+	ComputeShader* CreateOrGetComputeShader(const char* shaderName, VertexType vertexType) override;
+	Texture* CreateOrGetTextureFromFile(const char* imageFilePath) override;
+	Texture* GetTextureForFileName(const char* imageFilePath) override;
+	Texture* CreateEmptyTextureWithUAV(const char* name, const IntVec2& dimensions) override;
+	Texture3D* CreateTexture3DFromNoise(const IntVec3& dimensions, float scale, int octaves, float persistence, float lacunarity, bool tileable) override;
+	Texture3D* CreateTexture3DFromWorley(const IntVec3& dimensions, int cellSize, unsigned int seed) override;
+	StructuredBuffer* CreateStructuredBuffer(size_t numElements, size_t elementSize, bool isWritable) override;
+	void CopyCPUToGPU(const void* data, size_t numElements, size_t elementSize, StructuredBuffer* buffer) override;
+	using GameRenderBackend::CopyCPUToGPU;
+
+	void BeginCamera(const Camera& camera) override;
+	void EndCamera(const Camera& camera) override;
+	void ClearScreen(const Rgba8& clearColor) override;
+	void PreRenderMain() override;
+	void PreRenderShadowMap() override;
+	void RenderGodRays() override;
+	void RenderDebugWorld(const Camera& camera) override;
+	void RenderDebugScreen(const Camera& camera) override;
+	void SetCurrentCamera(PipelineStage stage, const Camera& camera) override;
+	void SetModelConstants() override;
+	void SetModelConstants(const Mat44& modelMatrix, const Rgba8& modelColor) override;
+	void SetLightConstants(PipelineStage stage, const LightConstants& lightConstants) override;
+	void SetCloudConstants(PipelineStage stage, const CloudConstants& cloudConstants) override;
+	void SetShadowConstants(const ShadowConstants& shadowConstants) override;
+	void SetShadowConstants(PipelineStage stage, const ShadowConstants& shadowConstants) override;
+	void SetGodRaysConstants(const GodRaysConstants& godRaysConstants) override;
+
+	void SetBlendMode(BlendMode blendMode) override;
+	void SetDepthMode(DepthMode depthMode) override;
+	void SetRasterizerMode(RasterizerMode rasterizerMode) override;
+	void SetSamplerMode(SamplerMode samplerMode) override;
+	void BindShader(Shader* shader) override;
+	void BindComputeShader(ComputeShader* computeShader) override;
+	void UnbindComputeShader() override;
+	void BindTexture() override;
+	void BindTexture(Texture* texture, int slot = 0) override;
+	void BindTexture(PipelineStage stage, Texture* texture, int slot) override;
+	void BindTexture3D(PipelineStage stage, Texture3D* texture, int slot) override;
+	void BindTextureWithUAV(PipelineStage stage, Texture* texture) override;
+	void BindShaderResources(Texture* texture, int slot) override;
+	void BindStructuredBufferToWrite(int slot, StructuredBuffer* buffer) override;
+
+	void DispatchComputeJob(ComputeShader* computeShader, int threadGroupsX, int threadGroupsY, int threadGroupsZ) override;
+	void DrawVertexArray(int numVertexes, const Vertex_PCU* vertexes) override;
+	void DrawFullScreenQuad() override;
+
+private:
+	void Count(RenderBackendCall call) { m_counters.numCalls[(int)call]++; }
+
+	IntVec2 m_renderDimensions;
+	RenderBackendCounters m_counters;
+};
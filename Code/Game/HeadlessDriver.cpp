@@ -0,0 +1,267 @@
+#include "Game/HeadlessDriver.hpp"
+#include "Game/GameCommon.hpp"
+#include "Game/Game.hpp"
+#include "Game/CpuProfiler.hpp"
+#include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Core/Clock.hpp"
+#include "Engine/Core/DevConsole.hpp"
+#include "Engine/Input/InputSystem.hpp"
+#include "ThirdParty/ImGui/imgui.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+extern DevConsole* g_theConsole;
+
+enum HeadlessPhase
+{
+	HEADLESS_PHASE_BEGIN_FRAME,
+	HEADLESS_PHASE_UPDATE,
+	HEADLESS_PHASE_RUN_COMPUTE,
+	HEADLESS_PHASE_PREPARE_FOR_RENDER,
+	HEADLESS_PHASE_RENDER,
+	HEADLESS_PHASE_END_FRAME,
+	HEADLESS_PHASE_FRAME,
+	NUM_HEADLESS_PHASES
+};
+
+static const char* s_headlessPhaseNames[NUM_HEADLESS_PHASES] =
+{
+	"BeginFrame", "Update", "RunCompute", "PrepareForRender", "Render", "EndFrame", "Frame",
+};
+
+//-----------------------------------------------------------------------------------------------
+HeadlessDriver::HeadlessDriver(const HeadlessDriverConfig& config)
+	: m_config(config)
+{
+}
+
+void HeadlessDriver::Run()
+{
+	// The engine systems Game touches that need no window; the renderer is replaced by the null backend
+	EventSystemConfig eventConfig;
+	g_theEventSystem = new EventSystem(eventConfig);
+	g_theEventSystem->Startup();
+
+	InputConfig inputConfig;
+	g_theInputSystem = new InputSystem(inputConfig);
+	g_theInputSystem->Startup();
+
+	DevConsoleConfig devConsoleConfig;
+	devConsoleConfig.m_renderer = nullptr;
+	g_theConsole = new DevConsole(devConsoleConfig);
+
+	NullRenderBackend* nullBackend = new NullRenderBackend(m_config.renderDimensions);
+	g_theRenderBackend = nullBackend;
+
+	ImGui::CreateContext();
+	ImGuiIO& io = ImGui::GetIO();
+	io.DisplaySize = ImVec2((float)m_config.renderDimensions.x, (float)m_config.renderDimensions.y);
+	unsigned char* fontPixels = nullptr;
+	int fontWidth = 0;
+	int fontHeight = 0;
+	io.Fonts->GetTexDataAsRGBA32(&fontPixels, &fontWidth, &fontHeight);
+
+	Game* game = new Game();
+	game->Startup();
+	if (!m_config.presetName.empty() && !game->m_singleCloudManager->ApplyParameterPreset(m_config.presetName))
+	{
+		printf("Unknown cloud preset %s, running with the default\n", m_config.presetName.c_str());
+	}
+
+	std::vector<double> phaseMs[NUM_HEADLESS_PHASES];
+	m_frameCounters = RenderBackendCounters();
+	m_numTimedFrames = 0;
+
+	typedef std::chrono::high_resolution_clock HeadlessClock;
+	auto ElapsedMs = [](HeadlessClock::time_point start, HeadlessClock::time_point end)
+	{
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	};
+
+	int numFrames = m_config.numWarmupFrames + m_config.numFrames;
+	for (int frameIndex = 0; frameIndex < numFrames; ++frameIndex)
+	{
+		nullBackend->ResetCounters();
+		io.DeltaTime = m_config.frameSeconds;
+
+		HeadlessClock::time_point times[NUM_HEADLESS_PHASES];
+		HeadlessClock::time_point frameStart = HeadlessClock::now();
+		CpuProfiler::Get().BeginFrame();
+
+		g_theEventSystem->BeginFrame();
+		g_theInputSystem->BeginFrame();
+		ImGui::NewFrame();
+		game->BeginFrame();
+		Clock::TickSystemClock();
+		times[HEADLESS_PHASE_BEGIN_FRAME] = HeadlessClock::now();
+
+		game->Update();
+		times[HEADLESS_PHASE_UPDATE] = HeadlessClock::now();
+
+		game->RunCompute();
+		times[HEADLESS_PHASE_RUN_COMPUTE] = HeadlessClock::now();
+
+		game->PrepareForRender();
+		times[HEADLESS_PHASE_PREPARE_FOR_RENDER] = HeadlessClock::now();
+
+		game->Render();
+		times[HEADLESS_PHASE_RENDER] = HeadlessClock::now();
+
+		ImGui::EndFrame();
+		g_theInputSystem->EndFrame();
+		g_theEventSystem->EndFrame();
+		game->EndFrame();
+		times[HEADLESS_PHASE_END_FRAME] = HeadlessClock::now();
+		CpuProfiler::Get().EndFrame();
+
+		if (frameIndex < m_config.numWarmupFrames)
+		{
+			continue;
+		}
+
+		HeadlessClock::time_point phaseStart = frameStart;
+		for (int phase = 0; phase < HEADLESS_PHASE_FRAME; ++phase)
+		{
+			phaseMs[phase].push_back(ElapsedMs(phaseStart, times[phase]));
+			phaseStart = times[phase];
+		}
+		phaseMs[HEADLESS_PHASE_FRAME].push_back(ElapsedMs(frameStart, times[HEADLESS_PHASE_END_FRAME]));
+		m_frameCounters.Add(nullBackend->GetCounters());
+		m_numTimedFrames++;
+	}
+
+	m_phaseStats.clear();
+	for (int phase = 0; phase < NUM_HEADLESS_PHASES; ++phase)
+	{
+		std::vector<double>& samples = phaseMs[phase];
+		HeadlessPhaseStats stats;
+		stats.phase = s_headlessPhaseNames[phase];
+		if (!samples.empty())
+		{
+			std::sort(samples.begin(), samples.end());
+			double total = 0.0;
+			for (double sample : samples)
+			{
+				total += sample;
+			}
+			stats.meanMs = total / (double)samples.size();
+			stats.minMs = samples.front();
+			stats.maxMs = samples.back();
+			stats.p95Ms = samples[(samples.size() * 95) / 100];
+		}
+		m_phaseStats.push_back(stats);
+	}
+
+	game->Shutdown();
+	delete game;
+
+	ImGui::DestroyContext();
+
+	g_theRenderBackend = nullptr;
+	delete nullBackend;
+
+	delete g_theConsole;
+	g_theConsole = nullptr;
+
+	g_theInputSystem->Shutdown();
+	delete g_theInputSystem;
+	g_theInputSystem = nullptr;
+
+	g_theEventSystem->Shutdown();
+	delete g_theEventSystem;
+	g_theEventSystem = nullptr;
+}
+
+std::string HeadlessDriver::ToJson() const
+{
+	char line[512];
+	snprintf(line, sizeof(line), "{\n  \"frames\": %d,\n  \"width\": %d,\n  \"height\": %d,\n  \"phases\": [\n", m_numTimedFrames,
+		m_config.renderDimensions.x, m_config.renderDimensions.y);
+	std::string json = line;
+
+	for (size_t i = 0; i < m_phaseStats.size(); ++i)
+	{
+		const HeadlessPhaseStats& stats = m_phaseStats[i];
+		snprintf(line, sizeof(line), "    { \"phase\": \"%s\", \"meanMs\": %.4f, \"minMs\": %.4f, \"maxMs\": %.4f, \"p95Ms\": %.4f }%s\n",
+			stats.phase.c_str(), stats.meanMs, stats.minMs, stats.maxMs, stats.p95Ms, (i + 1 < m_phaseStats.size()) ? "," : "");
+		json += line;
+	}
+	json += "  ],\n  \"perFrame\": {";
+
+	// Renderer traffic averaged over the timed frames
+	double frames = (m_numTimedFrames > 0) ? (double)m_numTimedFrames : 1.0;
+	for (int callIndex = 0; callIndex < (int)RenderBackendCall::COUNT; ++callIndex)
+	{
+		snprintf(line, sizeof(line), " \"%sCalls\": %.1f,", NullRenderBackend::GetCallName((RenderBackendCall)callIndex),
+			(double)m_frameCounters.numCalls[callIndex] / frames);
+		json += line;
+	}
+	snprintf(line, sizeof(line), " \"uploadBytes\": %.1f, \"constantBytes\": %.1f, \"vertexBytes\": %.1f, \"threadGroups\": %.1f }\n}\n",
+		(double)m_frameCounters.numUploadBytes / frames, (double)m_frameCounters.numConstantBytes / frames,
+		(double)m_frameCounters.numVertexBytes / frames, (double)m_frameCounters.numThreadGroups / frames);
+	json += line;
+	return json;
+}
+
+bool HeadlessDriver::WriteJson(const std::string& filePath) const
+{
+	std::ofstream file(filePath, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	std::string json = ToJson();
+	file.write(json.data(), (std::streamsize)json.size());
+	return file.good();
+}
+
+//-----------------------------------------------------------------------------------------------
+int RunHeadless(const char* commandLine)
+{
+	HeadlessDriverConfig config;
+	char filePath[260] = "Data/HeadlessReport.json";
+
+	const char* framesArg = strstr(commandLine, "frames=");
+	if (framesArg != nullptr)
+	{
+		sscanf_s(framesArg, "frames=%d", &config.numFrames);
+	}
+	const char* fileArg = strstr(commandLine, "file=");
+	if (fileArg != nullptr)
+	{
+		sscanf_s(fileArg, "file=%259s", filePath, (unsigned int)sizeof(filePath));
+	}
+	char tracePath[260] = "";
+	const char* traceArg = strstr(commandLine, "trace=");
+	if (traceArg != nullptr)
+	{
+		sscanf_s(traceArg, "trace=%259s", tracePath, (unsigned int)sizeof(tracePath));
+	}
+
+	char presetName[64] = "";
+	const char* presetArg = strstr(commandLine, "preset=");
+	if (presetArg != nullptr)
+	{
+		sscanf_s(presetArg, "preset=%63s", presetName, (unsigned int)sizeof(presetName));
+		config.presetName = presetName;
+	}
+
+	// Enough history for the trace to hold every frame of the run
+	CpuProfiler::Get().SetNumHistoryFrames(config.numFrames);
+
+	HeadlessDriver driver(config);
+	driver.Run();
+
+	std::string json = driver.ToJson();
+	printf("%s", json.c_str());
+	bool wasWritten = driver.WriteJson(filePath);
+	if (tracePath[0] != '\0')
+	{
+		wasWritten = CpuProfiler::Get().WriteChromeTrace(tracePath) && wasWritten;
+	}
+	return wasWritten ? 0 : 1;
+}
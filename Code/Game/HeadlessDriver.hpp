@@ -0,0 +1,48 @@
+#pragma once
+#include "Engine/Math/IntVec2.hpp"
+#include "Game/GameRenderBackend.hpp"
+#include <string>
+#include <vector>
+
+struct HeadlessDriverConfig
+{
+	int numFrames = 300;
+	int numWarmupFrames = 10;			// Run but not timed; the first frames include the initial cloud rebuild
+	IntVec2 renderDimensions = IntVec2(1382, 691);
+	float frameSeconds = 1.f / 60.f;	// Fixed step handed to ImGui; the game clock still runs on wall time
+	std::string presetName;				// Cloud preset applied after startup, empty for the file's default
+};
+
+struct HeadlessPhaseStats
+{
+	std::string phase;
+	double meanMs = 0.0;
+	double minMs = 0.0;
+	double maxMs = 0.0;
+	double p95Ms = 0.0;
+};
+
+// Runs Game's frame loop (BeginFrame, Update, RunCompute, PrepareForRender, Render, EndFrame) against a
+// NullRenderBackend, with no window or device, and reports CPU time per phase and what was sent to the renderer
+class HeadlessDriver
+{
+public:
+	explicit HeadlessDriver(const HeadlessDriverConfig& config);
+
+	void Run();
+
+	const std::vector<HeadlessPhaseStats>& GetPhaseStats() const { return m_phaseStats; }
+	const RenderBackendCounters& GetFrameCounters() const { return m_frameCounters; }
+	std::string ToJson() const;
+	bool WriteJson(const std::string& filePath) const;
+
+private:
+	HeadlessDriverConfig m_config;
+	std::vector<HeadlessPhaseStats> m_phaseStats;
+	RenderBackendCounters m_frameCounters;		// Totals over the timed frames
+	int m_numTimedFrames = 0;
+};
+
+// Entry point for "-headless" on the command line, e.g. -headless frames=600 file=Data/HeadlessReport.json;
+// trace=Data/HeadlessTrace.json also writes the profiler's zones as a Chrome trace, preset=Benchmark picks the cloud preset
+int RunHeadless(const char* commandLine);
@@ -1,17 +1,39 @@
 #include "Game/app.hpp"
 #include "Game/GameCommon.hpp"
+#include "Game/HeadlessDriver.hpp"
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#include <cstdio>
+#include <cstring>
 //-----------------------------------------------------------------------------------------------
+// A /SUBSYSTEM:WINDOWS process starts with no console, so stdout goes nowhere; print into the console that
+// launched us, or a new one when started from Explorer
+static void AttachHeadlessConsole()
+{
+	if (!AttachConsole(ATTACH_PARENT_PROCESS) && !AllocConsole())
+	{
+		return;
+	}
+
+	FILE* stream = nullptr;
+	freopen_s(&stream, "CONOUT$", "w", stdout);
+	freopen_s(&stream, "CONOUT$", "w", stderr);
+}
 
 //-----------------------------------------------------------------------------------------------
 int WINAPI WinMain( HINSTANCE applicationInstanceHandle, HINSTANCE previousInstance, LPSTR commandLineString, int nShowCmd)
 {
 	UNUSED( applicationInstanceHandle );
 	UNUSED( previousInstance );
-	UNUSED( commandLineString );
 	UNUSED( nShowCmd );
 
+	// No window or device: time the game's CPU frame work against the null render backend
+	if (commandLineString != nullptr && strstr(commandLineString, "-headless") != nullptr)
+	{
+		AttachHeadlessConsole();
+		return RunHeadless(commandLineString);
+	}
+
 	g_theApp = new App();
 	g_theApp->Startup();
 	g_theApp->Run();
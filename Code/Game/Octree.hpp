@@ -16,6 +16,7 @@ struct OctreeNodeGPU {
 	Vec3 minBounds = Vec3();
 	Vec3 maxBounds = Vec3();
 	float densitySum = 0.f;    // Aggregate density
+	float densityMax = 0.f;    // Majorant: densest element under this node, for delta tracking
 	int firstChildIndex = 0; // Index of the first child (-1 if leaf)
 	int numChildren = 0;     // Number of children (0 if leaf)
 	int firstElementIndex = 0; // Index of the first voxel (-1 if none)
@@ -29,6 +30,7 @@ class OctreeNode {
 public:
 	AABB3 boundingBox;
 	float densitySum = 0.0f;
+	float densityMax = 0.0f;
 	bool isLeaf = false;
 	int depth = 0;
 
@@ -187,6 +189,7 @@ void Octree<T, GetAABB, GetCenter, GetDensity>::BuildRecursive(OctreeNode<T>* no
 	Vec3 leafMax = Vec3::MIN;
 
 	node->densitySum = 0.0f;
+	node->densityMax = 0.0f;
 	node->depth = depth;
 
 	for (const T* element : elements)
@@ -196,7 +199,9 @@ void Octree<T, GetAABB, GetCenter, GetDensity>::BuildRecursive(OctreeNode<T>* no
 		leafMin = GetMin(leafMin, elementAABB.m_mins);
 		leafMax = GetMax(leafMax, elementAABB.m_maxs);
 
-		node->densitySum += getDensity(*element);
+		float density = getDensity(*element);
+		node->densitySum += density;
+		node->densityMax = (density > node->densityMax) ? density : node->densityMax;
 	}
 	node->boundingBox = AABB3(leafMin, leafMax);
 
@@ -292,6 +297,7 @@ int Octree<T, GetAABB, GetCenter, GetDensity>::SerializeRecursive(const OctreeNo
 	currentGPU.minBounds = node->boundingBox.m_mins;
 	currentGPU.maxBounds = node->boundingBox.m_maxs;
 	currentGPU.densitySum = node->densitySum;
+	currentGPU.densityMax = node->densityMax;
 	currentGPU.depth = node->depth;
 
 	if (node->isLeaf) {
@@ -351,6 +357,7 @@ void Octree<T, GetAABB, GetCenter, GetDensity>::SerializeIntoPlaceholder(const O
 	nodeGPU.minBounds = node->boundingBox.m_mins;
 	nodeGPU.maxBounds = node->boundingBox.m_maxs;
 	nodeGPU.densitySum = node->densitySum;
+	nodeGPU.densityMax = node->densityMax;
 	nodeGPU.depth = node->depth;
 
 	if (node->isLeaf) {
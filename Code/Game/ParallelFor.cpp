@@ -0,0 +1,55 @@
+#include "Game/ParallelFor.hpp"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+int GetNumWorkerThreads(int requestedThreads)
+{
+	if (requestedThreads > 0)
+	{
+		return requestedThreads;
+	}
+
+	int hardwareThreads = (int)std::thread::hardware_concurrency();
+	return hardwareThreads > 0 ? hardwareThreads : 1;
+}
+
+void ParallelFor(int count, const std::function<void(int begin, int end)>& work, int numThreads)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	int threadCount = std::min(GetNumWorkerThreads(numThreads), count);
+
+	if (threadCount == 1)
+	{
+		work(0, count);
+		return;
+	}
+
+	std::vector<std::thread> workers;
+	workers.reserve(threadCount - 1);
+
+	int chunkSize = (count + threadCount - 1) / threadCount;
+
+	// The calling thread takes the first chunk instead of sitting idle
+	for (int threadIndex = 1; threadIndex < threadCount; ++threadIndex)
+	{
+		int begin = threadIndex * chunkSize;
+		int end = std::min(begin + chunkSize, count);
+		if (begin >= end)
+		{
+			break;
+		}
+		workers.emplace_back(work, begin, end);
+	}
+
+	work(0, std::min(chunkSize, count));
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <functional>
+
+// Splits [0, count) into contiguous chunks and runs them on worker threads, blocking until all are done.
+// numThreads <= 0 uses every hardware thread.
+void ParallelFor(int count, const std::function<void(int begin, int end)>& work, int numThreads = 0);
+
+int GetNumWorkerThreads(int requestedThreads = 0);
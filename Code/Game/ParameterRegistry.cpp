@@ -0,0 +1,373 @@
+#include "Game/ParameterRegistry.hpp"
+#include "Engine/Core/EngineCommon.hpp"
+#include "ThirdParty/ImGui/imgui.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+//-----------------------------------------------------------------------------------------------
+void ParameterRegistry::AddFloat(const char* name, const char* label, float* value, float defaultValue, float minValue, float maxValue, const char* format)
+{
+	ParameterDefinition parameter;
+	parameter.name = name;
+	parameter.label = label;
+	parameter.type = ParameterType::FLOAT;
+	parameter.floatValue = value;
+	parameter.defaultValue = defaultValue;
+	parameter.minValue = minValue;
+	parameter.maxValue = maxValue;
+	parameter.format = format;
+	m_parameters.push_back(parameter);
+	*value = defaultValue;
+}
+
+void ParameterRegistry::AddInt(const char* name, const char* label, int* value, int defaultValue, const char* comboItems)
+{
+	ParameterDefinition parameter;
+	parameter.name = name;
+	parameter.label = label;
+	parameter.type = ParameterType::INT;
+	parameter.intValue = value;
+	parameter.defaultValue = (float)defaultValue;
+
+	// Combo items are zero-separated and end with an empty one
+	int numItems = 0;
+	const char* item = comboItems;
+	for (; *item != '\0'; item += strlen(item) + 1)
+	{
+		numItems++;
+	}
+	parameter.comboItems.assign(comboItems, item + 1);
+	parameter.maxValue = (float)(numItems - 1);
+
+	m_parameters.push_back(parameter);
+	*value = defaultValue;
+}
+
+void ParameterRegistry::AddBool(const char* name, const char* label, bool* value, bool defaultValue)
+{
+	ParameterDefinition parameter;
+	parameter.name = name;
+	parameter.label = label;
+	parameter.type = ParameterType::BOOL;
+	parameter.boolValue = value;
+	parameter.defaultValue = defaultValue ? 1.f : 0.f;
+	m_parameters.push_back(parameter);
+	*value = defaultValue;
+}
+
+//-----------------------------------------------------------------------------------------------
+const ParameterDefinition* ParameterRegistry::FindParameter(const std::string& name) const
+{
+	for (const ParameterDefinition& parameter : m_parameters)
+	{
+		if (parameter.name == name)
+		{
+			return &parameter;
+		}
+	}
+	return nullptr;
+}
+
+std::string ParameterRegistry::GetValueString(const ParameterDefinition& parameter) const
+{
+	char text[64];
+	switch (parameter.type)
+	{
+	case ParameterType::FLOAT:	snprintf(text, sizeof(text), "%.9g", *parameter.floatValue); break;
+	case ParameterType::INT:	snprintf(text, sizeof(text), "%d", *parameter.intValue); break;
+	case ParameterType::BOOL:	snprintf(text, sizeof(text), "%s", *parameter.boolValue ? "true" : "false"); break;
+	}
+	return text;
+}
+
+bool ParameterRegistry::SetValueFromString(const std::string& name, const std::string& value)
+{
+	const ParameterDefinition* parameter = FindParameter(name);
+	if (parameter == nullptr)
+	{
+		return false;
+	}
+
+	bool hasChanged = false;
+	switch (parameter->type)
+	{
+	case ParameterType::FLOAT:
+	{
+		float newValue = (float)atof(value.c_str());
+		hasChanged = *parameter->floatValue != newValue;
+		*parameter->floatValue = newValue;
+		break;
+	}
+	case ParameterType::INT:
+	{
+		int newValue = atoi(value.c_str());
+		newValue = (newValue < 0) ? 0 : ((newValue > (int)parameter->maxValue) ? (int)parameter->maxValue : newValue);
+		hasChanged = *parameter->intValue != newValue;
+		*parameter->intValue = newValue;
+		break;
+	}
+	case ParameterType::BOOL:
+	{
+		bool newValue = value == "true" || value == "1";
+		hasChanged = *parameter->boolValue != newValue;
+		*parameter->boolValue = newValue;
+		break;
+	}
+	}
+
+	if (hasChanged)
+	{
+		MarkChanged();
+	}
+	return true;
+}
+
+void ParameterRegistry::ResetToDefaults()
+{
+	for (const ParameterDefinition& parameter : m_parameters)
+	{
+		switch (parameter.type)
+		{
+		case ParameterType::FLOAT:	*parameter.floatValue = parameter.defaultValue; break;
+		case ParameterType::INT:	*parameter.intValue = (int)parameter.defaultValue; break;
+		case ParameterType::BOOL:	*parameter.boolValue = parameter.defaultValue != 0.f; break;
+		}
+	}
+	MarkChanged();
+}
+
+bool ParameterRegistry::ConsumeChanges()
+{
+	bool hadChanges = m_hasChanges;
+	m_hasChanges = false;
+	return hadChanges;
+}
+
+void ParameterRegistry::MarkChanged()
+{
+	m_hasChanges = true;
+	m_isModified = true;
+	m_version++;
+}
+
+//-----------------------------------------------------------------------------------------------
+bool ParameterRegistry::LoadPresets(const std::string& filePath)
+{
+	XmlDocument document;
+	if (document.LoadFile(filePath.c_str()) != tinyxml2::XML_SUCCESS || document.RootElement() == nullptr)
+	{
+		return false;
+	}
+
+	m_presets.clear();
+	m_defaultPresetName.clear();
+
+	const XmlElement* presetsElement = document.RootElement()->FirstChildElement("CloudPresets");
+	if (presetsElement == nullptr)
+	{
+		return true;
+	}
+
+	const char* defaultName = presetsElement->Attribute("default");
+	m_defaultPresetName = (defaultName != nullptr) ? defaultName : "";
+
+	for (const XmlElement* presetElement = presetsElement->FirstChildElement("Preset"); presetElement != nullptr;
+		presetElement = presetElement->NextSiblingElement("Preset"))
+	{
+		ParameterPreset preset;
+		for (const tinyxml2::XMLAttribute* attribute = presetElement->FirstAttribute(); attribute != nullptr; attribute = attribute->Next())
+		{
+			if (strcmp(attribute->Name(), "name") == 0)
+			{
+				preset.name = attribute->Value();
+			}
+			else
+			{
+				preset.values.push_back(std::make_pair(std::string(attribute->Name()), std::string(attribute->Value())));
+			}
+		}
+
+		if (!preset.name.empty())
+		{
+			m_presets.push_back(preset);
+		}
+	}
+	return true;
+}
+
+bool ParameterRegistry::SavePreset(const std::string& filePath, const std::string& presetName)
+{
+	// Other presets, the config attributes and comments in the file are left as they are
+	XmlDocument document;
+	if (document.LoadFile(filePath.c_str()) != tinyxml2::XML_SUCCESS || document.RootElement() == nullptr)
+	{
+		return false;
+	}
+
+	XmlElement* root = document.RootElement();
+	XmlElement* presetsElement = root->FirstChildElement("CloudPresets");
+	if (presetsElement == nullptr)
+	{
+		presetsElement = document.NewElement("CloudPresets");
+		root->InsertEndChild(presetsElement);
+	}
+
+	XmlElement* presetElement = presetsElement->FirstChildElement("Preset");
+	while (presetElement != nullptr && (presetElement->Attribute("name") == nullptr || presetName != presetElement->Attribute("name")))
+	{
+		presetElement = presetElement->NextSiblingElement("Preset");
+	}
+
+	XmlElement* newPresetElement = document.NewElement("Preset");
+	ParameterPreset preset = CaptureCurrentValues(presetName);
+	newPresetElement->SetAttribute("name", presetName.c_str());
+	for (const std::pair<std::string, std::string>& value : preset.values)
+	{
+		newPresetElement->SetAttribute(value.first.c_str(), value.second.c_str());
+	}
+
+	if (presetElement != nullptr)
+	{
+		presetsElement->InsertAfterChild(presetElement, newPresetElement);
+		presetsElement->DeleteChild(presetElement);
+	}
+	else
+	{
+		presetsElement->InsertEndChild(newPresetElement);
+	}
+
+	if (document.SaveFile(filePath.c_str()) != tinyxml2::XML_SUCCESS)
+	{
+		return false;
+	}
+
+	bool isNewPreset = true;
+	for (ParameterPreset& existing : m_presets)
+	{
+		if (existing.name == presetName)
+		{
+			existing = preset;
+			isNewPreset = false;
+		}
+	}
+	if (isNewPreset)
+	{
+		m_presets.push_back(preset);
+	}
+	m_currentPresetName = presetName;
+	m_isModified = false;
+	return true;
+}
+
+bool ParameterRegistry::ApplyPreset(const std::string& presetName)
+{
+	const ParameterPreset* preset = FindPreset(presetName);
+	if (preset == nullptr)
+	{
+		return false;
+	}
+
+	// Defaults first, so the result doesn't depend on what was set before
+	ResetToDefaults();
+	for (const std::pair<std::string, std::string>& value : preset->values)
+	{
+		SetValueFromString(value.first, value.second);
+	}
+
+	m_currentPresetName = presetName;
+	m_isModified = false;
+	for (int presetIndex = 0; presetIndex < (int)m_presets.size(); ++presetIndex)
+	{
+		if (m_presets[presetIndex].name == presetName)
+		{
+			m_selectedPreset = presetIndex;
+		}
+	}
+	return true;
+}
+
+const ParameterPreset* ParameterRegistry::FindPreset(const std::string& presetName) const
+{
+	for (const ParameterPreset& preset : m_presets)
+	{
+		if (preset.name == presetName)
+		{
+			return &preset;
+		}
+	}
+	return nullptr;
+}
+
+ParameterPreset ParameterRegistry::CaptureCurrentValues(const std::string& presetName) const
+{
+	ParameterPreset preset;
+	preset.name = presetName;
+	for (const ParameterDefinition& parameter : m_parameters)
+	{
+		preset.values.push_back(std::make_pair(parameter.name, GetValueString(parameter)));
+	}
+	return preset;
+}
+
+//-----------------------------------------------------------------------------------------------
+bool ParameterRegistry::DrawImGui(const std::string& filePath)
+{
+	bool hasChanged = false;
+
+	std::string presetItems;
+	for (const ParameterPreset& preset : m_presets)
+	{
+		presetItems += preset.name;
+		presetItems.push_back('\0');
+	}
+	presetItems.push_back('\0');
+
+	if (!m_presets.empty())
+	{
+		ImGui::Combo("Preset", &m_selectedPreset, presetItems.c_str());
+		if (ImGui::Button("Load Preset"))
+		{
+			ApplyPreset(m_presets[m_selectedPreset].name);
+			hasChanged = true;
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Save Preset"))
+		{
+			std::string presetName = m_presets[m_selectedPreset].name;
+			m_lastFileMessage = SavePreset(filePath, presetName) ? "Saved " + presetName : "Failed to write " + filePath;
+		}
+		ImGui::SameLine();
+	}
+	if (ImGui::Button("Reset to Defaults"))
+	{
+		ResetToDefaults();
+		hasChanged = true;
+	}
+	ImGui::Text("Current: %s%s %s", m_currentPresetName.empty() ? "(defaults)" : m_currentPresetName.c_str(), m_isModified ? " (modified)" : "",
+		m_lastFileMessage.c_str());
+
+	for (const ParameterDefinition& parameter : m_parameters)
+	{
+		bool hasWidgetChanged = false;
+		switch (parameter.type)
+		{
+		case ParameterType::FLOAT:
+			hasWidgetChanged = ImGui::SliderFloat(parameter.label.c_str(), parameter.floatValue, parameter.minValue, parameter.maxValue, parameter.format.c_str());
+			break;
+		case ParameterType::INT:
+			hasWidgetChanged = ImGui::Combo(parameter.label.c_str(), parameter.intValue, parameter.comboItems.c_str());
+			break;
+		case ParameterType::BOOL:
+			hasWidgetChanged = ImGui::Checkbox(parameter.label.c_str(), parameter.boolValue);
+			break;
+		}
+
+		if (hasWidgetChanged)
+		{
+			MarkChanged();
+			hasChanged = true;
+		}
+	}
+	return hasChanged;
+}
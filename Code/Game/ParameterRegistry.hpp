@@ -0,0 +1,90 @@
+#pragma once
+#include <string>
+#include <vector>
+
+enum class ParameterType
+{
+	FLOAT,
+	INT,
+	BOOL,
+};
+
+// One tunable value, bound to the variable it lives in (a constant buffer field, a member, ...)
+struct ParameterDefinition
+{
+	std::string name;				// Attribute name in the presets
+	std::string label;				// ImGui label
+	ParameterType type = ParameterType::FLOAT;
+	float* floatValue = nullptr;
+	int* intValue = nullptr;
+	bool* boolValue = nullptr;
+	float defaultValue = 0.f;		// Any type, stored as a float
+	float minValue = 0.f;
+	float maxValue = 1.f;
+	std::string format;				// Slider format for floats
+	std::string comboItems;			// Zero-separated names for ints; the value is the index
+};
+
+// Named set of values; parameters it leaves out keep their defaults when it is applied
+struct ParameterPreset
+{
+	std::string name;
+	std::vector<std::pair<std::string, std::string>> values;
+};
+
+// Registered tuning values with ImGui widgets, named presets in an XML file and change tracking, so the values
+// can be copied or uploaded only on the frames something touched them.
+//
+// Presets live under the root element of the file:
+//   <CloudPresets default="Default">
+//     <Preset name="Default" extinctionCoefficient="1.0" ... />
+//   </CloudPresets>
+class ParameterRegistry
+{
+public:
+	// Each writes defaultValue into the bound variable, which must outlive the registry
+	void AddFloat(const char* name, const char* label, float* value, float defaultValue, float minValue, float maxValue, const char* format = "%.2f");
+	void AddInt(const char* name, const char* label, int* value, int defaultValue, const char* comboItems);
+	void AddBool(const char* name, const char* label, bool* value, bool defaultValue);
+
+	int GetNumParameters() const { return (int)m_parameters.size(); }
+	const ParameterDefinition* FindParameter(const std::string& name) const;
+	std::string GetValueString(const ParameterDefinition& parameter) const;
+	bool SetValueFromString(const std::string& name, const std::string& value);
+	void ResetToDefaults();
+
+	// True once after any value changed through the registry (widgets, presets, SetValueFromString)
+	bool ConsumeChanges();
+	bool HasChanges() const { return m_hasChanges; }
+	unsigned int GetVersion() const { return m_version; }
+
+	// Reads every preset in the file, replacing the ones held; returns false if the file could not be read
+	bool LoadPresets(const std::string& filePath);
+
+	// Writes the current values as a preset into the file, replacing one with the same name; the rest is kept
+	bool SavePreset(const std::string& filePath, const std::string& presetName);
+
+	bool ApplyPreset(const std::string& presetName);
+	const ParameterPreset* FindPreset(const std::string& presetName) const;
+	const std::vector<ParameterPreset>& GetPresets() const { return m_presets; }
+	const std::string& GetDefaultPresetName() const { return m_defaultPresetName; }
+	const std::string& GetCurrentPresetName() const { return m_currentPresetName; }
+
+	// Preset picker, Load / Save / Reset buttons and a widget per parameter, inside the current ImGui window.
+	// Returns true if anything changed.
+	bool DrawImGui(const std::string& filePath);
+
+private:
+	void MarkChanged();
+	ParameterPreset CaptureCurrentValues(const std::string& presetName) const;
+
+	std::vector<ParameterDefinition> m_parameters;
+	std::vector<ParameterPreset> m_presets;
+	std::string m_defaultPresetName;
+	std::string m_currentPresetName;			// Last preset applied or saved, edited since if m_isModified
+	bool m_isModified = false;
+	bool m_hasChanges = true;					// Registered values have never been consumed
+	unsigned int m_version = 0;
+	int m_selectedPreset = 0;
+	std::string m_lastFileMessage;
+};
@@ -1,4 +1,5 @@
 #include "Perlin3D.hpp"
+#include <emmintrin.h>
 
 int Hash(int x, int y, int z)
 {
@@ -23,6 +24,12 @@ float Fade(float t)
 	return t * t * t * (t * (t * 6 - 15) + 10);
 }
 
+float FadeDerivative(float t)
+{
+	// d/dt of Fade: 30t^4 - 60t^3 + 30t^2
+	return 30.f * t * t * (t * (t - 2.f) + 1.f);
+}
+
 float Lerp(float a, float b, float t)
 {
 	return a + t * (b - a);
@@ -72,22 +79,235 @@ float PerlinNoise3D(float x, float y, float z)
 	float n111 = DotGridGradient(x1, y1, z1, x, y, z);
 
 	// Interpolate along x
-	float nx00 = Lerp(u, n000, n100);
-	float nx10 = Lerp(u, n010, n110);
-	float nx01 = Lerp(u, n001, n101);
-	float nx11 = Lerp(u, n011, n111);
+	float nx00 = Lerp(n000, n100, u);
+	float nx10 = Lerp(n010, n110, u);
+	float nx01 = Lerp(n001, n101, u);
+	float nx11 = Lerp(n011, n111, u);
 
 	// Interpolate along y
-	float nxy0 = Lerp(v, nx00, nx10);
-	float nxy1 = Lerp(v, nx01, nx11);
+	float nxy0 = Lerp(nx00, nx10, v);
+	float nxy1 = Lerp(nx01, nx11, v);
 
 	// Interpolate along z
-	float nxyz = Lerp(w, nxy0, nxy1);
+	float nxyz = Lerp(nxy0, nxy1, w);
 
 	// Return the final noise value
 	return nxyz;
 }
 
+static PerlinSample ComputePerlinSample(int x0, int y0, int z0, int x1, int y1, int z1, float tx, float ty, float tz)
+{
+	// Same lattice walk as PerlinNoise3D, but the trilinear blend is expanded into polynomial form
+	// so the derivative falls out of the corner values we already have instead of 6 extra samples
+	float u = Fade(tx);
+	float v = Fade(ty);
+	float w = Fade(tz);
+
+	float du = FadeDerivative(tx);
+	float dv = FadeDerivative(ty);
+	float dw = FadeDerivative(tz);
+
+	// Corner gradients
+	Vec3 ga = Gradient(x0, y0, z0);
+	Vec3 gb = Gradient(x1, y0, z0);
+	Vec3 gc = Gradient(x0, y1, z0);
+	Vec3 gd = Gradient(x1, y1, z0);
+	Vec3 ge = Gradient(x0, y0, z1);
+	Vec3 gf = Gradient(x1, y0, z1);
+	Vec3 gg = Gradient(x0, y1, z1);
+	Vec3 gh = Gradient(x1, y1, z1);
+
+	// Corner values, dot(gradient, offset from corner)
+	float a = ga.x * tx + ga.y * ty + ga.z * tz;
+	float b = gb.x * (tx - 1.f) + gb.y * ty + gb.z * tz;
+	float c = gc.x * tx + gc.y * (ty - 1.f) + gc.z * tz;
+	float d = gd.x * (tx - 1.f) + gd.y * (ty - 1.f) + gd.z * tz;
+	float e = ge.x * tx + ge.y * ty + ge.z * (tz - 1.f);
+	float f = gf.x * (tx - 1.f) + gf.y * ty + gf.z * (tz - 1.f);
+	float g = gg.x * tx + gg.y * (ty - 1.f) + gg.z * (tz - 1.f);
+	float h = gh.x * (tx - 1.f) + gh.y * (ty - 1.f) + gh.z * (tz - 1.f);
+
+	// value = k0 + k1*u + k2*v + k3*w + k4*u*v + k5*v*w + k6*w*u + k7*u*v*w
+	float k0 = a;
+	float k1 = b - a;
+	float k2 = c - a;
+	float k3 = e - a;
+	float k4 = a - b - c + d;
+	float k5 = a - c - e + g;
+	float k6 = a - b - e + f;
+	float k7 = -a + b + c - d + e - f - g + h;
+
+	float uv = u * v;
+	float vw = v * w;
+	float wu = w * u;
+	float uvw = uv * w;
+
+	PerlinSample sample;
+	sample.value = k0 + k1 * u + k2 * v + k3 * w + k4 * uv + k5 * vw + k6 * wu + k7 * uvw;
+
+	// Corner values are linear in the sample position, so their derivatives are the corner gradients;
+	// blend those with the same weights and add the terms coming from the fade curves
+	float wa = 1.f - u - v - w + uv + vw + wu - uvw;
+	float wb = u - uv - wu + uvw;
+	float wc = v - uv - vw + uvw;
+	float wd = uv - uvw;
+	float we = w - vw - wu + uvw;
+	float wf = wu - uvw;
+	float wg = vw - uvw;
+	float wh = uvw;
+
+	sample.derivative.x = wa * ga.x + wb * gb.x + wc * gc.x + wd * gd.x + we * ge.x + wf * gf.x + wg * gg.x + wh * gh.x
+		+ du * (k1 + k4 * v + k6 * w + k7 * vw);
+	sample.derivative.y = wa * ga.y + wb * gb.y + wc * gc.y + wd * gd.y + we * ge.y + wf * gf.y + wg * gg.y + wh * gh.y
+		+ dv * (k2 + k5 * w + k4 * u + k7 * wu);
+	sample.derivative.z = wa * ga.z + wb * gb.z + wc * gc.z + wd * gd.z + we * ge.z + wf * gf.z + wg * gg.z + wh * gh.z
+		+ dw * (k3 + k6 * u + k5 * v + k7 * uv);
+
+	return sample;
+}
+
+PerlinSample PerlinNoise3DWithDerivative(float x, float y, float z)
+{
+	int x0 = (int)std::floor(x);
+	int y0 = (int)std::floor(y);
+	int z0 = (int)std::floor(z);
+
+	return ComputePerlinSample(x0, y0, z0, x0 + 1, y0 + 1, z0 + 1, x - x0, y - y0, z - z0);
+}
+
+PerlinSample PerlinNoise3DWithDerivative(float x, float y, float z, int period, int seed)
+{
+	int x0 = (int)std::floor(x);
+	int y0 = (int)std::floor(y);
+	int z0 = (int)std::floor(z);
+
+	float tx = x - x0;
+	float ty = y - y0;
+	float tz = z - z0;
+
+	// Wrap the lattice so the noise repeats every 'period' cells, then shift by the seed so
+	// different seeds pick independent gradients without breaking the tiling
+	auto wrap = [period](int i) { int m = i % period; return m < 0 ? m + period : m; };
+	int seedOffset = seed * 1031;
+
+	int wx0 = wrap(x0) + seedOffset;
+	int wy0 = wrap(y0) + seedOffset;
+	int wz0 = wrap(z0) + seedOffset;
+	int wx1 = wrap(x0 + 1) + seedOffset;
+	int wy1 = wrap(y0 + 1) + seedOffset;
+	int wz1 = wrap(z0 + 1) + seedOffset;
+
+	return ComputePerlinSample(wx0, wy0, wz0, wx1, wy1, wz1, tx, ty, tz);
+}
+
+void PerlinNoise3DBatch(const Vec3* positions, float* outValues, int count)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		outValues[i] = PerlinNoise3D(positions[i].x, positions[i].y, positions[i].z);
+	}
+}
+
+static inline __m128 Fade4(__m128 t)
+{
+	__m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.f)), _mm_set1_ps(15.f))), _mm_set1_ps(10.f));
+	return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+}
+
+static inline __m128 Lerp4(__m128 a, __m128 b, __m128 t)
+{
+	return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+}
+
+static inline __m128i Floor4(__m128 value)
+{
+	// Truncation rounds negative values up, so step those back by one
+	__m128i truncated = _mm_cvttps_epi32(value);
+	__m128i isAbove = _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(truncated), value));
+	return _mm_add_epi32(truncated, isAbove);
+}
+
+// DotGridGradient for four corners. Only the low 8 bits of Hash are used, and those only depend on the low 16 bits
+// of each product, so SSE2's 16-bit multiply is enough. The 12 gradients are (+-1, +-1, 0), (+-1, 0, +-1) and
+// (0, +-1, +-1) in that order, so the dot product picks two of the offsets and the low two bits flip their signs.
+static inline __m128 DotGridGradient4(__m128i ix, __m128i iy, __m128i iz, __m128 dx, __m128 dy, __m128 dz)
+{
+	__m128i hash = _mm_xor_si128(_mm_xor_si128(_mm_mullo_epi16(ix, _mm_set1_epi32(73856093 & 0xFFFF)), _mm_mullo_epi16(iy, _mm_set1_epi32(19349663 & 0xFFFF))),
+		_mm_mullo_epi16(iz, _mm_set1_epi32(83492791 & 0xFFFF)));
+	hash = _mm_and_si128(hash, _mm_set1_epi32(255));
+
+	// hash % 12, as hash - 12 * (hash * 5462 >> 16), which is exact for hashes below 256
+	__m128i quotient = _mm_mulhi_epu16(hash, _mm_set1_epi32(5462));
+	__m128i gradientIndex = _mm_sub_epi32(hash, _mm_mullo_epi16(quotient, _mm_set1_epi32(12)));
+
+	__m128 isFirstY = _mm_castsi128_ps(_mm_cmpgt_epi32(gradientIndex, _mm_set1_epi32(7)));
+	__m128 isSecondY = _mm_castsi128_ps(_mm_cmplt_epi32(gradientIndex, _mm_set1_epi32(4)));
+	__m128 first = _mm_or_ps(_mm_and_ps(isFirstY, dy), _mm_andnot_ps(isFirstY, dx));
+	__m128 second = _mm_or_ps(_mm_and_ps(isSecondY, dy), _mm_andnot_ps(isSecondY, dz));
+
+	__m128 firstSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(gradientIndex, _mm_set1_epi32(1)), 31));
+	__m128 secondSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(gradientIndex, _mm_set1_epi32(2)), 30));
+	return _mm_add_ps(_mm_xor_ps(first, firstSign), _mm_xor_ps(second, secondSign));
+}
+
+void PerlinNoise3D4(const float* x, const float* y, const float* z, float* outValues)
+{
+	__m128 px = _mm_loadu_ps(x);
+	__m128 py = _mm_loadu_ps(y);
+	__m128 pz = _mm_loadu_ps(z);
+
+	__m128i x0 = Floor4(px);
+	__m128i y0 = Floor4(py);
+	__m128i z0 = Floor4(pz);
+	__m128i one = _mm_set1_epi32(1);
+	__m128i x1 = _mm_add_epi32(x0, one);
+	__m128i y1 = _mm_add_epi32(y0, one);
+	__m128i z1 = _mm_add_epi32(z0, one);
+
+	// Offsets from the lower and upper corners
+	__m128 tx0 = _mm_sub_ps(px, _mm_cvtepi32_ps(x0));
+	__m128 ty0 = _mm_sub_ps(py, _mm_cvtepi32_ps(y0));
+	__m128 tz0 = _mm_sub_ps(pz, _mm_cvtepi32_ps(z0));
+	__m128 tx1 = _mm_sub_ps(tx0, _mm_set1_ps(1.f));
+	__m128 ty1 = _mm_sub_ps(ty0, _mm_set1_ps(1.f));
+	__m128 tz1 = _mm_sub_ps(tz0, _mm_set1_ps(1.f));
+
+	__m128 u = Fade4(tx0);
+	__m128 v = Fade4(ty0);
+	__m128 w = Fade4(tz0);
+
+	__m128 nx00 = Lerp4(DotGridGradient4(x0, y0, z0, tx0, ty0, tz0), DotGridGradient4(x1, y0, z0, tx1, ty0, tz0), u);
+	__m128 nx10 = Lerp4(DotGridGradient4(x0, y1, z0, tx0, ty1, tz0), DotGridGradient4(x1, y1, z0, tx1, ty1, tz0), u);
+	__m128 nx01 = Lerp4(DotGridGradient4(x0, y0, z1, tx0, ty0, tz1), DotGridGradient4(x1, y0, z1, tx1, ty0, tz1), u);
+	__m128 nx11 = Lerp4(DotGridGradient4(x0, y1, z1, tx0, ty1, tz1), DotGridGradient4(x1, y1, z1, tx1, ty1, tz1), u);
+
+	_mm_storeu_ps(outValues, Lerp4(Lerp4(nx00, nx10, v), Lerp4(nx01, nx11, v), w));
+}
+
+void PerlinNoise3DBatchSIMD(const Vec3* positions, float* outValues, int count)
+{
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		float x[4] = { positions[i].x, positions[i + 1].x, positions[i + 2].x, positions[i + 3].x };
+		float y[4] = { positions[i].y, positions[i + 1].y, positions[i + 2].y, positions[i + 3].y };
+		float z[4] = { positions[i].z, positions[i + 1].z, positions[i + 2].z, positions[i + 3].z };
+		PerlinNoise3D4(x, y, z, outValues + i);
+	}
+	for (; i < count; ++i)
+	{
+		outValues[i] = PerlinNoise3D(positions[i].x, positions[i].y, positions[i].z);
+	}
+}
+
+void PerlinNoise3DWithDerivativeBatch(const Vec3* positions, PerlinSample* outSamples, int count)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		outSamples[i] = PerlinNoise3DWithDerivative(positions[i].x, positions[i].y, positions[i].z);
+	}
+}
+
 std::vector<float> GeneratePerlin3D(int width, int height, int depth, float scale, float frequency, float amplitude, float persistence, int numOctaves, int seed)
 {
 	UNUSED(seed);
@@ -163,3 +383,37 @@ std::vector<float> GeneratePerlin3D(int width, int height, int depth, float scal
 	}
 	return noiseArray;
 }
+
+
+std::vector<PerlinSample> GeneratePerlinGradient3D(int width, int height, int depth, float scale, float frequency, float amplitude, float persistence, int numOctaves, int seed)
+{
+	UNUSED(seed);
+	std::vector<PerlinSample> gradientArray(width * height * depth);
+
+	for (int z = 0; z < depth; ++z) {
+		for (int y = 0; y < height; ++y) {
+			for (int x = 0; x < width; ++x) {
+				PerlinSample result;
+				float currentAmplitude = amplitude;
+				float currentFrequency = frequency * scale;
+
+				for (int octave = 0; octave < numOctaves; ++octave) {
+					PerlinSample octaveSample = PerlinNoise3DWithDerivative(x * currentFrequency, y * currentFrequency, z * currentFrequency);
+
+					// Chain rule: d/dx noise(x * f) = f * noise'(x * f)
+					float derivativeScale = currentAmplitude * currentFrequency;
+					result.value += octaveSample.value * currentAmplitude;
+					result.derivative.x += octaveSample.derivative.x * derivativeScale;
+					result.derivative.y += octaveSample.derivative.y * derivativeScale;
+					result.derivative.z += octaveSample.derivative.z * derivativeScale;
+
+					currentAmplitude *= persistence;
+					currentFrequency *= 2.0f;
+				}
+
+				gradientArray[z * width * height + y * width + x] = result;
+			}
+		}
+	}
+	return gradientArray;
+}
@@ -1,6 +1,14 @@
 #pragma once
 
 #include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Math/Vec3.hpp"
+
+// Noise value plus its analytic derivative (d/dx, d/dy, d/dz) at a sample point
+struct PerlinSample
+{
+	float value = 0.f;
+	Vec3 derivative = Vec3();
+};
 
 int Hash(int x, int y, int z);
 
@@ -8,10 +16,30 @@ Vec3 Gradient(int x, int y, int z);
 
 float Fade(float t);
 
+float FadeDerivative(float t);
+
 float Lerp(float a, float b, float t);
 
 float DotGridGradient(int ix, int iy, int iz, float x, float y, float z);
 
 float PerlinNoise3D(float x, float y, float z);
 
-std::vector<float> GeneratePerlin3D(int width, int height, int depth, float scale, float frequency, float amplitude, float persistence, int numOctaves, int seed);
\ No newline at end of file
+PerlinSample PerlinNoise3DWithDerivative(float x, float y, float z);
+
+// Tileable variant: the lattice repeats every 'period' cells on each axis
+PerlinSample PerlinNoise3DWithDerivative(float x, float y, float z, int period, int seed);
+
+void PerlinNoise3DBatch(const Vec3* positions, float* outValues, int count);
+
+// PerlinNoise3D at four points at once in SSE2 lanes, with the same lattice, gradients and result
+void PerlinNoise3D4(const float* x, const float* y, const float* z, float* outValues);
+
+// PerlinNoise3DBatch through PerlinNoise3D4, four positions at a time
+void PerlinNoise3DBatchSIMD(const Vec3* positions, float* outValues, int count);
+
+void PerlinNoise3DWithDerivativeBatch(const Vec3* positions, PerlinSample* outSamples, int count);
+
+std::vector<float> GeneratePerlin3D(int width, int height, int depth, float scale, float frequency, float amplitude, float persistence, int numOctaves, int seed);
+
+// Same octave sum as GeneratePerlin3D, but each texel also carries the gradient with respect to the texel coordinates
+std::vector<PerlinSample> GeneratePerlinGradient3D(int width, int height, int depth, float scale, float frequency, float amplitude, float persistence, int numOctaves, int seed);
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "Game/Prop.hpp"
+#include "Game/GameRenderBackend.hpp"
 
 
 Prop::Prop(Game* owner, Vec3 const& startPos, ObjectType type) : Entity(owner, startPos)
@@ -12,7 +13,7 @@ Prop::Prop(Game* owner, Vec3 const& startPos, ObjectType type) : Entity(owner, s
 
 	m_modelMatrix.SetTranslation3D(m_position);
 
-	m_texture = g_theRenderer->CreateOrGetTextureFromFile("Data/Images/TestUV.png");
+	m_texture = g_theRenderBackend->CreateOrGetTextureFromFile("Data/Images/TestUV.png");
 
 	InitializeLocalVerts();
 }
@@ -49,72 +50,72 @@ void Prop::Update(float deltaSeconds)
 
 void Prop::RenderShadow() const
 {
-	g_theRenderer->SetDepthMode(DepthMode::ENABLED);
+	g_theRenderBackend->SetDepthMode(DepthMode::ENABLED);
 
 	if (m_type == ObjectType::UniformColorCube)
 	{
-		g_theRenderer->SetBlendMode(BlendMode::OPAQUE);
-		g_theRenderer->BindTexture(nullptr);
+		g_theRenderBackend->SetBlendMode(BlendMode::OPAQUE);
+		g_theRenderBackend->BindTexture(nullptr);
 
-		g_theRenderer->SetModelConstants(m_modelMatrix, m_color);
+		g_theRenderBackend->SetModelConstants(m_modelMatrix, m_color);
 
-		g_theRenderer->DrawVertexArray((int)m_vertexes.size(), m_vertexes.data());
+		g_theRenderBackend->DrawVertexArray((int)m_vertexes.size(), m_vertexes.data());
 		return;
 	}
 }
 
 void Prop::Render() const
 {
-	g_theRenderer->SetDepthMode(DepthMode::ENABLED);
+	g_theRenderBackend->SetDepthMode(DepthMode::ENABLED);
 
 	if(m_type == ObjectType::Cube)
 	{
-		g_theRenderer->SetBlendMode(BlendMode::OPAQUE);
-		g_theRenderer->BindTexture(nullptr);
+		g_theRenderBackend->SetBlendMode(BlendMode::OPAQUE);
+		g_theRenderBackend->BindTexture(nullptr);
 		
-		g_theRenderer->SetModelConstants(m_modelMatrix, m_color);
+		g_theRenderBackend->SetModelConstants(m_modelMatrix, m_color);
 
-		g_theRenderer->DrawVertexArray((int)m_vertexes.size(), m_vertexes.data());
+		g_theRenderBackend->DrawVertexArray((int)m_vertexes.size(), m_vertexes.data());
 	}
 
 	else if(m_type == ObjectType::Sphere)
 	{
-		g_theRenderer->SetBlendMode(BlendMode::OPAQUE);
-		g_theRenderer->BindTexture(m_texture);
+		g_theRenderBackend->SetBlendMode(BlendMode::OPAQUE);
+		g_theRenderBackend->BindTexture(m_texture);
 
-		g_theRenderer->SetModelConstants(m_modelMatrix, m_color);
+		g_theRenderBackend->SetModelConstants(m_modelMatrix, m_color);
 
-		g_theRenderer->DrawVertexArray((int)m_vertexes.size(), m_vertexes.data());
+		g_theRenderBackend->DrawVertexArray((int)m_vertexes.size(), m_vertexes.data());
 	}
 
 	else if (m_type == ObjectType::Cylinder)
 	{
-		g_theRenderer->SetBlendMode(BlendMode::OPAQUE);
-		g_theRenderer->BindTexture(m_texture);
+		g_theRenderBackend->SetBlendMode(BlendMode::OPAQUE);
+		g_theRenderBackend->BindTexture(m_texture);
 
-		g_theRenderer->SetModelConstants(m_modelMatrix, m_color);
+		g_theRenderBackend->SetModelConstants(m_modelMatrix, m_color);
 
-		g_theRenderer->DrawVertexArray((int)m_vertexes.size(), m_vertexes.data());
+		g_theRenderBackend->DrawVertexArray((int)m_vertexes.size(), m_vertexes.data());
 	}
 
 	else if (m_type == ObjectType::Cone)
 	{
-		g_theRenderer->SetBlendMode(BlendMode::OPAQUE);
-		g_theRenderer->BindTexture(m_texture);
+		g_theRenderBackend->SetBlendMode(BlendMode::OPAQUE);
+		g_theRenderBackend->BindTexture(m_texture);
 
-		g_theRenderer->SetModelConstants(m_modelMatrix, m_color);
+		g_theRenderBackend->SetModelConstants(m_modelMatrix, m_color);
 
-		g_theRenderer->DrawVertexArray((int)m_vertexes.size(), m_vertexes.data());
+		g_theRenderBackend->DrawVertexArray((int)m_vertexes.size(), m_vertexes.data());
 	}
 
 	else if (m_type == ObjectType::UniformColorCube)
 	{
-		g_theRenderer->SetBlendMode(BlendMode::OPAQUE);
-		g_theRenderer->BindTexture(nullptr);
+		g_theRenderBackend->SetBlendMode(BlendMode::OPAQUE);
+		g_theRenderBackend->BindTexture(nullptr);
 
-		g_theRenderer->SetModelConstants(m_modelMatrix, m_color);
+		g_theRenderBackend->SetModelConstants(m_modelMatrix, m_color);
 
-		g_theRenderer->DrawVertexArray((int)m_vertexes.size(), m_vertexes.data());
+		g_theRenderBackend->DrawVertexArray((int)m_vertexes.size(), m_vertexes.data());
 	}
 }
 
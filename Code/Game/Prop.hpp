@@ -34,6 +34,8 @@ public:
 	virtual void RenderShadow() const override;
 	virtual void Render() const override;
 
+	ObjectType GetType() const { return m_type; }
+
 
 	Mat44					m_modelMatrix;
 
@@ -0,0 +1,380 @@
+#include "Game/VolumeMipChain.hpp"
+#include "Game/ParallelFor.hpp"
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+constexpr char VOLUME_MIP_CACHE_MAGIC[4] = { 'V', 'M', 'I', 'P' };
+constexpr int VOLUME_MIP_CACHE_VERSION = 1;
+constexpr float VOLUME_MIP_PI = 3.14159265f;
+
+struct VolumeMipCacheHeader
+{
+	char magic[4];
+	int version;
+	int width;
+	int height;
+	int depth;
+	int numLevels;
+	int filter;
+	int wrap;
+	float kaiserRadius;
+	float kaiserAlpha;
+};
+
+struct FilterTaps
+{
+	std::vector<int> firstWeight;	// Per destination texel: offset into weights/sourceIndices
+	std::vector<int> numTaps;
+	std::vector<int> sourceIndices;
+	std::vector<float> weights;
+};
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window
+static float BesselI0(float x)
+{
+	float sum = 1.f;
+	float term = 1.f;
+	float halfX = 0.5f * x;
+	for (int k = 1; k < 16; ++k)
+	{
+		term *= (halfX / (float)k) * (halfX / (float)k);
+		sum += term;
+	}
+	return sum;
+}
+
+static float EvaluateFilter(const VolumeMipConfig& config, float distance)
+{
+	if (config.filter == VolumeMipFilter::BOX)
+	{
+		return (fabsf(distance) <= 0.5f) ? 1.f : 0.f;
+	}
+
+	// Kaiser-windowed sinc with the cutoff at the smaller level's Nyquist frequency
+	float x = distance / config.kaiserRadius;
+	if (fabsf(x) >= 1.f)
+	{
+		return 0.f;
+	}
+
+	float sinc = (fabsf(distance) < 1e-5f) ? 1.f : sinf(VOLUME_MIP_PI * distance) / (VOLUME_MIP_PI * distance);
+	float window = BesselI0(config.kaiserAlpha * sqrtf(1.f - x * x)) / BesselI0(config.kaiserAlpha);
+	return sinc * window;
+}
+
+// The taps only depend on the axis sizes, so they're computed once per axis per level
+static FilterTaps ComputeFilterTaps(const VolumeMipConfig& config, int sourceSize, int destinationSize)
+{
+	FilterTaps taps;
+	float scale = (float)sourceSize / (float)destinationSize;
+	float support = (config.filter == VolumeMipFilter::BOX) ? 0.5f : config.kaiserRadius;
+
+	for (int i = 0; i < destinationSize; ++i)
+	{
+		float center = ((float)i + 0.5f) * scale;
+		int first = (int)floorf(center - support * scale);
+		int last = (int)ceilf(center + support * scale);
+
+		taps.firstWeight.push_back((int)taps.weights.size());
+		float weightSum = 0.f;
+		int count = 0;
+
+		for (int j = first; j <= last; ++j)
+		{
+			float weight = EvaluateFilter(config, ((float)j + 0.5f - center) / scale);
+			if (weight == 0.f)
+			{
+				continue;
+			}
+
+			int index = j;
+			if (config.wrap)
+			{
+				index = ((j % sourceSize) + sourceSize) % sourceSize;
+			}
+			else
+			{
+				index = (j < 0) ? 0 : ((j >= sourceSize) ? sourceSize - 1 : j);
+			}
+
+			taps.sourceIndices.push_back(index);
+			taps.weights.push_back(weight);
+			weightSum += weight;
+			++count;
+		}
+
+		for (int k = 0; k < count; ++k)
+		{
+			taps.weights[taps.firstWeight.back() + k] /= weightSum;
+		}
+		taps.numTaps.push_back(count);
+	}
+
+	return taps;
+}
+
+// Filters one axis down to destinationSize, leaving the other two untouched
+static void DownsampleAxis(const std::vector<float>& source, const IntVec3& sourceDimensions, int axis, int destinationSize,
+	const VolumeMipConfig& config, std::vector<float>& destination, IntVec3& destinationDimensions)
+{
+	int sourceSize = (axis == 0) ? sourceDimensions.x : ((axis == 1) ? sourceDimensions.y : sourceDimensions.z);
+
+	destinationDimensions = sourceDimensions;
+	if (axis == 0) destinationDimensions.x = destinationSize;
+	if (axis == 1) destinationDimensions.y = destinationSize;
+	if (axis == 2) destinationDimensions.z = destinationSize;
+
+	destination.assign((size_t)destinationDimensions.x * destinationDimensions.y * destinationDimensions.z, 0.f);
+
+	FilterTaps taps = ComputeFilterTaps(config, sourceSize, destinationSize);
+
+	size_t sourceStride = (axis == 0) ? 1 : ((axis == 1) ? (size_t)sourceDimensions.x : (size_t)sourceDimensions.x * sourceDimensions.y);
+	size_t destinationStride = (axis == 0) ? 1 : ((axis == 1) ? (size_t)destinationDimensions.x : (size_t)destinationDimensions.x * destinationDimensions.y);
+
+	// Every line along the filtered axis is independent
+	int numLinesA = (axis == 0) ? sourceDimensions.y : sourceDimensions.x;
+	int numLinesB = (axis == 2) ? sourceDimensions.y : sourceDimensions.z;
+
+	ParallelFor(numLinesA * numLinesB, [&](int begin, int end)
+	{
+		for (int line = begin; line < end; ++line)
+		{
+			int a = line % numLinesA;
+			int b = line / numLinesA;
+
+			int x = (axis == 0) ? 0 : a;
+			int y = (axis == 0) ? a : ((axis == 1) ? 0 : b);
+			int z = (axis == 2) ? 0 : b;
+
+			size_t sourceBase = ((size_t)z * sourceDimensions.y + y) * sourceDimensions.x + x;
+			size_t destinationBase = ((size_t)z * destinationDimensions.y + y) * destinationDimensions.x + x;
+
+			for (int i = 0; i < destinationSize; ++i)
+			{
+				float sum = 0.f;
+				int firstWeight = taps.firstWeight[i];
+				for (int k = 0; k < taps.numTaps[i]; ++k)
+				{
+					sum += taps.weights[firstWeight + k] * source[sourceBase + taps.sourceIndices[firstWeight + k] * sourceStride];
+				}
+				destination[destinationBase + i * destinationStride] = sum;
+			}
+		}
+	}, config.numThreads);
+}
+
+void VolumeMipChain::Build(const std::vector<float>& baseLevel, const IntVec3& dimensions, const VolumeMipConfig& config)
+{
+	m_config = config;
+	m_levels.clear();
+	m_levelDimensions.clear();
+
+	m_levels.push_back(baseLevel);
+	m_levelDimensions.push_back(dimensions);
+
+	// Separable: each level is three 1D passes, halving one axis at a time
+	std::vector<float> scratchA;
+	std::vector<float> scratchB;
+
+	while (config.maxLevels <= 0 || (int)m_levels.size() < config.maxLevels)
+	{
+		IntVec3 sourceDimensions = m_levelDimensions.back();
+		if (sourceDimensions.x == 1 && sourceDimensions.y == 1 && sourceDimensions.z == 1)
+		{
+			break;
+		}
+
+		IntVec3 targetDimensions = IntVec3(sourceDimensions.x > 1 ? sourceDimensions.x / 2 : 1,
+			sourceDimensions.y > 1 ? sourceDimensions.y / 2 : 1,
+			sourceDimensions.z > 1 ? sourceDimensions.z / 2 : 1);
+
+		IntVec3 dimensionsX;
+		IntVec3 dimensionsY;
+		IntVec3 dimensionsZ;
+		DownsampleAxis(m_levels.back(), sourceDimensions, 0, targetDimensions.x, config, scratchA, dimensionsX);
+		DownsampleAxis(scratchA, dimensionsX, 1, targetDimensions.y, config, scratchB, dimensionsY);
+
+		std::vector<float> level;
+		DownsampleAxis(scratchB, dimensionsY, 2, targetDimensions.z, config, level, dimensionsZ);
+
+		m_levels.push_back(std::move(level));
+		m_levelDimensions.push_back(dimensionsZ);
+	}
+}
+
+void VolumeMipChain::LoadOrBuild(const std::string& cachePath, const IntVec3& dimensions, const VolumeMipConfig& config,
+	const std::function<void(std::vector<float>& baseLevel)>& bakeBaseLevel)
+{
+	if (LoadFromFile(cachePath, dimensions, config))
+	{
+		return;
+	}
+
+	std::vector<float> baseLevel((size_t)dimensions.x * dimensions.y * dimensions.z, 0.f);
+	bakeBaseLevel(baseLevel);
+	Build(baseLevel, dimensions, config);
+
+	// A failed write only costs a rebuild next run
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path(), error);
+	SaveToFile(cachePath);
+}
+
+bool VolumeMipChain::LoadFromFile(const std::string& filePath, const IntVec3& dimensions, const VolumeMipConfig& config)
+{
+	std::ifstream file(filePath, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	VolumeMipCacheHeader header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file || memcmp(header.magic, VOLUME_MIP_CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != VOLUME_MIP_CACHE_VERSION)
+	{
+		return false;
+	}
+
+	if (header.width != dimensions.x || header.height != dimensions.y || header.depth != dimensions.z ||
+		header.filter != (int)config.filter || header.wrap != (config.wrap ? 1 : 0) ||
+		header.kaiserRadius != config.kaiserRadius || header.kaiserAlpha != config.kaiserAlpha ||
+		(config.maxLevels > 0 && header.numLevels != config.maxLevels))
+	{
+		return false;
+	}
+
+	std::vector<IntVec3> levelDimensions;
+	std::vector<std::vector<float>> levels;
+
+	IntVec3 levelSize = dimensions;
+	for (int level = 0; level < header.numLevels; ++level)
+	{
+		std::vector<float> values((size_t)levelSize.x * levelSize.y * levelSize.z);
+		file.read(reinterpret_cast<char*>(values.data()), (std::streamsize)(values.size() * sizeof(float)));
+		if (!file)
+		{
+			return false;
+		}
+
+		levelDimensions.push_back(levelSize);
+		levels.push_back(std::move(values));
+		levelSize = IntVec3(levelSize.x > 1 ? levelSize.x / 2 : 1, levelSize.y > 1 ? levelSize.y / 2 : 1, levelSize.z > 1 ? levelSize.z / 2 : 1);
+	}
+
+	m_config = config;
+	m_levelDimensions.swap(levelDimensions);
+	m_levels.swap(levels);
+	return true;
+}
+
+bool VolumeMipChain::SaveToFile(const std::string& filePath) const
+{
+	if (m_levels.empty())
+	{
+		return false;
+	}
+
+	std::ofstream file(filePath, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	VolumeMipCacheHeader header;
+	memcpy(header.magic, VOLUME_MIP_CACHE_MAGIC, sizeof(header.magic));
+	header.version = VOLUME_MIP_CACHE_VERSION;
+	header.width = m_levelDimensions[0].x;
+	header.height = m_levelDimensions[0].y;
+	header.depth = m_levelDimensions[0].z;
+	header.numLevels = (int)m_levels.size();
+	header.filter = (int)m_config.filter;
+	header.wrap = m_config.wrap ? 1 : 0;
+	header.kaiserRadius = m_config.kaiserRadius;
+	header.kaiserAlpha = m_config.kaiserAlpha;
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	for (const std::vector<float>& level : m_levels)
+	{
+		file.write(reinterpret_cast<const char*>(level.data()), (std::streamsize)(level.size() * sizeof(float)));
+	}
+	return file.good();
+}
+
+int VolumeMipChain::AddressTexel(int coordinate, int size) const
+{
+	if (m_config.wrap)
+	{
+		return ((coordinate % size) + size) % size;
+	}
+	return (coordinate < 0) ? 0 : ((coordinate >= size) ? size - 1 : coordinate);
+}
+
+float VolumeMipChain::GetTexel(int level, int x, int y, int z) const
+{
+	const IntVec3& dimensions = m_levelDimensions[level];
+	x = AddressTexel(x, dimensions.x);
+	y = AddressTexel(y, dimensions.y);
+	z = AddressTexel(z, dimensions.z);
+	return m_levels[level][((size_t)z * dimensions.y + y) * dimensions.x + x];
+}
+
+float VolumeMipChain::SampleTrilinear(int level, const Vec3& uvw) const
+{
+	const IntVec3& dimensions = m_levelDimensions[level];
+
+	// Texel centers sit at (i + 0.5) / size, same convention as the GPU sampler
+	float fx = uvw.x * dimensions.x - 0.5f;
+	float fy = uvw.y * dimensions.y - 0.5f;
+	float fz = uvw.z * dimensions.z - 0.5f;
+
+	int x0 = (int)floorf(fx);
+	int y0 = (int)floorf(fy);
+	int z0 = (int)floorf(fz);
+
+	float tx = fx - x0;
+	float ty = fy - y0;
+	float tz = fz - z0;
+
+	float c00 = GetTexel(level, x0, y0, z0) + (GetTexel(level, x0 + 1, y0, z0) - GetTexel(level, x0, y0, z0)) * tx;
+	float c10 = GetTexel(level, x0, y0 + 1, z0) + (GetTexel(level, x0 + 1, y0 + 1, z0) - GetTexel(level, x0, y0 + 1, z0)) * tx;
+	float c01 = GetTexel(level, x0, y0, z0 + 1) + (GetTexel(level, x0 + 1, y0, z0 + 1) - GetTexel(level, x0, y0, z0 + 1)) * tx;
+	float c11 = GetTexel(level, x0, y0 + 1, z0 + 1) + (GetTexel(level, x0 + 1, y0 + 1, z0 + 1) - GetTexel(level, x0, y0 + 1, z0 + 1)) * tx;
+
+	float c0 = c00 + (c10 - c00) * ty;
+	float c1 = c01 + (c11 - c01) * ty;
+
+	return c0 + (c1 - c0) * tz;
+}
+
+float VolumeMipChain::SampleLevel(const Vec3& uvw, float lod) const
+{
+	if (m_levels.empty())
+	{
+		return 0.f;
+	}
+
+	float maxLod = (float)(m_levels.size() - 1);
+	lod = (lod < 0.f) ? 0.f : ((lod > maxLod) ? maxLod : lod);
+
+	int level0 = (int)lod;
+	float t = lod - (float)level0;
+	float sample0 = SampleTrilinear(level0, uvw);
+	if (t <= 0.f || level0 + 1 >= (int)m_levels.size())
+	{
+		return sample0;
+	}
+
+	return sample0 + (SampleTrilinear(level0 + 1, uvw) - sample0) * t;
+}
+
+size_t VolumeMipChain::GetMemoryBytes() const
+{
+	size_t bytes = 0;
+	for (const std::vector<float>& level : m_levels)
+	{
+		bytes += level.size() * sizeof(float);
+	}
+	return bytes;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "Engine/Math/Vec3.hpp"
+#include "Engine/Math/IntVec3.hpp"
+#include <functional>
+#include <string>
+#include <vector>
+
+enum class VolumeMipFilter
+{
+	BOX,
+	KAISER,
+};
+
+struct VolumeMipConfig
+{
+	VolumeMipFilter filter = VolumeMipFilter::BOX;
+	bool wrap = true;				// Tileable volumes filter across the opposite face instead of clamping
+	float kaiserRadius = 2.f;		// Filter support in texels of the smaller level
+	float kaiserAlpha = 4.f;
+	int maxLevels = 0;				// 0 = down to 1x1x1
+	int numThreads = 0;				// 0 = all hardware threads
+};
+
+// Scalar 3D volume with a full mip chain built on the CPU. Levels are stored x-fastest.
+class VolumeMipChain
+{
+public:
+	VolumeMipChain() = default;
+
+	void Build(const std::vector<float>& baseLevel, const IntVec3& dimensions, const VolumeMipConfig& config);
+
+	// Loads the chain from cachePath when it was built with the same dimensions and config, otherwise calls
+	// bakeBaseLevel to fill level 0, builds the mips and writes them back to the cache
+	void LoadOrBuild(const std::string& cachePath, const IntVec3& dimensions, const VolumeMipConfig& config,
+		const std::function<void(std::vector<float>& baseLevel)>& bakeBaseLevel);
+	bool LoadFromFile(const std::string& filePath, const IntVec3& dimensions, const VolumeMipConfig& config);
+	bool SaveToFile(const std::string& filePath) const;
+
+	// Trilinear within a level, linear between levels, same addressing as a SampleLevel on a Texture3D
+	float SampleLevel(const Vec3& uvw, float lod) const;
+	float GetTexel(int level, int x, int y, int z) const;
+
+	int GetNumLevels() const { return (int)m_levels.size(); }
+	IntVec3 GetLevelDimensions(int level) const { return m_levelDimensions[level]; }
+	const std::vector<float>& GetLevel(int level) const { return m_levels[level]; }
+	size_t GetMemoryBytes() const;
+
+private:
+	float SampleTrilinear(int level, const Vec3& uvw) const;
+	int AddressTexel(int coordinate, int size) const;
+
+private:
+	VolumeMipConfig m_config;
+	std::vector<IntVec3> m_levelDimensions;
+	std::vector<std::vector<float>> m_levels;
+};
@@ -0,0 +1,277 @@
+#include "Game/VoxelOccupancyGrid.hpp"
+#include <cmath>
+
+constexpr float OCCUPANCY_NO_HIT = 1e30f;
+
+//-----------------------------------------------------------------------------------------------
+static int ClampInt(int value, int minValue, int maxValue)
+{
+	return (value < minValue) ? minValue : ((value > maxValue) ? maxValue : value);
+}
+
+static float GetAxis(const Vec3& vec, int axis)
+{
+	return (axis == 0) ? vec.x : ((axis == 1) ? vec.y : vec.z);
+}
+
+static int GetAxis(const IntVec3& vec, int axis)
+{
+	return (axis == 0) ? vec.x : ((axis == 1) ? vec.y : vec.z);
+}
+
+//-----------------------------------------------------------------------------------------------
+void VoxelOccupancyGrid::Build(const Vec3& minBounds, const Vec3& cellSize, const IntVec3& dimensions, const std::vector<Voxel>& voxels, const std::vector<int>& voxelIndices)
+{
+	m_minBounds = minBounds;
+	m_cellSize = cellSize;
+	m_dimensions = IntVec3(dimensions.x > 0 ? dimensions.x : 1, dimensions.y > 0 ? dimensions.y : 1, dimensions.z > 0 ? dimensions.z : 1);
+	m_blockDimensions = IntVec3((m_dimensions.x + OCCUPANCY_BLOCK_SIZE - 1) / OCCUPANCY_BLOCK_SIZE,
+		(m_dimensions.y + OCCUPANCY_BLOCK_SIZE - 1) / OCCUPANCY_BLOCK_SIZE,
+		(m_dimensions.z + OCCUPANCY_BLOCK_SIZE - 1) / OCCUPANCY_BLOCK_SIZE);
+
+	m_voxelIndices.assign((size_t)m_dimensions.x * m_dimensions.y * m_dimensions.z, -1);
+	m_blockMasks.assign((size_t)m_blockDimensions.x * m_blockDimensions.y * m_blockDimensions.z, 0);
+	m_numOccupied = 0;
+
+	for (int voxelIndex : voxelIndices)
+	{
+		// Voxel positions are cell centers
+		IntVec3 cell;
+		if (!FindCell(voxels[voxelIndex].m_position, cell))
+		{
+			continue;
+		}
+
+		int& cellVoxel = m_voxelIndices[GetCellIndex(cell.x, cell.y, cell.z)];
+		if (cellVoxel >= 0)
+		{
+			continue;
+		}
+
+		cellVoxel = voxelIndex;
+		int bit = (cell.x % OCCUPANCY_BLOCK_SIZE) + (cell.y % OCCUPANCY_BLOCK_SIZE) * OCCUPANCY_BLOCK_SIZE + (cell.z % OCCUPANCY_BLOCK_SIZE) * OCCUPANCY_BLOCK_SIZE * OCCUPANCY_BLOCK_SIZE;
+		m_blockMasks[GetBlockIndex(cell.x, cell.y, cell.z)] |= (uint64_t)1 << bit;
+		m_numOccupied++;
+	}
+}
+
+int VoxelOccupancyGrid::GetBlockIndex(int x, int y, int z) const
+{
+	int blockX = x / OCCUPANCY_BLOCK_SIZE;
+	int blockY = y / OCCUPANCY_BLOCK_SIZE;
+	int blockZ = z / OCCUPANCY_BLOCK_SIZE;
+	return (blockZ * m_blockDimensions.y + blockY) * m_blockDimensions.x + blockX;
+}
+
+bool VoxelOccupancyGrid::IsOccupied(const IntVec3& cell) const
+{
+	if (cell.x < 0 || cell.y < 0 || cell.z < 0 || cell.x >= m_dimensions.x || cell.y >= m_dimensions.y || cell.z >= m_dimensions.z)
+	{
+		return false;
+	}
+
+	int bit = (cell.x % OCCUPANCY_BLOCK_SIZE) + (cell.y % OCCUPANCY_BLOCK_SIZE) * OCCUPANCY_BLOCK_SIZE + (cell.z % OCCUPANCY_BLOCK_SIZE) * OCCUPANCY_BLOCK_SIZE * OCCUPANCY_BLOCK_SIZE;
+	return (GetBlockMask(cell.x, cell.y, cell.z) >> bit) & 1;
+}
+
+int VoxelOccupancyGrid::GetVoxelIndex(const IntVec3& cell) const
+{
+	if (cell.x < 0 || cell.y < 0 || cell.z < 0 || cell.x >= m_dimensions.x || cell.y >= m_dimensions.y || cell.z >= m_dimensions.z)
+	{
+		return -1;
+	}
+	return m_voxelIndices[GetCellIndex(cell.x, cell.y, cell.z)];
+}
+
+bool VoxelOccupancyGrid::FindCell(const Vec3& position, IntVec3& cell) const
+{
+	cell.x = (int)floorf((position.x - m_minBounds.x) / m_cellSize.x);
+	cell.y = (int)floorf((position.y - m_minBounds.y) / m_cellSize.y);
+	cell.z = (int)floorf((position.z - m_minBounds.z) / m_cellSize.z);
+	return cell.x >= 0 && cell.y >= 0 && cell.z >= 0 && cell.x < m_dimensions.x && cell.y < m_dimensions.y && cell.z < m_dimensions.z;
+}
+
+bool VoxelOccupancyGrid::IntersectBounds(const Vec3& origin, const Vec3& direction, float& tEnter, float& tExit) const
+{
+	tEnter = 0.f;
+	tExit = OCCUPANCY_NO_HIT;
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float axisOrigin = GetAxis(origin, axis);
+		float axisDirection = GetAxis(direction, axis);
+		float axisMin = GetAxis(m_minBounds, axis);
+		float axisMax = axisMin + GetAxis(m_cellSize, axis) * (float)GetAxis(m_dimensions, axis);
+
+		if (axisDirection == 0.f)
+		{
+			if (axisOrigin < axisMin || axisOrigin > axisMax)
+			{
+				return false;
+			}
+			continue;
+		}
+
+		float t1 = (axisMin - axisOrigin) / axisDirection;
+		float t2 = (axisMax - axisOrigin) / axisDirection;
+		tEnter = fmaxf(tEnter, fminf(t1, t2));
+		tExit = fminf(tExit, fmaxf(t1, t2));
+	}
+
+	return tEnter <= tExit;
+}
+
+bool VoxelOccupancyGrid::FindFirstOccupied(const Vec3& origin, const Vec3& direction, float tMax, VoxelGridHit& hit, int* numCellsVisited) const
+{
+	float tStart = 0.f;
+	float tEnd = 0.f;
+	if (!IntersectBounds(origin, direction, tStart, tEnd))
+	{
+		return false;
+	}
+
+	tEnd = fminf(tEnd, tMax);
+	if (tStart > tEnd)
+	{
+		return false;
+	}
+
+	float rayOrigin[3] = { origin.x, origin.y, origin.z };
+	float rayDirection[3] = { direction.x, direction.y, direction.z };
+	float gridMin[3] = { m_minBounds.x, m_minBounds.y, m_minBounds.z };
+	float cellSize[3] = { m_cellSize.x, m_cellSize.y, m_cellSize.z };
+	int dimensions[3] = { m_dimensions.x, m_dimensions.y, m_dimensions.z };
+
+	int cell[3];
+	int step[3];
+	float tDelta[3];
+	float tNext[3];
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float startPoint = rayOrigin[axis] + rayDirection[axis] * tStart;
+		cell[axis] = ClampInt((int)floorf((startPoint - gridMin[axis]) / cellSize[axis]), 0, dimensions[axis] - 1);
+		step[axis] = (rayDirection[axis] > 0.f) ? 1 : ((rayDirection[axis] < 0.f) ? -1 : 0);
+		tDelta[axis] = (step[axis] != 0) ? cellSize[axis] / fabsf(rayDirection[axis]) : OCCUPANCY_NO_HIT;
+	}
+
+	int visited = 0;
+	float t = tStart;
+
+	for (;;)
+	{
+		// Exit distance of the current cell on each axis, recomputed from the cell so hops don't drift
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			tNext[axis] = (step[axis] != 0) ? (gridMin[axis] + (float)(cell[axis] + (step[axis] > 0 ? 1 : 0)) * cellSize[axis] - rayOrigin[axis]) / rayDirection[axis] : OCCUPANCY_NO_HIT;
+		}
+
+		int blockLo[3];
+		int blockHi[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			blockLo[axis] = (cell[axis] / OCCUPANCY_BLOCK_SIZE) * OCCUPANCY_BLOCK_SIZE;
+			blockHi[axis] = ClampInt(blockLo[axis] + OCCUPANCY_BLOCK_SIZE - 1, 0, dimensions[axis] - 1);
+		}
+
+		visited++;
+
+		if (GetBlockMask(cell[0], cell[1], cell[2]) == 0)
+		{
+			// Empty block: jump straight to the face the ray leaves through
+			int exitAxis = 0;
+			float tBlockExit = OCCUPANCY_NO_HIT;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				if (step[axis] == 0)
+				{
+					continue;
+				}
+
+				int boundary = (step[axis] > 0) ? blockHi[axis] + 1 : blockLo[axis];
+				float tBoundary = (gridMin[axis] + (float)boundary * cellSize[axis] - rayOrigin[axis]) / rayDirection[axis];
+				if (tBoundary < tBlockExit)
+				{
+					tBlockExit = tBoundary;
+					exitAxis = axis;
+				}
+			}
+
+			if (tBlockExit > tEnd)
+			{
+				break;
+			}
+
+			t = tBlockExit;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				if (axis == exitAxis)
+				{
+					cell[axis] = (step[axis] > 0) ? blockHi[axis] + 1 : blockLo[axis] - 1;
+				}
+				else
+				{
+					float point = rayOrigin[axis] + rayDirection[axis] * t;
+					cell[axis] = ClampInt((int)floorf((point - gridMin[axis]) / cellSize[axis]), blockLo[axis], blockHi[axis]);
+				}
+			}
+
+			if (cell[exitAxis] < 0 || cell[exitAxis] >= dimensions[exitAxis])
+			{
+				break;
+			}
+			continue;
+		}
+
+		// Occupied block: plain cell DDA until the ray leaves it
+		bool isInBlock = true;
+		while (isInBlock)
+		{
+			int voxelIndex = m_voxelIndices[GetCellIndex(cell[0], cell[1], cell[2])];
+			int exitAxis = (tNext[0] < tNext[1]) ? ((tNext[0] < tNext[2]) ? 0 : 2) : ((tNext[1] < tNext[2]) ? 1 : 2);
+
+			if (voxelIndex >= 0)
+			{
+				hit.cell = IntVec3(cell[0], cell[1], cell[2]);
+				hit.voxelIndex = voxelIndex;
+				hit.tEnter = t;
+				hit.tExit = fminf(tNext[exitAxis], tEnd);
+				if (numCellsVisited != nullptr)
+				{
+					*numCellsVisited += visited;
+				}
+				return true;
+			}
+
+			t = tNext[exitAxis];
+			if (t > tEnd)
+			{
+				break;
+			}
+
+			cell[exitAxis] += step[exitAxis];
+			tNext[exitAxis] += tDelta[exitAxis];
+			if (cell[exitAxis] < 0 || cell[exitAxis] >= dimensions[exitAxis])
+			{
+				break;
+			}
+
+			isInBlock = cell[exitAxis] >= blockLo[exitAxis] && cell[exitAxis] <= blockHi[exitAxis];
+			if (isInBlock)
+			{
+				visited++;
+			}
+		}
+
+		if (isInBlock || t > tEnd || cell[0] < 0 || cell[1] < 0 || cell[2] < 0 || cell[0] >= dimensions[0] || cell[1] >= dimensions[1] || cell[2] >= dimensions[2])
+		{
+			break;
+		}
+	}
+
+	if (numCellsVisited != nullptr)
+	{
+		*numCellsVisited += visited;
+	}
+	return false;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "Game/Voxel.hpp"
+#include <cstdint>
+#include <vector>
+
+constexpr int OCCUPANCY_BLOCK_SIZE = 4;		// 4x4x4 cells per 64-bit mask word
+
+struct VoxelGridHit
+{
+	IntVec3 cell;
+	int voxelIndex = -1;
+	float tEnter = 0.f;						// Where the ray enters the cell (0 if it starts inside)
+	float tExit = 0.f;
+};
+
+// A cloud's voxels on their regular grid, with one occupancy bit per cell packed as one 64-bit word per
+// 4x4x4 block. Rays walk it cell by cell (Amanatides-Woo) and hop empty blocks in one step.
+class VoxelOccupancyGrid
+{
+public:
+	VoxelOccupancyGrid() = default;
+
+	// Cells are cellSize wide starting at minBounds; voxelIndices picks this cloud's voxels out of voxels.
+	// When two voxels share a cell the first one wins.
+	void Build(const Vec3& minBounds, const Vec3& cellSize, const IntVec3& dimensions, const std::vector<Voxel>& voxels, const std::vector<int>& voxelIndices);
+
+	bool IsOccupied(const IntVec3& cell) const;
+	int GetVoxelIndex(const IntVec3& cell) const;
+	bool FindCell(const Vec3& position, IntVec3& cell) const;
+
+	// Slab test against the whole grid
+	bool IntersectBounds(const Vec3& origin, const Vec3& direction, float& tEnter, float& tExit) const;
+
+	// First occupied cell along the ray within [0, tMax]; numCellsVisited counts cells and block hops
+	bool FindFirstOccupied(const Vec3& origin, const Vec3& direction, float tMax, VoxelGridHit& hit, int* numCellsVisited = nullptr) const;
+
+	const IntVec3& GetDimensions() const { return m_dimensions; }
+	int GetNumOccupied() const { return m_numOccupied; }
+	size_t GetMemoryBytes() const { return m_blockMasks.size() * sizeof(uint64_t) + m_voxelIndices.size() * sizeof(int); }
+
+private:
+	int GetCellIndex(int x, int y, int z) const { return (z * m_dimensions.y + y) * m_dimensions.x + x; }
+	int GetBlockIndex(int x, int y, int z) const;
+	uint64_t GetBlockMask(int x, int y, int z) const { return m_blockMasks[GetBlockIndex(x, y, z)]; }
+
+private:
+	Vec3 m_minBounds;
+	Vec3 m_cellSize = Vec3(1.f, 1.f, 1.f);
+	IntVec3 m_dimensions;
+	IntVec3 m_blockDimensions;
+	std::vector<uint64_t> m_blockMasks;
+	std::vector<int> m_voxelIndices;		// Per cell, -1 when empty
+	int m_numOccupied = 0;
+};
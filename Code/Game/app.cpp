@@ -1,6 +1,8 @@
 #pragma once
 #include "Game/app.hpp"
 #include "Game/Player.hpp"
+#include "Game/EngineRenderBackend.hpp"
+#include "Game/CpuProfiler.hpp"
 #include <math.h>
 #include <cassert>
 #include <crtdbg.h>
@@ -16,6 +18,7 @@
 
 App* g_theApp = nullptr;
 Renderer*  g_theRenderer = nullptr;
+GameRenderBackend* g_theRenderBackend = nullptr;
 AudioSystem* g_theAudioSystem = nullptr;
 Window* g_theWindow = nullptr;
 
@@ -97,6 +100,7 @@ void App::InitializeSystems()
 	RenderConfig renderConfig;
 	renderConfig.m_window = g_theWindow;
 	g_theRenderer = new Renderer(renderConfig);
+	g_theRenderBackend = new EngineRenderBackend();
 
 	Camera camera = Camera();
 	camera.SetOrthoView(AABB2(Vec2(0.f, 0.f), Vec2(1600.f, 800.f)));
@@ -168,6 +172,9 @@ void App:: Shutdown()
 	delete m_theGame;
 	m_theGame = nullptr;
 
+	delete g_theRenderBackend;
+	g_theRenderBackend = nullptr;
+
 	delete g_theRenderer;
 	g_theRenderer = nullptr;
 
@@ -200,16 +207,22 @@ void App::RunFrame()
 {
 	//currentframe = GetCurrentTimeSeconds();
 	//float deltaSeconds = (float)currentframe - (float)previousframe;
-	BeginFrame();	//once this function becomes App::RunFrame()
+	CpuProfiler::Get().BeginFrame();
+	{
+		PROFILE_SCOPE("App::RunFrame");
+		BeginFrame();	//once this function becomes App::RunFrame()
 
-	//if (m_isPaused == false) // if the program is paused, stop updating the game itself, but continue rendering(check to see if you should just stop everything)
-	Update();
+		//if (m_isPaused == false) // if the program is paused, stop updating the game itself, but continue rendering(check to see if you should just stop everything)
+		Update();
 
-	RunCompute();
-	PrepareForRender();
+		RunCompute();
+		PrepareForRender();
 
-	Render();		//once this function becomes App::RunFrame()
-	EndFrame();	//once this function becomes App::RunFrame()
+		Render();		//once this function becomes App::RunFrame()
+		EndFrame();	//once this function becomes App::RunFrame()
+	}
+	// Zones close before the frame is collected
+	CpuProfiler::Get().EndFrame();
 	//previousframe = currentframe;
 }
 
@@ -0,0 +1,282 @@
+#include "NoiseBenchmark/NoiseBenchmark.hpp"
+#include "Game/Perlin3D.hpp"
+#include "Game/ParallelFor.hpp"
+#include "ThirdParty/Engine_Code_ThirdParty_Squirrel/SmoothNoise.hpp"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+
+typedef float (*NoiseKernelFunction)(float x, float y, float z);
+
+struct NoiseKernel
+{
+	const char* name;
+	NoiseKernelFunction function;
+};
+
+// Each kernel is called with texel-space coordinates and applies the same scaling as its call site in the game
+static const NoiseKernel s_noiseKernels[] =
+{
+	{ "PerlinNoise3D",					[](float x, float y, float z) { return PerlinNoise3D(x * 0.05f, y * 0.05f, z * 0.05f); } },
+	{ "PerlinNoise3DWithDerivative",	[](float x, float y, float z) { return PerlinNoise3DWithDerivative(x * 0.05f, y * 0.05f, z * 0.05f).value; } },
+	{ "Compute3dPerlinNoise",			[](float x, float y, float z) { return Compute3dPerlinNoise(x * 0.1f, y * 0.1f, z * 0.1f, 10.f, 3, 0.5f, 2.f, true, 0); } },
+	{ "Compute3dWorleyNoise",			[](float x, float y, float z) { return Compute3dWorleyNoise(x * 20.f, y * 20.f, z * 20.f, 1.5f, 0); } },
+};
+
+// Keeps the optimizer from discarding kernel results
+static volatile float s_benchmarkSink = 0.f;
+
+static double TimeBestOf(int numRepeats, const std::function<void()>& work)
+{
+	double bestSeconds = 1e30;
+	for (int repeat = 0; repeat < numRepeats; ++repeat)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		work();
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+		double seconds = std::chrono::duration<double>(end - start).count();
+		if (seconds < bestSeconds)
+		{
+			bestSeconds = seconds;
+		}
+	}
+	return bestSeconds;
+}
+
+static void FillVolumeSlices(NoiseKernelFunction function, int size, int zBegin, int zEnd, float* out)
+{
+	for (int z = zBegin; z < zEnd; ++z)
+	{
+		for (int y = 0; y < size; ++y)
+		{
+			for (int x = 0; x < size; ++x)
+			{
+				out[((size_t)z * size + y) * size + x] = function((float)x, (float)y, (float)z);
+			}
+		}
+	}
+}
+
+// PerlinNoise3D at the same scale as its kernel above, four texels of a row at a time
+static void FillVolumeSlicesPerlinSIMD(int size, int zBegin, int zEnd, float* out)
+{
+	float x[4];
+	float y[4];
+	float z[4];
+	for (int slice = zBegin; slice < zEnd; ++slice)
+	{
+		for (int row = 0; row < size; ++row)
+		{
+			float* rowOut = out + ((size_t)slice * size + row) * size;
+			for (int lane = 0; lane < 4; ++lane)
+			{
+				y[lane] = (float)row * 0.05f;
+				z[lane] = (float)slice * 0.05f;
+			}
+
+			int column = 0;
+			for (; column + 4 <= size; column += 4)
+			{
+				for (int lane = 0; lane < 4; ++lane)
+				{
+					x[lane] = (float)(column + lane) * 0.05f;
+				}
+				PerlinNoise3D4(x, y, z, rowOut + column);
+			}
+			for (; column < size; ++column)
+			{
+				rowOut[column] = PerlinNoise3D((float)column * 0.05f, (float)row * 0.05f, (float)slice * 0.05f);
+			}
+		}
+	}
+}
+
+NoiseBenchmark::NoiseBenchmark(const NoiseBenchmarkConfig& config)
+	: m_config(config)
+{
+}
+
+void NoiseBenchmark::Run()
+{
+	m_results.clear();
+
+	RunPointKernels();
+
+	for (int size : m_config.volumeSizes)
+	{
+		RunVolumeKernels(size);
+	}
+}
+
+void NoiseBenchmark::RunPointKernels()
+{
+	// Scattered points defeat any caching between neighbouring lattice cells, like isolated gameplay queries
+	int numPoints = m_config.numPointSamples;
+	std::vector<Vec3> positions;
+	positions.reserve(numPoints);
+
+	unsigned int state = 12345u;
+	for (int i = 0; i < numPoints; ++i)
+	{
+		state = state * 1664525u + 1013904223u;
+		float x = (float)(state & 0xFFFF) * 0.01f;
+		state = state * 1664525u + 1013904223u;
+		float y = (float)(state & 0xFFFF) * 0.01f;
+		state = state * 1664525u + 1013904223u;
+		float z = (float)(state & 0xFFFF) * 0.01f;
+		positions.push_back(Vec3(x, y, z));
+	}
+
+	for (const NoiseKernel& kernel : s_noiseKernels)
+	{
+		double seconds = TimeBestOf(m_config.numRepeats, [&]()
+		{
+			float sum = 0.f;
+			for (const Vec3& position : positions)
+			{
+				sum += kernel.function(position.x, position.y, position.z);
+			}
+			s_benchmarkSink = sum;
+		});
+		AddResult(kernel.name, "scalar", 1, 1, numPoints, seconds);
+	}
+
+	std::vector<float> values(numPoints);
+	double batchSeconds = TimeBestOf(m_config.numRepeats, [&]()
+	{
+		PerlinNoise3DBatch(positions.data(), values.data(), numPoints);
+		s_benchmarkSink = values[numPoints - 1];
+	});
+	AddResult("PerlinNoise3D", "batch", 1, 1, numPoints, batchSeconds);
+
+	double simdSeconds = TimeBestOf(m_config.numRepeats, [&]()
+	{
+		PerlinNoise3DBatchSIMD(positions.data(), values.data(), numPoints);
+		s_benchmarkSink = values[numPoints - 1];
+	});
+	AddResult("PerlinNoise3D", "simd", 1, 1, numPoints, simdSeconds);
+
+	std::vector<PerlinSample> samples(numPoints);
+	double batchDerivativeSeconds = TimeBestOf(m_config.numRepeats, [&]()
+	{
+		PerlinNoise3DWithDerivativeBatch(positions.data(), samples.data(), numPoints);
+		s_benchmarkSink = samples[numPoints - 1].value;
+	});
+	AddResult("PerlinNoise3DWithDerivative", "batch", 1, 1, numPoints, batchDerivativeSeconds);
+}
+
+void NoiseBenchmark::RunVolumeKernels(int size)
+{
+	long long numTexels = (long long)size * size * size;
+	std::vector<float> volume((size_t)numTexels);
+
+	// Whole-volume generator as the game would call it
+	double generateSeconds = TimeBestOf(m_config.numRepeats, [&]()
+	{
+		std::vector<float> noise = GeneratePerlin3D(size, size, size, 1.f, 0.05f, 1.f, 0.5f, 4, 0);
+		s_benchmarkSink = noise[0];
+	});
+	AddResult("GeneratePerlin3D", "scalar", size, 1, numTexels, generateSeconds);
+
+	// Per-kernel volume fills, scaled across thread counts 1, 2, 4, ... up to the hardware limit, and the whole
+	// machine once more at the end when that isn't a power of two
+	int maxThreads = GetNumWorkerThreads(m_config.maxThreads);
+	std::vector<int> threadCounts;
+	for (int numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+	{
+		threadCounts.push_back(numThreads);
+	}
+	if (threadCounts.back() != maxThreads)
+	{
+		threadCounts.push_back(maxThreads);
+	}
+
+	for (const NoiseKernel& kernel : s_noiseKernels)
+	{
+		for (int numThreads : threadCounts)
+		{
+			double seconds = TimeBestOf(m_config.numRepeats, [&]()
+			{
+				ParallelFor(size, [&](int zBegin, int zEnd)
+				{
+					FillVolumeSlices(kernel.function, size, zBegin, zEnd, volume.data());
+				}, numThreads);
+				s_benchmarkSink = volume[0];
+			});
+			AddResult(kernel.name, numThreads == 1 ? "scalar" : "threaded", size, numThreads, numTexels, seconds);
+		}
+	}
+
+	// After the scalar PerlinNoise3D runs, so the speedups are against those
+	for (int numThreads : threadCounts)
+	{
+		double seconds = TimeBestOf(m_config.numRepeats, [&]()
+		{
+			ParallelFor(size, [&](int zBegin, int zEnd)
+			{
+				FillVolumeSlicesPerlinSIMD(size, zBegin, zEnd, volume.data());
+			}, numThreads);
+			s_benchmarkSink = volume[0];
+		});
+		AddResult("PerlinNoise3D", numThreads == 1 ? "simd" : "simd threaded", size, numThreads, numTexels, seconds);
+	}
+}
+
+void NoiseBenchmark::AddResult(const std::string& kernel, const std::string& mode, int size, int numThreads, long long numSamples, double seconds)
+{
+	NoiseBenchmarkResult result;
+	result.kernel = kernel;
+	result.mode = mode;
+	result.size = size;
+	result.numThreads = numThreads;
+	result.numSamples = numSamples;
+	result.seconds = seconds;
+	result.nsPerSample = seconds * 1e9 / (double)numSamples;
+	result.samplesPerSecond = (double)numSamples / seconds;
+
+	for (const NoiseBenchmarkResult& previous : m_results)
+	{
+		if (previous.kernel == kernel && previous.size == size && previous.numThreads == 1 && previous.mode == "scalar")
+		{
+			result.speedup = previous.seconds / seconds;
+			break;
+		}
+	}
+
+	m_results.push_back(result);
+}
+
+std::string NoiseBenchmark::ToJson() const
+{
+	std::string json = "{\n  \"results\": [\n";
+
+	char line[512];
+	for (size_t i = 0; i < m_results.size(); ++i)
+	{
+		const NoiseBenchmarkResult& result = m_results[i];
+		snprintf(line, sizeof(line),
+			"    { \"kernel\": \"%s\", \"mode\": \"%s\", \"size\": %d, \"threads\": %d, \"samples\": %lld, \"seconds\": %.6f, \"nsPerSample\": %.3f, \"samplesPerSecond\": %.1f, \"speedup\": %.3f }%s\n",
+			result.kernel.c_str(), result.mode.c_str(), result.size, result.numThreads, result.numSamples,
+			result.seconds, result.nsPerSample, result.samplesPerSecond, result.speedup,
+			(i + 1 < m_results.size()) ? "," : "");
+		json += line;
+	}
+
+	json += "  ]\n}\n";
+	return json;
+}
+
+bool NoiseBenchmark::WriteJson(const std::string& filePath) const
+{
+	std::ofstream file(filePath, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	std::string json = ToJson();
+	file.write(json.data(), (std::streamsize)json.size());
+	return file.good();
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <vector>
+
+struct NoiseBenchmarkResult
+{
+	std::string kernel;
+	std::string mode;				// "scalar", "batch", "simd", "threaded" or "simd threaded"
+	int size = 1;					// Volume edge length, 1 for scattered point samples
+	int numThreads = 1;
+	long long numSamples = 0;
+	double seconds = 0.0;			// Best of NoiseBenchmarkConfig::numRepeats
+	double nsPerSample = 0.0;
+	double samplesPerSecond = 0.0;
+	double speedup = 1.0;			// Relative to the single-threaded scalar run of the same kernel and size
+};
+
+struct NoiseBenchmarkConfig
+{
+	std::vector<int> volumeSizes = { 32, 128 };
+	int numPointSamples = 1 << 18;
+	int numRepeats = 3;
+	int maxThreads = 0;				// 0 = all hardware threads
+};
+
+// Times the noise kernels the cloud generation relies on (PerlinNoise3D and its SSE2 version, GeneratePerlin3D and the
+// Squirrel Perlin/Worley calls used by CreateTest/GenerateDensityField) so changes can be compared run to run
+class NoiseBenchmark
+{
+public:
+	explicit NoiseBenchmark(const NoiseBenchmarkConfig& config);
+
+	void Run();
+
+	const std::vector<NoiseBenchmarkResult>& GetResults() const { return m_results; }
+	std::string ToJson() const;
+	bool WriteJson(const std::string& filePath) const;
+
+private:
+	void RunPointKernels();
+	void RunVolumeKernels(int size);
+
+	void AddResult(const std::string& kernel, const std::string& mode, int size, int numThreads, long long numSamples, double seconds);
+
+private:
+	NoiseBenchmarkConfig m_config;
+	std::vector<NoiseBenchmarkResult> m_results;
+};
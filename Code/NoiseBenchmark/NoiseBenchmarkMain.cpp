@@ -0,0 +1,68 @@
+#include "NoiseBenchmark/NoiseBenchmark.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+//-----------------------------------------------------------------------------------------------
+// Value of a key=value argument, or nullptr when it wasn't given
+static const char* FindArgument(int argc, char* argv[], const char* key)
+{
+	size_t keyLength = strlen(key);
+	for (int argIndex = 1; argIndex < argc; ++argIndex)
+	{
+		if (strncmp(argv[argIndex], key, keyLength) == 0 && argv[argIndex][keyLength] == '=')
+		{
+			return argv[argIndex] + keyLength + 1;
+		}
+	}
+	return nullptr;
+}
+
+static int GetIntArgument(int argc, char* argv[], const char* key, int defaultValue)
+{
+	const char* value = FindArgument(argc, argv, key);
+	return (value != nullptr) ? atoi(value) : defaultValue;
+}
+
+// e.g. NoiseBenchmark_Release_x64.exe maxSize=256 threads=8 repeats=3 file=NoiseBenchmark.json
+// Volumes are 32^3, 128^3 and, with maxSize=256, 256^3. Returns 0 when the JSON was written.
+int main(int argc, char* argv[])
+{
+	int maxSize = GetIntArgument(argc, argv, "maxSize", 128);
+	const char* filePath = FindArgument(argc, argv, "file");
+	if (filePath == nullptr)
+	{
+		filePath = "NoiseBenchmark.json";
+	}
+
+	NoiseBenchmarkConfig config;
+	config.maxThreads = GetIntArgument(argc, argv, "threads", 0);
+	config.numRepeats = GetIntArgument(argc, argv, "repeats", 3);
+	config.volumeSizes.clear();
+	for (int size = 32; size <= maxSize; size *= 4)
+	{
+		config.volumeSizes.push_back(size);
+	}
+	if (maxSize >= 256)
+	{
+		config.volumeSizes.push_back(256);
+	}
+
+	NoiseBenchmark benchmark(config);
+	benchmark.Run();
+
+	printf("%-28s %-13s %-9s %12s %15s %8s\n", "kernel", "mode", "size/thr", "ns/sample", "samples/s", "speedup");
+	for (const NoiseBenchmarkResult& result : benchmark.GetResults())
+	{
+		printf("%-28s %-13s %3d^3 x%-2d %12.2f %15.0f %7.2fx\n", result.kernel.c_str(), result.mode.c_str(), result.size, result.numThreads,
+			result.nsPerSample, result.samplesPerSecond, result.speedup);
+	}
+
+	if (!benchmark.WriteJson(filePath))
+	{
+		printf("Failed to write %s\n", filePath);
+		return 1;
+	}
+	printf("Wrote %s\n", filePath);
+	return 0;
+}
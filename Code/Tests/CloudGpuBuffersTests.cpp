@@ -0,0 +1,121 @@
+#include "Tests/CloudTest.hpp"
+#include "Game/CloudGpuBuffers.hpp"
+#include <cstring>
+#include <random>
+
+//-----------------------------------------------------------------------------------------------
+// 48 bytes of floats; the buffer only sees bytes
+struct TestBufferElement
+{
+	float values[12] = {};
+};
+
+static bool IsElementChanged(const std::vector<TestBufferElement>& previous, const std::vector<TestBufferElement>& current, size_t element)
+{
+	return element >= previous.size() || memcmp(&previous[element], &current[element], sizeof(TestBufferElement)) != 0;
+}
+
+// 5000 elements through 200 random edits (single changes, scattered changes, appends, truncations) on the recording
+// backend: after every update the simulated GPU contents match the source, the buffer is only recreated when the
+// size passes its capacity, and every uploaded range starts and ends on an element that changed. A second buffer
+// given FindChangedRanges' ranges, as the scene job finds them, must end up holding the same.
+CLOUD_TEST(PersistentCloudBufferUploadsOnlyDirtyRanges)
+{
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+	std::vector<TestBufferElement> elements(5000);
+	for (TestBufferElement& element : elements)
+	{
+		for (float& value : element.values)
+		{
+			value = unit(rng);
+		}
+	}
+
+	RecordingCloudBufferBackend backend;
+	PersistentCloudBuffer buffer(backend, sizeof(TestBufferElement));
+	buffer.Update(elements.data(), elements.size());
+	PersistentCloudBuffer rangedBuffer(backend, sizeof(TestBufferElement));
+	rangedBuffer.Update(elements.data(), elements.size());
+	std::vector<CloudBufferRange> changedRanges;
+	long long fullUploadBytes = buffer.GetLastUpdateStats().numBytesUploaded;
+	CLOUD_TEST_CHECK(fullUploadBytes == (long long)(elements.size() * sizeof(TestBufferElement)), "first update sent %lld bytes", fullUploadBytes);
+
+	long long numEditBytes = 0;
+	for (int edit = 0; edit < 200; ++edit)
+	{
+		std::vector<TestBufferElement> previous = elements;
+		switch (rng() % 4)
+		{
+		case 0:
+			elements[rng() % elements.size()].values[3] += 1.f;
+			break;
+		case 1:
+			for (int appended = 0; appended < 20; ++appended)
+			{
+				elements.push_back(elements[appended]);
+			}
+			break;
+		case 2:
+			elements.resize(elements.size() - 10);
+			break;
+		default:
+		{
+			size_t first = rng() % (elements.size() - 50);
+			for (size_t offset = 0; offset < 50; offset += 3)
+			{
+				elements[first + offset].values[0] = unit(rng);
+			}
+			break;
+		}
+		}
+
+		size_t capacityBefore = buffer.GetCapacity();
+		backend.ClearEvents();
+		buffer.Update(elements.data(), elements.size());
+		numEditBytes += buffer.GetLastUpdateStats().numBytesUploaded;
+
+		PersistentCloudBuffer::FindChangedRanges(previous.data(), previous.size(), elements.data(), elements.size(), sizeof(TestBufferElement),
+			PersistentCloudBuffer::DEFAULT_MERGE_GAP, changedRanges);
+		rangedBuffer.Update(elements.data(), elements.size(), changedRanges);
+
+		const std::vector<unsigned char>& contents = backend.GetContents(buffer.GetHandle());
+		CLOUD_TEST_CHECK(memcmp(contents.data(), elements.data(), elements.size() * sizeof(TestBufferElement)) == 0, "edit %d: GPU contents differ", edit);
+		const std::vector<unsigned char>& rangedContents = backend.GetContents(rangedBuffer.GetHandle());
+		CLOUD_TEST_CHECK(memcmp(rangedContents.data(), elements.data(), elements.size() * sizeof(TestBufferElement)) == 0,
+			"edit %d: GPU contents differ with known ranges", edit);
+		CLOUD_TEST_CHECK(rangedBuffer.GetLastUpdateStats().numBytesUploaded == buffer.GetLastUpdateStats().numBytesUploaded,
+			"edit %d: %lld bytes with known ranges, %lld compared", edit, rangedBuffer.GetLastUpdateStats().numBytesUploaded,
+			buffer.GetLastUpdateStats().numBytesUploaded);
+		CLOUD_TEST_CHECK(backend.GetNumLiveBuffers() == 2, "edit %d: %d live buffers", edit, backend.GetNumLiveBuffers());
+
+		int expectedCreates = (elements.size() > capacityBefore) ? 1 : 0;
+		CLOUD_TEST_CHECK(buffer.GetLastUpdateStats().numCreates == expectedCreates, "edit %d: %d creates for %zu elements in a capacity of %zu", edit,
+			buffer.GetLastUpdateStats().numCreates, elements.size(), capacityBefore);
+		if (expectedCreates > 0)
+		{
+			continue;
+		}
+
+		for (const RecordingCloudBufferBackend::Event& event : backend.GetEvents())
+		{
+			if (event.type != RecordingCloudBufferBackend::EventType::UPLOAD)
+			{
+				continue;
+			}
+			size_t last = event.firstElement + event.numElements - 1;
+			CLOUD_TEST_CHECK(event.numElements > 0 && last < elements.size(), "edit %d: range [%zu, +%zu) past %zu elements", edit, event.firstElement,
+				event.numElements, elements.size());
+			CLOUD_TEST_CHECK(IsElementChanged(previous, elements, event.firstElement) && IsElementChanged(previous, elements, last),
+				"edit %d: range [%zu, +%zu) starts or ends on an unchanged element", edit, event.firstElement, event.numElements);
+		}
+	}
+
+	// Each edit touches at most a few dozen elements against 5000 for a re-upload, so all 200 send less than 10 re-uploads
+	const CloudBufferUploadStats& stats = buffer.GetStats();
+	CLOUD_TEST_CHECK(numEditBytes < fullUploadBytes * 10, "200 edits sent %lld bytes, a full upload is %lld", numEditBytes, fullUploadBytes);
+	printf("  200 edits sent %lld bytes in %d ranges, %lld with full re-uploads; %d creates\n", numEditBytes, stats.numRanges, fullUploadBytes * 200,
+		stats.numCreates);
+	return true;
+}
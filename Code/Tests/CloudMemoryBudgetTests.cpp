@@ -0,0 +1,186 @@
+#include "Tests/CloudTest.hpp"
+#include "Game/CloudMemoryBudget.hpp"
+#include <cmath>
+
+//-----------------------------------------------------------------------------------------------
+// The bytes a scene at these levels holds, counted independently of FitCloudMemoryBudget: each prototype once per
+// level any instance uses it at, and every instance that isn't evicted
+static size_t GetSceneBytes(const std::vector<CloudInstance>& instances, const CloudMemoryCosts& costs, const std::vector<CloudDetailLevel>& levels)
+{
+	std::vector<bool> usesFull(costs.prototypeBytes.size(), false);
+	std::vector<bool> usesCoarse(costs.prototypeBytes.size(), false);
+	size_t numBytes = costs.fixedBytes;
+	for (int instanceIndex = 0; instanceIndex < (int)instances.size(); ++instanceIndex)
+	{
+		if (levels[instanceIndex] == CloudDetailLevel::EVICTED)
+		{
+			continue;
+		}
+		int prototypeIndex = instances[instanceIndex].prototypeIndex;
+		(levels[instanceIndex] == CloudDetailLevel::FULL ? usesFull : usesCoarse)[prototypeIndex] = true;
+		numBytes += costs.instanceBytes[instanceIndex];
+	}
+	for (int prototypeIndex = 0; prototypeIndex < (int)costs.prototypeBytes.size(); ++prototypeIndex)
+	{
+		numBytes += usesFull[prototypeIndex] ? costs.prototypeBytes[prototypeIndex] : 0;
+		numBytes += usesCoarse[prototypeIndex] ? costs.coarsePrototypeBytes[prototypeIndex] : 0;
+	}
+	return numBytes;
+}
+
+// Eight instances of three prototypes along a line, fitted to every budget from nothing to more than they need: the
+// bytes reported match a recount from the chosen levels, no instance is at a higher level than one farther away,
+// and nothing is evicted while any instance is still at full resolution
+CLOUD_TEST(MemoryBudgetDemotesFarthestFirst)
+{
+	CloudMemoryCosts costs;
+	costs.prototypeBytes = { 4000, 2500, 900 };
+	costs.coarsePrototypeBytes = { 500, 320, 120 };
+	costs.fixedBytes = 700;
+
+	std::vector<CloudInstance> instances;
+	const int prototypeOrder[] = { 0, 1, 0, 2, 1, 0, 2, 0 };
+	for (int instanceIndex = 0; instanceIndex < 8; ++instanceIndex)
+	{
+		CloudInstance instance;
+		instance.prototypeIndex = prototypeOrder[instanceIndex];
+		instances.push_back(instance);
+		costs.instanceBytes.push_back(200 + 37 * (size_t)instanceIndex);
+
+		// Out of order along the line, so farthest-first isn't the instance order
+		costs.instanceCenters.push_back(Vec3((float)((instanceIndex * 5) % 8) * 100.f, 0.f, 0.f));
+	}
+
+	std::vector<CloudDetailLevel> allFull(instances.size(), CloudDetailLevel::FULL);
+	size_t numBytesFull = GetSceneBytes(instances, costs, allFull);
+	int numBudgetsEvicting = 0;
+	for (size_t budgetBytes = 0; budgetBytes <= numBytesFull + 100; budgetBytes += 50)
+	{
+		CloudMemoryBudgetResult result = FitCloudMemoryBudget(instances, costs, Vec3(-50.f, 0.f, 0.f), budgetBytes);
+		CLOUD_TEST_CHECK(result.levels.size() == instances.size(), "budget %zu: %zu levels", budgetBytes, result.levels.size());
+		CLOUD_TEST_CHECK(result.numBytesFull == numBytesFull, "budget %zu: %zu bytes at full, recounted %zu", budgetBytes, result.numBytesFull, numBytesFull);
+
+		size_t numBytes = GetSceneBytes(instances, costs, result.levels);
+		CLOUD_TEST_CHECK(result.numBytes == numBytes, "budget %zu: %zu bytes, recounted %zu", budgetBytes, result.numBytes, numBytes);
+		CLOUD_TEST_CHECK(result.fitsBudget == (budgetBytes == 0 || numBytes <= budgetBytes), "budget %zu: %zu bytes reported as %s", budgetBytes,
+			numBytes, result.fitsBudget ? "fitting" : "not fitting");
+		if (budgetBytes == 0 || budgetBytes >= numBytesFull)
+		{
+			CLOUD_TEST_CHECK(result.levels == allFull, "budget %zu: lowered detail the scene didn't need to", budgetBytes);
+		}
+
+		int numCoarse = 0;
+		int numEvicted = 0;
+		for (int instanceIndex = 0; instanceIndex < (int)instances.size(); ++instanceIndex)
+		{
+			numCoarse += (result.levels[instanceIndex] == CloudDetailLevel::COARSE) ? 1 : 0;
+			numEvicted += (result.levels[instanceIndex] == CloudDetailLevel::EVICTED) ? 1 : 0;
+			for (int otherIndex = 0; otherIndex < (int)instances.size(); ++otherIndex)
+			{
+				bool isFarther = costs.instanceCenters[otherIndex].x > costs.instanceCenters[instanceIndex].x;
+				CLOUD_TEST_CHECK(!isFarther || (int)result.levels[otherIndex] >= (int)result.levels[instanceIndex],
+					"budget %zu: instance %d is at level %d, farther instance %d at %d", budgetBytes, instanceIndex, (int)result.levels[instanceIndex],
+					otherIndex, (int)result.levels[otherIndex]);
+			}
+		}
+		CLOUD_TEST_CHECK(result.numCoarse == numCoarse && result.numEvicted == numEvicted, "budget %zu: %d coarse and %d evicted reported, %d and %d set",
+			budgetBytes, result.numCoarse, result.numEvicted, numCoarse, numEvicted);
+		CLOUD_TEST_CHECK(numEvicted == 0 || numCoarse + numEvicted == (int)instances.size(), "budget %zu: %d evicted with %d still at full",
+			budgetBytes, numEvicted, (int)instances.size() - numCoarse - numEvicted);
+		numBudgetsEvicting += (numEvicted > 0) ? 1 : 0;
+	}
+	CLOUD_TEST_CHECK(numBudgetsEvicting > 0, "no budget was small enough to evict anything");
+	return true;
+}
+
+// Scenes built from a real library at the fitted levels: coarse instances use the shared coarse prototype at twice
+// the scale, evicted ones and prototypes nothing uses are dropped, and the built scene's prototypes and instances
+// add up to the bytes the fit reported
+CLOUD_TEST(BudgetedSceneMatchesFittedLevels)
+{
+	CloudPrototypeLibrary prototypes;
+	int smallPrototype = prototypes.FindOrAdd(IntVec3(6, 6, 4), Vec3(1.f), ECloudType::CLOUD_TEST, false);
+	int largePrototype = prototypes.FindOrAdd(IntVec3(10, 8, 6), Vec3(1.f), ECloudType::CLOUD_TEST, false);
+
+	std::vector<CloudInstance> instances;
+	for (int instanceIndex = 0; instanceIndex < 6; ++instanceIndex)
+	{
+		CloudInstance instance;
+		instance.prototypeIndex = (instanceIndex % 3 == 0) ? smallPrototype : largePrototype;
+		instance.position = Vec3((float)instanceIndex * 40.f, 0.f, 0.f);
+		instance.scale = 1.f + 0.25f * (float)instanceIndex;
+		instances.push_back(instance);
+	}
+
+	CloudMemoryCosts costs = EstimateCloudMemoryCosts(prototypes, instances, CloudSunTransmittanceConfig(), 0);
+	size_t numBytesFull = GetSceneBytes(instances, costs, std::vector<CloudDetailLevel>(instances.size(), CloudDetailLevel::FULL));
+	size_t numBytesCoarse = GetSceneBytes(instances, costs, std::vector<CloudDetailLevel>(instances.size(), CloudDetailLevel::COARSE));
+
+	// The instances' own bytes dwarf the prototypes', so the budgets step evenly down to all coarse, then on to nothing
+	std::vector<size_t> budgets;
+	for (int step = 16; step > 0; --step)
+	{
+		budgets.push_back(numBytesCoarse + (numBytesFull - numBytesCoarse) * step / 16);
+		budgets.push_back(numBytesCoarse * step / 16);
+	}
+
+	bool hasMixedLevels = false;
+	bool hasEvicted = false;
+	for (size_t budgetBytes : budgets)
+	{
+		CloudMemoryBudgetResult result = FitCloudMemoryBudget(instances, costs, Vec3(0.f, 0.f, 0.f), budgetBytes);
+		std::vector<std::shared_ptr<const Cloud>> scenePrototypes;
+		std::vector<CloudInstance> sceneInstances;
+		MakeBudgetedScene(prototypes, instances, result.levels, scenePrototypes, sceneInstances);
+		CLOUD_TEST_CHECK((int)sceneInstances.size() == (int)instances.size() - result.numEvicted, "budget %zu: %zu instances built, %d evicted",
+			budgetBytes, sceneInstances.size(), result.numEvicted);
+
+		size_t numBytes = costs.fixedBytes;
+		for (const std::shared_ptr<const Cloud>& prototype : scenePrototypes)
+		{
+			bool isLibraryPrototype = false;
+			for (int prototypeIndex = 0; prototypeIndex < prototypes.GetNumPrototypes(); ++prototypeIndex)
+			{
+				if (prototype == prototypes.GetSharedPrototype(prototypeIndex))
+				{
+					numBytes += costs.prototypeBytes[prototypeIndex];
+					isLibraryPrototype = true;
+				}
+				else if (prototypes.HasCoarsePrototype(prototypeIndex) && prototype == prototypes.GetSharedCoarsePrototype(prototypeIndex))
+				{
+					numBytes += costs.coarsePrototypeBytes[prototypeIndex];
+					isLibraryPrototype = true;
+				}
+			}
+			CLOUD_TEST_CHECK(isLibraryPrototype, "budget %zu: a built prototype isn't one of the library's", budgetBytes);
+		}
+
+		int sceneIndex = 0;
+		for (int instanceIndex = 0; instanceIndex < (int)instances.size(); ++instanceIndex)
+		{
+			CloudDetailLevel level = result.levels[instanceIndex];
+			if (level == CloudDetailLevel::EVICTED)
+			{
+				continue;
+			}
+
+			const CloudInstance& instance = instances[instanceIndex];
+			const CloudInstance& built = sceneInstances[sceneIndex++];
+			const std::shared_ptr<const Cloud>& expected = (level == CloudDetailLevel::COARSE) ?
+				prototypes.GetSharedCoarsePrototype(instance.prototypeIndex) : prototypes.GetSharedPrototype(instance.prototypeIndex);
+			float expectedScale = instance.scale * ((level == CloudDetailLevel::COARSE) ? 2.f : 1.f);
+			CLOUD_TEST_CHECK(scenePrototypes[built.prototypeIndex] == expected, "budget %zu: instance %d built with the wrong prototype",
+				budgetBytes, instanceIndex);
+			CLOUD_TEST_CHECK(built.scale == expectedScale && built.position.x == instance.position.x, "budget %zu: instance %d built at scale %g, x %g",
+				budgetBytes, instanceIndex, built.scale, built.position.x);
+			numBytes += costs.instanceBytes[instanceIndex];
+		}
+		CLOUD_TEST_CHECK(numBytes == result.numBytes, "budget %zu: the built scene holds %zu bytes, the fit reported %zu", budgetBytes, numBytes,
+			result.numBytes);
+		hasMixedLevels |= result.numCoarse > 0 && result.numCoarse + result.numEvicted < (int)instances.size();
+		hasEvicted |= result.numEvicted > 0;
+	}
+	CLOUD_TEST_CHECK(hasMixedLevels && hasEvicted, "no budget mixed full and coarse instances (%d) or evicted any (%d)", (int)hasMixedLevels,
+		(int)hasEvicted);
+	return true;
+}
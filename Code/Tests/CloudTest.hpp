@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdio>
+#include <vector>
+
+// Tests for the CloudTests executable. Each one registers itself at startup and returns false on failure, after
+// CLOUD_TEST_CHECK has printed where and why.
+typedef bool (*CloudTestFunction)();
+
+struct CloudTestCase
+{
+	const char* name = nullptr;
+	CloudTestFunction function = nullptr;
+};
+
+std::vector<CloudTestCase>& GetCloudTests();
+
+struct CloudTestRegistrar
+{
+	CloudTestRegistrar(const char* name, CloudTestFunction function) { GetCloudTests().push_back({ name, function }); }
+};
+
+#define CLOUD_TEST(testName)																\
+	static bool testName();																	\
+	static CloudTestRegistrar s_##testName##Registrar(#testName, testName);					\
+	static bool testName()
+
+// printf-style message for the failure
+#define CLOUD_TEST_CHECK(condition, ...)													\
+	if (!(condition))																		\
+	{																						\
+		printf("  %s(%d): ", __FILE__, __LINE__);											\
+		printf(__VA_ARGS__);																\
+		printf("\n");																		\
+		return false;																		\
+	}
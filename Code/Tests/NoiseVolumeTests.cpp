@@ -0,0 +1,90 @@
+#include "Tests/CloudTest.hpp"
+#include "Game/CloudNoiseVolumes.hpp"
+#include <cmath>
+#include <random>
+
+//-----------------------------------------------------------------------------------------------
+// CPU copies of GetNoiseTexel / SampleNoiseVolumeLevel / SampleNoiseVolume in CloudShader.hlsl, reading the
+// flattened buffers the same way the shader does
+static float GetFlattenedTexel(const std::vector<float>& texels, const NoiseVolumeLevelGPU& level, int x, int y, int z)
+{
+	x = ((x % level.sizeX) + level.sizeX) % level.sizeX;
+	y = ((y % level.sizeY) + level.sizeY) % level.sizeY;
+	z = ((z % level.sizeZ) + level.sizeZ) % level.sizeZ;
+	return texels[level.firstTexel + (z * level.sizeY + y) * level.sizeX + x];
+}
+
+static float SampleFlattenedLevel(const std::vector<float>& texels, const NoiseVolumeLevelGPU& level, const Vec3& uvw)
+{
+	float localX = uvw.x * (float)level.sizeX - 0.5f;
+	float localY = uvw.y * (float)level.sizeY - 0.5f;
+	float localZ = uvw.z * (float)level.sizeZ - 0.5f;
+	int x0 = (int)floorf(localX);
+	int y0 = (int)floorf(localY);
+	int z0 = (int)floorf(localZ);
+	float blendX = localX - (float)x0;
+	float blendY = localY - (float)y0;
+	float blendZ = localZ - (float)z0;
+
+	auto lerp = [](float a, float b, float t) { return a + (b - a) * t; };
+	float c00 = lerp(GetFlattenedTexel(texels, level, x0, y0, z0), GetFlattenedTexel(texels, level, x0 + 1, y0, z0), blendX);
+	float c10 = lerp(GetFlattenedTexel(texels, level, x0, y0 + 1, z0), GetFlattenedTexel(texels, level, x0 + 1, y0 + 1, z0), blendX);
+	float c01 = lerp(GetFlattenedTexel(texels, level, x0, y0, z0 + 1), GetFlattenedTexel(texels, level, x0 + 1, y0, z0 + 1), blendX);
+	float c11 = lerp(GetFlattenedTexel(texels, level, x0, y0 + 1, z0 + 1), GetFlattenedTexel(texels, level, x0 + 1, y0 + 1, z0 + 1), blendX);
+	return lerp(lerp(c00, c10, blendY), lerp(c01, c11, blendY), blendZ);
+}
+
+static float SampleFlattenedVolume(const std::vector<float>& texels, const std::vector<NoiseVolumeLevelGPU>& levels, const Vec3& uvw, float lod)
+{
+	float maxLod = (float)(levels.size() - 1);
+	lod = fminf(fmaxf(lod, 0.f), maxLod);
+
+	int level0 = (int)lod;
+	float blend = lod - (float)level0;
+	float sample0 = SampleFlattenedLevel(texels, levels[level0], uvw);
+	if (blend <= 0.f || level0 + 1 >= (int)levels.size())
+	{
+		return sample0;
+	}
+	return sample0 + (SampleFlattenedLevel(texels, levels[level0 + 1], uvw) - sample0) * blend;
+}
+
+// A random 16x8x4 chain flattened for the GPU and read like the shaders read it agrees with
+// VolumeMipChain::SampleLevel at 2000 random points and lods, out-of-range coordinates and lods included
+CLOUD_TEST(FlattenedNoiseVolumeMatchesSampleLevel)
+{
+	std::mt19937 rng(11);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+	IntVec3 dimensions = IntVec3(16, 8, 4);
+	std::vector<float> baseLevel((size_t)dimensions.x * dimensions.y * dimensions.z);
+	for (float& value : baseLevel)
+	{
+		value = unit(rng);
+	}
+
+	VolumeMipConfig mipConfig;
+	mipConfig.numThreads = 1;
+	VolumeMipChain chain;
+	chain.Build(baseLevel, dimensions, mipConfig);
+
+	std::vector<float> texels;
+	std::vector<NoiseVolumeLevelGPU> levels;
+	FlattenVolumeMipChain(chain, texels, levels);
+	CLOUD_TEST_CHECK((int)levels.size() == chain.GetNumLevels(), "%zu levels flattened from %d", levels.size(), chain.GetNumLevels());
+	CLOUD_TEST_CHECK(texels.size() * sizeof(float) == chain.GetMemoryBytes(), "%zu texels for %zu bytes", texels.size(), chain.GetMemoryBytes());
+
+	std::uniform_real_distribution<float> coordinate(-2.f, 3.f);
+	std::uniform_real_distribution<float> lodRange(-1.f, (float)levels.size() + 1.f);
+	for (int sampleIndex = 0; sampleIndex < 2000; ++sampleIndex)
+	{
+		Vec3 uvw = Vec3(coordinate(rng), coordinate(rng), coordinate(rng));
+		float lod = (sampleIndex % 4 == 0) ? (float)(sampleIndex / 4 % levels.size()) : lodRange(rng);
+
+		float expected = chain.SampleLevel(uvw, lod);
+		float flattened = SampleFlattenedVolume(texels, levels, uvw, lod);
+		CLOUD_TEST_CHECK(fabsf(flattened - expected) <= 1e-5f, "(%g, %g, %g) at lod %g: flattened %g, SampleLevel %g", uvw.x, uvw.y, uvw.z, lod,
+			flattened, expected);
+	}
+	return true;
+}
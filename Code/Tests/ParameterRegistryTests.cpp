@@ -0,0 +1,89 @@
+#include "Tests/CloudTest.hpp"
+#include "Game/ParameterRegistry.hpp"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+//-----------------------------------------------------------------------------------------------
+// One parameter of each type, bound to this struct's members like CloudManager binds its own
+struct TestParameters
+{
+	float extinction = 0.f;
+	float third = 0.f;
+	int mode = 0;
+	bool useShadows = false;
+	ParameterRegistry registry;
+
+	TestParameters()
+	{
+		registry.AddFloat("extinction", "Extinction", &extinction, 1.f, 0.f, 10.f);
+		registry.AddFloat("third", "Third", &third, 0.5f, 0.f, 1.f);
+		registry.AddInt("mode", "Mode", &mode, 0, "Off\0Low\0High\0");
+		registry.AddBool("useShadows", "Shadows", &useShadows, true);
+	}
+};
+
+static bool IsSameFloat(float a, float b)
+{
+	return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+// A file with a config attribute and two presets is loaded, the current values are saved over one preset and as a
+// new one, and a second registry loading the file gets back every value bit for bit; the preset nobody saved, the
+// default name and the rest of the file are left as they were
+CLOUD_TEST(ParameterPresetsRoundTripThroughFile)
+{
+	std::filesystem::path filePath = std::filesystem::temp_directory_path() / "CloudTestsPresets.xml";
+	{
+		std::ofstream file(filePath, std::ios::binary);
+		file << "<GameConfig windowAspect=\"2.0\">\n"
+			"\t<CloudPresets default=\"Soft\">\n"
+			"\t\t<Preset name=\"Soft\" extinction=\"0.25\" mode=\"1\" />\n"
+			"\t\t<Preset name=\"Dense\" extinction=\"4\" useShadows=\"false\" />\n"
+			"\t</CloudPresets>\n"
+			"</GameConfig>\n";
+	}
+
+	TestParameters saved;
+	CLOUD_TEST_CHECK(saved.registry.LoadPresets(filePath.string()), "could not load %s", filePath.string().c_str());
+	CLOUD_TEST_CHECK(saved.registry.GetPresets().size() == 2, "%zu presets loaded", saved.registry.GetPresets().size());
+	CLOUD_TEST_CHECK(saved.registry.ApplyPreset("Soft") && IsSameFloat(saved.extinction, 0.25f) && saved.mode == 1 && saved.useShadows,
+		"Soft applied as extinction %g, mode %d, shadows %d", saved.extinction, saved.mode, (int)saved.useShadows);
+
+	// A value that only survives with every digit written, and a mode past the combo that clamps to its last entry
+	saved.registry.SetValueFromString("third", "0.333333343");
+	saved.registry.SetValueFromString("mode", "7");
+	saved.registry.SetValueFromString("useShadows", "false");
+	CLOUD_TEST_CHECK(IsSameFloat(saved.third, 1.f / 3.f) && saved.mode == 2, "third set to %.9g, mode clamped to %d", saved.third, saved.mode);
+	CLOUD_TEST_CHECK(saved.registry.SavePreset(filePath.string(), "Soft"), "could not save over Soft");
+	saved.registry.SetValueFromString("extinction", "7.125");
+	CLOUD_TEST_CHECK(saved.registry.SavePreset(filePath.string(), "Tuned"), "could not save Tuned");
+
+	TestParameters loaded;
+	CLOUD_TEST_CHECK(loaded.registry.LoadPresets(filePath.string()), "could not reload %s", filePath.string().c_str());
+	CLOUD_TEST_CHECK(loaded.registry.GetPresets().size() == 3, "%zu presets after saving one over another and one new",
+		loaded.registry.GetPresets().size());
+	CLOUD_TEST_CHECK(loaded.registry.GetDefaultPresetName() == "Soft", "default preset is now %s", loaded.registry.GetDefaultPresetName().c_str());
+
+	CLOUD_TEST_CHECK(loaded.registry.ApplyPreset("Soft"), "Soft missing after the save");
+	CLOUD_TEST_CHECK(IsSameFloat(loaded.extinction, 0.25f) && IsSameFloat(loaded.third, 1.f / 3.f) && loaded.mode == 2 && !loaded.useShadows,
+		"Soft reloaded as extinction %.9g, third %.9g, mode %d, shadows %d", loaded.extinction, loaded.third, loaded.mode, (int)loaded.useShadows);
+
+	CLOUD_TEST_CHECK(loaded.registry.ApplyPreset("Tuned"), "Tuned missing after the save");
+	CLOUD_TEST_CHECK(IsSameFloat(loaded.extinction, 7.125f) && IsSameFloat(loaded.third, 1.f / 3.f) && loaded.mode == 2 && !loaded.useShadows,
+		"Tuned reloaded as extinction %.9g, third %.9g, mode %d, shadows %d", loaded.extinction, loaded.third, loaded.mode, (int)loaded.useShadows);
+
+	// Parameters Dense leaves out come back at their defaults, whatever was applied before
+	CLOUD_TEST_CHECK(loaded.registry.ApplyPreset("Dense"), "Dense missing after the save");
+	CLOUD_TEST_CHECK(IsSameFloat(loaded.extinction, 4.f) && IsSameFloat(loaded.third, 0.5f) && loaded.mode == 0 && !loaded.useShadows,
+		"Dense reloaded as extinction %.9g, third %.9g, mode %d, shadows %d", loaded.extinction, loaded.third, loaded.mode, (int)loaded.useShadows);
+
+	std::ifstream file(filePath, std::ios::binary);
+	std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	file.close();
+	CLOUD_TEST_CHECK(contents.find("windowAspect=\"2.0\"") != std::string::npos, "the root element's attribute was lost:\n%s", contents.c_str());
+
+	std::error_code error;
+	std::filesystem::remove(filePath, error);
+	return true;
+}
@@ -0,0 +1,92 @@
+#include "Tests/CloudTest.hpp"
+#include "Game/Perlin3D.hpp"
+#include <cmath>
+#include <random>
+
+//-----------------------------------------------------------------------------------------------
+// Central differences of the noise at a point, for checking the analytic derivative
+template <typename NoiseFunction>
+static Vec3 GetFiniteDifferenceDerivative(NoiseFunction noise, const Vec3& position, float step)
+{
+	float inverseStep = 0.5f / step;
+	return Vec3((noise(position.x + step, position.y, position.z) - noise(position.x - step, position.y, position.z)) * inverseStep,
+		(noise(position.x, position.y + step, position.z) - noise(position.x, position.y - step, position.z)) * inverseStep,
+		(noise(position.x, position.y, position.z + step) - noise(position.x, position.y, position.z - step)) * inverseStep);
+}
+
+static float GetLargestAxisError(const Vec3& a, const Vec3& b)
+{
+	return fmaxf(fabsf(a.x - b.x), fmaxf(fabsf(a.y - b.y), fabsf(a.z - b.z)));
+}
+
+// PerlinNoise3DWithDerivative against PerlinNoise3D and central differences at 10000 random points, for both the plain
+// and the tileable variant; the tileable one must also repeat every period cells
+CLOUD_TEST(PerlinDerivativeMatchesFiniteDifferences)
+{
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> coordinate(-20.f, 20.f);
+
+	const int period = 8;
+	const int seed = 5;
+	const float step = 1e-3f;
+	const float tolerance = 5e-3f;
+
+	auto plainNoise = [](float x, float y, float z) { return PerlinNoise3DWithDerivative(x, y, z).value; };
+	auto tiledNoise = [](float x, float y, float z) { return PerlinNoise3DWithDerivative(x, y, z, period, seed).value; };
+
+	float largestError = 0.f;
+	for (int pointIndex = 0; pointIndex < 10000; ++pointIndex)
+	{
+		Vec3 position = Vec3(coordinate(rng), coordinate(rng), coordinate(rng));
+
+		PerlinSample sample = PerlinNoise3DWithDerivative(position.x, position.y, position.z);
+		float value = PerlinNoise3D(position.x, position.y, position.z);
+		CLOUD_TEST_CHECK(fabsf(sample.value - value) <= 1e-5f, "point %d: value %g, PerlinNoise3D %g", pointIndex, sample.value, value);
+
+		Vec3 expected = GetFiniteDifferenceDerivative(plainNoise, position, step);
+		float error = GetLargestAxisError(sample.derivative, expected);
+		CLOUD_TEST_CHECK(error <= tolerance, "point %d: derivative (%g, %g, %g), finite differences (%g, %g, %g)", pointIndex, sample.derivative.x,
+			sample.derivative.y, sample.derivative.z, expected.x, expected.y, expected.z);
+		largestError = fmaxf(largestError, error);
+
+		PerlinSample tiled = PerlinNoise3DWithDerivative(position.x, position.y, position.z, period, seed);
+		expected = GetFiniteDifferenceDerivative(tiledNoise, position, step);
+		error = GetLargestAxisError(tiled.derivative, expected);
+		CLOUD_TEST_CHECK(error <= tolerance, "point %d: tiled derivative (%g, %g, %g), finite differences (%g, %g, %g)", pointIndex, tiled.derivative.x,
+			tiled.derivative.y, tiled.derivative.z, expected.x, expected.y, expected.z);
+		largestError = fmaxf(largestError, error);
+
+		// Shifted by one period, the cell fraction can round differently, so this allows a little float error
+		PerlinSample shifted = PerlinNoise3DWithDerivative(position.x + (float)period, position.y - (float)period, position.z, period, seed);
+		CLOUD_TEST_CHECK(fabsf(shifted.value - tiled.value) <= 1e-4f, "point %d: tiled value %g, one period over %g", pointIndex, tiled.value, shifted.value);
+	}
+
+	printf("  largest derivative error %g\n", largestError);
+	return true;
+}
+
+// PerlinNoise3D4 and PerlinNoise3DBatchSIMD against PerlinNoise3D at 10001 random points, negative coordinates and a
+// partial last group included
+CLOUD_TEST(PerlinSimdMatchesScalar)
+{
+	std::mt19937 rng(4);
+	std::uniform_real_distribution<float> coordinate(-300.f, 300.f);
+
+	std::vector<Vec3> positions(10001);
+	for (Vec3& position : positions)
+	{
+		position = Vec3(coordinate(rng), coordinate(rng), coordinate(rng));
+	}
+	positions[0] = Vec3(-1.f, 0.f, 2.f);	// Whole lattice coordinates, where the floor matters most
+
+	std::vector<float> values(positions.size());
+	PerlinNoise3DBatchSIMD(positions.data(), values.data(), (int)positions.size());
+	for (int pointIndex = 0; pointIndex < (int)positions.size(); ++pointIndex)
+	{
+		const Vec3& position = positions[pointIndex];
+		float expected = PerlinNoise3D(position.x, position.y, position.z);
+		CLOUD_TEST_CHECK(fabsf(values[pointIndex] - expected) <= 1e-5f, "point %d (%g, %g, %g): SIMD %g, scalar %g", pointIndex, position.x, position.y,
+			position.z, values[pointIndex], expected);
+	}
+	return true;
+}
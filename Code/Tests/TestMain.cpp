@@ -0,0 +1,39 @@
+#include "Tests/CloudTest.hpp"
+#include <chrono>
+#include <cstring>
+
+//-----------------------------------------------------------------------------------------------
+std::vector<CloudTestCase>& GetCloudTests()
+{
+	static std::vector<CloudTestCase> s_tests;
+	return s_tests;
+}
+
+// e.g. CloudTests_Release_x64.exe, or CloudTests_Release_x64.exe Perlin to run the tests whose names contain it.
+// Returns the number of failed tests, so 0 means everything passed.
+int main(int argc, char* argv[])
+{
+	const char* filter = (argc > 1) ? argv[1] : nullptr;
+
+	int numRun = 0;
+	int numFailed = 0;
+	for (const CloudTestCase& test : GetCloudTests())
+	{
+		if (filter != nullptr && strstr(test.name, filter) == nullptr)
+		{
+			continue;
+		}
+
+		printf("%s\n", test.name);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		bool isPassed = test.function();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		printf("  %s (%.2f s)\n", isPassed ? "passed" : "FAILED", seconds);
+
+		++numRun;
+		numFailed += isPassed ? 0 : 1;
+	}
+
+	printf("%d of %d tests passed\n", numRun - numFailed, numRun);
+	return numFailed;
+}
@@ -0,0 +1,120 @@
+#include "Tests/CloudTest.hpp"
+#include "Game/VoxelOccupancyGrid.hpp"
+#include <cmath>
+#include <random>
+
+//-----------------------------------------------------------------------------------------------
+// Nearest voxel box the ray enters within [0, tMax] by slab tests over every voxel, or a negative value on a miss
+static float FindFirstVoxelBruteForce(const std::vector<Voxel>& voxels, const Vec3& cellSize, const Vec3& origin, const Vec3& direction, float tMax)
+{
+	float rayOrigin[3] = { origin.x, origin.y, origin.z };
+	float rayDirection[3] = { direction.x, direction.y, direction.z };
+	float halfSize[3] = { cellSize.x * 0.5f, cellSize.y * 0.5f, cellSize.z * 0.5f };
+
+	float bestT = -1.f;
+	for (const Voxel& voxel : voxels)
+	{
+		float center[3] = { voxel.m_position.x, voxel.m_position.y, voxel.m_position.z };
+		float tEnter = 0.f;
+		float tExit = 1e30f;
+		bool isHit = true;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float minBound = center[axis] - halfSize[axis];
+			float maxBound = center[axis] + halfSize[axis];
+			if (rayDirection[axis] == 0.f)
+			{
+				isHit &= rayOrigin[axis] >= minBound && rayOrigin[axis] <= maxBound;
+				continue;
+			}
+			float t1 = (minBound - rayOrigin[axis]) / rayDirection[axis];
+			float t2 = (maxBound - rayOrigin[axis]) / rayDirection[axis];
+			tEnter = fmaxf(tEnter, fminf(t1, t2));
+			tExit = fminf(tExit, fmaxf(t1, t2));
+		}
+
+		if (isHit && tEnter <= tExit && tEnter <= tMax && tExit > 1e-4f && (bestT < 0.f || tEnter < bestT))
+		{
+			bestT = tEnter;
+		}
+	}
+	return bestT;
+}
+
+// FindFirstOccupied against brute force: 200 random grids (sizes, cell sizes, fills, offsets) with 500 rays each,
+// starting inside and outside the grid, including rays parallel to one or two axes
+CLOUD_TEST(VoxelOccupancyGridMatchesBruteForce)
+{
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+	int numRays = 0;
+	int numHits = 0;
+	for (int gridIndex = 0; gridIndex < 200; ++gridIndex)
+	{
+		IntVec3 dimensions = IntVec3(1 + (int)(rng() % 20), 1 + (int)(rng() % 20), 1 + (int)(rng() % 12));
+		Vec3 cellSize = Vec3(0.5f + unit(rng) * 2.f, 0.5f + unit(rng) * 2.f, 0.5f + unit(rng) * 2.f);
+		Vec3 minBounds = Vec3(unit(rng) * 10.f - 5.f, unit(rng) * 10.f - 5.f, unit(rng) * 10.f - 5.f);
+		float fill = unit(rng) * 0.3f;
+
+		std::vector<Voxel> voxels;
+		std::vector<int> voxelIndices;
+		for (int z = 0; z < dimensions.z; ++z)
+		{
+			for (int y = 0; y < dimensions.y; ++y)
+			{
+				for (int x = 0; x < dimensions.x; ++x)
+				{
+					if (unit(rng) < fill)
+					{
+						Voxel voxel;
+						voxel.m_position = Vec3(minBounds.x + ((float)x + 0.5f) * cellSize.x, minBounds.y + ((float)y + 0.5f) * cellSize.y,
+							minBounds.z + ((float)z + 0.5f) * cellSize.z);
+						voxelIndices.push_back((int)voxels.size());
+						voxels.push_back(voxel);
+					}
+				}
+			}
+		}
+
+		VoxelOccupancyGrid grid;
+		grid.Build(minBounds, cellSize, dimensions, voxels, voxelIndices);
+		CLOUD_TEST_CHECK(grid.GetNumOccupied() == (int)voxels.size(), "grid %d: %d occupied cells for %d voxels", gridIndex, grid.GetNumOccupied(), (int)voxels.size());
+
+		Vec3 extent = Vec3(cellSize.x * (float)dimensions.x, cellSize.y * (float)dimensions.y, cellSize.z * (float)dimensions.z);
+		for (int rayIndex = 0; rayIndex < 500; ++rayIndex)
+		{
+			Vec3 origin = Vec3(minBounds.x + (unit(rng) * 3.f - 1.f) * extent.x, minBounds.y + (unit(rng) * 3.f - 1.f) * extent.y,
+				minBounds.z + (unit(rng) * 3.f - 1.f) * extent.z);
+			Vec3 direction = Vec3(unit(rng) * 2.f - 1.f, unit(rng) * 2.f - 1.f, unit(rng) * 2.f - 1.f);
+			if (rayIndex % 7 == 0)
+			{
+				direction.z = 0.f;
+			}
+			if (rayIndex % 11 == 0)
+			{
+				direction.y = 0.f;
+			}
+			direction = direction.GetNormalized();
+			float tMax = unit(rng) * 100.f;
+
+			float expectedT = FindFirstVoxelBruteForce(voxels, cellSize, origin, direction, tMax);
+			VoxelGridHit hit;
+			bool isHit = grid.FindFirstOccupied(origin, direction, tMax, hit);
+			++numRays;
+
+			CLOUD_TEST_CHECK(isHit == (expectedT >= 0.f), "grid %d ray %d: hit %d, brute force %d", gridIndex, rayIndex, isHit ? 1 : 0, (expectedT >= 0.f) ? 1 : 0);
+			if (!isHit)
+			{
+				continue;
+			}
+
+			++numHits;
+			CLOUD_TEST_CHECK(fabsf(hit.tEnter - expectedT) <= 1e-3f * (1.f + expectedT), "grid %d ray %d: tEnter %g, brute force %g", gridIndex, rayIndex, hit.tEnter, expectedT);
+			CLOUD_TEST_CHECK(grid.IsOccupied(hit.cell) && grid.GetVoxelIndex(hit.cell) == hit.voxelIndex, "grid %d ray %d: hit cell isn't the returned voxel's", gridIndex, rayIndex);
+		}
+	}
+
+	printf("  %d rays, %d hits\n", numRays, numHits);
+	return true;
+}
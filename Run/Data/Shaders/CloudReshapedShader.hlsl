@@ -6,6 +6,7 @@ struct Voxel {
     float temperature;
 };
 
+// Must match CloudGPU in Cloud.hpp
 struct Cloud {
     float3 position;
     int3 gridDimensions;
@@ -14,6 +15,10 @@ struct Cloud {
     unsigned int voxelOffset;
     unsigned int voxelCount;
     unsigned int octreeOffset;
+    float scale;
+    float densityScale;
+    float3 noiseOffset;
+    unsigned int prototypeIndex;
 };
 
 struct OctreeStackEntry {
@@ -25,6 +30,7 @@ struct OctreeNode {
     float3 minBounds;
     float3 maxBounds;
     float densitySum;             // Aggregate density
+    float densityMax;             // Majorant: densest voxel under this node (delta tracking)
     unsigned int firstChildIndex; // Index of the first child (-1 if leaf)
     unsigned int numChildren;     // Number of children (0 if leaf)
     unsigned int firstVoxelIndex; // Index of the first voxel (-1 if none)
@@ -32,6 +38,14 @@ struct OctreeNode {
     unsigned int depth;           // Depth of this node
 };
 
+// One mip level of a baked noise volume (must match NoiseVolumeLevelGPU in CloudNoiseVolumes.hpp). Perlin and
+// Worley have the same size, so one table describes both.
+struct NoiseVolumeLevel
+{
+    int  firstTexel;
+    int3 size;
+};
+
 // Constant buffers
 cbuffer LightConstants : register(b1) {
     float3 SunDirection;
@@ -51,7 +65,7 @@ cbuffer CameraConstants : register(b2) {
 cbuffer CloudConstants : register(b6) {
     int numClouds;
     int numOctrees;
-    float timeElapsed;
+    float unusedTimeElapsed;  // cloudFrame[0].timeElapsed instead; kept for CloudConstants' layout
     int useDensity;
     int useNoise;
     int invertNoise;
@@ -61,11 +75,20 @@ cbuffer CloudConstants : register(b6) {
     int currentDepth;
 };
 
+// Per-frame values (CloudFrameGPU), kept out of CloudConstants so that block is only re-sent after an edit
+struct CloudFrame
+{
+    float timeElapsed;
+    float3 padding;
+};
+
 // Resources
 StructuredBuffer<Cloud> clouds : register(t0);
 StructuredBuffer<Voxel> voxels : register(t1);
-Texture3D<float> perlinNoiseTexture : register(t2);
+StructuredBuffer<float> perlinNoise : register(t2);
 StructuredBuffer<OctreeNode> octreeNodes : register(t3);
+StructuredBuffer<NoiseVolumeLevel> noiseVolumeLevels : register(t10);
+StructuredBuffer<CloudFrame> cloudFrame : register(t19);
 SamplerState samplerState : register(s0);
 RWTexture2D<float4> outputTexture : register(u0);
 
@@ -105,12 +128,32 @@ float3 ComputeRayDirection(float2 uv) {
     return normalize(worldDir);
 }
 
+float GetNoiseTexel(StructuredBuffer<float> volume, NoiseVolumeLevel level, int3 texel) {
+    texel = ((texel % level.size) + level.size) % level.size;
+    return volume[level.firstTexel + (texel.z * level.size.y + texel.y) * level.size.x + texel.x];
+}
+
+// Trilinear with wrapping inside one level, texel centers at (i + 0.5) / size (VolumeMipChain::SampleTrilinear)
+float SampleNoiseVolumeLevel(StructuredBuffer<float> volume, NoiseVolumeLevel level, float3 uvw) {
+    float3 local = uvw * float3(level.size) - 0.5f;
+    int3 texel0 = int3(floor(local));
+    int3 texel1 = texel0 + 1;
+    float3 blend = local - float3(texel0);
+
+    float c00 = lerp(GetNoiseTexel(volume, level, int3(texel0.x, texel0.y, texel0.z)), GetNoiseTexel(volume, level, int3(texel1.x, texel0.y, texel0.z)), blend.x);
+    float c10 = lerp(GetNoiseTexel(volume, level, int3(texel0.x, texel1.y, texel0.z)), GetNoiseTexel(volume, level, int3(texel1.x, texel1.y, texel0.z)), blend.x);
+    float c01 = lerp(GetNoiseTexel(volume, level, int3(texel0.x, texel0.y, texel1.z)), GetNoiseTexel(volume, level, int3(texel1.x, texel0.y, texel1.z)), blend.x);
+    float c11 = lerp(GetNoiseTexel(volume, level, int3(texel0.x, texel1.y, texel1.z)), GetNoiseTexel(volume, level, int3(texel1.x, texel1.y, texel1.z)), blend.x);
+    return lerp(lerp(c00, c10, blend.y), lerp(c01, c11, blend.y), blend.z);
+}
+
 float SampleNoise(float3 rayPos) {
+    float timeElapsed = cloudFrame[0].timeElapsed;
     float3 noiseCoords = rayPos + float3(timeElapsed * 1.0f, -timeElapsed * .5f, -timeElapsed * .1f);
     if (scrolling == 0) {
         noiseCoords = rayPos;
     }
-    float noiseValue = perlinNoiseTexture.SampleLevel(samplerState, noiseCoords, 0).r;
+    float noiseValue = SampleNoiseVolumeLevel(perlinNoise, noiseVolumeLevels[0], noiseCoords);
     if (useNoise == 0) noiseValue = 0.5f;
     if (invertNoise == 1) noiseValue = 1.0f - noiseValue;
     return saturate(noiseValue);
@@ -279,16 +322,20 @@ float4 RayMarch(float2 uv) {
         int closestCloudIndex;
         float minSDF = FindClosestCloud(rayPos, closestCloudIndex);
 
-        // Bounding box visualization
+        // Bounding box visualization, of the closest instance's prototype nodes
         if (showBoundingBoxes == 1) {
             float colorOffset = 0;    
+            float3 nodeRayPos = rayPos;
+            if (closestCloudIndex != -1) {
+                nodeRayPos = (rayPos - clouds[closestCloudIndex].position) / clouds[closestCloudIndex].scale;
+            }
             for (uint nodeIndex = 0; nodeIndex < numOctrees; ++nodeIndex) {
                 OctreeNode node = octreeNodes[nodeIndex];
 
                 if (node.depth == currentDepth) {
                     float3 nodeCenter = (node.minBounds + node.maxBounds) * 0.5f;
                     float3 nodeSize = (node.maxBounds - node.minBounds) * 0.5f;
-                    float distanceToNode = BoxSDF(rayPos, nodeCenter, nodeSize);
+                    float distanceToNode = BoxSDF(nodeRayPos, nodeCenter, nodeSize);
 
 
                     colorOffset += 1.f / 8.f;
@@ -309,8 +356,10 @@ float4 RayMarch(float2 uv) {
             Cloud cloud = clouds[closestCloudIndex];
             uint startIndex = cloud.octreeOffset;
 
+            // The octrees are in prototype space (Cloud.hpp)
+            float3 prototypeRayPos = (rayPos - cloud.position) / cloud.scale;
             for (uint rootIndex = startIndex; rootIndex < numOctrees; rootIndex++) {
-                TraverseOctree(rayPos, rayDir, rootIndex, totalDensity, finalColor, stepsize);
+                TraverseOctree(prototypeRayPos, rayDir / cloud.scale, rootIndex, totalDensity, finalColor, stepsize);
             }
         }
         
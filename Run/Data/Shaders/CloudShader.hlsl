@@ -6,6 +6,8 @@ struct Voxel {
     float temperature;
 };
 
+// One placed instance of a prototype (must match CloudGPU in Cloud.hpp). Its voxels and octree are shared with
+// the other instances and in prototype space: world = position + prototype * scale. The bounds are world space.
 struct Cloud {
     float3 position;
     int3 gridDimensions;
@@ -14,6 +16,10 @@ struct Cloud {
     unsigned int voxelOffset;
     unsigned int voxelCount;
     unsigned int octreeOffset;
+    float scale;
+    float densityScale;
+    float3 noiseOffset;
+    unsigned int prototypeIndex;
 };
 
 struct OctreeNode
@@ -21,6 +27,7 @@ struct OctreeNode
     float3 minBounds; 
     float3 maxBounds;
     float densitySum;             // Aggregate density
+    float densityMax;             // Majorant: densest voxel under this node (delta tracking)
     unsigned int firstChildIndex; // Index of the first child (-1 if leaf)
     unsigned int numChildren;     // Number of children (0 if leaf)
     unsigned int firstVoxelIndex; // Index of the first voxel (-1 if none)
@@ -28,6 +35,83 @@ struct OctreeNode
     unsigned int depth;           // Depth of this node
 };
 
+// Per-frame values (CloudFrameGPU), kept out of CloudConstants so that block is only re-sent after an edit
+struct CloudFrame
+{
+    float  timeElapsed;
+    float3 padding;
+};
+
+struct RayJitter
+{
+    int    textureSize;
+    int2   offset;
+    float  rotation;
+    float  strength;
+    float3 padding;
+};
+
+// Temporal amortization (TemporalReprojectionGPU): with blockSize > 1 this pass only marches one pixel of
+// each block and CloudTemporalShader rebuilds the full-resolution image from the history
+struct TemporalReprojection
+{
+    float4x4 previousViewProjection;
+    float3   cloudDrift;
+    int      blockSize;
+    int2     phase;
+    int      historyValid;
+    int2     outputSize;
+    float3   padding;
+};
+
+// Must match CloudUpsampleGPU in CloudUpsample.hpp
+struct CloudUpsample
+{
+    int      factor;
+    int2     outputSize;
+    int      numOccluders;
+    float    depthSigma;
+    float    maxDistance;
+    float2   padding;
+};
+
+// Must match SceneOccluderGPU in CloudRayMarcher.hpp: a unit cube around center, inverseAxis = axis / |axis|^2
+struct SceneOccluder
+{
+    float3 center;
+    float3 inverseAxisX;
+    float3 inverseAxisY;
+    float3 inverseAxisZ;
+};
+
+// Per-cloud sun transmittance volume, values at cell centers (must match SunTransmittanceVolumeGPU)
+struct SunTransmittanceVolume
+{
+    float3 minBounds;
+    int    firstCell;
+    float3 inverseCellSize;
+    int    numCellsX;
+    int    numCellsY;
+    int    numCellsZ;
+    float2 padding;
+};
+
+// One mip level of a baked noise volume (must match NoiseVolumeLevelGPU in CloudNoiseVolumes.hpp). Perlin and
+// Worley have the same size, so one table describes both.
+struct NoiseVolumeLevel
+{
+    int  firstTexel;
+    int3 size;
+};
+
+// Cost heatmap view (must match CloudCostViewGPU in CloudRayCost.hpp); channel -1 shows the clouds
+struct CloudCostView
+{
+    int    channel;
+    float  maxValue;
+    float2 padding;
+};
+
 // Constant buffers
 cbuffer LightConstants : register(b1) {
     float3 SunDirection;
@@ -47,7 +131,7 @@ cbuffer CameraConstants : register(b2) {
 cbuffer CloudConstants : register(b6) {
     int     numClouds;
     int     numOctrees;
-    float   timeElapsed;
+    float   unusedTimeElapsed;  // cloudFrame[0].timeElapsed instead; kept for CloudConstants' layout
     int     useDensity;
 
     int     useNoise;
@@ -94,10 +178,22 @@ cbuffer ShadowConstants : register(b7) {
 // Resources
 StructuredBuffer<Cloud>         clouds              : register(t0);
 StructuredBuffer<Voxel>         voxels              : register(t1);
-Texture3D<float>                perlinNoiseTexture  : register(t2);
-Texture3D<float>                worleyNoiseTexture  : register(t3);
+StructuredBuffer<float>         perlinNoise         : register(t2);    // Every mip level back to back, see noiseVolumeLevels
+StructuredBuffer<float>         worleyNoise         : register(t3);
 StructuredBuffer<OctreeNode>    octreeNodes         : register(t4);
 Texture2D<float4>               voxelShadowMap        : register(t5);
+StructuredBuffer<float3>        windField           : register(t6);
+StructuredBuffer<float>         blueNoise           : register(t7);
+StructuredBuffer<RayJitter>     rayJitter           : register(t8);
+StructuredBuffer<TemporalReprojection> temporalReprojection : register(t9);
+StructuredBuffer<NoiseVolumeLevel> noiseVolumeLevels : register(t10);
+StructuredBuffer<CloudUpsample> cloudUpsample       : register(t12);
+StructuredBuffer<SceneOccluder> sceneOccluders      : register(t13);
+StructuredBuffer<SunTransmittanceVolume> sunTransmittanceVolumes : register(t14);
+StructuredBuffer<float>         sunTransmittance    : register(t15);
+StructuredBuffer<uint>          visibleClouds       : register(t17);    // Count, then the clouds inside the camera frustum
+StructuredBuffer<CloudCostView> costView            : register(t18);
+StructuredBuffer<CloudFrame>    cloudFrame          : register(t19);
 SamplerState                    samplerState        : register(s0);
 RWTexture2D<float4>             outputTexture       : register(u0);
 
@@ -105,6 +201,62 @@ RWTexture2D<float4>             outputTexture       : register(u0);
 
 
 
+//------------------------------------------------------------------------------
+// Cost heatmaps: what this thread's ray cost, counted as it marches and shown instead of the clouds when
+// costView is on. Same counters as CloudRayCounters in the CPU marcher.
+//------------------------------------------------------------------------------
+static const int COST_VIEW_STEPS = 0;
+static const int COST_VIEW_NODES_VISITED = 1;
+static const int COST_VIEW_VOXEL_TESTS = 2;
+static const int COST_VIEW_NOISE_SAMPLES = 3;
+static const int COST_VIEW_TERMINATION_DISTANCE = 4;
+static const int COST_VIEW_INTERVAL_REFILLS = 5;
+
+static uint  costSteps = 0;
+static uint  costNodesVisited = 0;
+static uint  costVoxelTests = 0;
+static uint  costNoiseSamples = 0;
+static float costTerminationDistance = 0.0f;
+static uint  costIntervalRefills = 0;
+
+// Dark blue, blue, green, yellow, red over [0,1] (CloudRayCostMap::GetHeatColor)
+float3 CostHeatColor(float t)
+{
+    const float3 stops[5] = {
+        float3(0.02f, 0.02f, 0.2f),
+        float3(0.0f, 0.35f, 1.0f),
+        float3(0.0f, 0.85f, 0.3f),
+        float3(1.0f, 0.85f, 0.0f),
+        float3(1.0f, 0.1f, 0.0f)
+    };
+    float scaled = saturate(t) * 4.0f;
+    int stop = min(int(scaled), 3);
+    return lerp(stops[stop], stops[stop + 1], scaled - float(stop));
+}
+
+// The march's color, or the selected counter in false colour (opaque, so it covers the scene)
+float4 ApplyCostView(float4 color)
+{
+    CloudCostView view = costView[0];
+    if (view.channel < 0) {
+        return color;
+    }
+
+    float value = costTerminationDistance;
+    if (view.channel == COST_VIEW_STEPS) {
+        value = float(costSteps);
+    } else if (view.channel == COST_VIEW_NODES_VISITED) {
+        value = float(costNodesVisited);
+    } else if (view.channel == COST_VIEW_VOXEL_TESTS) {
+        value = float(costVoxelTests);
+    } else if (view.channel == COST_VIEW_NOISE_SAMPLES) {
+        value = float(costNoiseSamples);
+    } else if (view.channel == COST_VIEW_INTERVAL_REFILLS) {
+        value = float(costIntervalRefills);
+    }
+    return float4(CostHeatColor(value / max(view.maxValue, 0.0001f)), 1.0f);
+}
+
 // Helper functions
 float ApplyBeersLaw(float density, float distance) {
     return exp(-extinctionCoefficient * density * distance);
@@ -131,6 +283,12 @@ float BoxSDF(float3 p, float3 voxelPos, float3 boxSize) {
 //the value returned will be positive if the point is outside the box, negative if inside, and zero if on the surface
 }
 
+// Octree nodes and voxels are shared by a prototype's instances, so they are tested in its space and the distances
+// scaled back. Directions divided by the scale keep ray distances the same in both.
+float3 ToPrototypeSpace(Cloud cloud, float3 worldPos) {
+    return (worldPos - cloud.position) / cloud.scale;
+}
+
 float FindAABBExitPoint(float3 rayOrigin, float3 rayDir, float3 minBounds, float3 maxBounds)
 {
     float3 invRayDir = 1.0f / rayDir; // Precompute inverse direction
@@ -141,6 +299,129 @@ float FindAABBExitPoint(float3 rayOrigin, float3 rayDir, float3 minBounds, float
     return min(tMax3.x, min(tMax3.y, tMax3.z)); // Smallest exit time is when the ray leaves the AABB
 }
 
+// Analytic slab test. x = entry distance (clamped to the origin), y = exit distance; a miss has x > y.
+float2 IntersectAABB(float3 rayOrigin, float3 invRayDir, float3 minBounds, float3 maxBounds)
+{
+    float3 t1 = (minBounds - rayOrigin) * invRayDir;
+    float3 t2 = (maxBounds - rayOrigin) * invRayDir;
+    float3 tMin3 = min(t1, t2);
+    float3 tMax3 = max(t1, t2);
+    float tEnter = max(max(tMin3.x, tMin3.y), max(tMin3.z, 0.0f));
+    float tExit = min(tMax3.x, min(tMax3.y, tMax3.z));
+    return float2(tEnter, tExit);
+}
+
+// Distance to the nearest opaque scene box along the ray; clouds behind it are hidden
+float FindSceneDepth(float3 rayOrigin, float3 rayDir, float maxDistance)
+{
+    CloudUpsample upsample = cloudUpsample[0];
+    float depth = maxDistance;
+    for (int occluderIndex = 0; occluderIndex < upsample.numOccluders; occluderIndex++) {
+        SceneOccluder occluder = sceneOccluders[occluderIndex];
+        float3 localOrigin = float3(dot(rayOrigin - occluder.center, occluder.inverseAxisX), dot(rayOrigin - occluder.center, occluder.inverseAxisY), dot(rayOrigin - occluder.center, occluder.inverseAxisZ));
+        float3 localDir = float3(dot(rayDir, occluder.inverseAxisX), dot(rayDir, occluder.inverseAxisY), dot(rayDir, occluder.inverseAxisZ));
+        float2 t = IntersectAABB(localOrigin, 1.0f / localDir, float3(-0.5f, -0.5f, -0.5f), float3(0.5f, 0.5f, 0.5f));
+        if (t.x <= t.y && t.x < depth) {
+            depth = t.x;
+        }
+    }
+    return depth;
+}
+
+// Clouds the ray passes through, as [tEnter, tExit] intervals sorted by entry. The list is kept short so it stays in
+// registers; when more clouds are on the ray the farthest entries are dropped and the list is rebuilt further on.
+static const int MAX_CLOUD_INTERVALS = 16;
+
+struct CloudInterval
+{
+    float tEnter;
+    float tExit;
+    int   cloudIndex;
+};
+
+// Camera rays only test the clouds CloudManager found inside the view frustum; rays towards the sun can leave it.
+// Clouds the ray has left by minDistance are skipped. refillDistance is where the list must be rebuilt because a
+// dropped cloud may start there: the last kept entry, or the first exit when every kept cloud is already entered.
+int BuildCloudIntervals(float3 rayOrigin, float3 rayDir, float minDistance, float maxDistance, bool cameraVisibleOnly,
+                        out CloudInterval intervals[MAX_CLOUD_INTERVALS], out float refillDistance)
+{
+    float3 invRayDir = 1.0f / rayDir;
+    int numIntervals = 0;
+    bool isOverflowing = false;
+
+    int numCandidates = numClouds;
+    if (cameraVisibleOnly) {
+        numCandidates = (int)visibleClouds[0];
+    }
+
+    for (int candidate = 0; candidate < numCandidates; candidate++) {
+        int ci = candidate;
+        if (cameraVisibleOnly) {
+            ci = (int)visibleClouds[candidate + 1];
+        }
+        float2 t = IntersectAABB(rayOrigin, invRayDir, clouds[ci].minBounds, clouds[ci].maxBounds);
+        if (t.x > t.y || t.x >= maxDistance || t.y < minDistance) {
+            continue;
+        }
+
+        // Insertion sort; past capacity the farthest entry is dropped
+        int slot = min(numIntervals, MAX_CLOUD_INTERVALS - 1);
+        isOverflowing = isOverflowing || numIntervals == MAX_CLOUD_INTERVALS;
+        if (numIntervals == MAX_CLOUD_INTERVALS && t.x >= intervals[slot].tEnter) {
+            continue;
+        }
+        while (slot > 0 && intervals[slot - 1].tEnter > t.x) {
+            intervals[slot] = intervals[slot - 1];
+            slot--;
+        }
+        intervals[slot].tEnter = t.x;
+        intervals[slot].tExit = t.y;
+        intervals[slot].cloudIndex = ci;
+        numIntervals = min(numIntervals + 1, MAX_CLOUD_INTERVALS);
+    }
+
+    refillDistance = 100000.0f;
+    if (isOverflowing) {
+        refillDistance = intervals[MAX_CLOUD_INTERVALS - 1].tEnter;
+        if (refillDistance <= minDistance) {
+            refillDistance = 100000.0f;
+            for (int k = 0; k < MAX_CLOUD_INTERVALS; k++) {
+                refillDistance = min(refillDistance, intervals[k].tExit);
+            }
+        }
+    }
+    return numIntervals;
+}
+
+// Nearest cloud among the intervals the ray is in (or within 0.1 of entering), by BoxSDF as before.
+// Outside every interval the distance is the gap to the next entry plus entryOffset, so the step jumps straight
+// there and lands the ray's start jitter inside the cloud; after the last exit it is 100000 and the march ends.
+void FindClosestCloudInterval(float3 rayPos, float distanceTraveled, float entryOffset, CloudInterval intervals[MAX_CLOUD_INTERVALS], int numIntervals,
+                              out float minDistCloud, out int closestCloudIndex)
+{
+    minDistCloud = 100000;
+    closestCloudIndex = -1;
+
+    for (int k = 0; k < numIntervals; k++) {
+        if (intervals[k].tEnter > distanceTraveled + 0.1f) {
+            if (closestCloudIndex < 0) {
+                minDistCloud = intervals[k].tEnter + entryOffset - distanceTraveled;
+            }
+            break;
+        }
+        if (intervals[k].tExit < distanceTraveled) {
+            continue;
+        }
+
+        Cloud c = clouds[intervals[k].cloudIndex];
+        float distToCloud = BoxSDF(rayPos, 0.5f*(c.minBounds + c.maxBounds), 0.5f*(c.maxBounds - c.minBounds));
+        if (distToCloud < minDistCloud) {
+            minDistCloud      = distToCloud;
+            closestCloudIndex = intervals[k].cloudIndex;
+        }
+    }
+}
+
 float3 ComputeRayDirection(float2 uv) {
     float2 ndc = uv;
     ndc.y = -ndc.y;
@@ -155,8 +436,74 @@ float3 ComputeRayDirection(float2 uv) {
 //    return pow(saturate(worleyVal), 3.0f); // Increase contrast for stronger cloud edges
 //}
 
+// Curl-noise wind volume baked on the CPU (CurlNoiseField), WIND_FIELD_SIZE^3 texels, x fastest
+static const int WIND_FIELD_SIZE = 32;
+
+float3 GetWindTexel(int3 texel) {
+    texel = ((texel % WIND_FIELD_SIZE) + WIND_FIELD_SIZE) % WIND_FIELD_SIZE;
+    return windField[(texel.z * WIND_FIELD_SIZE + texel.y) * WIND_FIELD_SIZE + texel.x];
+}
+
+// Trilinear with wrapping, texel centers at (i + 0.5) / WIND_FIELD_SIZE (CurlNoiseField::SampleVelocity)
+float3 SampleWindField(float3 uvw) {
+    float3 local = frac(uvw) * WIND_FIELD_SIZE - 0.5f;
+    int3 texel0 = int3(floor(local));
+    int3 texel1 = texel0 + 1;
+    float3 blend = local - float3(texel0);
+
+    float3 c00 = lerp(GetWindTexel(int3(texel0.x, texel0.y, texel0.z)), GetWindTexel(int3(texel1.x, texel0.y, texel0.z)), blend.x);
+    float3 c10 = lerp(GetWindTexel(int3(texel0.x, texel1.y, texel0.z)), GetWindTexel(int3(texel1.x, texel1.y, texel0.z)), blend.x);
+    float3 c01 = lerp(GetWindTexel(int3(texel0.x, texel0.y, texel1.z)), GetWindTexel(int3(texel1.x, texel0.y, texel1.z)), blend.x);
+    float3 c11 = lerp(GetWindTexel(int3(texel0.x, texel1.y, texel1.z)), GetWindTexel(int3(texel1.x, texel1.y, texel1.z)), blend.x);
+    return lerp(lerp(c00, c10, blend.y), lerp(c01, c11, blend.y), blend.z);
+}
+
+// Blue-noise ray-start jitter (BlueNoiseTexture), returns a fraction of a step rotated every frame
+float SampleRayJitter(uint2 pixel) {
+    RayJitter params = rayJitter[0];
+    uint2 texel = (pixel + uint2(params.offset)) % uint(params.textureSize);
+    return frac(blueNoise[texel.y * params.textureSize + texel.x] + params.rotation) * params.strength;
+}
+
+float GetNoiseTexel(StructuredBuffer<float> volume, NoiseVolumeLevel level, int3 texel) {
+    texel = ((texel % level.size) + level.size) % level.size;
+    return volume[level.firstTexel + (texel.z * level.size.y + texel.y) * level.size.x + texel.x];
+}
+
+// Trilinear with wrapping inside one level, texel centers at (i + 0.5) / size (VolumeMipChain::SampleTrilinear)
+float SampleNoiseVolumeLevel(StructuredBuffer<float> volume, NoiseVolumeLevel level, float3 uvw) {
+    float3 local = uvw * float3(level.size) - 0.5f;
+    int3 texel0 = int3(floor(local));
+    int3 texel1 = texel0 + 1;
+    float3 blend = local - float3(texel0);
+
+    float c00 = lerp(GetNoiseTexel(volume, level, int3(texel0.x, texel0.y, texel0.z)), GetNoiseTexel(volume, level, int3(texel1.x, texel0.y, texel0.z)), blend.x);
+    float c10 = lerp(GetNoiseTexel(volume, level, int3(texel0.x, texel1.y, texel0.z)), GetNoiseTexel(volume, level, int3(texel1.x, texel1.y, texel0.z)), blend.x);
+    float c01 = lerp(GetNoiseTexel(volume, level, int3(texel0.x, texel0.y, texel1.z)), GetNoiseTexel(volume, level, int3(texel1.x, texel0.y, texel1.z)), blend.x);
+    float c11 = lerp(GetNoiseTexel(volume, level, int3(texel0.x, texel1.y, texel1.z)), GetNoiseTexel(volume, level, int3(texel1.x, texel1.y, texel1.z)), blend.x);
+    return lerp(lerp(c00, c10, blend.y), lerp(c01, c11, blend.y), blend.z);
+}
+
+// Linear between the two levels around lod, like SampleLevel on a mipped Texture3D (VolumeMipChain::SampleLevel);
+// a whole lod reads one level
+float SampleNoiseVolume(StructuredBuffer<float> volume, float3 uvw, float lod) {
+    uint numLevels, stride;
+    noiseVolumeLevels.GetDimensions(numLevels, stride);
+    lod = clamp(lod, 0.0f, float(numLevels - 1));
+
+    int level0 = int(lod);
+    float blend = lod - float(level0);
+    float sample0 = SampleNoiseVolumeLevel(volume, noiseVolumeLevels[level0], uvw);
+    if (blend <= 0.0f || level0 + 1 >= int(numLevels)) {
+        return sample0;
+    }
+    return lerp(sample0, SampleNoiseVolumeLevel(volume, noiseVolumeLevels[level0 + 1], uvw), blend);
+}
+
 float SampleNoise(float3 rayPos) {
+    costNoiseSamples += 2;  // Perlin and Worley
     float scale = noiseScale / voxelDimensions;
+    float timeElapsed = cloudFrame[0].timeElapsed;
 
     // Apply scrolling movement to the noise coordinates
     float3 noiseCoords = frac(rayPos * scale + float3(timeElapsed * 0.1, -timeElapsed * 0.05, -timeElapsed * 0.01) * scrollFactor);
@@ -164,10 +511,15 @@ float SampleNoise(float3 rayPos) {
     if (scrolling == 0) {
         noiseCoords = rayPos * scale;
     }
+    else {
+        // The wind field is fixed in world space, so scrolling features get bent differently as they pass through it
+        float3 wind = SampleWindField(rayPos * scale);
+        worleyCoords = frac(worleyCoords + wind * scrollFactor * 0.1f);
+    }
 
     // Sample base Perlin and Worley noise
-    float perlinVal = perlinNoiseTexture.SampleLevel(samplerState, noiseCoords, 0).r;
-    float worleyBase = worleyNoiseTexture.SampleLevel(samplerState, worleyCoords, 0).r;
+    float perlinVal = SampleNoiseVolume(perlinNoise, noiseCoords, 0.0f);
+    float worleyBase = SampleNoiseVolume(worleyNoise, worleyCoords, 0.0f);
     
     //// Threshold the base Worley noise to create initial structure
     if (worleyBase <= minWorleyValue) {
@@ -175,14 +527,14 @@ float SampleNoise(float3 rayPos) {
     }
     
     float midFrequency = 2.0f; // Increase frequency for medium details
-    float worleyMedium = worleyNoiseTexture.SampleLevel(samplerState, worleyCoords * midFrequency, 0.5f).r * 0.4f;
+    float worleyMedium = SampleNoiseVolume(worleyNoise, worleyCoords * midFrequency, 0.5f) * 0.4f;
     //if (worleyMedium <= minWorleyValue) {
     //    worleyMedium = 0.0f;
     //}
     
     // Detail octave: higher frequency Worley noise for fine textures
     float detailFrequency = 6.0f; // Increase frequency for finer details
-    float worleyDetail = worleyNoiseTexture.SampleLevel(samplerState, worleyCoords * detailFrequency, 1.0f).r * 0.2f;
+    float worleyDetail = SampleNoiseVolume(worleyNoise, worleyCoords * detailFrequency, 1.0f) * 0.2f;
     //if (worleyDetail <= minWorleyValue) {
     //    worleyDetail = 0.0f;
     //}
@@ -193,7 +545,7 @@ float SampleNoise(float3 rayPos) {
     
     // Mask octave: lower frequency Worley noise to control where detail appears
     float maskFrequency = .50f; // Lower frequency for large-scale structure
-    float worleyMaskVal = 1 - worleyNoiseTexture.SampleLevel(samplerState, maskCoords * maskFrequency, 0).r;
+    float worleyMaskVal = 1 - SampleNoiseVolume(worleyNoise, maskCoords * maskFrequency, 0.0f);
     float detailMask = pow(smoothstep(0.4f, 0.6f, worleyMaskVal), 1.5f);
     
     // Blend base and detail Worley noise using the mask
@@ -266,6 +618,7 @@ float TraverseOctree(uint rootNodeIndex, float3 rayPos, float3 rayDir, inout flo
         // Pop a node from the stack
         uint nodeIndex = stack[--stackPointer];
         OctreeNode node = octreeNodes[nodeIndex];
+        costNodesVisited++;
 
         // Compute SDF for this node's bounding box
         float3 nodeCenter = (node.minBounds + node.maxBounds) * 0.5f;
@@ -468,13 +821,326 @@ float ComputeLightingWithShadows(Voxel rayVoxel, float3 rayPosition, float3 sunD
     return ((NdotL * densityFactor * SunIntensity) + ambientContribution) * lightAccumulation * phaseFunction;
 }
 
-// Ray marching function with octree traversal
-float4 RayMarchOctree(float2 uv)
+//------------------------------------------------------------------------------
+// Delta tracking (Woodcock) against the octree majorants. Unbiased where RayMarchOctree's Beer-Lambert steps are
+// not, but one path per pixel is noisy, so it stays off until there is temporal accumulation to average it.
+//------------------------------------------------------------------------------
+static const bool USE_DELTA_TRACKING = false;
+static const bool USE_RATIO_TRACKED_SHADOWS = false;   // Sun transmittance by ratio tracking instead of the voxel shadow map
+static const int  MAX_TRACKING_STEPS = 256;
+
+uint HashPCG(uint value)
+{
+    uint state = value * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// Uniform in [0,1)
+float NextRandom(inout uint rngState)
+{
+    rngState = HashPCG(rngState);
+    return float(rngState >> 8) * (1.0f / 16777216.0f);
+}
+
+bool IsInsideBox(float3 p, float3 minBounds, float3 maxBounds)
+{
+    return all(p >= minBounds) && all(p <= maxBounds);
+}
+
+// Extinction majorant of the octree region around rayPos, and how far along the ray it holds:
+// a leaf's densityMax bound, or zero in the gaps between children
+float FindMajorant(uint rootNodeIndex, float3 rayPos, float3 invRayDir, out float regionLength)
+{
+    regionLength = 100000.0f;
+    uint nodeIndex = rootNodeIndex;
+
+    for (int level = 0; level < 16; level++) {
+        OctreeNode node = octreeNodes[nodeIndex];
+        float2 nodeHit = IntersectAABB(rayPos, invRayDir, node.minBounds, node.maxBounds);
+        if (!IsInsideBox(rayPos, node.minBounds, node.maxBounds)) {
+            // Only at the root, just outside the cloud bounds: empty until the ray enters
+            regionLength = (nodeHit.x <= nodeHit.y) ? min(regionLength, nodeHit.x) : 0.0f;
+            return 0.0f;
+        }
+        regionLength = min(regionLength, nodeHit.y);
+
+        if (node.numChildren == 0) {
+            // AccumulateDensity lerps the voxel density towards noise in [0,1], and the falloffs only scale it down
+            if (useDensity == 0) {
+                return extinctionCoefficient;
+            }
+            return extinctionCoefficient * max(node.densityMax, 1.0f) * densityMultiplier;
+        }
+
+        int containingChild = -1;
+        float nextChildEntry = regionLength;
+        for (uint i = 0; i < node.numChildren; i++) {
+            OctreeNode child = octreeNodes[node.firstChildIndex + i];
+            if (containingChild < 0 && IsInsideBox(rayPos, child.minBounds, child.maxBounds)) {
+                containingChild = (int)(node.firstChildIndex + i);
+            } else {
+                float2 childHit = IntersectAABB(rayPos, invRayDir, child.minBounds, child.maxBounds);
+                if (childHit.x <= childHit.y && childHit.x > 0.0f) {
+                    nextChildEntry = min(nextChildEntry, childHit.x);
+                }
+            }
+        }
+
+        if (containingChild < 0) {
+            regionLength = nextChildEntry;
+            return 0.0f;
+        }
+        nodeIndex = (uint)containingChild;
+    }
+    return 0.0f;
+}
+
+// Free-flight sampling to the next tentative collision; false once the walker leaves every cloud.
+// The majorant is the max over the clouds the walker is in, valid up to their nearest region boundary.
+// Region boundaries include every listed entry, so the walker stops at refillDistance and rebuilds the list there.
+bool SampleTentativeCollision(inout float3 rayPos, inout float distanceTraveled, float3 rayDir, float maxDistance, bool cameraVisibleOnly,
+                              inout CloudInterval intervals[MAX_CLOUD_INTERVALS], inout int numIntervals, inout float refillDistance,
+                              inout uint rngState, out float majorant)
+{
+    float3 invRayDir = 1.0f / rayDir;
+    majorant = 0.0f;
+
+    for (int regionIndex = 0; regionIndex < MAX_TRACKING_STEPS && distanceTraveled < maxDistance; regionIndex++) {
+        costSteps++;
+        if (distanceTraveled >= refillDistance) {
+            numIntervals = BuildCloudIntervals(rayPos - rayDir * distanceTraveled, rayDir, distanceTraveled, maxDistance, cameraVisibleOnly, intervals, refillDistance);
+            costIntervalRefills++;
+        }
+        majorant = 0.0f;
+        float regionLength = maxDistance - distanceTraveled;
+        for (int k = 0; k < numIntervals; k++) {
+            if (intervals[k].tEnter > distanceTraveled) {
+                regionLength = min(regionLength, intervals[k].tEnter - distanceTraveled);
+                break;
+            }
+            if (intervals[k].tExit <= distanceTraveled) {
+                continue;
+            }
+
+            Cloud cloud = clouds[intervals[k].cloudIndex];
+            float cloudRegionLength;
+            float cloudMajorant = FindMajorant(cloud.octreeOffset, ToPrototypeSpace(cloud, rayPos), invRayDir * cloud.scale, cloudRegionLength);
+            majorant = max(majorant, cloudMajorant * cloud.densityScale);
+            regionLength = min(regionLength, min(cloudRegionLength, intervals[k].tExit - distanceTraveled));
+        }
+
+        float freeFlight = (majorant > 0.0f) ? -log(1.0f - NextRandom(rngState)) / majorant : regionLength + 1.0f;
+        if (freeFlight < regionLength) {
+            rayPos += rayDir * freeFlight;
+            distanceTraveled += freeFlight;
+            return true;
+        }
+
+        // Free flights are memoryless, so the next region just restarts with its own majorant
+        float stepSize = regionLength + 0.001f;
+        rayPos += rayDir * stepSize;
+        distanceTraveled += stepSize;
+    }
+    return false;
+}
+
+// RayMarchOctree's density at rayPos: noise, voxel/cloud distance falloff and radial fade
+float ComputeVoxelDensity(Cloud cloud, Voxel voxel, float3 rayPos)
+{
+    float densityVal = AccumulateDensity(voxel, SampleNoise(rayPos + cloud.noiseOffset));
+
+    float normalizedVoxelDist = saturate(length(ToPrototypeSpace(cloud, rayPos) - voxel.position) / length(voxelDimensions * 0.5f));
+    float3 cloudCenter = (cloud.maxBounds + cloud.minBounds) * 0.5f;
+    float normalizedCloudDist = saturate(length(rayPos - cloudCenter) / abs(cloud.maxBounds.z - cloud.minBounds.z));
+    float combinedNorm = lerp(normalizedVoxelDist, normalizedCloudDist, cloudVoxelDistanceLerpVal);
+    densityVal *= 1.0f - smoothstep(0.0f, 0.95f, combinedNorm);
+
+    float radialNorm = saturate(length(rayPos.xy - cloudCenter.xy) / length((cloud.maxBounds - cloud.minBounds).xy * 0.5f));
+    densityVal *= pow(1.0f - radialNorm, 2.0f);
+    return densityVal * cloud.densityScale;
+}
+
+// Extinction of the closest cloud's voxel at rayPos, picked the same way as RayMarchOctree
+float EvaluateExtinction(float3 rayPos, float distanceTraveled, CloudInterval intervals[MAX_CLOUD_INTERVALS], int numIntervals)
+{
+    float minDistCloud;
+    int   closestCloudIndex;
+    FindClosestCloudInterval(rayPos, distanceTraveled, 0.0f, intervals, numIntervals, minDistCloud, closestCloudIndex);
+    if (closestCloudIndex < 0 || minDistCloud >= 0.1f) {
+        return 0.0f;
+    }
+
+    Cloud cloud = clouds[closestCloudIndex];
+    float3 prototypePos = ToPrototypeSpace(cloud, rayPos);
+    float minSDF = 100000.0f;
+    uint  closestNodeIndex = 0xFFFFFFFF;
+    TraverseOctree(cloud.octreeOffset, prototypePos, float3(0.0f, 0.0f, 0.0f), minSDF, closestNodeIndex);
+    minSDF *= cloud.scale;
+    if (minSDF > 0.02f || closestNodeIndex == 0xFFFFFFFF) {
+        return 0.0f;
+    }
+
+    OctreeNode node = octreeNodes[closestNodeIndex];
+    if (node.numChildren != 0) {
+        return 0.0f;
+    }
+
+    for (uint v = 0; v < node.numVoxels; v++) {
+        Voxel voxel = voxels[node.firstVoxelIndex + v];
+        if (BoxSDF(prototypePos, voxel.position, voxelDimensions * 0.5f) * cloud.scale < 0.02f) {
+            return extinctionCoefficient * ComputeVoxelDensity(cloud, voxel, rayPos);
+        }
+    }
+    return 0.0f;
+}
+
+// Ratio tracking towards the sun: every tentative collision scales the transmittance by the null-collision
+// probability. Russian roulette ends walkers carrying little light without adding bias.
+float EstimateSunTransmittance(float3 rayPos, inout uint rngState)
+{
+    float3 sunPosition = normalize(SunDirection) * -10000.0f;
+    float3 lightDir = normalize(sunPosition - rayPos);
+    CloudInterval lightIntervals[MAX_CLOUD_INTERVALS];
+    float lightRefillDistance;
+    int numLightIntervals = BuildCloudIntervals(rayPos, lightDir, 0.0f, 500.0f, false, lightIntervals, lightRefillDistance);
+
+    float transmittance = 1.0f;
+    float distanceTraveled = 0.0f;
+    float majorant;
+    while (SampleTentativeCollision(rayPos, distanceTraveled, lightDir, 500.0f, false, lightIntervals, numLightIntervals, lightRefillDistance, rngState, majorant)) {
+        float extinction = EvaluateExtinction(rayPos, distanceTraveled, lightIntervals, numLightIntervals);
+        transmittance *= max(1.0f - extinction / majorant, 0.0f);
+
+        if (transmittance < 0.1f) {
+            if (NextRandom(rngState) >= 0.5f) {
+                return 0.0f;
+            }
+            transmittance *= 2.0f;
+        }
+    }
+    return transmittance;
+}
+
+// Voxel shadow map PCF as in RayMarchOctree, averaged lit fraction in [0,1]
+// Optical depth to normalized depth d from the Fourier opacity series CloudShadowShader packed (a0, a1, b1 after the
+// first depth; a2, b2, a3, b3), clamped against ringing. Mirrors CloudOpacityShadowMap::ReconstructOpticalDepth.
+float ReconstructOpticalDepth(float4 opacityLow, float4 opacityHigh, float normalizedDepth)
+{
+    float depth = saturate(normalizedDepth);
+    float3 frequencies = 6.28318530718f * float3(1.0f, 2.0f, 3.0f);
+    float3 angles = frequencies * depth;
+    float3 cosineTerms = float3(opacityLow.z, opacityHigh.x, opacityHigh.z);
+    float3 sineTerms = float3(opacityLow.w, opacityHigh.y, opacityHigh.w);
+    float opticalDepth = 0.5f * opacityLow.y * depth + dot((cosineTerms * sin(angles) + sineTerms * (1.0f - cos(angles))) / frequencies, float3(1.0f, 1.0f, 1.0f));
+    return clamp(opticalDepth, 0.0f, 0.5f * opacityLow.y);
+}
+
+// The series is linear in the extinction, so one bilinear fetch per half filters it instead of a 3x3 PCF
+float SampleVoxelShadowMap(float3 rayPos)
+{
+    float4 lightPos = mul(LightViewProj, float4(rayPos, 1.0f));
+    float depthInLight = lightPos.z / lightPos.w;
+    float2 voxelShadowUV = 0.5 * (lightPos.xy / lightPos.w) + 0.5;
+    voxelShadowUV.y = 1.0 - voxelShadowUV.y;
+
+    uint atlasWidth, atlasHeight;
+    voxelShadowMap.GetDimensions(atlasWidth, atlasHeight);
+    float2 mapSize = float2(atlasWidth, (atlasHeight - 1) / 2);
+    float2 depthRange = voxelShadowMap.Load(int3(0, atlasHeight - 1, 0)).xy;
+
+    // Clamped half a texel inside the half so the filter never reaches the other one
+    float2 texel = clamp(voxelShadowUV * mapSize, float2(0.5f, 0.5f), mapSize - 0.5f);
+    float4 opacityLow = voxelShadowMap.SampleLevel(samplerState, texel / float2(atlasWidth, atlasHeight), 0.0f);
+    float4 opacityHigh = voxelShadowMap.SampleLevel(samplerState, (texel + float2(0.0f, mapSize.y)) / float2(atlasWidth, atlasHeight), 0.0f);
+    return exp(-ReconstructOpticalDepth(opacityLow, opacityHigh, (depthInLight - depthRange.x) / (depthRange.y - depthRange.x)));
+}
+
+// Trilinear lookup in the cloud's sun transmittance volume; clouds without one use the voxel shadow map
+float SampleSunLight(int cloudIndex, float3 rayPos)
+{
+    if (cloudIndex < 0) {
+        return SampleVoxelShadowMap(rayPos);
+    }
+    SunTransmittanceVolume volume = sunTransmittanceVolumes[cloudIndex];
+    if (volume.numCellsX == 0) {
+        return SampleVoxelShadowMap(rayPos);
+    }
+
+    int3 numCells = int3(volume.numCellsX, volume.numCellsY, volume.numCellsZ);
+    float3 local = clamp((rayPos - volume.minBounds) * volume.inverseCellSize - 0.5f, float3(0.0f, 0.0f, 0.0f), float3(numCells - 1));
+    int3 cell0 = int3(local);
+    int3 cell1 = min(cell0 + 1, numCells - 1);
+    float3 frac = local - float3(cell0);
+
+    int x0 = cell0.x;
+    int x1 = cell1.x;
+    int y0 = cell0.y * numCells.x;
+    int y1 = cell1.y * numCells.x;
+    int z0 = volume.firstCell + cell0.z * numCells.x * numCells.y;
+    int z1 = volume.firstCell + cell1.z * numCells.x * numCells.y;
+
+    float c00 = lerp(sunTransmittance[z0 + y0 + x0], sunTransmittance[z0 + y0 + x1], frac.x);
+    float c10 = lerp(sunTransmittance[z0 + y1 + x0], sunTransmittance[z0 + y1 + x1], frac.x);
+    float c01 = lerp(sunTransmittance[z1 + y0 + x0], sunTransmittance[z1 + y0 + x1], frac.x);
+    float c11 = lerp(sunTransmittance[z1 + y1 + x0], sunTransmittance[z1 + y1 + x1], frac.x);
+    return lerp(lerp(c00, c10, frac.y), lerp(c01, c11, frac.y), frac.z);
+}
+
+// One delta-tracked path: the first real collision is lit like a RayMarchOctree sample, escapes return zero
+// firstHitDistance is the accepted collision, maxDistance when the path escapes
+float4 DeltaTrackOctree(float2 uv, uint2 pixel, float maxDistance, out float firstHitDistance)
+{
+    float3 rayPos = CameraPosition;
+    float3 rayDir = ComputeRayDirection(uv);
+    float  distanceTraveled = 0.0f;
+    firstHitDistance = maxDistance;
+    costTerminationDistance = maxDistance;
+    uint   rngState = HashPCG(pixel.x + pixel.y * 65536u) ^ HashPCG(asuint(cloudFrame[0].timeElapsed));
+
+    CloudInterval cloudIntervals[MAX_CLOUD_INTERVALS];
+    float refillDistance;
+    int numCloudIntervals = BuildCloudIntervals(CameraPosition, rayDir, 0.0f, maxDistance, true, cloudIntervals, refillDistance);
+
+    float majorant;
+    while (SampleTentativeCollision(rayPos, distanceTraveled, rayDir, maxDistance, true, cloudIntervals, numCloudIntervals, refillDistance, rngState, majorant)) {
+        // Tentative collisions that fail the test are null collisions and the flight continues
+        float extinction = EvaluateExtinction(rayPos, distanceTraveled, cloudIntervals, numCloudIntervals);
+        if (NextRandom(rngState) * majorant >= extinction) {
+            continue;
+        }
+        firstHitDistance = distanceTraveled;
+        costTerminationDistance = distanceTraveled;
+
+        float3 SunPosition = normalize(SunDirection) * -10000.0f;
+        float3 DirectionToSun = normalize(SunPosition - rayPos);
+        float powder = PowderEffect(rayDir, -DirectionToSun, powderBias);
+        float hg = HenyeyGreensteinPhaseFunction(rayDir, -DirectionToSun, anisotropyG);
+        float lit;
+        if (USE_RATIO_TRACKED_SHADOWS) {
+            lit = EstimateSunTransmittance(rayPos, rngState);
+        } else {
+            float minDistCloud;
+            int   closestCloudIndex;
+            FindClosestCloudInterval(rayPos, distanceTraveled, 0.0f, cloudIntervals, numCloudIntervals, minDistCloud, closestCloudIndex);
+            lit = SampleSunLight(closestCloudIndex, rayPos);
+        }
+
+        float3 scatterColor = float3(.85f, .85f, 1.0f);
+        return float4(saturate(scatterColor * powder * hg * (shadowFactorMin + lit)), 1.0f);
+    }
+    return float4(0.0f, 0.0f, 0.0f, 0.0f);
+}
+
+// Ray marching function with octree traversal. The march ends at maxDistance (the scene depth);
+// firstHitDistance is where density first showed up, maxDistance if it never did.
+float4 RayMarchOctree(float2 uv, uint2 jitterPixel, float maxDistance, out float firstHitDistance)
 {
     float3 rayPos           = CameraPosition;
     float3 rayDir           = ComputeRayDirection(uv);
     float  distanceTraveled = 0.0f;
-    float  maxDistance      = 500.0f;
+    firstHitDistance        = maxDistance;
+    costTerminationDistance = maxDistance;
     float3 transmittance    = float3(1.f,1.f,1.f);
     float4 finalColor       = float4(0.f,0.f,0.f,0.f);
     float  totalDensity     = 0.0f;
@@ -482,36 +1148,36 @@ float4 RayMarchOctree(float2 uv)
     float minStep = minStepSize * voxelDimensions.x;
     float minDist = 0.02f;
 
+    // Start each ray a blue-noise fraction of a step in, so undersampling shows as fine noise instead of banding.
+    // Jumps over empty space keep the same offset past each cloud entry.
+    float rayJitter = SampleRayJitter(jitterPixel) * minStep;
+    distanceTraveled = rayJitter;
+    rayPos += rayDir * distanceTraveled;
+
     const float lowDensityThreshold = 0.1f; // Threshold for low density
     const float densityMultiplier   = 2.0f;  // Multiplier when density is low
 
     const float leafMultiplier = 5.0f; // Multiplier for leaf nodes
 
+    // Slab-test every cloud once up front instead of sphere-tracing BoxSDF through empty space
+    CloudInterval cloudIntervals[MAX_CLOUD_INTERVALS];
+    float refillDistance;
+    int numCloudIntervals = BuildCloudIntervals(CameraPosition, rayDir, 0.0f, maxDistance, true, cloudIntervals, refillDistance);
 
     while (distanceTraveled < maxDistance)
     {
+        costSteps++;
+        if (distanceTraveled >= refillDistance) {
+            numCloudIntervals = BuildCloudIntervals(CameraPosition, rayDir, distanceTraveled, maxDistance, true, cloudIntervals, refillDistance);
+            costIntervalRefills++;
+        }
+
         //--------------------------------------------------
         // 1) Check which cloud bounding box is nearest
         //--------------------------------------------------
-        float minDistCloud = 100000;
-        int   closestCloudIndex = -1;
-
-        for (int ci = 0; ci < numClouds; ci++) {
-            Cloud c = clouds[ci];
-            float distToCloud = BoxSDF(rayPos,
-                                       0.5f*(c.minBounds + c.maxBounds),
-                                       0.5f*(c.maxBounds - c.minBounds));
-
-            if(distToCloud > maxDistance)
-            {
-                continue;
-            }
-
-            if (distToCloud < minDistCloud) {
-                minDistCloud      = distToCloud;
-                closestCloudIndex = ci;
-            }
-        }
+        float minDistCloud;
+        int   closestCloudIndex;
+        FindClosestCloudInterval(rayPos, distanceTraveled, rayJitter, cloudIntervals, numCloudIntervals, minDistCloud, closestCloudIndex);
 
         //--------------------------------------------------
         // 2) If we found a cloud, see if we are inside it
@@ -529,8 +1195,10 @@ float4 RayMarchOctree(float2 uv)
             float minSDF = 100000.0f;
             uint  closestNodeIndex = 0xFFFFFFFF;
 
-            // Assuming cloud.octreeOffset is the root node for this cloud
-            TraverseOctree(cloud.octreeOffset, rayPos, rayDir, minSDF, closestNodeIndex);
+            // Assuming cloud.octreeOffset is the root node for this cloud; it is shared with the prototype's other instances
+            float3 prototypePos = ToPrototypeSpace(cloud, rayPos);
+            TraverseOctree(cloud.octreeOffset, prototypePos, rayDir, minSDF, closestNodeIndex);
+            minSDF *= cloud.scale;
 
             //---------------------------------------------
             // 4) If we are close enough to that node, process it
@@ -547,16 +1215,17 @@ float4 RayMarchOctree(float2 uv)
                         Voxel voxel = voxels[voxelIdx];
 
                         // Check if inside the voxel
-                        float distToVoxel = BoxSDF(rayPos, voxel.position,  voxelDimensions * .5f);
+                        costVoxelTests++;
+                        float distToVoxel = BoxSDF(prototypePos, voxel.position,  voxelDimensions * .5f) * cloud.scale;
                         if (distToVoxel < minDist) {
                             // If so, accumulate lighting & color, etc.
-                            float noiseVal   = SampleNoise(rayPos);
+                            float noiseVal   = SampleNoise(rayPos + cloud.noiseOffset);
 //                             if (noiseVal < 0.1f) {
 //                                 noiseVal = 0.f;
 //                             }
                             float densityVal = AccumulateDensity(voxel, noiseVal);
                            
-                            float voxelDist = length(rayPos - voxel.position);
+                            float voxelDist = length(prototypePos - voxel.position);
                             float voxelMaxRadius = length(voxelDimensions * 0.5f);
                             float normalizedVoxelDist = saturate(voxelDist / voxelMaxRadius);
                                 
@@ -611,7 +1280,7 @@ float4 RayMarchOctree(float2 uv)
 
                             
 
-                            densityVal *= radialFalloff;
+                            densityVal *= radialFalloff * cloud.densityScale;
                             
                             float densityFactor = 1.0f;
 
@@ -633,6 +1302,9 @@ float4 RayMarchOctree(float2 uv)
 
                             float transmittanceDecay = exp(-extinctionCoefficient * densityVal * stepSize);
                             float alpha = 1.0f - transmittanceDecay;
+                            if (alpha > 0.0f) {
+                                firstHitDistance = min(firstHitDistance, distanceTraveled);
+                            }
 
                             //float alpha = 1.0f - exp(-extinctionCoefficient * densityVal * stepSize);
 
@@ -653,50 +1325,13 @@ float4 RayMarchOctree(float2 uv)
                            // float powder = hg * densityVal;
                             //float powder = PowderEffect(rayDir, DirectionToSun, .1f);
 
-                                   // --- Begin Voxel Shadow Map PCF Sampling ---
-                           // Transform the current ray position into light space
-                           float4 lightPos = mul(LightViewProj, float4(rayPos, 1.0f));
-                           float depthInLight = lightPos.z / lightPos.w;
-                           float2 lightNDC = lightPos.xy / lightPos.w;
-                           float2 voxelShadowUV = 0.5 * lightNDC + 0.5;
-                           // Flip Y if needed
-                           voxelShadowUV.y = 1.0 - voxelShadowUV.y;
-                          
-                           // Define texel size for PCF sampling (adjust to your voxel shadow map resolution)
-                           float2 texelSize = 1.0 / float2(1381, 690);
-
-                           float voxelShadowSum = 0.0f;
-                           int pcfSamples = 0;  // 4x4 PCF
-                           for (int x = -1; x <= 1; x++) {
-                               for (int y = -1; y <= 1; y++) {
-                                   float2 offset = texelSize * float2(x, y); 
-                                   float2 sampleUV = voxelShadowUV + offset;
-                           
-                                   float4 voxelData = voxelShadowMap.SampleLevel(samplerState, sampleUV, 0.0f);
-                                   float sampleVoxelShadow = 1.0f;
-                           
-                                   if (depthInLight < voxelData.r) {
-                                       sampleVoxelShadow = 1.0f;  // Fully lit
-                                   } else if (depthInLight > voxelData.b) {
-                                       sampleVoxelShadow = 1.0f - voxelData.g;  // Fully shadowed
-                                   } else {
-                                       float t = saturate((depthInLight - voxelData.r) / (voxelData.b - voxelData.r));
-                                       sampleVoxelShadow = lerp(1.0f, 1.0f - voxelData.g, t);
-                                   }
-                                   pcfSamples++;
-                                   voxelShadowSum += sampleVoxelShadow;
-                               }
-                           }
-                           
-                           // Average the PCF samples
-                           float voxelShadowFactor = shadowFactorMin + (voxelShadowSum / (pcfSamples) * 1.f);
+                           // Self-shadowing from the cloud's sun transmittance volume, the voxel shadow map's 3x3 PCF without one
+                           float voxelShadowFactor = shadowFactorMin + SampleSunLight(closestCloudIndex, rayPos);
 
                            float powder = PowderEffect(rayDir, -DirectionToSun, powderBias);
                             
                             float hg = HenyeyGreensteinPhaseFunction(rayDir, -DirectionToSun, anisotropyG);
-                           
-                           //float voxelShadowFactor = voxelShadowSum;
-                            // --- End Voxel Shadow Map PCF Sampling ---
+
 
 
                             //front-to-back accumulation
@@ -721,6 +1356,7 @@ float4 RayMarchOctree(float2 uv)
 
                             if (transmittance.r < 0.01f) {
                                 finalColor.a = 1.0f;
+                                costTerminationDistance = distanceTraveled;
                                 return finalColor;
                             }
                         }
@@ -924,6 +1560,51 @@ float4 RayMarchOctree(float2 uv)
 //[numthreads(16, 16, 1)]
 void ComputeMain(uint3 dtid : SV_DispatchThreadID)
 {
+    // Amortized: outputTexture is the low-res target, one texel per block, marched through this frame's phase pixel
+    TemporalReprojection temporal = temporalReprojection[0];
+    if (temporal.blockSize > 1) {
+        uint lowWidth, lowHeight;
+        outputTexture.GetDimensions(lowWidth, lowHeight);
+        if (dtid.x >= lowWidth || dtid.y >= lowHeight) {
+            return;
+        }
+
+        uint2 samplePixel = min(dtid.xy * temporal.blockSize + uint2(temporal.phase), uint2(temporal.outputSize) - 1);
+        float2 sampleUV = (float2(samplePixel) / float2(temporal.outputSize)) * 2.0f - 1.0f;
+        float sceneDepth = FindSceneDepth(CameraPosition, ComputeRayDirection(sampleUV), 500.0f);
+        float firstHitDistance;
+        if (USE_DELTA_TRACKING) {
+            outputTexture[dtid.xy] = ApplyCostView(DeltaTrackOctree(sampleUV, samplePixel, sceneDepth, firstHitDistance));
+        } else {
+            outputTexture[dtid.xy] = ApplyCostView(RayMarchOctree(sampleUV, samplePixel, sceneDepth, firstHitDistance));
+        }
+        return;
+    }
+
+    // Bilateral upsampling: outputTexture is a low-res atlas, colors in the top half and depths in the bottom half
+    // (x = first cloud hit clamped to the scene, y = scene depth), which CloudUpsampleShader resolves to full res
+    CloudUpsample upsample = cloudUpsample[0];
+    if (upsample.factor > 1) {
+        uint lowWidth, atlasHeight;
+        outputTexture.GetDimensions(lowWidth, atlasHeight);
+        uint lowHeight = atlasHeight / 2;
+        if (dtid.x >= lowWidth || dtid.y >= lowHeight) {
+            return;
+        }
+
+        uint2 samplePixel = min(dtid.xy * upsample.factor + upsample.factor / 2, uint2(upsample.outputSize) - 1);
+        float2 sampleUV = (float2(samplePixel) / float2(upsample.outputSize)) * 2.0f - 1.0f;
+        float sceneDepth = FindSceneDepth(CameraPosition, ComputeRayDirection(sampleUV), upsample.maxDistance);
+        float firstHitDistance;
+        if (USE_DELTA_TRACKING) {
+            outputTexture[dtid.xy] = ApplyCostView(DeltaTrackOctree(sampleUV, samplePixel, sceneDepth, firstHitDistance));
+        } else {
+            outputTexture[dtid.xy] = ApplyCostView(RayMarchOctree(sampleUV, samplePixel, sceneDepth, firstHitDistance));
+        }
+        outputTexture[uint2(dtid.x, dtid.y + lowHeight)] = float4(firstHitDistance, sceneDepth, 0.0f, 0.0f);
+        return;
+    }
+
     // 1) Get full-resolution dimensions
     uint fullWidth, fullHeight;
     outputTexture.GetDimensions(fullWidth, fullHeight);
@@ -953,7 +1634,15 @@ void ComputeMain(uint3 dtid : SV_DispatchThreadID)
     // 5) Call your existing RayMarch(uv) to get a color
     //float4 color = RayMarch(uv);
         
-    float4 color = RayMarchOctree(uv);
+    float sceneDepth = FindSceneDepth(CameraPosition, ComputeRayDirection(uv), 500.0f);
+    float firstHitDistance;
+    float4 color;
+    if (USE_DELTA_TRACKING) {
+        color = DeltaTrackOctree(uv, dtid.xy, sceneDepth, firstHitDistance);
+    } else {
+        color = RayMarchOctree(uv, dtid.xy, sceneDepth, firstHitDistance);
+    }
+    color = ApplyCostView(color);
 
     // 6) Write that color to the 2x2 block: (baseCoord.x .. baseCoord.x+1, baseCoord.y .. baseCoord.y+1)
     [unroll]
@@ -6,6 +6,8 @@ struct Voxel {
     float temperature;
 };
 
+// One placed instance of a prototype (must match CloudGPU in Cloud.hpp). Its voxels and octree are shared with
+// the other instances and in prototype space: world = position + prototype * scale. The bounds are world space.
 struct Cloud {
     float3 position;
     int3 gridDimensions;
@@ -14,6 +16,10 @@ struct Cloud {
     unsigned int voxelOffset;
     unsigned int voxelCount;
     unsigned int octreeOffset;
+    float scale;
+    float densityScale;
+    float3 noiseOffset;
+    unsigned int prototypeIndex;
 };
 
 struct OctreeNode
@@ -21,6 +27,7 @@ struct OctreeNode
     float3 minBounds;
     float3 maxBounds;
     float densitySum;             // Aggregate density
+    float densityMax;             // Majorant: densest voxel under this node (delta tracking)
     unsigned int firstChildIndex; // Index of the first child (-1 if leaf)
     unsigned int numChildren;     // Number of children (0 if leaf)
     unsigned int firstVoxelIndex; // Index of the first voxel (-1 if none)
@@ -28,6 +35,38 @@ struct OctreeNode
     unsigned int depth;           // Depth of this node
 };
 
+// Per-frame values (CloudFrameGPU), kept out of CloudConstants so that block is only re-sent after an edit
+struct CloudFrame
+{
+    float  timeElapsed;
+    float3 padding;
+};
+
+struct RayJitter
+{
+    int    textureSize;
+    int2   offset;
+    float  rotation;
+    float  strength;
+    float3 padding;
+};
+
+// Depth range the opacity series covers, in light depth / maxDistance (CloudOpacityShadowMapGPU)
+struct OpacityShadowMap
+{
+    float  depthMin;
+    float  depthMax;
+    float2 padding;
+};
+
+// One mip level of a baked noise volume (must match NoiseVolumeLevelGPU in CloudNoiseVolumes.hpp). Perlin and
+// Worley have the same size, so one table describes both.
+struct NoiseVolumeLevel
+{
+    int  firstTexel;
+    int3 size;
+};
+
 // Constant buffers
 cbuffer LightConstants : register(b1) {
     float3 SunDirection;
@@ -47,7 +86,7 @@ cbuffer CameraConstants : register(b2) {
 cbuffer CloudConstants : register(b6) {
     int numClouds;
     int numOctrees;
-    float timeElapsed;
+    float unusedTimeElapsed;  // cloudFrame[0].timeElapsed instead; kept for CloudConstants' layout
     int useDensity;
 
     int useNoise;
@@ -70,9 +109,16 @@ cbuffer CloudConstants : register(b6) {
 // Resources
 StructuredBuffer<Cloud>         clouds              : register(t0);
 StructuredBuffer<Voxel>         voxels              : register(t1);
-Texture3D<float>                perlinNoiseTexture  : register(t2);
-Texture3D<float>                worleyNoiseTexture  : register(t3);
+StructuredBuffer<float>         perlinNoise         : register(t2);    // Every mip level back to back, see noiseVolumeLevels
+StructuredBuffer<float>         worleyNoise         : register(t3);
 StructuredBuffer<OctreeNode>    octreeNodes         : register(t4);
+StructuredBuffer<float3>        windField           : register(t6);
+StructuredBuffer<float>         blueNoise           : register(t7);
+StructuredBuffer<RayJitter>     rayJitter           : register(t8);
+StructuredBuffer<NoiseVolumeLevel> noiseVolumeLevels : register(t10);
+StructuredBuffer<OpacityShadowMap> opacityShadowMap : register(t16);
+StructuredBuffer<uint>          visibleClouds       : register(t17);    // Count, then the clouds inside the light frustum
+StructuredBuffer<CloudFrame>    cloudFrame          : register(t19);
 SamplerState                    samplerState        : register(s0);
 RWTexture2D<float4>             outputTexture       : register(u0);
 
@@ -82,6 +128,21 @@ RWTexture2D<float4>             outputTexture       : register(u0);
 
 
 // Helper functions
+static const float TWO_PI = 6.28318530718f;
+
+// Fourier opacity map: the extinction along each light ray as a series over the normalized depth d in [0,1],
+// a_k = 2 sum(tau cos(2 pi k d)), b_k = 2 sum(tau sin(2 pi k d)) for k = 0..3. Linear in the extinction, so the
+// consumers can filter it. Packed as (first depth, a0, a1, b1) in the top half, (a2, b2, a3, b3) in the bottom.
+// Mirrors CloudOpacityShadowMap::AccumulateOpticalDepth on the CPU.
+void AccumulateOpacity(inout float4 opacityLow, inout float4 opacityHigh, float opticalDepth, float normalizedDepth)
+{
+    float3 angles = TWO_PI * float3(1.0f, 2.0f, 3.0f) * normalizedDepth;
+    float3 cosines = 2.0f * opticalDepth * cos(angles);
+    float3 sines = 2.0f * opticalDepth * sin(angles);
+    opacityLow.yzw += float3(2.0f * opticalDepth, cosines.x, sines.x);
+    opacityHigh += float4(cosines.y, sines.y, cosines.z, sines.z);
+}
+
 float ApplyBeersLaw(float density, float distance) {
     return exp(-extinctionCoefficient * density * distance);
 }
@@ -100,6 +161,108 @@ float BoxSDF(float3 p, float3 voxelPos, float3 boxSize) {
 //the value returned will be positive if the point is outside the box, negative if inside, and zero if on the surface
 }
 
+// Instances share their prototype's octree and voxels, which are in its space (see CloudShader.hlsl)
+float3 ToPrototypeSpace(Cloud cloud, float3 worldPos) {
+    return (worldPos - cloud.position) / cloud.scale;
+}
+
+// Analytic slab test. x = entry distance (clamped to the origin), y = exit distance; a miss has x > y.
+float2 IntersectAABB(float3 rayOrigin, float3 invRayDir, float3 minBounds, float3 maxBounds)
+{
+    float3 t1 = (minBounds - rayOrigin) * invRayDir;
+    float3 t2 = (maxBounds - rayOrigin) * invRayDir;
+    float3 tMin3 = min(t1, t2);
+    float3 tMax3 = max(t1, t2);
+    float tEnter = max(max(tMin3.x, tMin3.y), max(tMin3.z, 0.0f));
+    float tExit = min(tMax3.x, min(tMax3.y, tMax3.z));
+    return float2(tEnter, tExit);
+}
+
+// Clouds the ray passes through, as [tEnter, tExit] intervals sorted by entry, kept short like CloudShader's
+static const int MAX_CLOUD_INTERVALS = 16;
+
+struct CloudInterval
+{
+    float tEnter;
+    float tExit;
+    int   cloudIndex;
+};
+
+// Clouds the ray has left by minDistance are skipped; refillDistance is where to rebuild (CloudShader's BuildCloudIntervals)
+int BuildCloudIntervals(float3 rayOrigin, float3 rayDir, float minDistance, float maxDistance, out CloudInterval intervals[MAX_CLOUD_INTERVALS],
+                        out float refillDistance)
+{
+    float3 invRayDir = 1.0f / rayDir;
+    int numIntervals = 0;
+    bool isOverflowing = false;
+
+    // Only the clouds CloudManager found inside the light frustum
+    int numCandidates = (int)visibleClouds[0];
+    for (int candidate = 0; candidate < numCandidates; candidate++) {
+        int ci = (int)visibleClouds[candidate + 1];
+        float2 t = IntersectAABB(rayOrigin, invRayDir, clouds[ci].minBounds, clouds[ci].maxBounds);
+        if (t.x > t.y || t.x >= maxDistance || t.y < minDistance) {
+            continue;
+        }
+
+        // Insertion sort; past capacity the farthest entry is dropped
+        int slot = min(numIntervals, MAX_CLOUD_INTERVALS - 1);
+        isOverflowing = isOverflowing || numIntervals == MAX_CLOUD_INTERVALS;
+        if (numIntervals == MAX_CLOUD_INTERVALS && t.x >= intervals[slot].tEnter) {
+            continue;
+        }
+        while (slot > 0 && intervals[slot - 1].tEnter > t.x) {
+            intervals[slot] = intervals[slot - 1];
+            slot--;
+        }
+        intervals[slot].tEnter = t.x;
+        intervals[slot].tExit = t.y;
+        intervals[slot].cloudIndex = ci;
+        numIntervals = min(numIntervals + 1, MAX_CLOUD_INTERVALS);
+    }
+
+    refillDistance = 100000.0f;
+    if (isOverflowing) {
+        refillDistance = intervals[MAX_CLOUD_INTERVALS - 1].tEnter;
+        if (refillDistance <= minDistance) {
+            refillDistance = 100000.0f;
+            for (int k = 0; k < MAX_CLOUD_INTERVALS; k++) {
+                refillDistance = min(refillDistance, intervals[k].tExit);
+            }
+        }
+    }
+    return numIntervals;
+}
+
+// Nearest cloud among the intervals the ray is in (or within 0.1 of entering), by BoxSDF as before.
+// Outside every interval the distance is the gap to the next entry plus entryOffset, so the step jumps straight
+// there and lands the ray's start jitter inside the cloud; after the last exit it is 100000 and the march ends.
+void FindClosestCloudInterval(float3 rayPos, float distanceTraveled, float entryOffset, CloudInterval intervals[MAX_CLOUD_INTERVALS], int numIntervals,
+                              out float minDistCloud, out int closestCloudIndex)
+{
+    minDistCloud = 100000;
+    closestCloudIndex = -1;
+
+    for (int k = 0; k < numIntervals; k++) {
+        if (intervals[k].tEnter > distanceTraveled + 0.1f) {
+            if (closestCloudIndex < 0) {
+                minDistCloud = intervals[k].tEnter + entryOffset - distanceTraveled;
+            }
+            break;
+        }
+        if (intervals[k].tExit < distanceTraveled) {
+            continue;
+        }
+
+        Cloud c = clouds[intervals[k].cloudIndex];
+        float distToCloud = BoxSDF(rayPos, 0.5f*(c.minBounds + c.maxBounds), 0.5f*(c.maxBounds - c.minBounds));
+        if (distToCloud < minDistCloud) {
+            minDistCloud      = distToCloud;
+            closestCloudIndex = intervals[k].cloudIndex;
+        }
+    }
+}
+
 int RaycastVsAABB3D(float3 rayOrigin, float3 rayDir, float3 minBounds, float3 maxBounds, float MaxDist) {
     float3 invDir = 1.0f / rayDir;
     float3 t0s = (minBounds - rayOrigin) * invDir;
@@ -155,20 +318,91 @@ float3 ComputeRayPosition(float2 uv)
     return  rayOrigin;
 }
 
+// Curl-noise wind volume baked on the CPU (CurlNoiseField), WIND_FIELD_SIZE^3 texels, x fastest
+static const int WIND_FIELD_SIZE = 32;
+
+float3 GetWindTexel(int3 texel) {
+    texel = ((texel % WIND_FIELD_SIZE) + WIND_FIELD_SIZE) % WIND_FIELD_SIZE;
+    return windField[(texel.z * WIND_FIELD_SIZE + texel.y) * WIND_FIELD_SIZE + texel.x];
+}
+
+// Trilinear with wrapping, texel centers at (i + 0.5) / WIND_FIELD_SIZE (CurlNoiseField::SampleVelocity)
+float3 SampleWindField(float3 uvw) {
+    float3 local = frac(uvw) * WIND_FIELD_SIZE - 0.5f;
+    int3 texel0 = int3(floor(local));
+    int3 texel1 = texel0 + 1;
+    float3 blend = local - float3(texel0);
+
+    float3 c00 = lerp(GetWindTexel(int3(texel0.x, texel0.y, texel0.z)), GetWindTexel(int3(texel1.x, texel0.y, texel0.z)), blend.x);
+    float3 c10 = lerp(GetWindTexel(int3(texel0.x, texel1.y, texel0.z)), GetWindTexel(int3(texel1.x, texel1.y, texel0.z)), blend.x);
+    float3 c01 = lerp(GetWindTexel(int3(texel0.x, texel0.y, texel1.z)), GetWindTexel(int3(texel1.x, texel0.y, texel1.z)), blend.x);
+    float3 c11 = lerp(GetWindTexel(int3(texel0.x, texel1.y, texel1.z)), GetWindTexel(int3(texel1.x, texel1.y, texel1.z)), blend.x);
+    return lerp(lerp(c00, c10, blend.y), lerp(c01, c11, blend.y), blend.z);
+}
+
+// Blue-noise ray-start jitter (BlueNoiseTexture), returns a fraction of a step rotated every frame
+float SampleRayJitter(uint2 pixel) {
+    RayJitter params = rayJitter[0];
+    uint2 texel = (pixel + uint2(params.offset)) % uint(params.textureSize);
+    return frac(blueNoise[texel.y * params.textureSize + texel.x] + params.rotation) * params.strength;
+}
+
+float GetNoiseTexel(StructuredBuffer<float> volume, NoiseVolumeLevel level, int3 texel) {
+    texel = ((texel % level.size) + level.size) % level.size;
+    return volume[level.firstTexel + (texel.z * level.size.y + texel.y) * level.size.x + texel.x];
+}
+
+// Trilinear with wrapping inside one level, texel centers at (i + 0.5) / size (VolumeMipChain::SampleTrilinear)
+float SampleNoiseVolumeLevel(StructuredBuffer<float> volume, NoiseVolumeLevel level, float3 uvw) {
+    float3 local = uvw * float3(level.size) - 0.5f;
+    int3 texel0 = int3(floor(local));
+    int3 texel1 = texel0 + 1;
+    float3 blend = local - float3(texel0);
+
+    float c00 = lerp(GetNoiseTexel(volume, level, int3(texel0.x, texel0.y, texel0.z)), GetNoiseTexel(volume, level, int3(texel1.x, texel0.y, texel0.z)), blend.x);
+    float c10 = lerp(GetNoiseTexel(volume, level, int3(texel0.x, texel1.y, texel0.z)), GetNoiseTexel(volume, level, int3(texel1.x, texel1.y, texel0.z)), blend.x);
+    float c01 = lerp(GetNoiseTexel(volume, level, int3(texel0.x, texel0.y, texel1.z)), GetNoiseTexel(volume, level, int3(texel1.x, texel0.y, texel1.z)), blend.x);
+    float c11 = lerp(GetNoiseTexel(volume, level, int3(texel0.x, texel1.y, texel1.z)), GetNoiseTexel(volume, level, int3(texel1.x, texel1.y, texel1.z)), blend.x);
+    return lerp(lerp(c00, c10, blend.y), lerp(c01, c11, blend.y), blend.z);
+}
+
+// Linear between the two levels around lod, like SampleLevel on a mipped Texture3D (VolumeMipChain::SampleLevel);
+// a whole lod reads one level
+float SampleNoiseVolume(StructuredBuffer<float> volume, float3 uvw, float lod) {
+    uint numLevels, stride;
+    noiseVolumeLevels.GetDimensions(numLevels, stride);
+    lod = clamp(lod, 0.0f, float(numLevels - 1));
+
+    int level0 = int(lod);
+    float blend = lod - float(level0);
+    float sample0 = SampleNoiseVolumeLevel(volume, noiseVolumeLevels[level0], uvw);
+    if (blend <= 0.0f || level0 + 1 >= int(numLevels)) {
+        return sample0;
+    }
+    return lerp(sample0, SampleNoiseVolumeLevel(volume, noiseVolumeLevels[level0 + 1], uvw), blend);
+}
+
 // Sampling Perlin noise for voxel density
 float SampleNoise(float3 rayPos) {
     float scale = 1.0f / voxelDimensions;
     float scrollFactor = 2.0f;
+    float timeElapsed = cloudFrame[0].timeElapsed;
 
     // Apply scrolling movement to the noise coordinates
     float3 noiseCoords = rayPos * scale + float3(timeElapsed * 0.1, -timeElapsed * 0.05, -timeElapsed * 0.01) * scrollFactor;
+    float3 worleyCoords = noiseCoords;
     if (scrolling == 0) {
         noiseCoords = rayPos * scale;
     }
+    else {
+        // Same world-space wind warp as CloudShader so shadows follow the rendered clouds: Worley lookups only
+        float3 wind = SampleWindField(rayPos * scale);
+        worleyCoords = frac(worleyCoords + wind * scrollFactor * 0.1f);
+    }
 
     // Sample base Perlin and Worley noise
-    float perlinVal = perlinNoiseTexture.SampleLevel(samplerState, noiseCoords, 0).r;
-    float worleyBase = worleyNoiseTexture.SampleLevel(samplerState, noiseCoords, 0).r;
+    float perlinVal = SampleNoiseVolume(perlinNoise, noiseCoords, 0.0f);
+    float worleyBase = SampleNoiseVolume(worleyNoise, worleyCoords, 0.0f);
     
     // Threshold the base Worley noise to create initial structure
     if (worleyBase <= 0.5f) {
@@ -177,14 +411,14 @@ float SampleNoise(float3 rayPos) {
 
     // Detail octave: higher frequency Worley noise for fine textures
     float detailFrequency = 2.0f; // Increase frequency for finer details
-    float worleyDetail = worleyNoiseTexture.SampleLevel(samplerState, noiseCoords * detailFrequency, 0).r;
+    float worleyDetail = SampleNoiseVolume(worleyNoise, worleyCoords * detailFrequency, 0.0f);
     if (worleyDetail <= 0.5f) {
         worleyDetail = 0.0f;
     }
     
     // Mask octave: lower frequency Worley noise to control where detail appears
     float maskFrequency = 1.0f; // Lower frequency for large-scale structure
-    float worleyMaskVal = worleyNoiseTexture.SampleLevel(samplerState, noiseCoords * maskFrequency, 0).r;
+    float worleyMaskVal = SampleNoiseVolume(worleyNoise, noiseCoords * maskFrequency, 0.0f);
     float detailMask = smoothstep(0.4f, 0.6f, worleyMaskVal);
     
     // Blend base and detail Worley noise using the mask
@@ -374,7 +608,7 @@ float ComputeLightingWithShadows(Voxel rayVoxel, float3 rayPosition, float3 sunD
 }
 
 // Ray marching function with octree traversal
-float4 RayMarchOctree(float2 uv)
+float4 RayMarchOctree(float2 uv, uint2 jitterPixel, out float4 opacityHigh)
 {
     float3 rayPos           = ComputeRayPosition(uv);
     float3 rayDir           = ComputeRayDirection(uv);
@@ -387,6 +621,12 @@ float4 RayMarchOctree(float2 uv)
     float minStep = 0.05f * voxelDimensions.x;
     float minDist = 0.02f;
 
+    // Start each ray a blue-noise fraction of a step in, so undersampling shows as fine noise instead of banding.
+    // Jumps over empty space keep the same offset past each cloud entry.
+    float rayJitter = SampleRayJitter(jitterPixel) * minStep;
+    distanceTraveled = rayJitter;
+    rayPos += rayDir * distanceTraveled;
+
     float startDist = maxDistance;
     float endDist = 0.0f;
 
@@ -394,26 +634,29 @@ float4 RayMarchOctree(float2 uv)
 
     float aniostropyG = 0.5f;
 
-    
+    OpacityShadowMap opacityRange = opacityShadowMap[0];
+    float opacityDepthScale = 1.0f / (opacityRange.depthMax - opacityRange.depthMin);
+    float4 opacityLow = float4(0.0f, 0.0f, 0.0f, 0.0f);
+    opacityHigh = float4(0.0f, 0.0f, 0.0f, 0.0f);
+
+    // Slab-test every cloud once up front instead of sphere-tracing BoxSDF through empty space
+    float3 rayOrigin = rayPos - rayDir * distanceTraveled;
+    CloudInterval cloudIntervals[MAX_CLOUD_INTERVALS];
+    float refillDistance;
+    int numCloudIntervals = BuildCloudIntervals(rayOrigin, rayDir, 0.0f, maxDistance, cloudIntervals, refillDistance);
 
     while (distanceTraveled < maxDistance)
     {
+        if (distanceTraveled >= refillDistance) {
+            numCloudIntervals = BuildCloudIntervals(rayOrigin, rayDir, distanceTraveled, maxDistance, cloudIntervals, refillDistance);
+        }
+
         //--------------------------------------------------
         // 1) Check which cloud bounding box is nearest
         //--------------------------------------------------
-        float minDistCloud = 100000;
-        int   closestCloudIndex = -1;
-
-        for (int ci = 0; ci < numClouds; ci++) {
-            Cloud c = clouds[ci];
-            float distToCloud = BoxSDF(rayPos,
-                                       0.5f*(c.minBounds + c.maxBounds),
-                                       0.5f*(c.maxBounds - c.minBounds));
-            if (distToCloud < minDistCloud) {
-                minDistCloud      = distToCloud;
-                closestCloudIndex = ci;
-            }
-        }
+        float minDistCloud;
+        int   closestCloudIndex;
+        FindClosestCloudInterval(rayPos, distanceTraveled, rayJitter, cloudIntervals, numCloudIntervals, minDistCloud, closestCloudIndex);
 
 
         //--------------------------------------------------
@@ -447,8 +690,10 @@ float4 RayMarchOctree(float2 uv)
             float minSDF = 100000.0f;
             uint  closestNodeIndex = 0xFFFFFFFF;
 
-            // Assuming cloud.octreeOffset is the root node for this cloud
-            TraverseOctree(cloud.octreeOffset, rayPos, rayDir, minSDF, closestNodeIndex);
+            // Assuming cloud.octreeOffset is the root node for this cloud; it is shared with the prototype's other instances
+            float3 prototypePos = ToPrototypeSpace(cloud, rayPos);
+            TraverseOctree(cloud.octreeOffset, prototypePos, rayDir, minSDF, closestNodeIndex);
+            minSDF *= cloud.scale;
 
             //---------------------------------------------
             // 4) If we are close enough to that node, process it
@@ -465,13 +710,13 @@ float4 RayMarchOctree(float2 uv)
                         Voxel voxel = voxels[voxelIdx];
 
                         // Check if inside the voxel
-                        float distToVoxel = BoxSDF(rayPos, voxel.position, voxelDimensions * .5f);
+                        float distToVoxel = BoxSDF(prototypePos, voxel.position, voxelDimensions * .5f) * cloud.scale;
                         if (distToVoxel < minDist) {
                             // If so, accumulate lighting & color, etc.
-                            float noiseVal   = SampleNoise(rayPos);
+                            float noiseVal   = SampleNoise(rayPos + cloud.noiseOffset);
                             float densityVal = AccumulateDensity(voxel, noiseVal);
 
-                            float voxelDist = length(rayPos - voxel.position);
+                            float voxelDist = length(prototypePos - voxel.position);
                             float voxelMaxRadius = length(voxelDimensions * 0.5f);
                             float normalizedVoxelDist = saturate(voxelDist / voxelMaxRadius);
                             
@@ -514,11 +759,14 @@ float4 RayMarchOctree(float2 uv)
                             
                             // Optionally, sharpen the fade:
                             radialFalloff = pow(radialFalloff, 2.0f); // or 3.0f, etc.
+
+                            densityVal *= cloud.densityScale;
                             
                             //Compute alpha via Beer-Lambert: 
 
                             float value = -extinctionCoefficient * densityVal * stepSize;
                             float expVal = exp(value);
+                            AccumulateOpacity(opacityLow, opacityHigh, -value, saturate((distanceTraveled / maxDistance - opacityRange.depthMin) * opacityDepthScale));
                             float alpha = 1.0f - expVal;
 
                             float3 scatterColor = float3(1.0f, 1.0f, 1.0f);
@@ -590,10 +838,11 @@ float4 RayMarchOctree(float2 uv)
 
     //float shadowDistance = endDist - startDist;
 
-    // Return final color
-    finalColor.g   = 1.f - transmittance.r;
+    // First depth stays in r for GodRays.hlsl; the opacity series replaces the accumulated density and last depth
+    //finalColor.g   = 1.f - transmittance.r;
     //finalColor.rgb = saturate(finalColor.rgb);
-    return finalColor;
+    opacityLow.x = finalColor.r;
+    return opacityLow;
 }
 
 // Main compute shader function
@@ -612,9 +861,15 @@ float4 RayMarchOctree(float2 uv)
 //[numthreads(16, 16, 1)]
 void ComputeMain(uint3 dtid : SV_DispatchThreadID)
 {
-    // 1) Get full-resolution dimensions
-    uint fullWidth, fullHeight;
-    outputTexture.GetDimensions(fullWidth, fullHeight);
+    // 1) Get full-resolution dimensions: the output is two map-sized halves over one row for the depth range
+    uint fullWidth, atlasHeight;
+    outputTexture.GetDimensions(fullWidth, atlasHeight);
+    uint fullHeight = (atlasHeight - 1) / 2;
+
+    if (dtid.x == 0 && dtid.y == 0) {
+        OpacityShadowMap opacityRange = opacityShadowMap[0];
+        outputTexture[uint2(0, atlasHeight - 1)] = float4(opacityRange.depthMin, opacityRange.depthMax, 0.0f, 0.0f);
+    }
 
     // 2) The dtid.xy now goes only up to (fullWidth/2, fullHeight/2) if 
     //    you dispatch the job at half resolution from the CPU side.
@@ -649,7 +904,8 @@ void ComputeMain(uint3 dtid : SV_DispatchThreadID)
     //    return;
     //}
 
-    float4 color = RayMarchOctree(uv);
+    float4 opacityHigh;
+    float4 color = RayMarchOctree(uv, dtid.xy, opacityHigh);
 
     // 6) Write that color to the 2x2 block: (baseCoord.x .. baseCoord.x+1, baseCoord.y .. baseCoord.y+1)
     [unroll]
@@ -664,6 +920,7 @@ void ComputeMain(uint3 dtid : SV_DispatchThreadID)
             if (outPixel.x < fullWidth && outPixel.y < fullHeight)
             {
                 outputTexture[outPixel] = color;
+                outputTexture[outPixel + uint2(0, fullHeight)] = opacityHigh;
             }
         }
     }
@@ -0,0 +1,138 @@
+// Temporal reconstruction for the amortized cloud pass. CloudShader marched one pixel of each block into the
+// low-res texture; every other pixel reprojects last frame's output through the cloud depth and clamps it to
+// the 3x3 neighbourhood of fresh samples. Mirrors CloudTemporalReprojector on the CPU.
+
+// Must match CloudGPU in Cloud.hpp
+struct Cloud {
+    float3 position;
+    int3 gridDimensions;
+    float3 minBounds;
+    float3 maxBounds;
+    unsigned int voxelOffset;
+    unsigned int voxelCount;
+    unsigned int octreeOffset;
+    float scale;
+    float densityScale;
+    float3 noiseOffset;
+    unsigned int prototypeIndex;
+};
+
+struct TemporalReprojection
+{
+    float4x4 previousViewProjection;
+    float3   cloudDrift;
+    int      blockSize;
+    int2     phase;
+    int      historyValid;
+    int2     outputSize;
+    float3   padding;
+};
+
+cbuffer CameraConstants : register(b2) {
+    float4x4 ViewMatrix;
+    float4x4 ProjectionMatrix;
+    float4x4 InverseViewMatrix;
+    float4x4 InverseProjMatrix;
+    float3 CameraPosition;
+    float2 NearScreenSize;
+};
+
+// Only the leading members are needed
+cbuffer CloudConstants : register(b6) {
+    int     numClouds;
+    int     numOctrees;
+    float   unusedTimeElapsed;  // CloudFrameGPU carries the time; kept for CloudConstants' layout
+};
+
+StructuredBuffer<Cloud>                 clouds               : register(t0);
+StructuredBuffer<TemporalReprojection>  temporalReprojection : register(t9);
+Texture2D<float4>                       cloudLowRes          : register(t10);
+Texture2D<float4>                       cloudHistory         : register(t11);
+StructuredBuffer<uint>                  visibleClouds        : register(t17);   // Count, then the clouds inside the camera frustum
+SamplerState                            samplerState         : register(s0);
+RWTexture2D<float4>                     outputTexture        : register(u0);
+
+float3 ComputeRayDirection(float2 uv) {
+    float2 ndc = uv;
+    ndc.y = -ndc.y;
+    float4 rayStart = mul(InverseProjMatrix, float4(ndc, 0.0, 1.0));
+    rayStart /= rayStart.w;
+    float3 worldDir = mul(InverseViewMatrix, float4(rayStart.xyz, 0.0)).xyz;
+    return normalize(worldDir);
+}
+
+// Entry distance of the first cloud box along the ray, maxDistance when it misses them all
+float FindReprojectionDepth(float3 rayOrigin, float3 rayDir, float maxDistance)
+{
+    float3 invRayDir = 1.0f / rayDir;
+    float depth = maxDistance;
+    int numCandidates = (int)visibleClouds[0];
+    for (int candidate = 0; candidate < numCandidates; candidate++) {
+        int ci = (int)visibleClouds[candidate + 1];
+        float3 t1 = (clouds[ci].minBounds - rayOrigin) * invRayDir;
+        float3 t2 = (clouds[ci].maxBounds - rayOrigin) * invRayDir;
+        float3 tMin3 = min(t1, t2);
+        float3 tMax3 = max(t1, t2);
+        float tEnter = max(max(tMin3.x, tMin3.y), max(tMin3.z, 0.0f));
+        float tExit = min(tMax3.x, min(tMax3.y, tMax3.z));
+        if (tEnter <= tExit) {
+            depth = min(depth, tEnter);
+        }
+    }
+    return depth;
+}
+
+[numthreads(16, 8, 1)]
+void ComputeMain(uint3 dtid : SV_DispatchThreadID)
+{
+    TemporalReprojection temporal = temporalReprojection[0];
+    int2 outputSize = temporal.outputSize;
+    int2 pixel = int2(dtid.xy);
+    if (pixel.x >= outputSize.x || pixel.y >= outputSize.y) {
+        return;
+    }
+
+    int2 lowSize;
+    cloudLowRes.GetDimensions(lowSize.x, lowSize.y);
+    int2 block = min(pixel / temporal.blockSize, lowSize - 1);
+    float4 fresh = cloudLowRes[block];
+
+    if (temporal.historyValid == 0 || all(pixel % temporal.blockSize == temporal.phase)) {
+        outputTexture[pixel] = fresh;
+        return;
+    }
+
+    // Same uv convention as CloudShader's ComputeMain
+    float2 uv = (float2(pixel) / float2(outputSize)) * 2.0f - 1.0f;
+    float3 rayDir = ComputeRayDirection(uv);
+    float3 worldPos = CameraPosition + rayDir * FindReprojectionDepth(CameraPosition, rayDir, 500.0f);
+
+    float4 previousClip = mul(temporal.previousViewProjection, float4(worldPos - temporal.cloudDrift, 1.0f));
+    float2 previousUV = 0.5f * (previousClip.xy / previousClip.w) + 0.5f;
+    previousUV.y = 1.0f - previousUV.y;
+    float2 historyPixel = previousUV * float2(outputSize);
+
+    if (previousClip.w <= 0.0f || any(historyPixel < 0.0f) || any(historyPixel > float2(outputSize - 1))) {
+        outputTexture[pixel] = fresh;
+        return;
+    }
+
+    // Neighbourhood clamp against the fresh rays of the 3x3 surrounding blocks
+    float4 minColor = fresh;
+    float4 maxColor = fresh;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            int2 neighbour = block + int2(x, y);
+            if (any(neighbour < 0) || any(neighbour >= lowSize)) {
+                continue;
+            }
+            float4 neighbourColor = cloudLowRes[neighbour];
+            minColor = min(minColor, neighbourColor);
+            maxColor = max(maxColor, neighbourColor);
+        }
+    }
+
+    // Bilinear fetch at the texel centers the history was written to
+    float4 history = cloudHistory.SampleLevel(samplerState, (historyPixel + 0.5f) / float2(outputSize), 0.0f);
+    outputTexture[pixel] = clamp(history, minColor, maxColor);
+}
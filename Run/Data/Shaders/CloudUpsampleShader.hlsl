@@ -0,0 +1,121 @@
+// Joint-bilateral upsample for the low-res cloud pass. CloudShader marched the center of each factor x factor block
+// into the top half of the atlas and stored that ray's depths in the bottom half. Each full-res pixel blends its four
+// nearest blocks bilinearly, weighted down when a block saw cloud behind this pixel's scene surface or sits on
+// nearer geometry. Mirrors UpsampleCloudsBilateral on the CPU.
+
+struct CloudUpsample
+{
+    int      factor;
+    int2     outputSize;
+    int      numOccluders;
+    float    depthSigma;
+    float    maxDistance;
+    float2   padding;
+};
+
+struct SceneOccluder
+{
+    float3 center;
+    float3 inverseAxisX;
+    float3 inverseAxisY;
+    float3 inverseAxisZ;
+};
+
+cbuffer CameraConstants : register(b2) {
+    float4x4 ViewMatrix;
+    float4x4 ProjectionMatrix;
+    float4x4 InverseViewMatrix;
+    float4x4 InverseProjMatrix;
+    float3 CameraPosition;
+    float2 NearScreenSize;
+};
+
+Texture2D<float4>                       cloudLowRes          : register(t10);
+StructuredBuffer<CloudUpsample>         cloudUpsample        : register(t12);
+StructuredBuffer<SceneOccluder>         sceneOccluders       : register(t13);
+RWTexture2D<float4>                     outputTexture        : register(u0);
+
+float3 ComputeRayDirection(float2 uv) {
+    float2 ndc = uv;
+    ndc.y = -ndc.y;
+    float4 rayStart = mul(InverseProjMatrix, float4(ndc, 0.0, 1.0));
+    rayStart /= rayStart.w;
+    float3 worldDir = mul(InverseViewMatrix, float4(rayStart.xyz, 0.0)).xyz;
+    return normalize(worldDir);
+}
+
+// Same as CloudShader's FindSceneDepth
+float FindSceneDepth(float3 rayOrigin, float3 rayDir, float maxDistance, int numOccluders)
+{
+    float depth = maxDistance;
+    for (int occluderIndex = 0; occluderIndex < numOccluders; occluderIndex++) {
+        SceneOccluder occluder = sceneOccluders[occluderIndex];
+        float3 localOrigin = float3(dot(rayOrigin - occluder.center, occluder.inverseAxisX), dot(rayOrigin - occluder.center, occluder.inverseAxisY), dot(rayOrigin - occluder.center, occluder.inverseAxisZ));
+        float3 invLocalDir = 1.0f / float3(dot(rayDir, occluder.inverseAxisX), dot(rayDir, occluder.inverseAxisY), dot(rayDir, occluder.inverseAxisZ));
+        float3 t1 = (-0.5f - localOrigin) * invLocalDir;
+        float3 t2 = (0.5f - localOrigin) * invLocalDir;
+        float3 tMin3 = min(t1, t2);
+        float3 tMax3 = max(t1, t2);
+        float tEnter = max(max(tMin3.x, tMin3.y), max(tMin3.z, 0.0f));
+        float tExit = min(tMax3.x, min(tMax3.y, tMax3.z));
+        if (tEnter <= tExit) {
+            depth = min(depth, tEnter);
+        }
+    }
+    return depth;
+}
+
+[numthreads(16, 8, 1)]
+void ComputeMain(uint3 dtid : SV_DispatchThreadID)
+{
+    CloudUpsample upsample = cloudUpsample[0];
+    int2 outputSize = upsample.outputSize;
+    int2 pixel = int2(dtid.xy);
+    if (pixel.x >= outputSize.x || pixel.y >= outputSize.y) {
+        return;
+    }
+
+    int2 atlasSize;
+    cloudLowRes.GetDimensions(atlasSize.x, atlasSize.y);
+    int2 lowSize = int2(atlasSize.x, atlasSize.y / 2);
+
+    float2 uv = (float2(pixel) / float2(outputSize)) * 2.0f - 1.0f;
+    float pixelDepth = FindSceneDepth(CameraPosition, ComputeRayDirection(uv), upsample.maxDistance, upsample.numOccluders);
+
+    // Block b was marched through pixel b * factor + factor / 2
+    float2 lowPosition = (float2(pixel) - float(upsample.factor / 2)) / float(upsample.factor);
+    int2 lowBase = int2(floor(lowPosition));
+    float2 frac = lowPosition - float2(lowBase);
+
+    float4 colorSum = float4(0.0f, 0.0f, 0.0f, 0.0f);
+    float weightSum = 0.0f;
+    float4 nearestColor = float4(0.0f, 0.0f, 0.0f, 0.0f);
+    float nearestPenalty = 1e30f;
+    float depthScale = 1.0f / max(upsample.depthSigma * pixelDepth, 1e-3f);
+
+    for (int y = 0; y <= 1; y++) {
+        for (int x = 0; x <= 1; x++) {
+            int2 tap = clamp(lowBase + int2(x, y), int2(0, 0), lowSize - 1);
+            float4 tapColor = cloudLowRes[tap];
+            float2 tapDepth = cloudLowRes[tap + int2(0, lowSize.y)].xy;
+
+            // x = what the tap saw first (cloud or scene), y = its scene depth
+            float behind = max(tapDepth.x - pixelDepth, 0.0f) * depthScale;
+            float inFront = max(pixelDepth - tapDepth.y, 0.0f) * depthScale;
+            float penalty = behind * behind + inFront * inFront;
+
+            float bilinear = (x == 0 ? 1.0f - frac.x : frac.x) * (y == 0 ? 1.0f - frac.y : frac.y);
+            float weight = (upsample.depthSigma > 0.0f) ? bilinear * exp(-penalty) : bilinear;
+            colorSum += tapColor * weight;
+            weightSum += weight;
+
+            if (penalty < nearestPenalty) {
+                nearestPenalty = penalty;
+                nearestColor = tapColor;
+            }
+        }
+    }
+
+    // Every tap disagrees with this pixel's depth: fall back to the closest match
+    outputTexture[pixel] = (weightSum > 1e-4f) ? colorSum / weightSum : nearestColor;
+}
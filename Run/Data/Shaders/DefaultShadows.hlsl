@@ -63,6 +63,40 @@ v2p_t VertexMain(vs_input_t input)
 	return v2p;
 }
 
+//------------------------------------------------------------------------------------------------
+// Optical depth to normalized depth d from the Fourier opacity series: (first depth, a0, a1, b1) in the top half of
+// the voxel shadow map, (a2, b2, a3, b3) in the bottom half and the depth range in its last row. Same as CloudShader.
+float ReconstructOpticalDepth(float4 opacityLow, float4 opacityHigh, float normalizedDepth)
+{
+	float depth = saturate(normalizedDepth);
+	float3 frequencies = 6.28318530718f * float3(1.0f, 2.0f, 3.0f);
+	float3 angles = frequencies * depth;
+	float3 cosineTerms = float3(opacityLow.z, opacityHigh.x, opacityHigh.z);
+	float3 sineTerms = float3(opacityLow.w, opacityHigh.y, opacityHigh.w);
+	float opticalDepth = 0.5f * opacityLow.y * depth + dot((cosineTerms * sin(angles) + sineTerms * (1.0f - cos(angles))) / frequencies, float3(1.0f, 1.0f, 1.0f));
+	return clamp(opticalDepth, 0.0f, 0.5f * opacityLow.y);
+}
+
+//------------------------------------------------------------------------------------------------
+float SampleVoxelShadowMap(Texture2D<float4> opacityMap, SamplerState opacitySampler, float3 worldPos)
+{
+	float4 lightClipPos = mul(LightViewProj, float4(worldPos, 1));
+	float2 shadowUV = 0.5 * lightClipPos.xy / lightClipPos.w + 0.5;
+	shadowUV.y = 1.0 - shadowUV.y;
+	float depthInLight = lightClipPos.z / lightClipPos.w;
+
+	uint atlasWidth, atlasHeight;
+	opacityMap.GetDimensions(atlasWidth, atlasHeight);
+	float2 mapSize = float2(atlasWidth, (atlasHeight - 1) / 2);
+	float2 depthRange = opacityMap.Load(int3(0, atlasHeight - 1, 0)).xy;
+
+	// Clamped half a texel inside the half so the filter never reaches the other one
+	float2 texel = clamp(saturate(shadowUV) * mapSize, float2(0.5f, 0.5f), mapSize - 0.5f);
+	float4 opacityLow = opacityMap.Sample(opacitySampler, texel / float2(atlasWidth, atlasHeight));
+	float4 opacityHigh = opacityMap.Sample(opacitySampler, (texel + float2(0.0f, mapSize.y)) / float2(atlasWidth, atlasHeight));
+	return exp(-ReconstructOpticalDepth(opacityLow, opacityHigh, (depthInLight - depthRange.x) / (depthRange.y - depthRange.x)));
+}
+
 //------------------------------------------------------------------------------------------------
 float4 PixelMain(v2p_t input) : SV_Target0
 {
@@ -101,49 +135,15 @@ for (int x = -1; x <= 1; ++x)
 float geomShadow = geomShadowSum / numSamples;
 
 //----------------------------------------------
-// Voxel Shadow PCF (using voxelShadowMap)
-// The voxel shadow map stores:
-//    R = earliest depth where density starts,
-//    G = total density accumulated,
-//    B = last depth of density.
-// Our goal:
-//   - If depthInLight is less than voxelData.r, no density has accumulated (fully lit).
-//   - If depthInLight is greater than voxelData.b, apply full voxel density shadowing.
-//   - Otherwise, leave it as fully lit for now (you can later add interpolation if desired).
-float voxelShadowSum = 0.0;
-numSamples = 0;
-for (int x = -1; x <= 1; ++x)
+// Voxel Shadow (Fourier opacity map from CloudShadowShader)
+// The series is linear in the cloud density, so a single bilinear fetch per half filters it; no PCF needed.
+float voxelShadow = SampleVoxelShadowMap(voxelShadowMap, diffuseSampler, input.worldPos);
+
+// Clamp to a minimum light value (e.g., 0.2) if desired.
+if (voxelShadow <= minLightValue)
 {
-    for (int y = -1; y <= 1; ++y)
-    {
-        float2 offset = float2(x, y) * texelSize;
-        float4 voxelData = voxelShadowMap.Sample(diffuseSampler, clampUV + offset);
-        float sampleVoxelShadow = 1.0f;
-        
-        if (depthInLight < voxelData.r)
-        {
-            sampleVoxelShadow = 1.0f; // Before density accumulation.
-        }
-        else if (depthInLight > voxelData.b)
-        {
-            sampleVoxelShadow = 1.0f - voxelData.g; // Full density applied.
-        }
-        else
-        {
-            sampleVoxelShadow = 1.0f; // In betweenno change for now.
-        }
-
-        // Clamp to a minimum light value (e.g., 0.2) if desired.
-        if (sampleVoxelShadow <= minLightValue)
-        {
-            sampleVoxelShadow = minLightValue;
-        }
-        
-        voxelShadowSum += sampleVoxelShadow;
-        numSamples++;
-    }
+    voxelShadow = minLightValue;
 }
-float voxelShadow = voxelShadowSum / numSamples;
 
 //----------------------------------------------
 // Combine the two shadow contributions
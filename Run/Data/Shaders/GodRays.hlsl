@@ -91,6 +91,11 @@ float3 CalculateGodRays(float2 uv)
     float3 samplePos = rayOrigin;
     float3 godRayAccum = float3(0, 0, 0);
 
+    // First cloud depth is in the top half of the opacity map atlas (two halves over a depth range row)
+    uint atlasWidth, atlasHeight;
+    ShadowMapTexture.GetDimensions(atlasWidth, atlasHeight);
+    float topHalfScale = float((atlasHeight - 1) / 2) / float(atlasHeight);
+
     for (int i = 0; i < numSteps; i++)
     {
         float4 lightSpace = mul(LightViewProj, float4(samplePos, 1.0));
@@ -101,7 +106,7 @@ float3 CalculateGodRays(float2 uv)
         if (any(shadowUV < 0.0f) || any(shadowUV > 1.0f))
             break;
 
-        float shadowDepth = ShadowMapTexture.Sample(samplerState, shadowUV).r;
+        float shadowDepth = ShadowMapTexture.Sample(samplerState, float2(shadowUV.x, shadowUV.y * topHalfScale)).r;
         bool inShadow = sampleDepth > shadowDepth + 0.001;
         
         if(!inShadow)